@@ -12,11 +12,13 @@
 
 #import "RVFileLogFormatter.h"
 #import "RVLogFileManager.h"
+#import "RVLogFileReader.h"
 #import "RVLogFormattter.h"
 #import "RVDebugViewController.h"
 #import "RVDebugFloatWindow.h"
 #import "RVDebugWindow.h"
 #import "RVLogFileTableViewController.h"
+#import "RVLogReaderViewController.h"
 #import "RVLogService.h"
 #import "CocoaVVLog.h"
 #import "VVASLLogger.h"
@@ -24,17 +26,23 @@
 #import "VVFileLogger+Internal.h"
 #import "VVFileLogger.h"
 #import "VVLog.h"
+#import "VVLogBlockFile.h"
 #import "VVLoggerNames.h"
 #import "VVLogMacros.h"
+#import "VVLogRecord.h"
+#import "VVLogRecordFormat.h"
+#import "VVMappedLogBuffer.h"
 #import "VVOSLogger.h"
 #import "RVOnlyLog.h"
 #import "RVFileStream.h"
 #import "RVLogUploadConfigModel.h"
 #import "RVLogUploadSettingModel.h"
+#import "RVLogZipSource.h"
 #import "RVLogUploadManager.h"
 #import "RVLogUploadNetManager.h"
 #import "vv_mz.h"
 #import "vv_mz_compat.h"
+#import "vv_mz_crc32.h"
 #import "vv_mz_crypt.h"
 #import "vv_mz_os.h"
 #import "vv_mz_strm.h"
@@ -70,8 +78,13 @@
 #import "RVRequestManager.h"
 #import "RVNetUtils.h"
 #import "RVResponseParser.h"
+#import "RSICMPPacketPool.h"
+#import "RSNetChecksum.h"
 #import "RSNetDiagnosisHelper.h"
+#import "RSAddressSelector.h"
+#import "RSDNSClient.h"
 #import "RSDomainLookup.h"
+#import "RSHostResolver.h"
 #import "RSPing.h"
 #import "RSPingService.h"
 #import "RSPingConclusion.h"
@@ -79,10 +92,13 @@
 #import "AFRVSDKNetworkReachabilityManager.h"
 #import "RSNetDetector.h"
 #import "RSTCPPing.h"
+#import "RSTCPProbeEngine.h"
 #import "log4cplus.h"
 #import "RSNetInfoUtils.h"
 #import "RSNetReachability.h"
 #import "RSAsyncTaskQueue.h"
+#import "RSICMPReactor.h"
+#import "RSLatencyStatistics.h"
 #import "RSNetDiagnosisLog.h"
 #import "RSNetQueue.h"
 #import "RSICMPTraceRoute.h"
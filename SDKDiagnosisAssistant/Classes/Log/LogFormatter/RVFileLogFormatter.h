@@ -11,7 +11,9 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
-@interface RVFileLogFormatter : NSObject<VVLogFormatter>
+/// 格式：yyyy.MM.dd-HH.mm.ss.SSS 时区[等级] 内容
+/// 时间取log产生时的时间戳，日期部分每秒只格式化一次，直接以UTF-8字节写给文件logger
+@interface RVFileLogFormatter : NSObject<VVLogDataFormatter>
 
 @end
 
@@ -7,41 +7,143 @@
 //
 
 #import "RVFileLogFormatter.h"
+#import <os/lock.h>
+
+/// "yyyy.MM.dd-HH.mm.ss"
+#define kRVTimePrefixMaxLength  32
+/// " GMT+8"
+#define kRVTimeZoneMaxLength    32
+
+@interface RVFileLogFormatter ()
+{
+    os_unfair_lock _lock;
+    NSDateFormatter *_dateFormatter;
+    NSDateFormatter *_zoneFormatter;
+    /// 缓存对应的秒
+    NSTimeInterval _cachedSecond;
+    char _cachedPrefix[kRVTimePrefixMaxLength];
+    size_t _cachedPrefixLength;
+    char _cachedZone[kRVTimeZoneMaxLength];
+    size_t _cachedZoneLength;
+}
+@end
 
 @implementation RVFileLogFormatter
 
- - (NSString *)formatLogMessage:(VVLogMessage *)logMessage {
-     NSString *logLevel = nil;
-     switch (logMessage->_flag) {
-         case VVLogFlagError:
-             logLevel = @"E";
-             break;
-         case VVLogFlagWarning:
-             logLevel = @"W";
-             break;
-         case VVLogFlagInfo:
-             logLevel = @"I";
-             break;
-         case VVLogFlagDebug:
-             logLevel = @"D";
-             break;
-         default:
-             logLevel = @"V";
-             break;
-     }
-     NSString *formatLog = [NSString stringWithFormat:@"%@[%@] %@",[self getTimeStringWithDate:logMessage->_timestamp], logLevel, logMessage->_message];
-     return formatLog;
- }
-
-
-- (NSString *)getTimeStringWithDate:(NSDate *)date {
-    static NSDateFormatter *dateFormatter;
-    static dispatch_once_t onceToken;
-    dispatch_once(&onceToken, ^{
-        dateFormatter = [NSDateFormatter new];
-        [dateFormatter setDateFormat:@"yyyy.MM.dd-HH.mm.ss.S z"];
-    });
-    return [dateFormatter stringFromDate:NSDate.date];
+- (instancetype)init {
+    if (self = [super init]) {
+        _lock = OS_UNFAIR_LOCK_INIT;
+        _dateFormatter = [NSDateFormatter new];
+        [_dateFormatter setDateFormat:@"yyyy.MM.dd-HH.mm.ss"];
+        _zoneFormatter = [NSDateFormatter new];
+        [_zoneFormatter setDateFormat:@" z"];
+        _cachedSecond = -1;
+    }
+    return self;
+}
+
+- (NSString *)formatLogMessage:(VVLogMessage *)logMessage {
+    NSMutableData *buffer = [NSMutableData dataWithCapacity:256];
+    if (![self appendLogMessage:logMessage toBuffer:buffer]) {
+        return nil;
+    }
+    // 去掉结尾换行，由logger决定是否追加
+    return [[NSString alloc] initWithBytes:buffer.bytes length:buffer.length - 1 encoding:NSUTF8StringEncoding];
+}
+
+- (BOOL)appendLogMessage:(VVLogMessage *)logMessage toBuffer:(NSMutableData *)buffer {
+    NSString *message = logMessage.message;
+    NSTimeInterval timestamp = [logMessage->_timestamp timeIntervalSince1970];
+    NSTimeInterval second = floor(timestamp);
+    unsigned int millisecond = (unsigned int)((timestamp - second) * 1000);
+    if (millisecond > 999) {
+        millisecond = 999;
+    }
+
+    char level;
+    switch (logMessage->_flag) {
+        case VVLogFlagError:
+            level = 'E';
+            break;
+        case VVLogFlagWarning:
+            level = 'W';
+            break;
+        case VVLogFlagInfo:
+            level = 'I';
+            break;
+        case VVLogFlagDebug:
+            level = 'D';
+            break;
+        default:
+            level = 'V';
+            break;
+    }
+
+    // 头部：日期 + .毫秒 + 时区 + [等级] + 空格
+    char header[kRVTimePrefixMaxLength + kRVTimeZoneMaxLength + 16];
+    size_t headerLength = 0;
+
+    os_unfair_lock_lock(&_lock);
+    if (second != _cachedSecond) {
+        [self updateCacheWithSecond:second];
+    }
+    memcpy(header, _cachedPrefix, _cachedPrefixLength);
+    headerLength += _cachedPrefixLength;
+    header[headerLength++] = '.';
+    header[headerLength++] = '0' + millisecond / 100;
+    header[headerLength++] = '0' + millisecond / 10 % 10;
+    header[headerLength++] = '0' + millisecond % 10;
+    memcpy(header + headerLength, _cachedZone, _cachedZoneLength);
+    headerLength += _cachedZoneLength;
+    os_unfair_lock_unlock(&_lock);
+
+    header[headerLength++] = '[';
+    header[headerLength++] = level;
+    header[headerLength++] = ']';
+    header[headerLength++] = ' ';
+    [buffer appendBytes:header length:headerLength];
+
+    // 内容：ASCII/UTF-8存储的字符串直接拷贝，其余一次性转码写入buffer
+    const char *utf8 = message ? CFStringGetCStringPtr((__bridge CFStringRef)message, kCFStringEncodingUTF8) : NULL;
+    if (utf8) {
+        [buffer appendBytes:utf8 length:strlen(utf8)];
+    } else if (message.length > 0) {
+        NSUInteger start = buffer.length;
+        NSUInteger maxLength = [message maximumLengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+        buffer.length = start + maxLength;
+        NSUInteger usedLength = 0;
+        [message getBytes:(char *)buffer.mutableBytes + start
+                maxLength:maxLength
+               usedLength:&usedLength
+                 encoding:NSUTF8StringEncoding
+                  options:0
+                    range:NSMakeRange(0, message.length)
+           remainingRange:NULL];
+        buffer.length = start + usedLength;
+    }
+
+    const char *bytes = buffer.bytes;
+    if (bytes[buffer.length - 1] != '\n') {
+        [buffer appendBytes:"\n" length:1];
+    }
+    return YES;
+}
+
+/// 每秒只调用一次NSDateFormatter
+- (void)updateCacheWithSecond:(NSTimeInterval)second {
+    NSDate *date = [NSDate dateWithTimeIntervalSince1970:second];
+
+    NSString *prefix = [_dateFormatter stringFromDate:date];
+    NSUInteger prefixLength = 0;
+    [prefix getBytes:_cachedPrefix maxLength:kRVTimePrefixMaxLength usedLength:&prefixLength encoding:NSUTF8StringEncoding options:0 range:NSMakeRange(0, prefix.length) remainingRange:NULL];
+    _cachedPrefixLength = prefixLength;
+
+    NSString *zone = [_zoneFormatter stringFromDate:date];
+    NSUInteger zoneLength = 0;
+    [zone getBytes:_cachedZone maxLength:kRVTimeZoneMaxLength usedLength:&zoneLength encoding:NSUTF8StringEncoding options:0 range:NSMakeRange(0, zone.length) remainingRange:NULL];
+    _cachedZoneLength = zoneLength;
+
+    _cachedSecond = second;
 }
 
 @end
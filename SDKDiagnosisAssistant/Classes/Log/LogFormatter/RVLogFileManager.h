@@ -11,6 +11,18 @@ NS_ASSUME_NONNULL_BEGIN
 
 @interface RVLogFileManager : VVLogFileManagerDefault
 
+/// 新建的log文件是否为二进制格式(.vvlog)，需和VVFileLogger的writesBinaryRecords一致
+@property (atomic, assign) BOOL binaryLogFiles;
+
+/// 新建的log文件是否按块压缩(后缀加z：.logz/.vvlogz)，需和VVFileLogger的compressesLogFiles一致
+@property (atomic, assign) BOOL compressedLogFiles;
+
+/// 可阅读的log文件路径：压缩或二进制log解压解码到临时目录的同名.log文件，文本log原样返回
++ (NSString *)readableLogFilePath:(NSString *)filePath;
+
+/// 读取log文件的文本内容，压缩或二进制log会先解压解码
++ (nullable NSString *)readLogFileText:(NSString *)filePath;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -7,6 +7,8 @@
 
 #import "RVLogFileManager.h"
 #import "RSXToolSet.h"
+#import "VVLogRecordFormat.h"
+#import "VVLogBlockFile.h"
 
 @implementation RVLogFileManager
 
@@ -17,13 +19,19 @@
     
     NSString *timeStamp = [self getTimestamp];
     
-    return [NSString stringWithFormat:@"%@.log", timeStamp];
+    NSString *extension = self.binaryLogFiles ? @"vvlog" : @"log";
+    if (self.compressedLogFiles) {
+        extension = [extension stringByAppendingString:@"z"];
+    }
+    
+    return [NSString stringWithFormat:@"%@.%@", timeStamp, extension];
 }
 
 /// 判断是否是log文件
 - (BOOL)isLogFile:(NSString *)fileName {
     
-    BOOL hasProperSuffix = [fileName hasSuffix:@".log"];
+    NSString *extension = fileName.pathExtension;
+    BOOL hasProperSuffix = [@[@"log", @"vvlog", @"logz", @"vvlogz"] containsObject:extension];
     
     return hasProperSuffix;
 }
@@ -37,6 +45,41 @@
     return logsDirectory;
 }
 
+#pragma mark - 二进制和压缩log
+
++ (NSString *)readableLogFilePath:(NSString *)filePath {
+    BOOL isCompressed = [VVLogBlockFile isBlockFileAtPath:filePath];
+    if (!isCompressed && ![VVLogRecordDecoder isRecordFileAtPath:filePath]) {
+        return filePath;
+    }
+    
+    NSString *text = [self readLogFileText:filePath];
+    NSString *fileName = [[filePath.lastPathComponent stringByDeletingPathExtension] stringByAppendingPathExtension:@"log"];
+    NSString *textPath = [NSTemporaryDirectory() stringByAppendingPathComponent:fileName];
+    if (![text writeToFile:textPath atomically:YES encoding:NSUTF8StringEncoding error:nil]) {
+        return filePath;
+    }
+    return textPath;
+}
+
++ (NSString *)readLogFileText:(NSString *)filePath {
+    NSData *data = nil;
+    if ([VVLogBlockFile isBlockFileAtPath:filePath]) {
+        VVLogBlockFile *blockFile = [[VVLogBlockFile alloc] initWithPath:filePath error:nil];
+        data = [blockFile dataWithError:nil];
+    } else {
+        data = [NSData dataWithContentsOfFile:filePath options:NSDataReadingMappedIfSafe error:nil];
+    }
+    if (!data) {
+        return nil;
+    }
+    
+    if ([VVLogRecordDecoder isRecordData:data]) {
+        return [VVLogRecordDecoder textWithData:data error:nil];
+    }
+    return [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+}
+
 #pragma mark - 内部方法
 
 - (NSString *)getTimestamp {
@@ -0,0 +1,69 @@
+//
+//  RVLogFileReader.h
+//
+//  Created by Ron-Samkulami on 2023/12/26.
+//  Copyright © 2023 Ron-Samkulami. All rights reserved.
+//  按页读取log文件：文件内存映射，行索引按需建立，不把整个文件转成NSString
+
+#import "RVOnlyLog.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// 一页log
+@interface RVLogPage : NSObject
+
+/// 本页的行，按文件中的先后顺序
+@property (nonatomic, copy, readonly) NSArray<NSString *> *lines;
+/// 本页第一行的起始字节位置，传给pageBeforeOffset:往前翻页
+@property (nonatomic, assign, readonly) unsigned long long startOffset;
+/// 本页最后一行之后的字节位置，传给pageFromOffset:往后翻页
+@property (nonatomic, assign, readonly) unsigned long long endOffset;
+
+@end
+
+/**
+ * log文件的分页读取
+ *
+ * 一行指一条log：以RVFileLogFormatter的时间开头的一行，加上它后面不以时间开头的行(多行log的内容)。
+ * 文件在创建时映射，之后写入的内容不可见，需要重新创建。
+ * 二进制和压缩log会先解码到临时目录的文本文件(RVLogFileManager readableLogFilePath:)。
+ * 非线程安全，需在同一线程或串行队列使用。
+ */
+@interface RVLogFileReader : NSObject
+
+/// 文件无法读取时返回nil
+- (nullable instancetype)initWithFilePath:(NSString *)filePath;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/// 传入的文件路径
+@property (nonatomic, copy, readonly) NSString *filePath;
+/// 映射的字节数
+@property (nonatomic, assign, readonly) unsigned long long length;
+
+/// 过滤等级，按RVFileLogFormatter写入的[E][W][I][D][V]匹配，0表示不过滤。默认0
+@property (nonatomic, assign) VVLogFlag levelFilter;
+/// 过滤内容，按UTF-8字节区分大小写匹配，nil或空表示不过滤。默认nil
+@property (nonatomic, copy, nullable) NSString *substringFilter;
+
+/// 最后maxLines条符合过滤条件的log，只从文件尾部往前扫描
+- (RVLogPage *)tailPageWithMaxLines:(NSUInteger)maxLines;
+
+/// offset之前最多maxLines条符合过滤条件的log，offset需为某页的startOffset或文件长度
+- (RVLogPage *)pageBeforeOffset:(unsigned long long)offset maxLines:(NSUInteger)maxLines;
+
+/// offset开始最多maxLines条符合过滤条件的log，offset需为某页的endOffset或0
+- (RVLogPage *)pageFromOffset:(unsigned long long)offset maxLines:(NSUInteger)maxLines;
+
+/// log条数，第一次调用时为整个文件建立行索引
+- (NSUInteger)numberOfLines;
+
+/// 行号区间内符合过滤条件的log，只为区间之前的部分建立行索引
+- (RVLogPage *)pageWithLineRange:(NSRange)range;
+
+/// 时间区间内最多maxLines条符合过滤条件的log，按时间二分查找起点，要求文件内时间递增
+- (RVLogPage *)pageFromDate:(NSDate *)fromDate toDate:(NSDate *)toDate maxLines:(NSUInteger)maxLines;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,370 @@
+//
+//  RVLogFileReader.m
+//
+//  Created by Ron-Samkulami on 2023/12/26.
+//  Copyright © 2023 Ron-Samkulami. All rights reserved.
+//
+
+#import "RVLogFileReader.h"
+#import "RVLogFileManager.h"
+
+/// "yyyy.MM.dd-HH.mm.ss.SSS"
+#define kRVLogTimeLength        23
+/// 时间之后到[等级]之间最多的字节数，" GMT+05:30"
+#define kRVLogTagSearchLength   16
+
+#pragma mark - 字节扫描
+
+/// 是否以"yyyy.MM.dd-"开头，即一条log的第一行
+static BOOL RVLogIsLineStart(const char *bytes, NSUInteger length, NSUInteger offset) {
+    if (length - offset < 11) {
+        return NO;
+    }
+    const char *p = bytes + offset;
+    static const char pattern[] = "dddd.dd.dd-";
+    for (int i = 0; i < 11; i++) {
+        BOOL matches = pattern[i] == 'd' ? (p[i] >= '0' && p[i] <= '9') : p[i] == pattern[i];
+        if (!matches) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+/// offset所在的物理行之后下一物理行的起始位置
+static NSUInteger RVLogNextPhysicalLine(const char *bytes, NSUInteger length, NSUInteger offset) {
+    const char *newline = memchr(bytes + offset, '\n', length - offset);
+    return newline ? (NSUInteger)(newline - bytes) + 1 : length;
+}
+
+/// 从offset(一条log的开头)开始，下一条log的起始位置
+static NSUInteger RVLogNextLineStart(const char *bytes, NSUInteger length, NSUInteger offset) {
+    NSUInteger next = RVLogNextPhysicalLine(bytes, length, offset);
+    while (next < length && !RVLogIsLineStart(bytes, length, next)) {
+        next = RVLogNextPhysicalLine(bytes, length, next);
+    }
+    return next;
+}
+
+/// offset(一条log的开头或文件末尾)之前一条log的起始位置，offset为0时返回0
+static NSUInteger RVLogPreviousLineStart(const char *bytes, NSUInteger length, NSUInteger offset) {
+    NSUInteger start = offset;
+    while (start > 0) {
+        // 跳过上一行的换行符，往前找到再上一个换行符
+        NSUInteger cursor = start - 1;
+        while (cursor > 0 && bytes[cursor - 1] != '\n') {
+            cursor--;
+        }
+        start = cursor;
+        if (RVLogIsLineStart(bytes, length, start)) {
+            break;
+        }
+    }
+    return start;
+}
+
+/// offset之后(含)第一条log的起始位置
+static NSUInteger RVLogLineStartAtOrAfter(const char *bytes, NSUInteger length, NSUInteger offset) {
+    if (offset == 0) {
+        return 0;
+    }
+    // 先对齐到物理行
+    NSUInteger start = bytes[offset - 1] == '\n' ? offset : RVLogNextPhysicalLine(bytes, length, offset);
+    while (start < length && !RVLogIsLineStart(bytes, length, start)) {
+        start = RVLogNextPhysicalLine(bytes, length, start);
+    }
+    return start;
+}
+
+static BOOL RVLogReadDigits(const char *p, int count, int *value) {
+    int result = 0;
+    for (int i = 0; i < count; i++) {
+        if (p[i] < '0' || p[i] > '9') {
+            return NO;
+        }
+        result = result * 10 + (p[i] - '0');
+    }
+    *value = result;
+    return YES;
+}
+
+/// 公历日期到1970-01-01的天数
+static int64_t RVLogDaysFromCivil(int64_t year, int month, int day) {
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t yearOfEra = year - era * 400;
+    int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+/// 解析一条log开头的"yyyy.MM.dd-HH.mm.ss.SSS GMT+8"，没有时区时按本地时区
+static BOOL RVLogReadTimestamp(const char *bytes, NSUInteger length, NSUInteger offset, NSTimeInterval *timestamp) {
+    if (length - offset < kRVLogTimeLength) {
+        return NO;
+    }
+    const char *p = bytes + offset;
+    int year, month, day, hour, minute, second, millisecond;
+    if (!RVLogReadDigits(p, 4, &year) || !RVLogReadDigits(p + 5, 2, &month) || !RVLogReadDigits(p + 8, 2, &day)
+        || !RVLogReadDigits(p + 11, 2, &hour) || !RVLogReadDigits(p + 14, 2, &minute)
+        || !RVLogReadDigits(p + 17, 2, &second) || !RVLogReadDigits(p + 20, 3, &millisecond)) {
+        return NO;
+    }
+
+    NSInteger secondsFromGMT = [NSTimeZone localTimeZone].secondsFromGMT;
+    const char *zone = p + kRVLogTimeLength;
+    const char *end = bytes + length;
+    if (end - zone >= 4 && memcmp(zone, " GMT", 4) == 0) {
+        secondsFromGMT = 0;
+        const char *cursor = zone + 4;
+        if (cursor < end && (*cursor == '+' || *cursor == '-')) {
+            int sign = *cursor == '-' ? -1 : 1;
+            int hours = 0, minutes = 0;
+            cursor++;
+            while (cursor < end && *cursor >= '0' && *cursor <= '9') {
+                hours = hours * 10 + (*cursor++ - '0');
+            }
+            if (cursor + 2 < end && *cursor == ':') {
+                RVLogReadDigits(cursor + 1, 2, &minutes);
+            }
+            secondsFromGMT = sign * (hours * 3600 + minutes * 60);
+        }
+    }
+
+    int64_t seconds = RVLogDaysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+    *timestamp = (NSTimeInterval)(seconds - secondsFromGMT) + millisecond / 1000.0;
+    return YES;
+}
+
+/// 一条log的等级标记[E][W][I][D][V]，没有时返回0
+static VVLogFlag RVLogReadFlag(const char *bytes, NSUInteger lineStart, NSUInteger lineEnd) {
+    NSUInteger from = lineStart + kRVLogTimeLength;
+    NSUInteger to = MIN(lineEnd, from + kRVLogTagSearchLength + 3);
+    for (NSUInteger i = from; i + 2 < to; i++) {
+        if (bytes[i] != '[' || bytes[i + 2] != ']') {
+            continue;
+        }
+        switch (bytes[i + 1]) {
+            case 'E': return VVLogFlagError;
+            case 'W': return VVLogFlagWarning;
+            case 'I': return VVLogFlagInfo;
+            case 'D': return VVLogFlagDebug;
+            case 'V': return VVLogFlagVerbose;
+            default: break;
+        }
+    }
+    return 0;
+}
+
+#pragma mark - RVLogPage
+
+@interface RVLogPage ()
+
+@property (nonatomic, copy, readwrite) NSArray<NSString *> *lines;
+@property (nonatomic, assign, readwrite) unsigned long long startOffset;
+@property (nonatomic, assign, readwrite) unsigned long long endOffset;
+
+@end
+
+@implementation RVLogPage
+
+@end
+
+#pragma mark - RVLogFileReader
+
+@interface RVLogFileReader ()
+{
+    /// 映射的文件内容
+    NSData *_data;
+    const char *_bytes;
+    NSUInteger _length;
+    /// 已建立索引的每条log的起始位置(NSUInteger)
+    NSMutableData *_lineStarts;
+    /// 行索引已扫描到的位置
+    NSUInteger _indexedOffset;
+    /// 过滤内容的UTF-8字节
+    NSData *_substringBytes;
+}
+@end
+
+@implementation RVLogFileReader
+
+- (instancetype)initWithFilePath:(NSString *)filePath {
+    if (self = [super init]) {
+        _filePath = [filePath copy];
+        // 二进制和压缩log先解码成文本
+        NSString *readablePath = [RVLogFileManager readableLogFilePath:filePath];
+        NSError *error = nil;
+        _data = [NSData dataWithContentsOfFile:readablePath options:NSDataReadingMappedAlways error:&error];
+        if (!_data) {
+            NSLogWarn(@"RVLogFileReader 读取失败 %@ error=%@", filePath, error);
+            return nil;
+        }
+        _bytes = _data.bytes;
+        _length = _data.length;
+        _lineStarts = [NSMutableData data];
+    }
+    return self;
+}
+
+- (unsigned long long)length {
+    return _length;
+}
+
+- (void)setSubstringFilter:(NSString *)substringFilter {
+    _substringFilter = [substringFilter copy];
+    _substringBytes = substringFilter.length > 0 ? [substringFilter dataUsingEncoding:NSUTF8StringEncoding] : nil;
+}
+
+#pragma mark 分页
+
+- (RVLogPage *)tailPageWithMaxLines:(NSUInteger)maxLines {
+    return [self pageBeforeOffset:_length maxLines:maxLines];
+}
+
+- (RVLogPage *)pageBeforeOffset:(unsigned long long)offset maxLines:(NSUInteger)maxLines {
+    NSUInteger end = (NSUInteger)MIN(offset, (unsigned long long)_length);
+    NSUInteger cursor = end;
+    NSMutableArray<NSString *> *lines = [NSMutableArray arrayWithCapacity:maxLines];
+
+    while (cursor > 0 && lines.count < maxLines) {
+        NSUInteger start = RVLogPreviousLineStart(_bytes, _length, cursor);
+        NSString *line = [self lineIfMatchingFrom:start to:cursor];
+        if (line) {
+            [lines addObject:line];
+        }
+        cursor = start;
+    }
+
+    return [self pageWithLines:lines.reverseObjectEnumerator.allObjects start:cursor end:end];
+}
+
+- (RVLogPage *)pageFromOffset:(unsigned long long)offset maxLines:(NSUInteger)maxLines {
+    NSUInteger start = (NSUInteger)MIN(offset, (unsigned long long)_length);
+    NSUInteger cursor = start;
+    NSMutableArray<NSString *> *lines = [NSMutableArray arrayWithCapacity:maxLines];
+
+    while (cursor < _length && lines.count < maxLines) {
+        NSUInteger next = RVLogNextLineStart(_bytes, _length, cursor);
+        NSString *line = [self lineIfMatchingFrom:cursor to:next];
+        if (line) {
+            [lines addObject:line];
+        }
+        cursor = next;
+    }
+
+    return [self pageWithLines:lines start:start end:cursor];
+}
+
+- (NSUInteger)numberOfLines {
+    [self indexLinesThroughLine:NSUIntegerMax];
+    return _lineStarts.length / sizeof(NSUInteger);
+}
+
+- (RVLogPage *)pageWithLineRange:(NSRange)range {
+    // 多索引一行，得到区间最后一行的结束位置
+    NSUInteger last = range.length > 0 ? NSMaxRange(range) : range.location;
+    [self indexLinesThroughLine:last];
+
+    const NSUInteger *starts = _lineStarts.bytes;
+    NSUInteger count = _lineStarts.length / sizeof(NSUInteger);
+    NSUInteger from = MIN(range.location, count);
+    NSUInteger to = MIN(NSMaxRange(range), count);
+
+    NSMutableArray<NSString *> *lines = [NSMutableArray arrayWithCapacity:to - from];
+    for (NSUInteger i = from; i < to; i++) {
+        NSUInteger end = i + 1 < count ? starts[i + 1] : _length;
+        NSString *line = [self lineIfMatchingFrom:starts[i] to:end];
+        if (line) {
+            [lines addObject:line];
+        }
+    }
+
+    NSUInteger start = from < count ? starts[from] : _length;
+    NSUInteger end = to < count ? starts[to] : _length;
+    return [self pageWithLines:lines start:start end:end];
+}
+
+- (RVLogPage *)pageFromDate:(NSDate *)fromDate toDate:(NSDate *)toDate maxLines:(NSUInteger)maxLines {
+    NSTimeInterval from = fromDate.timeIntervalSince1970;
+    NSTimeInterval to = toDate.timeIntervalSince1970;
+
+    // 二分查找时间不早于from的第一条log，每次只解析一行的时间
+    NSUInteger low = 0, high = _length;
+    while (low < high) {
+        NSUInteger middle = low + (high - low) / 2;
+        NSUInteger start = RVLogLineStartAtOrAfter(_bytes, _length, middle);
+        NSTimeInterval timestamp = 0;
+        BOOL isAfter = start >= _length
+            || (RVLogReadTimestamp(_bytes, _length, start, &timestamp) && timestamp >= from);
+        if (isAfter) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+
+    NSUInteger start = RVLogLineStartAtOrAfter(_bytes, _length, low);
+    NSUInteger cursor = start;
+    NSMutableArray<NSString *> *lines = [NSMutableArray arrayWithCapacity:maxLines];
+
+    while (cursor < _length && lines.count < maxLines) {
+        NSTimeInterval timestamp = 0;
+        if (RVLogReadTimestamp(_bytes, _length, cursor, &timestamp) && timestamp > to) {
+            break;
+        }
+        NSUInteger next = RVLogNextLineStart(_bytes, _length, cursor);
+        NSString *line = [self lineIfMatchingFrom:cursor to:next];
+        if (line) {
+            [lines addObject:line];
+        }
+        cursor = next;
+    }
+
+    return [self pageWithLines:lines start:start end:cursor];
+}
+
+#pragma mark 内部方法
+
+- (RVLogPage *)pageWithLines:(NSArray<NSString *> *)lines start:(NSUInteger)start end:(NSUInteger)end {
+    RVLogPage *page = [RVLogPage new];
+    page.lines = lines;
+    page.startOffset = start;
+    page.endOffset = end;
+    return page;
+}
+
+/// 建立行索引，直到有line + 1行或到文件末尾
+- (void)indexLinesThroughLine:(NSUInteger)line {
+    NSUInteger count = _lineStarts.length / sizeof(NSUInteger);
+    while (count <= line && _indexedOffset < _length) {
+        NSUInteger start = _indexedOffset;
+        [_lineStarts appendBytes:&start length:sizeof(start)];
+        count++;
+        _indexedOffset = RVLogNextLineStart(_bytes, _length, start);
+    }
+}
+
+/// [start, end)这条log符合过滤条件时返回其内容，不含结尾换行
+- (nullable NSString *)lineIfMatchingFrom:(NSUInteger)start to:(NSUInteger)end {
+    if (end > start && _bytes[end - 1] == '\n') {
+        end--;
+    }
+
+    if (_levelFilter != 0) {
+        NSUInteger firstLineEnd = RVLogNextPhysicalLine(_bytes, end, start);
+        if (!(RVLogReadFlag(_bytes, start, firstLineEnd) & _levelFilter)) {
+            return nil;
+        }
+    }
+
+    if (_substringBytes && !memmem(_bytes + start, end - start, _substringBytes.bytes, _substringBytes.length)) {
+        return nil;
+    }
+
+    // 崩溃时可能截断在多字节字符中间，按Latin1兜底
+    return [[NSString alloc] initWithBytes:_bytes + start length:end - start encoding:NSUTF8StringEncoding]
+        ?: [[NSString alloc] initWithBytes:_bytes + start length:end - start encoding:NSISOLatin1StringEncoding];
+}
+
+@end
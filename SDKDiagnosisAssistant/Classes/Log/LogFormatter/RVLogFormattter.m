@@ -35,7 +35,7 @@
              logLevel = @"V";
              break;
      }
-     NSString *formatLog = [NSString stringWithFormat:@"[XXSDK] %@ %@",logLevel,logMessage->_message];
+     NSString *formatLog = [NSString stringWithFormat:@"[XXSDK] %@ %@",logLevel,logMessage.message];
 
      if (_isDebugMode == NO) {
          return formatLog;
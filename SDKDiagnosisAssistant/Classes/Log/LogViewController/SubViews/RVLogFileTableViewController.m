@@ -7,8 +7,10 @@
 
 #import "RVLogFileTableViewController.h"
 #import "RVOnlyLog.h"
+#import "RVLogFileManager.h"
+#import "RVLogReaderViewController.h"
 
-@interface RVLogFileTableViewController ()<UIDocumentInteractionControllerDelegate>
+@interface RVLogFileTableViewController ()
 
 @property (nonatomic,strong)NSMutableArray *fileNames;//文件名
 
@@ -203,22 +205,12 @@
 
 #pragma mark - log显示操作
 
-//显示沙盒本地log（在iOS13模拟器会报错，真机不会，这是一个苹果的bug）
+//显示沙盒本地log，从文件末尾分页读取
 - (void)displayLocalLogWithFilePath:(NSString *)filePath
 {
-    //由文件路径初始化UIDocumentInteractionController
-    UIDocumentInteractionController *documentInteractionController  = [UIDocumentInteractionController interactionControllerWithURL:[NSURL fileURLWithPath:filePath]];
-    //设置代理
-    documentInteractionController .delegate = self;
-    //显示预览界面
-    [documentInteractionController  presentPreviewAnimated:YES];
-}
-
-#pragma mark - UIDocumentInteractionControllerDelegate
-//在哪个控制器显示预览界面
--(UIViewController *)documentInteractionControllerViewControllerForPreview:(UIDocumentInteractionController *)controller
-{
-    return self;
+    RVLogReaderViewController *controller = [[RVLogReaderViewController alloc] initWithFilePath:filePath];
+    controller.modalPresentationStyle = UIModalPresentationFullScreen;
+    [self presentViewController:controller animated:YES completion:nil];
 }
 
 //MARK: - self getFileSizeStrWithPath 公用方法上浮
@@ -0,0 +1,20 @@
+//
+//  RVLogReaderViewController.h
+//
+//  Created by Ron-Samkulami on 2023/12/26.
+//  Copyright © 2023 Ron-Samkulami. All rights reserved.
+//  log内容查看界面：从文件末尾开始分页显示，上滑加载更早的log，可按等级和内容过滤
+
+#import <UIKit/UIKit.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface RVLogReaderViewController : UIViewController
+
+- (instancetype)initWithFilePath:(NSString *)filePath;
+
+@property (nonatomic, copy, readonly) NSString *filePath;
+
+@end
+
+NS_ASSUME_NONNULL_END
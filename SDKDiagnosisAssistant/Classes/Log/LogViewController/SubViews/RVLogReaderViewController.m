@@ -0,0 +1,291 @@
+//
+//  RVLogReaderViewController.m
+//
+//  Created by Ron-Samkulami on 2023/12/26.
+//  Copyright © 2023 Ron-Samkulami. All rights reserved.
+//
+
+#import "RVLogReaderViewController.h"
+#import "RVLogFileReader.h"
+
+/// 每页log条数
+static NSUInteger const kRVLogReaderPageLines = 200;
+
+@interface RVLogReaderViewController ()<UITableViewDataSource, UITableViewDelegate, UISearchBarDelegate>
+
+/// 关闭界面
+@property (nonatomic, strong) UIButton *closePageButton;
+/// 文件名
+@property (nonatomic, strong) UILabel *titleLabel;
+/// 内容过滤
+@property (nonatomic, strong) UISearchBar *searchBar;
+/// 等级过滤
+@property (nonatomic, strong) UISegmentedControl *levelSeg;
+/// log内容
+@property (nonatomic, strong) UITableView *tableView;
+
+/// 已加载的log
+@property (nonatomic, strong) NSMutableArray<NSString *> *lines;
+/// 已加载的第一条log的字节位置，为0表示已到文件开头
+@property (nonatomic, assign) unsigned long long startOffset;
+/// 是否正在加载
+@property (nonatomic, assign) BOOL isLoading;
+/// 过滤条件变化后递增，丢弃旧条件的加载结果
+@property (nonatomic, assign) NSUInteger generation;
+
+@end
+
+@implementation RVLogReaderViewController
+{
+    /// 只在_readQueue上使用
+    RVLogFileReader *_reader;
+    dispatch_queue_t _readQueue;
+}
+
+- (instancetype)initWithFilePath:(NSString *)filePath {
+    if (self = [super initWithNibName:nil bundle:nil]) {
+        _filePath = [filePath copy];
+        _lines = [NSMutableArray array];
+        _readQueue = dispatch_queue_create("com.rvlog.reader", DISPATCH_QUEUE_SERIAL);
+    }
+    return self;
+}
+
+- (void)viewDidLoad {
+    [super viewDidLoad];
+
+    [self setupUI];
+
+    // 映射文件(二进制和压缩log需要先解码)放到子线程
+    NSString *filePath = self.filePath;
+    dispatch_async(_readQueue, ^{
+        self->_reader = [[RVLogFileReader alloc] initWithFilePath:filePath];
+    });
+    [self reloadFromTail];
+}
+
+- (void)setupUI {
+    self.view.backgroundColor = [UIColor whiteColor];
+    [self.view addSubview:self.closePageButton];
+    [self.view addSubview:self.titleLabel];
+    [self.view addSubview:self.searchBar];
+    [self.view addSubview:self.levelSeg];
+    [self.view addSubview:self.tableView];
+}
+
+- (void)viewWillLayoutSubviews {
+    [super viewWillLayoutSubviews];
+    CGFloat leading = 10;
+    CGFloat padding = 5;
+    CGFloat buttonWidth = 80;
+    CGFloat rowHeight = 30;
+    CGFloat top = 20;
+    if (@available(iOS 11.0, *)) {
+        top = MAX(top, self.view.safeAreaInsets.top);
+    }
+    CGFloat width = CGRectGetWidth(self.view.bounds);
+
+    self.closePageButton.frame = CGRectMake(leading, top, buttonWidth, rowHeight);
+    self.titleLabel.frame = CGRectMake(CGRectGetMaxX(self.closePageButton.frame) + padding, top, width - buttonWidth - leading * 2 - padding, rowHeight);
+    self.searchBar.frame = CGRectMake(0, CGRectGetMaxY(self.closePageButton.frame) + padding, width, 44);
+    self.levelSeg.frame = CGRectMake(leading, CGRectGetMaxY(self.searchBar.frame) + padding, width - leading * 2, rowHeight);
+    CGFloat tableTop = CGRectGetMaxY(self.levelSeg.frame) + padding;
+    self.tableView.frame = CGRectMake(0, tableTop, width, CGRectGetHeight(self.view.bounds) - tableTop);
+}
+
+#pragma mark - 加载
+
+/// 按当前过滤条件，重新从文件末尾加载
+- (void)reloadFromTail {
+    self.generation++;
+    NSUInteger generation = self.generation;
+    VVLogFlag levelFilter = [self selectedLevelFilter];
+    NSString *substringFilter = self.searchBar.text;
+
+    self.isLoading = YES;
+    dispatch_async(_readQueue, ^{
+        RVLogFileReader *reader = self->_reader;
+        reader.levelFilter = levelFilter;
+        reader.substringFilter = substringFilter;
+        RVLogPage *page = [reader tailPageWithMaxLines:kRVLogReaderPageLines];
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (generation != self.generation) {
+                return;
+            }
+            self.isLoading = NO;
+            if (!reader) {
+                self.titleLabel.text = [NSString stringWithFormat:@"%@ 读取失败", self.filePath.lastPathComponent];
+                return;
+            }
+            [self.lines setArray:page.lines];
+            self.startOffset = page.startOffset;
+            [self.tableView reloadData];
+            [self scrollToBottom];
+        });
+    });
+}
+
+/// 加载更早的一页，插入到顶部并保持当前位置
+- (void)loadEarlierPage {
+    if (self.isLoading || self.startOffset == 0) {
+        return;
+    }
+    NSUInteger generation = self.generation;
+    unsigned long long startOffset = self.startOffset;
+
+    self.isLoading = YES;
+    dispatch_async(_readQueue, ^{
+        RVLogPage *page = [self->_reader pageBeforeOffset:startOffset maxLines:kRVLogReaderPageLines];
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (generation != self.generation) {
+                return;
+            }
+            self.isLoading = NO;
+            self.startOffset = page.startOffset;
+            if (page.lines.count == 0) {
+                return;
+            }
+
+            CGFloat distanceFromBottom = self.tableView.contentSize.height - self.tableView.contentOffset.y;
+            [self.lines insertObjects:page.lines atIndexes:[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, page.lines.count)]];
+            [self.tableView reloadData];
+            [self.tableView layoutIfNeeded];
+            self.tableView.contentOffset = CGPointMake(0, self.tableView.contentSize.height - distanceFromBottom);
+        });
+    });
+}
+
+- (void)scrollToBottom {
+    if (self.lines.count == 0) {
+        return;
+    }
+    NSIndexPath *indexPath = [NSIndexPath indexPathForRow:self.lines.count - 1 inSection:0];
+    [self.tableView scrollToRowAtIndexPath:indexPath atScrollPosition:UITableViewScrollPositionBottom animated:NO];
+}
+
+- (VVLogFlag)selectedLevelFilter {
+    switch (self.levelSeg.selectedSegmentIndex) {
+        case 1:
+            return VVLogFlagError;
+        case 2:
+            return VVLogFlagError | VVLogFlagWarning;
+        case 3:
+            return VVLogFlagError | VVLogFlagWarning | VVLogFlagInfo;
+        default:
+            return 0;
+    }
+}
+
+#pragma mark - 事件
+
+- (void)closePage {
+    if (self.presentingViewController) {
+        [self dismissViewControllerAnimated:YES completion:nil];
+    } else {
+        [self.navigationController popViewControllerAnimated:YES];
+    }
+}
+
+- (void)levelSegChanged:(UISegmentedControl *)seg {
+    [self reloadFromTail];
+}
+
+#pragma mark - UISearchBarDelegate
+
+- (void)searchBarSearchButtonClicked:(UISearchBar *)searchBar {
+    [searchBar resignFirstResponder];
+    [self reloadFromTail];
+}
+
+- (void)searchBar:(UISearchBar *)searchBar textDidChange:(NSString *)searchText {
+    // 清空时恢复全部log
+    if (searchText.length == 0) {
+        [self reloadFromTail];
+    }
+}
+
+#pragma mark - UITableViewDataSource
+
+- (NSInteger)tableView:(UITableView *)tableView numberOfRowsInSection:(NSInteger)section {
+    return self.lines.count;
+}
+
+- (UITableViewCell *)tableView:(UITableView *)tableView cellForRowAtIndexPath:(NSIndexPath *)indexPath {
+    UITableViewCell *cell = [tableView dequeueReusableCellWithIdentifier:@"RVLogReaderViewController"];
+    if (!cell) {
+        cell = [[UITableViewCell alloc] initWithStyle:UITableViewCellStyleDefault reuseIdentifier:@"RVLogReaderViewController"];
+        cell.selectionStyle = UITableViewCellSelectionStyleNone;
+        cell.textLabel.numberOfLines = 0;
+        cell.textLabel.font = [UIFont fontWithName:@"Menlo" size:11] ?: [UIFont systemFontOfSize:11];
+    }
+    cell.textLabel.text = self.lines[indexPath.row];
+    return cell;
+}
+
+#pragma mark - UITableViewDelegate
+
+- (void)scrollViewDidScroll:(UIScrollView *)scrollView {
+    // 接近顶部时加载更早的log
+    if (scrollView.isDragging && scrollView.contentOffset.y < CGRectGetHeight(scrollView.bounds)) {
+        [self loadEarlierPage];
+    }
+}
+
+#pragma mark - UI Elements
+
+- (UIButton *)closePageButton {
+    if (!_closePageButton) {
+        _closePageButton = [[UIButton alloc] initWithFrame:CGRectZero];
+        [_closePageButton setTitle:@"关闭" forState:UIControlStateNormal];
+        [_closePageButton setTitleColor:[UIColor systemBlueColor] forState:UIControlStateNormal];
+        _closePageButton.contentHorizontalAlignment = UIControlContentHorizontalAlignmentLeft;
+        [_closePageButton addTarget:self action:@selector(closePage) forControlEvents:UIControlEventTouchUpInside];
+    }
+    return _closePageButton;
+}
+
+- (UILabel *)titleLabel {
+    if (!_titleLabel) {
+        _titleLabel = [[UILabel alloc] initWithFrame:CGRectZero];
+        _titleLabel.text = self.filePath.lastPathComponent;
+        _titleLabel.font = [UIFont systemFontOfSize:14];
+        _titleLabel.lineBreakMode = NSLineBreakByTruncatingMiddle;
+    }
+    return _titleLabel;
+}
+
+- (UISearchBar *)searchBar {
+    if (!_searchBar) {
+        _searchBar = [[UISearchBar alloc] initWithFrame:CGRectZero];
+        _searchBar.placeholder = @"过滤内容(区分大小写)";
+        _searchBar.autocapitalizationType = UITextAutocapitalizationTypeNone;
+        _searchBar.autocorrectionType = UITextAutocorrectionTypeNo;
+        _searchBar.delegate = self;
+    }
+    return _searchBar;
+}
+
+- (UISegmentedControl *)levelSeg {
+    if (!_levelSeg) {
+        _levelSeg = [[UISegmentedControl alloc] initWithItems:@[@"全部", @"Error", @"Warn+", @"Info+"]];
+        _levelSeg.selectedSegmentIndex = 0;
+        [_levelSeg addTarget:self action:@selector(levelSegChanged:) forControlEvents:UIControlEventValueChanged];
+    }
+    return _levelSeg;
+}
+
+- (UITableView *)tableView {
+    if (!_tableView) {
+        _tableView = [[UITableView alloc] initWithFrame:CGRectZero style:UITableViewStylePlain];
+        _tableView.dataSource = self;
+        _tableView.delegate = self;
+        _tableView.estimatedRowHeight = 44;
+        _tableView.rowHeight = UITableViewAutomaticDimension;
+        _tableView.keyboardDismissMode = UIScrollViewKeyboardDismissModeOnDrag;
+    }
+    return _tableView;
+}
+
+@end
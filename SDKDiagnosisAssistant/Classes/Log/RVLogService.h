@@ -26,6 +26,14 @@ extern NSString *const RVManualFileLogLevelKey;
 @property (nonatomic, assign)BOOL createNewLogEveryLaunching;
 /// 下次启动打开log浮窗
 @property (nonatomic, assign)BOOL showDebugWindowConfig;
+/// log文件的mmap缓冲区大小(字节)，进程被杀时缓冲区内容会在下次启动写回文件。0表示每条log直接写文件，默认256KB
+@property (nonatomic, assign)NSUInteger fileBufferSize;
+/// 缓冲区达到多少字节时写入文件，0表示缓冲区大小的3/4
+@property (nonatomic, assign)NSUInteger fileBufferHighWaterMark;
+/// log以二进制格式(.vvlog)写入文件：调用处只记录格式ID和原始参数，不做格式化，上传后由后台解码。默认NO
+@property (nonatomic, assign)BOOL writeBinaryLog;
+/// log文件按块压缩写入(.logz/.vvlogz)：每块独立可解压，上传时直接打包不再重新压缩。默认NO
+@property (nonatomic, assign)BOOL compressLogFile;
 
 /// 初始化
 + (void)start;
@@ -70,8 +78,11 @@ extern NSString *const RVManualFileLogLevelKey;
 /// 生成新的日志文件
 + (void)createNewLogFile;
 
-/// 读取当前日志文件内容
+/// 读取当前日志文件内容，会把整个文件读入内存，大文件请用readCurrentLogFileLastLines:
 + (NSString *)readCurrentLogFile;
 
+/// 读取当前日志文件最后count条log，只扫描文件尾部
++ (NSArray<NSString *> *)readCurrentLogFileLastLines:(NSUInteger)count;
+
 @end
 NS_ASSUME_NONNULL_END
@@ -10,8 +10,10 @@
 #import "RVLogFormattter.h"
 #import "RVFileLogFormatter.h"
 #import "RVLogFileManager.h"
+#import "RVLogFileReader.h"
 //log视图
 #import "RVLogFileTableViewController.h"
+#import "RVLogReaderViewController.h"
 #import "RVDebugFloatWindow.h"
 #import "RVDebugWindow.h"
 #import "RVDebugViewController.h"
@@ -28,13 +30,19 @@ static NSString *const RVShowlogInConsoleKey =      @"RVShowlogInConsoleKey";
 static NSString *const RVCreateLogEveryLaunchKey =  @"RVCreateLogEveryLaunchKey";
 static NSString *const RVShowDebugWindowKey =       @"RVShowDebugWindowKey";
 static NSString *const RVLogLevelKey =              @"RVLogLevelKey";
+static NSString *const RVFileBufferSizeKey =        @"RVFileBufferSizeKey";
+static NSString *const RVFileBufferHighWaterKey =   @"RVFileBufferHighWaterKey";
+static NSString *const RVWriteBinaryLogKey =        @"RVWriteBinaryLogKey";
+static NSString *const RVCompressLogFileKey =       @"RVCompressLogFileKey";
+
+static NSUInteger const RVDefaultFileBufferSize =   256 * 1024;
 
 NSString *const RVFileLogLevelKey =         @"RVFileLogLevelKey";
 NSString *const RVConsoleLogLevelKey =      @"RVConsoleLogLevelKey";
 NSString *const RVManualFileLogLevelKey =   @"RVManualFileLogLevelKey";
 
 
-@interface RVLogService ()<UIDocumentInteractionControllerDelegate>
+@interface RVLogService ()
 /// log文件管理
 @property (nonatomic, strong) RVLogFileManager *fileManager;
 /// log格式控制器
@@ -89,6 +97,21 @@ NSString *const RVManualFileLogLevelKey =   @"RVManualFileLogLevelKey";
         _fileLogger.maximumFileSize = 1024*1024*30;//每个文件数量最大尺寸为30M
         _fileLogger.logFileManager.logFilesDiskQuota = 1024*1024*100;//文件夹最大100M
         [_fileLogger setLogFormatter:[[RVFileLogFormatter alloc] init]];
+        // log先写入mmap缓冲区，攒够一批再落盘
+        NSNumber *bufferSize = [[NSUserDefaults sdkLogUserDefaults] objectForKey:RVFileBufferSizeKey];
+        _fileBufferSize = bufferSize ? bufferSize.unsignedIntegerValue : RVDefaultFileBufferSize;
+        _fileBufferHighWaterMark = [[NSUserDefaults sdkLogUserDefaults] integerForKey:RVFileBufferHighWaterKey];
+        _fileLogger.bufferSize = _fileBufferSize;
+        _fileLogger.bufferHighWaterMark = _fileBufferHighWaterMark;
+        // 二进制log，需在第一条log写入前设置，避免文本和二进制混在同一文件
+        _writeBinaryLog = [[NSUserDefaults sdkLogUserDefaults] boolForKey:RVWriteBinaryLogKey];
+        _fileManager.binaryLogFiles = _writeBinaryLog;
+        _fileLogger.writesBinaryRecords = _writeBinaryLog;
+        VVLog.recordsArguments = _writeBinaryLog;
+        // 压缩log，同样需在第一条log写入前设置
+        _compressLogFile = [[NSUserDefaults sdkLogUserDefaults] boolForKey:RVCompressLogFileKey];
+        _fileManager.compressedLogFiles = _compressLogFile;
+        _fileLogger.compressesLogFiles = _compressLogFile;
         
         RVLogFormattter *formatter = [[RVLogFormattter alloc] init];
         _logFormatter = formatter;
@@ -151,25 +174,21 @@ NSString *const RVManualFileLogLevelKey =   @"RVManualFileLogLevelKey";
 
 /// 显示当前的log内容
 - (void)dispalyCurrentLog {
+    // 缓冲区的log先落盘
+    [_fileLogger flush];
     [self displayLocalLogWithFilePath:_fileLogger.currentLogFileInfo.filePath];
 }
 
-/// 显示沙盒本地log（在iOS13模拟器会报错，真机不会，这是一个苹果的bug）
+/// 显示沙盒本地log，从文件末尾分页读取，不一次加载整个文件
 - (void)displayLocalLogWithFilePath:(NSString *)filePath
 {
-    // 由文件路径初始化UIDocumentInteractionController
-    UIDocumentInteractionController *documentInteractionController  = [UIDocumentInteractionController interactionControllerWithURL:[NSURL fileURLWithPath:filePath]];
-    // 设置代理
-    documentInteractionController .delegate = self;
-    // 显示预览界面
-    [documentInteractionController  presentPreviewAnimated:YES];
-}
-
-#pragma mark - UIDocumentInteractionControllerDelegate
-/// 在哪个控制器显示预览界面
--(UIViewController *)documentInteractionControllerViewControllerForPreview:(UIDocumentInteractionController *)controller
-{
-    return [UIApplication sharedApplication].delegate.window.rootViewController;
+    if (!filePath) {
+        return;
+    }
+    RVLogReaderViewController *controller = [[RVLogReaderViewController alloc] initWithFilePath:filePath];
+    controller.modalPresentationStyle = UIModalPresentationFullScreen;
+    UIViewController *rootViewController = [RVRootViewTool getTopViewController];
+    [rootViewController presentViewController:controller animated:YES completion:nil];
 }
 
 /// 显示日志调试浮窗
@@ -402,6 +421,43 @@ NSString *const RVManualFileLogLevelKey =   @"RVManualFileLogLevelKey";
     [[NSUserDefaults sdkLogUserDefaults] synchronize];
 }
 
+/// log文件的mmap缓冲区大小
+- (void)setFileBufferSize:(NSUInteger)fileBufferSize {
+    _fileBufferSize = fileBufferSize;
+    _fileLogger.bufferSize = fileBufferSize;
+    [[NSUserDefaults sdkLogUserDefaults] setInteger:fileBufferSize forKey:RVFileBufferSizeKey];
+    [[NSUserDefaults sdkLogUserDefaults] synchronize];
+}
+
+/// 缓冲区落盘阈值
+- (void)setFileBufferHighWaterMark:(NSUInteger)fileBufferHighWaterMark {
+    _fileBufferHighWaterMark = fileBufferHighWaterMark;
+    _fileLogger.bufferHighWaterMark = fileBufferHighWaterMark;
+    [[NSUserDefaults sdkLogUserDefaults] setInteger:fileBufferHighWaterMark forKey:RVFileBufferHighWaterKey];
+    [[NSUserDefaults sdkLogUserDefaults] synchronize];
+}
+
+/// log以二进制格式写入文件
+- (void)setWriteBinaryLog:(BOOL)writeBinaryLog {
+    _writeBinaryLog = writeBinaryLog;
+    // 先改文件名后缀，logger切换时会滚动到新文件
+    _fileManager.binaryLogFiles = writeBinaryLog;
+    _fileLogger.writesBinaryRecords = writeBinaryLog;
+    VVLog.recordsArguments = writeBinaryLog;
+    [[NSUserDefaults sdkLogUserDefaults] setBool:writeBinaryLog forKey:RVWriteBinaryLogKey];
+    [[NSUserDefaults sdkLogUserDefaults] synchronize];
+}
+
+/// log文件按块压缩写入
+- (void)setCompressLogFile:(BOOL)compressLogFile {
+    _compressLogFile = compressLogFile;
+    // 先改文件名后缀，logger切换时会滚动到新文件
+    _fileManager.compressedLogFiles = compressLogFile;
+    _fileLogger.compressesLogFiles = compressLogFile;
+    [[NSUserDefaults sdkLogUserDefaults] setBool:compressLogFile forKey:RVCompressLogFileKey];
+    [[NSUserDefaults sdkLogUserDefaults] synchronize];
+}
+
 /// 下次启动打开log浮窗
 - (void)setShowDebugWindowConfig:(BOOL)showDebugWindowConfig {
     _showDebugWindowConfig = showDebugWindowConfig;
@@ -495,12 +551,27 @@ NSString *const RVManualFileLogLevelKey =   @"RVManualFileLogLevelKey";
 }
 
 - (NSString *)readCurrentLogFile {
+    [_fileLogger flush];
     if (_fileLogger.currentLogFileInfo.filePath) {
-        return [NSString stringWithContentsOfFile:_fileLogger.currentLogFileInfo.filePath encoding:NSUTF8StringEncoding error:nil];
+        return [RVLogFileManager readLogFileText:_fileLogger.currentLogFileInfo.filePath];
     }
     return @"";
 }
 
++ (NSArray<NSString *> *)readCurrentLogFileLastLines:(NSUInteger)count {
+    return [[RVLogService sharedInstance] readCurrentLogFileLastLines:count];
+}
+
+- (NSArray<NSString *> *)readCurrentLogFileLastLines:(NSUInteger)count {
+    [_fileLogger flush];
+    NSString *filePath = _fileLogger.currentLogFileInfo.filePath;
+    if (!filePath) {
+        return @[];
+    }
+    RVLogFileReader *reader = [[RVLogFileReader alloc] initWithFilePath:filePath];
+    return [reader tailPageWithMaxLines:count].lines ?: @[];
+}
+
 
 /// 获取动态密码
 - (NSString *)getDynamicPassword
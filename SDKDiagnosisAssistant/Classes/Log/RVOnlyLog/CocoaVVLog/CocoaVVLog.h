@@ -72,6 +72,8 @@ FOUNDATION_EXPORT const unsigned char CocoaVVLogVersionString[];
 
 // Core
 #import "VVLog.h"
+#import "VVLogRecordFormat.h"
+#import "VVLogBlockFile.h"
 
 // Main macros
 #import "VVLogMacros.h"
@@ -68,7 +68,7 @@ static VVASLLogger *sharedInstance;
 
 - (void)logMessage:(VVLogMessage *)logMessage {
 
-    NSString * message = _logFormatter ? [_logFormatter formatLogMessage:logMessage] : logMessage->_message;
+    NSString * message = _logFormatter ? [_logFormatter formatLogMessage:logMessage] : logMessage.message;
 
     if (message) {
         const char *msg = [message UTF8String];
@@ -24,6 +24,9 @@ NS_ASSUME_NONNULL_BEGIN
 // Will assert if used outside logger's queue.
 - (void)lt_logData:(NSData *)data;
 
+// `timestamp` (seconds since 1970) is when the data was logged, kept by compressed log files.
+- (void)lt_logData:(NSData *)data timestamp:(NSTimeInterval)timestamp;
+
 - (nullable NSData *)lt_dataForMessage:(VVLogMessage *)message;
 
 @end
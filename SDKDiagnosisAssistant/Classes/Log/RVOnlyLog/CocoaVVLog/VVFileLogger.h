@@ -190,6 +190,11 @@ extern unsigned long long const kVVDefaultLogFilesDiskQuota;
  * Example: `com.organization.myapp 2013-12-03 17-14.log`
  *
  * Archived log files are automatically deleted according to the `maximumNumberOfLogFiles` property.
+ *
+ * The manager keeps an in-memory index of the log files with their sizes, so the sorted lists and the
+ * `logFilesDiskQuota` check don't list and stat the whole directory on every roll. The directory is listed again only
+ * after it changes on disk (watched with a vnode source); the sizes of files already indexed are refreshed when they
+ * are rolled.
  **/
 @interface VVLogFileManagerDefault : NSObject <VVLogFileManager>
 
@@ -293,6 +298,27 @@ extern unsigned long long const kVVDefaultLogFilesDiskQuota;
 #pragma mark -
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * A formatter which can write a log message straight as UTF-8 bytes.
+ *
+ * VVFileLogger prefers this over `formatLogMessage:` when its formatter implements it. The bytes are appended to a
+ * buffer the logger reuses for every message, which skips creating an NSString and converting it to NSData.
+ * Called on the logger's queue.
+ **/
+@protocol VVLogDataFormatter <VVLogFormatter>
+
+/**
+ * Appends the formatted message to `buffer`, trailing newline included.
+ * Returns NO to filter the message out, like returning nil from `formatLogMessage:`.
+ **/
+- (BOOL)appendLogMessage:(VVLogMessage *)logMessage toBuffer:(NSMutableData *)buffer;
+
+@end
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark -
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 /**
  * Most users will want file log messages to be prepended with the date and time.
  * Rather than forcing the majority of users to write their own formatter,
@@ -425,6 +451,54 @@ extern unsigned long long const kVVDefaultLogFilesDiskQuota;
  */
 @property (readwrite, assign, atomic) BOOL doNotReuseLogFiles;
 
+/**
+ * Log Buffering:
+ *
+ * `bufferSize`:
+ *   The size (in bytes) of a memory-mapped buffer log statements are appended to,
+ *   instead of writing each of them to the log file.
+ *   The buffer is a hidden file next to the logs directory. Statements still in it when the
+ *   process dies are written to their log file by the next launch, on the first log statement.
+ *   Zero (the default) writes every log statement directly to the log file.
+ *
+ * `bufferHighWaterMark`
+ *   The buffer is written to the log file in one chunk once it holds this many bytes.
+ *   It is also written when the next log statement does not fit, when the log file is rolled,
+ *   and on `flush`. Zero (the default) means three quarters of `bufferSize`.
+ *
+ * If the buffer file can not be created the logger writes directly to the log file.
+ **/
+@property (readwrite, assign) NSUInteger bufferSize;
+
+/**
+ *  See description for `bufferSize`
+ */
+@property (readwrite, assign) NSUInteger bufferHighWaterMark;
+
+/**
+ * Binary log files, NO by default.
+ *
+ * When YES, the formatter is not used: messages logged in binary record mode (`VVLog.recordsArguments`)
+ * are written as their call site and raw arguments, others as their text, see `VVLogRecordFormat.h`.
+ * `VVLogRecordDecoder` turns the files back into text.
+ * Changing it rolls the current log file, and a file of the other kind is not resumed.
+ * Name binary files differently through the log file manager, by convention `.vvlog`.
+ **/
+@property (readwrite, assign) BOOL writesBinaryRecords;
+
+/**
+ * Compressed log files, NO by default.
+ *
+ * When YES, what would be written to the log file is compressed a block at a time, see `VVLogBlockFile.h`:
+ * a block is what the buffer held when written, or 64KB when there is no `bufferSize`, in which case
+ * those bytes wait in memory until then or `flush`. Each block header keeps the time range and
+ * uncompressed offset of its content, `VVLogBlockFile` reads any block without the ones before it.
+ * `maximumFileSize` is then counted in compressed bytes.
+ * Changing it rolls the current log file, and a file of the other kind is not resumed.
+ * Name compressed files differently through the log file manager, by convention `.logz` or `.vvlogz`.
+ **/
+@property (readwrite, assign) BOOL compressesLogFiles;
+
 /**
  * The VVLogFileManager instance can be used to retrieve the list of log files,
  * and configure the maximum number of archived log files to keep.
@@ -17,9 +17,15 @@
 #error This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
 #endif
 
+#import <fcntl.h>
 #import <sys/xattr.h>
+#import <unistd.h>
+#import <zlib.h>
 
 #import "VVFileLogger+Internal.h"
+#import "VVMappedLogBuffer.h"
+#import "VVLogRecord.h"
+#import "VVLogBlockFile.h"
 
 // We probably shouldn't be using VVLog() statements within the VVLog implementation.
 // But we still want to leave our log statements for any future debugging,
@@ -56,10 +62,28 @@ unsigned long long const kVVDefaultLogFilesDiskQuota   = 20 * 1024 * 1024; // 20
 
 NSTimeInterval     const kVVRollingLeeway              = 1.0;              // 1s
 
+NSUInteger         const kVVLogBlockBufferSize         = 64 * 1024;        // 64 KB
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark -
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * One log file as the index of VVLogFileManagerDefault last saw it.
+ **/
+@interface VVLogFileIndexEntry : NSObject
+
+@property (nonatomic, copy) NSString *filePath;
+// The date parsed from the file name, or the file's creation date if the name has none. The index is sorted by it.
+@property (nonatomic, strong) NSDate *creationDate;
+@property (nonatomic, assign) unsigned long long fileSize;
+@property (nonatomic, assign) BOOL isArchived;
+
+@end
+
+@implementation VVLogFileIndexEntry
+@end
+
 @interface VVLogFileManagerDefault () {
     NSDateFormatter *_fileDateFormatter;
     NSUInteger _maximumNumberOfLogFiles;
@@ -68,6 +92,15 @@ NSTimeInterval     const kVVRollingLeeway              = 1.0;              // 1s
 #if TARGET_OS_IPHONE
     NSFileProtectionType _defaultFileProtectionLevel;
 #endif
+
+    // The index below is only touched on _indexQueue.
+    dispatch_queue_t _indexQueue;
+    // Sorted like sortedLogFileInfos, most recent first. nil until the directory is first listed.
+    NSMutableArray<VVLogFileIndexEntry *> *_indexEntries;
+    unsigned long long _indexedBytes;
+    // Set by the directory vnode source: files may have been added or removed behind our back.
+    BOOL _indexNeedsSync;
+    dispatch_source_t _logsDirectoryVnode;
 }
 
 @end
@@ -94,6 +127,8 @@ NSTimeInterval     const kVVRollingLeeway              = 1.0;              // 1s
         _maximumNumberOfLogFiles = kVVDefaultLogMaxNumLogFiles;
         _logFilesDiskQuota = kVVDefaultLogFilesDiskQuota;
 
+        _indexQueue = dispatch_queue_create("cocoa.vvlog.filemanager.index", DISPATCH_QUEUE_SERIAL);
+
         _fileDateFormatter = [[NSDateFormatter alloc] init];
         [_fileDateFormatter setLocale:[NSLocale localeWithLocaleIdentifier:@"en_US_POSIX"]];
         [_fileDateFormatter setDateFormat: @"yyyy'-'MM'-'dd'--'HH'-'mm'-'ss'-'SSS'"];
@@ -142,6 +177,10 @@ NSTimeInterval     const kVVRollingLeeway              = 1.0;              // 1s
         [self removeObserver:self forKeyPath:NSStringFromSelector(@selector(logFilesDiskQuota))];
     } @catch (NSException *exception) {
     }
+
+    if (_logsDirectoryVnode) {
+        dispatch_source_cancel(_logsDirectoryVnode);
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -197,63 +236,51 @@ NSTimeInterval     const kVVRollingLeeway              = 1.0;              // 1s
 - (void)deleteOldLogFiles {
     NSLogVerbose(@"VVLogFileManagerDefault: deleteOldLogFiles");
 
-    NSArray *sortedLogFileInfos = [self sortedLogFileInfos];
-    NSUInteger firstIndexToDelete = NSNotFound;
-
     const unsigned long long diskQuota = self.logFilesDiskQuota;
     const NSUInteger maxNumLogFiles = self.maximumNumberOfLogFiles;
 
-    if (diskQuota) {
-        unsigned long long used = 0;
+    // Drop the oldest files from the index while it is over either limit. That removes the same files as cutting the
+    // sorted list at the first file where the running size exceeds the quota, or at maxNumLogFiles, whichever is first.
+    NSMutableArray<NSString *> *filePathsToDelete = [NSMutableArray array];
+    dispatch_sync(_indexQueue, ^{
+        [self ix_syncIndexIfNeeded];
+        NSMutableArray<VVLogFileIndexEntry *> *entries = self->_indexEntries;
 
-        for (NSUInteger i = 0; i < sortedLogFileInfos.count; i++) {
-            VVLogFileInfo *info = sortedLogFileInfos[i];
-            used += info.fileSize;
+        // The most recent file is usually still being written to, so its indexed size is out of date.
+        if (entries.count > 0) {
+            [self ix_refreshIndexEntry:entries.firstObject];
+        }
 
-            if (used > diskQuota) {
-                firstIndexToDelete = i;
+        while (entries.count > 0) {
+            BOOL overQuota = diskQuota && self->_indexedBytes > diskQuota;
+            BOOL overCount = maxNumLogFiles && entries.count > maxNumLogFiles;
+            if (!overQuota && !overCount) {
                 break;
             }
-        }
-    }
-
-    if (maxNumLogFiles) {
-        if (firstIndexToDelete == NSNotFound) {
-            firstIndexToDelete = maxNumLogFiles;
-        } else {
-            firstIndexToDelete = MIN(firstIndexToDelete, maxNumLogFiles);
-        }
-    }
-
-    if (firstIndexToDelete == 0) {
-        // Do we consider the first file?
-        // We are only supposed to be deleting archived files.
-        // In most cases, the first file is likely the log file that is currently being written to.
-        // So in most cases, we do not want to consider this file for deletion.
 
-        if (sortedLogFileInfos.count > 0) {
-            VVLogFileInfo *logFileInfo = sortedLogFileInfos[0];
-
-            if (!logFileInfo.isArchived) {
-                // Don't delete active file.
-                ++firstIndexToDelete;
+            // We are only supposed to be deleting archived files.
+            // In most cases, the first file is likely the log file that is currently being written to.
+            if (entries.count == 1 && !entries.firstObject.isArchived) {
+                break;
             }
-        }
-    }
-
-    if (firstIndexToDelete != NSNotFound) {
-        // removing all log files starting with firstIndexToDelete
 
-        for (NSUInteger i = firstIndexToDelete; i < sortedLogFileInfos.count; i++) {
-            VVLogFileInfo *logFileInfo = sortedLogFileInfos[i];
+            [filePathsToDelete addObject:entries.lastObject.filePath];
+            self->_indexedBytes -= entries.lastObject.fileSize;
+            [entries removeLastObject];
+        }
+    });
 
-            NSError *error = nil;
-            BOOL success = [[NSFileManager defaultManager] removeItemAtPath:logFileInfo.filePath error:&error];
-            if (success) {
-                NSLogInfo(@"VVLogFileManagerDefault: Deleting file: %@", logFileInfo.fileName);
-            } else {
-                NSLogError(@"VVLogFileManagerDefault: Error deleting file %@", error);
-            }
+    for (NSString *filePath in filePathsToDelete) {
+        NSError *error = nil;
+        BOOL success = [[NSFileManager defaultManager] removeItemAtPath:filePath error:&error];
+        if (success) {
+            NSLogInfo(@"VVLogFileManagerDefault: Deleting file: %@", filePath.lastPathComponent);
+        } else {
+            NSLogError(@"VVLogFileManagerDefault: Error deleting file %@", error);
+            // The file is still there, let the next lookup put it back.
+            dispatch_async(_indexQueue, ^{
+                self->_indexNeedsSync = YES;
+            });
         }
     }
 }
@@ -310,12 +337,20 @@ NSTimeInterval     const kVVRollingLeeway              = 1.0;              // 1s
     return (hasProperPrefix && hasProperSuffix);
 }
 
-// if you change formatter, then change sortedLogFileInfos method also accordingly
+// if you change formatter, then change sortDateForLogFileInfo: method also accordingly
 - (NSDateFormatter *)logFileDateFormatter {
     return _fileDateFormatter;
 }
 
 - (NSArray *)unsortedLogFilePaths {
+    // The index order is a valid unsorted order.
+    return [self sortedLogFilePaths];
+}
+
+/**
+ * Lists the logs directory. This is the only place the index learns about files it did not create itself.
+ **/
+- (NSArray<NSString *> *)logFilePathsOnDisk {
     NSString *logsDirectory = [self logsDirectory];
     NSArray *fileNames = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:logsDirectory error:nil];
 
@@ -398,36 +433,192 @@ NSTimeInterval     const kVVRollingLeeway              = 1.0;              // 1s
 }
 
 - (NSArray *)sortedLogFileInfos {
-    return [[self unsortedLogFileInfos] sortedArrayUsingComparator:^NSComparisonResult(VVLogFileInfo *obj1,
-                                                                                       VVLogFileInfo *obj2) {
-        NSDate *date1 = [NSDate new];
-        NSDate *date2 = [NSDate new];
-
-        NSArray<NSString *> *arrayComponent = [[obj1 fileName] componentsSeparatedByString:@" "];
-        if (arrayComponent.count > 0) {
-            NSString *stringDate = arrayComponent.lastObject;
-            stringDate = [stringDate stringByReplacingOccurrencesOfString:@".log" withString:@""];
-#if TARGET_IPHONE_SIMULATOR
-            // This is only used on the iPhone simulator for backward compatibility reason.
-            stringDate = [stringDate stringByReplacingOccurrencesOfString:@".archived" withString:@""];
-#endif
-            date1 = [[self logFileDateFormatter] dateFromString:stringDate] ?: [obj1 creationDate];
+    __block NSMutableArray *sortedLogFileInfos;
+    dispatch_sync(_indexQueue, ^{
+        [self ix_syncIndexIfNeeded];
+
+        // Fresh infos, so callers reading attributes or flagging a file archived never share cached state.
+        sortedLogFileInfos = [NSMutableArray arrayWithCapacity:self->_indexEntries.count];
+        for (VVLogFileIndexEntry *entry in self->_indexEntries) {
+            [sortedLogFileInfos addObject:[[VVLogFileInfo alloc] initWithFilePath:entry.filePath]];
         }
+    });
 
-        arrayComponent = [[obj2 fileName] componentsSeparatedByString:@" "];
-        if (arrayComponent.count > 0) {
-            NSString *stringDate = arrayComponent.lastObject;
-            stringDate = [stringDate stringByReplacingOccurrencesOfString:@".log" withString:@""];
+    return sortedLogFileInfos;
+}
+
+- (void)didArchiveLogFile:(NSString *)logFilePath {
+    dispatch_async(_indexQueue, ^{
+        [self ix_refreshIndexEntryWithPath:logFilePath];
+    });
+}
+
+- (void)didRollAndArchiveLogFile:(NSString *)logFilePath {
+    dispatch_async(_indexQueue, ^{
+        [self ix_refreshIndexEntryWithPath:logFilePath];
+    });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Index
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The manager keeps the log files of its directory in memory, sorted and with their sizes, so rolling and enforcing
+// the quota don't list, stat and parse every file each time. The directory is listed when the index is first used and
+// again after a vnode event on it. Files that were already indexed are kept as they are then; only new files are
+// stat-ed. ix_ methods must run on _indexQueue.
+
+- (NSDate *)sortDateForLogFileInfo:(VVLogFileInfo *)logFileInfo {
+    NSArray<NSString *> *arrayComponent = [[logFileInfo fileName] componentsSeparatedByString:@" "];
+    if (arrayComponent.count > 0) {
+        NSString *stringDate = arrayComponent.lastObject;
+        stringDate = [stringDate stringByReplacingOccurrencesOfString:@".log" withString:@""];
 #if TARGET_IPHONE_SIMULATOR
-            // This is only used on the iPhone simulator for backward compatibility reason.
-            stringDate = [stringDate stringByReplacingOccurrencesOfString:@".archived" withString:@""];
+        // This is only used on the iPhone simulator for backward compatibility reason.
+        stringDate = [stringDate stringByReplacingOccurrencesOfString:@".archived" withString:@""];
 #endif
-            date2 = [[self logFileDateFormatter] dateFromString:stringDate] ?: [obj2 creationDate];
+        NSDate *date = [[self logFileDateFormatter] dateFromString:stringDate];
+        if (date) {
+            return date;
         }
+    }
+
+    return [logFileInfo creationDate] ?: [NSDate new];
+}
+
+- (VVLogFileIndexEntry *)ix_indexEntryForFileAtPath:(NSString *)filePath {
+    VVLogFileInfo *logFileInfo = [[VVLogFileInfo alloc] initWithFilePath:filePath];
+
+    VVLogFileIndexEntry *entry = [VVLogFileIndexEntry new];
+    entry.filePath = filePath;
+    entry.creationDate = [self sortDateForLogFileInfo:logFileInfo];
+    entry.fileSize = logFileInfo.fileSize;
+    entry.isArchived = logFileInfo.isArchived;
+
+    return entry;
+}
 
-        return [date2 compare:date1 ?: [NSDate new]];
+- (void)ix_insertIndexEntry:(VVLogFileIndexEntry *)entry {
+    // Most recent first; a file dated like an indexed one goes before it, as it was seen later.
+    NSUInteger index = [_indexEntries indexOfObject:entry
+                                      inSortedRange:NSMakeRange(0, _indexEntries.count)
+                                            options:NSBinarySearchingInsertionIndex | NSBinarySearchingFirstEqual
+                                    usingComparator:^NSComparisonResult(VVLogFileIndexEntry *obj1, VVLogFileIndexEntry *obj2) {
+        return [obj2.creationDate compare:obj1.creationDate];
     }];
 
+    [_indexEntries insertObject:entry atIndex:index];
+    _indexedBytes += entry.fileSize;
+}
+
+- (void)ix_refreshIndexEntry:(VVLogFileIndexEntry *)entry {
+    VVLogFileInfo *logFileInfo = [[VVLogFileInfo alloc] initWithFilePath:entry.filePath];
+    unsigned long long fileSize = logFileInfo.fileSize;
+
+    _indexedBytes = _indexedBytes - entry.fileSize + fileSize;
+    entry.fileSize = fileSize;
+    entry.isArchived = logFileInfo.isArchived;
+}
+
+- (void)ix_refreshIndexEntryWithPath:(NSString *)filePath {
+    for (VVLogFileIndexEntry *entry in _indexEntries) {
+        if ([entry.filePath isEqualToString:filePath]) {
+            [self ix_refreshIndexEntry:entry];
+            return;
+        }
+    }
+}
+
+- (void)ix_removeIndexEntryWithPath:(NSString *)filePath {
+    for (NSUInteger i = 0; i < _indexEntries.count; i++) {
+        VVLogFileIndexEntry *entry = _indexEntries[i];
+        if ([entry.filePath isEqualToString:filePath]) {
+            _indexedBytes -= entry.fileSize;
+            [_indexEntries removeObjectAtIndex:i];
+            return;
+        }
+    }
+}
+
+- (void)ix_syncIndexIfNeeded {
+    if (_indexEntries && !_indexNeedsSync) {
+        return;
+    }
+
+    // Watch before listing, so a change made while we list is not missed.
+    _indexNeedsSync = NO;
+    [self ix_monitorLogsDirectory];
+
+    NSArray<NSString *> *filePaths = [self logFilePathsOnDisk];
+
+    if (_indexEntries == nil) {
+        _indexEntries = [NSMutableArray arrayWithCapacity:filePaths.count];
+        _indexedBytes = 0;
+    }
+
+    NSSet<NSString *> *filePathsOnDisk = [NSSet setWithArray:filePaths];
+    NSMutableSet<NSString *> *indexedFilePaths = [NSMutableSet setWithCapacity:_indexEntries.count];
+
+    for (NSUInteger i = _indexEntries.count; i > 0; i--) {
+        VVLogFileIndexEntry *entry = _indexEntries[i - 1];
+        if ([filePathsOnDisk containsObject:entry.filePath]) {
+            [indexedFilePaths addObject:entry.filePath];
+        } else {
+            _indexedBytes -= entry.fileSize;
+            [_indexEntries removeObjectAtIndex:i - 1];
+        }
+    }
+
+    for (NSString *filePath in filePaths) {
+        if (![indexedFilePaths containsObject:filePath]) {
+            [self ix_insertIndexEntry:[self ix_indexEntryForFileAtPath:filePath]];
+        }
+    }
+}
+
+- (void)ix_monitorLogsDirectory {
+    if (_logsDirectoryVnode) {
+        return;
+    }
+
+    int fd = open([[self logsDirectory] fileSystemRepresentation], O_EVTONLY);
+    if (fd < 0) {
+        NSLogError(@"VVLogFileManagerDefault: Failed to watch logsDirectory (%d)", errno);
+        return;
+    }
+
+    dispatch_source_vnode_flags_t flags = DISPATCH_VNODE_WRITE | DISPATCH_VNODE_DELETE | DISPATCH_VNODE_RENAME | DISPATCH_VNODE_REVOKE;
+    dispatch_source_t vnode = dispatch_source_create(DISPATCH_SOURCE_TYPE_VNODE, (uintptr_t)fd, flags, _indexQueue);
+    _logsDirectoryVnode = vnode;
+
+    __weak __auto_type weakSelf = self;
+    dispatch_source_set_event_handler(vnode, ^{
+        __strong __auto_type strongSelf = weakSelf;
+        if (!strongSelf) {
+            return;
+        }
+
+        strongSelf->_indexNeedsSync = YES;
+
+        if (dispatch_source_get_data(vnode) & (DISPATCH_VNODE_DELETE | DISPATCH_VNODE_RENAME | DISPATCH_VNODE_REVOKE)) {
+            // The directory itself is gone. Watch the new one when it is next listed.
+            NSLogInfo(@"VVLogFileManagerDefault: logsDirectory was moved, rebuilding the index");
+            dispatch_source_cancel(vnode);
+            strongSelf->_logsDirectoryVnode = nil;
+        }
+    });
+
+    dispatch_source_set_cancel_handler(vnode, ^{
+        close(fd);
+#if !OS_OBJECT_USE_OBJC
+        dispatch_release(vnode);
+#endif
+    });
+
+    if (@available(macOS 10.12, iOS 10.0, tvOS 10.0, watchOS 3.0, *))
+        dispatch_activate(vnode);
+    else
+        dispatch_resume(vnode);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -517,6 +708,19 @@ NSTimeInterval     const kVVRollingLeeway              = 1.0;              // 1s
 
         if (success) {
             NSLogVerbose(@"VVLogFileManagerDefault: Created new log file: %@", actualFileName);
+            dispatch_sync(_indexQueue, ^{
+                // Not yet listed: the new file is picked up with the rest.
+                if (self->_indexEntries == nil) {
+                    return;
+                }
+                // A lookup may have listed it already.
+                [self ix_removeIndexEntryWithPath:filePath];
+                // The previous file won't grow any more, take its final size.
+                if (self->_indexEntries.count > 0) {
+                    [self ix_refreshIndexEntry:self->_indexEntries.firstObject];
+                }
+                [self ix_insertIndexEntry:[self ix_indexEntryForFileAtPath:filePath]];
+            });
             dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
                 // Since we just created a new log file, we may need to delete some old log files
                 [self deleteOldLogFiles];
@@ -594,7 +798,7 @@ NSTimeInterval     const kVVRollingLeeway              = 1.0;              // 1s
 - (NSString *)formatLogMessage:(VVLogMessage *)logMessage {
     NSString *dateAndTime = [_dateFormatter stringFromDate:(logMessage->_timestamp)];
 
-    return [NSString stringWithFormat:@"%@  %@", dateAndTime, logMessage->_message];
+    return [NSString stringWithFormat:@"%@  %@", dateAndTime, logMessage.message];
 }
 
 @end
@@ -616,6 +820,28 @@ NSTimeInterval     const kVVRollingLeeway              = 1.0;              // 1s
 
     unsigned long long _maximumFileSize;
 
+    NSUInteger _bufferSize;
+    NSUInteger _bufferHighWaterMark;
+    VVMappedLogBuffer *_mappedBuffer;
+    BOOL _mappedBufferUnavailable;
+    unsigned long long _currentLogFileOffset;
+
+    // Reused by formatters writing bytes directly, see VVLogDataFormatter, and by binary records.
+    NSMutableData *_messageBuffer;
+
+    BOOL _writesBinaryRecords;
+    VVLogRecordWriter *_recordWriter;
+
+    BOOL _compressesLogFiles;
+    VVLogBlockCompressor *_blockCompressor;
+    NSMutableData *_compressedBuffer;
+    // Uncompressed length of the current log file, the offset of its next block
+    unsigned long long _currentUncompressedLength;
+    // Bytes of the next block when there is no mapped buffer
+    NSMutableData *_blockBuffer;
+    NSTimeInterval _blockFirstTimestamp;
+    NSTimeInterval _blockLastTimestamp;
+
     dispatch_queue_t _completionQueue;
 }
 
@@ -654,6 +880,10 @@ NSTimeInterval     const kVVRollingLeeway              = 1.0;              // 1s
 - (void)lt_cleanup {
     NSAssert([self isOnInternalLoggerQueue], @"lt_ methods should be on logger queue.");
 
+    [self lt_flushMappedBuffer];
+    [self lt_flushBlockBuffer];
+    _mappedBuffer = nil;
+
     [_currentLogFileHandle synchronizeFile];
     [_currentLogFileHandle closeFile];
 
@@ -796,6 +1026,198 @@ NSTimeInterval     const kVVRollingLeeway              = 1.0;              // 1s
     });
 }
 
+- (NSUInteger)bufferSize {
+    __block NSUInteger result;
+
+    dispatch_block_t block = ^{
+        result = self->_bufferSize;
+    };
+
+    // The design of this method is taken from the VVAbstractLogger implementation.
+    // For extensive documentation please refer to the VVAbstractLogger implementation.
+
+    NSAssert(![self isOnGlobalLoggingQueue], @"Core architecture requirement failure");
+    NSAssert(![self isOnInternalLoggerQueue], @"MUST access ivar directly, NOT via self.* syntax.");
+
+    dispatch_queue_t globalLoggingQueue = [VVLog loggingQueue];
+
+    dispatch_sync(globalLoggingQueue, ^{
+        dispatch_sync(self.loggerQueue, block);
+    });
+
+    return result;
+}
+
+- (void)setBufferSize:(NSUInteger)newBufferSize {
+    dispatch_block_t block = ^{
+        @autoreleasepool {
+            if (self->_bufferSize == newBufferSize) {
+                return;
+            }
+
+            // Reopened at the new size by the next log statement
+            [self lt_flushMappedBuffer];
+            [self lt_flushBlockBuffer];
+            self->_mappedBuffer = nil;
+            self->_mappedBufferUnavailable = NO;
+            self->_bufferSize = newBufferSize;
+        }
+    };
+
+    // The design of this method is taken from the VVAbstractLogger implementation.
+    // For extensive documentation please refer to the VVAbstractLogger implementation.
+
+    NSAssert(![self isOnGlobalLoggingQueue], @"Core architecture requirement failure");
+    NSAssert(![self isOnInternalLoggerQueue], @"MUST access ivar directly, NOT via self.* syntax.");
+
+    dispatch_queue_t globalLoggingQueue = [VVLog loggingQueue];
+
+    dispatch_async(globalLoggingQueue, ^{
+        dispatch_async(self.loggerQueue, block);
+    });
+}
+
+- (NSUInteger)bufferHighWaterMark {
+    __block NSUInteger result;
+
+    dispatch_block_t block = ^{
+        result = self->_bufferHighWaterMark;
+    };
+
+    // The design of this method is taken from the VVAbstractLogger implementation.
+    // For extensive documentation please refer to the VVAbstractLogger implementation.
+
+    NSAssert(![self isOnGlobalLoggingQueue], @"Core architecture requirement failure");
+    NSAssert(![self isOnInternalLoggerQueue], @"MUST access ivar directly, NOT via self.* syntax.");
+
+    dispatch_queue_t globalLoggingQueue = [VVLog loggingQueue];
+
+    dispatch_sync(globalLoggingQueue, ^{
+        dispatch_sync(self.loggerQueue, block);
+    });
+
+    return result;
+}
+
+- (void)setBufferHighWaterMark:(NSUInteger)newBufferHighWaterMark {
+    dispatch_block_t block = ^{
+        @autoreleasepool {
+            self->_bufferHighWaterMark = newBufferHighWaterMark;
+        }
+    };
+
+    // The design of this method is taken from the VVAbstractLogger implementation.
+    // For extensive documentation please refer to the VVAbstractLogger implementation.
+
+    NSAssert(![self isOnGlobalLoggingQueue], @"Core architecture requirement failure");
+    NSAssert(![self isOnInternalLoggerQueue], @"MUST access ivar directly, NOT via self.* syntax.");
+
+    dispatch_queue_t globalLoggingQueue = [VVLog loggingQueue];
+
+    dispatch_async(globalLoggingQueue, ^{
+        dispatch_async(self.loggerQueue, block);
+    });
+}
+
+- (BOOL)writesBinaryRecords {
+    __block BOOL result;
+
+    dispatch_block_t block = ^{
+        result = self->_writesBinaryRecords;
+    };
+
+    // The design of this method is taken from the VVAbstractLogger implementation.
+    // For extensive documentation please refer to the VVAbstractLogger implementation.
+
+    NSAssert(![self isOnGlobalLoggingQueue], @"Core architecture requirement failure");
+    NSAssert(![self isOnInternalLoggerQueue], @"MUST access ivar directly, NOT via self.* syntax.");
+
+    dispatch_queue_t globalLoggingQueue = [VVLog loggingQueue];
+
+    dispatch_sync(globalLoggingQueue, ^{
+        dispatch_sync(self.loggerQueue, block);
+    });
+
+    return result;
+}
+
+- (void)setWritesBinaryRecords:(BOOL)newWritesBinaryRecords {
+    dispatch_block_t block = ^{
+        @autoreleasepool {
+            if (self->_writesBinaryRecords == newWritesBinaryRecords) {
+                return;
+            }
+
+            // A log file holds one kind of content, the next one is chosen again
+            [self lt_rollLogFileNow];
+            self->_currentLogFileInfo = nil;
+            self->_writesBinaryRecords = newWritesBinaryRecords;
+            self->_recordWriter = newWritesBinaryRecords ? [VVLogRecordWriter new] : nil;
+        }
+    };
+
+    // The design of this method is taken from the VVAbstractLogger implementation.
+    // For extensive documentation please refer to the VVAbstractLogger implementation.
+
+    NSAssert(![self isOnGlobalLoggingQueue], @"Core architecture requirement failure");
+    NSAssert(![self isOnInternalLoggerQueue], @"MUST access ivar directly, NOT via self.* syntax.");
+
+    dispatch_queue_t globalLoggingQueue = [VVLog loggingQueue];
+
+    dispatch_async(globalLoggingQueue, ^{
+        dispatch_async(self.loggerQueue, block);
+    });
+}
+
+- (BOOL)compressesLogFiles {
+    __block BOOL result;
+
+    dispatch_block_t block = ^{
+        result = self->_compressesLogFiles;
+    };
+
+    // The design of this method is taken from the VVAbstractLogger implementation.
+    // For extensive documentation please refer to the VVAbstractLogger implementation.
+
+    NSAssert(![self isOnGlobalLoggingQueue], @"Core architecture requirement failure");
+    NSAssert(![self isOnInternalLoggerQueue], @"MUST access ivar directly, NOT via self.* syntax.");
+
+    dispatch_queue_t globalLoggingQueue = [VVLog loggingQueue];
+
+    dispatch_sync(globalLoggingQueue, ^{
+        dispatch_sync(self.loggerQueue, block);
+    });
+
+    return result;
+}
+
+- (void)setCompressesLogFiles:(BOOL)newCompressesLogFiles {
+    dispatch_block_t block = ^{
+        @autoreleasepool {
+            if (self->_compressesLogFiles == newCompressesLogFiles) {
+                return;
+            }
+
+            // Buffered bytes are written the way their file was opened, then the next file is chosen again
+            [self lt_rollLogFileNow];
+            self->_currentLogFileInfo = nil;
+            self->_compressesLogFiles = newCompressesLogFiles;
+        }
+    };
+
+    // The design of this method is taken from the VVAbstractLogger implementation.
+    // For extensive documentation please refer to the VVAbstractLogger implementation.
+
+    NSAssert(![self isOnGlobalLoggingQueue], @"Core architecture requirement failure");
+    NSAssert(![self isOnInternalLoggerQueue], @"MUST access ivar directly, NOT via self.* syntax.");
+
+    dispatch_queue_t globalLoggingQueue = [VVLog loggingQueue];
+
+    dispatch_async(globalLoggingQueue, ^{
+        dispatch_async(self.loggerQueue, block);
+    });
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark File Rolling
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -890,6 +1312,9 @@ NSTimeInterval     const kVVRollingLeeway              = 1.0;              // 1s
         return;
     }
 
+    [self lt_flushMappedBuffer];
+    [self lt_flushBlockBuffer];
+
     [_currentLogFileHandle synchronizeFile];
     [_currentLogFileHandle closeFile];
     _currentLogFileHandle = nil;
@@ -937,7 +1362,16 @@ NSTimeInterval     const kVVRollingLeeway              = 1.0;              // 1s
     // We specifically wrote our own getter/setter method to allow us to do this (for performance reasons).
 
     if (_maximumFileSize > 0) {
-        unsigned long long fileSize = [_currentLogFileHandle offsetInFile];
+        // While buffering, the file offset is tracked to avoid a seek per message.
+        // Compressed files count what is on disk, what still waits to be compressed is at most a block.
+        unsigned long long fileSize;
+        if (_compressesLogFiles) {
+            fileSize = _currentLogFileOffset;
+        } else if (_mappedBuffer) {
+            fileSize = _currentLogFileOffset + _mappedBuffer.length;
+        } else {
+            fileSize = [_currentLogFileHandle offsetInFile];
+        }
 
         if (fileSize >= _maximumFileSize) {
             NSLogVerbose(@"VVFileLogger: Rolling log file due to size (%qu)...", fileSize);
@@ -1070,7 +1504,9 @@ NSTimeInterval     const kVVRollingLeeway              = 1.0;              // 1s
     }
 
     // If we're resuming, we need to check if the log file is allowed for reuse or needs to be archived.
-    if (isResuming && (_doNotReuseLogFiles || [self lt_shouldLogFileBeArchived:logFileInfo])) {
+    if (isResuming && (_doNotReuseLogFiles
+                       || [self lt_shouldLogFileBeArchived:logFileInfo]
+                       || ![self lt_logFileMatchesWriteMode:logFileInfo])) {
         logFileInfo.isArchived = YES;
 
         if ([_logFileManager respondsToSelector:@selector(didArchiveLogFile:)]) {
@@ -1087,6 +1523,30 @@ NSTimeInterval     const kVVRollingLeeway              = 1.0;              // 1s
     return YES;
 }
 
+- (BOOL)lt_logFileMatchesWriteMode:(VVLogFileInfo *)logFileInfo {
+    // An empty file can become either kind
+    if (logFileInfo.fileSize == 0) {
+        return YES;
+    }
+
+    NSString *filePath = logFileInfo.filePath;
+    BOOL isCompressed = [VVLogBlockFile isBlockFileAtPath:filePath];
+    if (isCompressed != _compressesLogFiles) {
+        return NO;
+    }
+    if (!isCompressed) {
+        return [VVLogRecordDecoder isRecordFileAtPath:filePath] == _writesBinaryRecords;
+    }
+
+    // A binary log file keeps its header in the first block
+    VVLogBlockFile *blockFile = [[VVLogBlockFile alloc] initWithPath:filePath error:nil];
+    if (blockFile.blocks.count == 0) {
+        return !_writesBinaryRecords;
+    }
+    NSData *content = [blockFile dataOfBlockAtIndex:0 error:nil];
+    return content && [VVLogRecordDecoder isRecordData:content] == _writesBinaryRecords;
+}
+
 - (void)lt_monitorCurrentLogFileForExternalChanges {
     NSAssert([self isOnInternalLoggerQueue], @"lt_ methods should be on logger queue.");
     NSAssert(_currentLogFileHandle, @"Can not monitor without handle.");
@@ -1122,7 +1582,15 @@ NSTimeInterval     const kVVRollingLeeway              = 1.0;              // 1s
     if (!_currentLogFileHandle) {
         NSString *logFilePath = [[self lt_currentLogFileInfo] filePath];
         _currentLogFileHandle = [NSFileHandle fileHandleForWritingAtPath:logFilePath];
-        [_currentLogFileHandle seekToEndOfFile];
+        _currentLogFileOffset = [_currentLogFileHandle seekToEndOfFile];
+
+        if (_currentLogFileHandle && _compressesLogFiles) {
+            [self lt_openCompressedLogFile];
+        } else if (_currentLogFileHandle && _writesBinaryRecords && _currentLogFileOffset == 0) {
+            NSData *header = [VVLogRecordWriter fileHeader];
+            [_currentLogFileHandle writeData:header];
+            _currentLogFileOffset = header.length;
+        }
 
         if (_currentLogFileHandle) {
             [self lt_scheduleTimerToRollLogFileDueToAge];
@@ -1133,6 +1601,275 @@ NSTimeInterval     const kVVRollingLeeway              = 1.0;              // 1s
     return _currentLogFileHandle;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Compression
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (void)lt_openCompressedLogFile {
+    NSAssert([self isOnInternalLoggerQueue], @"lt_ methods should be on logger queue.");
+
+    if (_currentLogFileOffset == 0) {
+        NSData *header = [VVLogBlockCompressor fileHeader];
+        [_currentLogFileHandle writeData:header];
+        _currentLogFileOffset = header.length;
+        _currentUncompressedLength = 0;
+
+        // The decoder expects the header of a binary log file first in the content
+        if (_writesBinaryRecords) {
+            NSTimeInterval now = [[NSDate date] timeIntervalSince1970];
+            [self lt_writeData:[VVLogRecordWriter fileHeader] firstTimestamp:now lastTimestamp:now];
+        }
+        return;
+    }
+
+    [self lt_resumeCompressedLogFile];
+}
+
+- (void)lt_resumeCompressedLogFile {
+    NSAssert([self isOnInternalLoggerQueue], @"lt_ methods should be on logger queue.");
+
+    // Blocks are appended after the last complete one, dropping a block a crash cut short.
+    VVLogBlockFile *blockFile = [[VVLogBlockFile alloc] initWithPath:_currentLogFileInfo.filePath error:nil];
+    unsigned long long validLength = blockFile ? blockFile.validLength : kVVLogBlockFileHeaderLength;
+
+    if (validLength < _currentLogFileOffset) {
+        NSLogWarn(@"VVFileLogger: Dropping %llu bytes of an incomplete block", _currentLogFileOffset - validLength);
+        [_currentLogFileHandle truncateFileAtOffset:validLength];
+        _currentLogFileOffset = validLength;
+    }
+    _currentUncompressedLength = blockFile.uncompressedLength;
+}
+
+- (BOOL)lt_writeBlockWithData:(NSData *)data
+           uncompressedOffset:(unsigned long long)offset
+               firstTimestamp:(NSTimeInterval)firstTimestamp
+                lastTimestamp:(NSTimeInterval)lastTimestamp
+                 toFileHandle:(NSFileHandle *)handle {
+    NSAssert([self isOnInternalLoggerQueue], @"lt_ methods should be on logger queue.");
+
+    if (_blockCompressor == nil) {
+        _blockCompressor = [[VVLogBlockCompressor alloc] initWithLevel:Z_DEFAULT_COMPRESSION];
+        _compressedBuffer = [[NSMutableData alloc] initWithCapacity:kVVLogBlockBufferSize];
+    }
+    _compressedBuffer.length = 0;
+
+    if (![_blockCompressor appendBlockWithData:data
+                            uncompressedOffset:offset
+                                firstTimestamp:firstTimestamp
+                                 lastTimestamp:lastTimestamp
+                                      toBuffer:_compressedBuffer]) {
+        NSLogError(@"VVFileLogger: Failed to compress %lu log bytes", (unsigned long)data.length);
+        return NO;
+    }
+
+    [handle writeData:_compressedBuffer];
+    return YES;
+}
+
+/// Appends to the current log file, as a block if it is compressed.
+- (void)lt_writeData:(NSData *)data firstTimestamp:(NSTimeInterval)firstTimestamp lastTimestamp:(NSTimeInterval)lastTimestamp {
+    NSAssert([self isOnInternalLoggerQueue], @"lt_ methods should be on logger queue.");
+
+    NSFileHandle *handle = [self lt_currentLogFileHandle];
+    [handle seekToEndOfFile];
+
+    if (!_compressesLogFiles) {
+        [handle writeData:data];
+    } else if ([self lt_writeBlockWithData:data
+                        uncompressedOffset:_currentUncompressedLength
+                            firstTimestamp:firstTimestamp
+                             lastTimestamp:lastTimestamp
+                              toFileHandle:handle]) {
+        _currentUncompressedLength += data.length;
+    }
+
+    _currentLogFileOffset = [handle offsetInFile];
+}
+
+- (void)lt_appendDataToBlockBuffer:(NSData *)data timestamp:(NSTimeInterval)timestamp {
+    NSAssert([self isOnInternalLoggerQueue], @"lt_ methods should be on logger queue.");
+
+    if (_blockBuffer == nil) {
+        _blockBuffer = [[NSMutableData alloc] initWithCapacity:kVVLogBlockBufferSize];
+    }
+
+    if (_blockBuffer.length == 0) {
+        _blockFirstTimestamp = timestamp;
+    }
+    [_blockBuffer appendData:data];
+    _blockLastTimestamp = timestamp;
+
+    if (_blockBuffer.length >= kVVLogBlockBufferSize) {
+        [self lt_flushBlockBuffer];
+    }
+}
+
+- (void)lt_flushBlockBuffer {
+    NSAssert([self isOnInternalLoggerQueue], @"lt_ methods should be on logger queue.");
+
+    if (_blockBuffer.length == 0) {
+        return;
+    }
+
+    @try {
+        [self lt_writeData:_blockBuffer firstTimestamp:_blockFirstTimestamp lastTimestamp:_blockLastTimestamp];
+    } @catch (NSException *exception) {
+        NSLogError(@"VVFileLogger: Failed to write log block: %@", exception);
+    }
+
+    _blockBuffer.length = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Buffering
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+- (NSString *)lt_mappedBufferPath {
+    // Next to the logs directory, not in it, so it is never taken for a log file nor copied with them.
+    NSString *logsDirectory = [_logFileManager logsDirectory];
+    NSString *bufferName = [NSString stringWithFormat:@".%@.vvbuffer", logsDirectory.lastPathComponent];
+
+    return [[logsDirectory stringByDeletingLastPathComponent] stringByAppendingPathComponent:bufferName];
+}
+
+- (nullable VVMappedLogBuffer *)lt_openMappedBuffer {
+    NSString *bufferPath = [self lt_mappedBufferPath];
+
+#if TARGET_OS_IPHONE
+    // A mapped page of a locked file faults, keep the buffer readable in background after first unlock.
+    if (![[NSFileManager defaultManager] fileExistsAtPath:bufferPath]) {
+        NSDictionary *attributes = @{ NSFileProtectionKey: NSFileProtectionCompleteUntilFirstUserAuthentication };
+        [[NSFileManager defaultManager] createFileAtPath:bufferPath contents:nil attributes:attributes];
+    }
+#endif
+
+    return [[VVMappedLogBuffer alloc] initWithPath:bufferPath capacity:_bufferSize];
+}
+
+- (nullable VVMappedLogBuffer *)lt_mappedBuffer {
+    NSAssert([self isOnInternalLoggerQueue], @"lt_ methods should be on logger queue.");
+
+    if (_mappedBuffer || _bufferSize == 0 || _mappedBufferUnavailable) {
+        return _mappedBuffer;
+    }
+
+    VVMappedLogBuffer *buffer = [self lt_openMappedBuffer];
+
+    if (buffer.length > 0) {
+        NSLogInfo(@"VVFileLogger: Recovering %lu buffered bytes of %@", (unsigned long)buffer.length, buffer.fileName);
+        [self lt_writeLeftoverOfMappedBuffer:buffer];
+
+        // Leftover keeps the capacity it was written with
+        if (buffer.capacity != _bufferSize) {
+            buffer = nil;
+            buffer = [self lt_openMappedBuffer];
+        }
+    }
+
+    if (!buffer) {
+        NSLogError(@"VVFileLogger: Failed to map log buffer, writing log file directly.");
+        _mappedBufferUnavailable = YES;
+    }
+
+    _mappedBuffer = buffer;
+    return _mappedBuffer;
+}
+
+- (void)lt_writeLeftoverOfMappedBuffer:(VVMappedLogBuffer *)buffer {
+    NSAssert([self isOnInternalLoggerQueue], @"lt_ methods should be on logger queue.");
+
+    // Back to the file it was logged into, or the current one if that is gone.
+    NSString *filePath = nil;
+    if (buffer.fileName.length > 0) {
+        filePath = [[_logFileManager logsDirectory] stringByAppendingPathComponent:buffer.fileName];
+    }
+
+    NSFileHandle *handle = nil;
+    if (filePath && [[NSFileManager defaultManager] fileExistsAtPath:filePath]) {
+        handle = [NSFileHandle fileHandleForWritingAtPath:filePath];
+    }
+
+    // Leftover of a process that did not record append times
+    NSTimeInterval lastTimestamp = buffer.lastTimestamp ?: [[NSDate date] timeIntervalSince1970];
+    NSTimeInterval firstTimestamp = buffer.firstTimestamp ?: lastTimestamp;
+
+    // Compressed like the rest of its file, after its last complete block
+    VVLogBlockFile *blockFile = handle ? [[VVLogBlockFile alloc] initWithPath:filePath error:nil] : nil;
+
+    @try {
+        if (blockFile) {
+            [handle truncateFileAtOffset:blockFile.validLength];
+            [self lt_writeBlockWithData:[buffer bufferedData]
+                     uncompressedOffset:blockFile.uncompressedLength
+                         firstTimestamp:firstTimestamp
+                          lastTimestamp:lastTimestamp
+                           toFileHandle:handle];
+            [handle closeFile];
+        } else if (handle) {
+            [handle seekToEndOfFile];
+            [handle writeData:[buffer bufferedData]];
+            [handle closeFile];
+        } else {
+            [self lt_writeData:[buffer bufferedData] firstTimestamp:firstTimestamp lastTimestamp:lastTimestamp];
+        }
+    } @catch (NSException *exception) {
+        NSLogError(@"VVFileLogger: Failed to recover log buffer: %@", exception);
+    }
+
+    [buffer reset];
+
+    if (_currentLogFileHandle) {
+        _currentLogFileOffset = [_currentLogFileHandle seekToEndOfFile];
+        if (_compressesLogFiles) {
+            [self lt_resumeCompressedLogFile];
+        }
+    }
+}
+
+- (void)lt_appendData:(NSData *)data toMappedBuffer:(VVMappedLogBuffer *)buffer timestamp:(NSTimeInterval)timestamp {
+    NSAssert([self isOnInternalLoggerQueue], @"lt_ methods should be on logger queue.");
+
+    // This method is called from logMessage.
+    // Keep it FAST.
+
+    NSString *fileName = _currentLogFileInfo.fileName;
+
+    if (![buffer appendData:data fileName:fileName timestamp:timestamp]) {
+        [self lt_flushMappedBuffer];
+
+        if (![buffer appendData:data fileName:fileName timestamp:timestamp]) {
+            // Larger than the whole buffer
+            [self lt_writeData:data firstTimestamp:timestamp lastTimestamp:timestamp];
+            return;
+        }
+    }
+
+    NSUInteger highWaterMark = _bufferHighWaterMark > 0 ? _bufferHighWaterMark : buffer.capacity / 4 * 3;
+    if (buffer.length >= MIN(highWaterMark, buffer.capacity)) {
+        [self lt_flushMappedBuffer];
+    }
+}
+
+- (void)lt_flushMappedBuffer {
+    NSAssert([self isOnInternalLoggerQueue], @"lt_ methods should be on logger queue.");
+
+    NSUInteger length = _mappedBuffer.length;
+    if (length == 0) {
+        return;
+    }
+
+    @try {
+        [self lt_writeData:[_mappedBuffer bufferedData]
+            firstTimestamp:_mappedBuffer.firstTimestamp
+             lastTimestamp:_mappedBuffer.lastTimestamp];
+    } @catch (NSException *exception) {
+        // Same loss as a failed direct write, the buffer must not outlive its log file.
+        NSLogError(@"VVFileLogger: Failed to write log buffer: %@", exception);
+    }
+
+    [_mappedBuffer reset];
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark VVLogger Protocol
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1147,7 +1884,7 @@ static int exception_count = 0;
         return;
     }
 
-    [self lt_logData:data];
+    [self lt_logData:data timestamp:[logMessage->_timestamp timeIntervalSince1970]];
 }
 
 - (void)willLogMessage:(VVLogFileInfo *)logFileInfo {
@@ -1193,6 +1930,8 @@ static int exception_count = 0;
 
 - (void)lt_flush {
     NSAssert([self isOnInternalLoggerQueue], @"flush should only be executed on internal queue.");
+    [self lt_flushMappedBuffer];
+    [self lt_flushBlockBuffer];
     [_currentLogFileHandle synchronizeFile];
 }
 
@@ -1247,6 +1986,10 @@ static int exception_count = 0;
 }
 
 - (void)lt_logData:(NSData *)data {
+    [self lt_logData:data timestamp:[[NSDate date] timeIntervalSince1970]];
+}
+
+- (void)lt_logData:(NSData *)data timestamp:(NSTimeInterval)timestamp {
     static BOOL implementsDeprecatedWillLog = NO;
     static BOOL implementsDeprecatedDidLog = NO;
 
@@ -1272,9 +2015,17 @@ static int exception_count = 0;
             [self willLogMessage:_currentLogFileInfo];
         }
 
+        VVMappedLogBuffer *buffer = [self lt_mappedBuffer];
         NSFileHandle *handle = [self lt_currentLogFileHandle];
-        [handle seekToEndOfFile];
-        [handle writeData:data];
+
+        if (buffer && handle) {
+            [self lt_appendData:data toMappedBuffer:buffer timestamp:timestamp];
+        } else if (handle && _compressesLogFiles) {
+            [self lt_appendDataToBlockBuffer:data timestamp:timestamp];
+        } else {
+            [handle seekToEndOfFile];
+            [handle writeData:data];
+        }
 
         if (implementsDeprecatedDidLog) {
 #pragma clang diagnostic push
@@ -1301,12 +2052,29 @@ static int exception_count = 0;
 - (NSData *)lt_dataForMessage:(VVLogMessage *)logMessage {
     NSAssert([self isOnInternalLoggerQueue], @"logMessage should only be executed on internal queue.");
 
-    NSString *message = logMessage->_message;
+    if (_writesBinaryRecords) {
+        return [self lt_recordDataForMessage:logMessage];
+    }
+
+    if ([_logFormatter respondsToSelector:@selector(appendLogMessage:toBuffer:)]) {
+        // The buffer is only valid until the next message, lt_logData: has consumed it by then.
+        if (_messageBuffer == nil) {
+            _messageBuffer = [[NSMutableData alloc] initWithCapacity:1024];
+        }
+        _messageBuffer.length = 0;
+
+        if (![(id <VVLogDataFormatter>)_logFormatter appendLogMessage:logMessage toBuffer:_messageBuffer]) {
+            return nil;
+        }
+        return _messageBuffer;
+    }
+
+    NSString *message = logMessage.message;
     BOOL isFormatted = NO;
 
     if (_logFormatter != nil) {
         message = [_logFormatter formatLogMessage:logMessage];
-        isFormatted = message != logMessage->_message;
+        isFormatted = message != logMessage.message;
     }
 
     if (message.length == 0) {
@@ -1321,6 +2089,24 @@ static int exception_count = 0;
     return [message dataUsingEncoding:NSUTF8StringEncoding];
 }
 
+- (NSData *)lt_recordDataForMessage:(VVLogMessage *)logMessage {
+    NSAssert([self isOnInternalLoggerQueue], @"logMessage should only be executed on internal queue.");
+
+    if (_messageBuffer == nil) {
+        _messageBuffer = [[NSMutableData alloc] initWithCapacity:1024];
+    }
+    _messageBuffer.length = 0;
+
+    // No open handle, the data goes to a file this process has not written yet.
+    // Call site identifiers are only valid within the process, begin a new session.
+    if (_currentLogFileHandle == nil) {
+        [_recordWriter appendSessionToBuffer:_messageBuffer];
+    }
+    [_recordWriter appendLogMessage:logMessage toBuffer:_messageBuffer];
+
+    return _messageBuffer;
+}
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
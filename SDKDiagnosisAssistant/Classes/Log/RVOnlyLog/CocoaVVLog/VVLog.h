@@ -36,6 +36,7 @@
 
 @class VVLogMessage;
 @class VVLoggerInformation;
+@class VVLogCallSiteInfo;
 @protocol VVLogger;
 @protocol VVLogFormatter;
 
@@ -203,6 +204,95 @@ FOUNDATION_EXTERN NSString * __nullable VVExtractFileNameWithoutExtension(const
  **/
 #define THIS_METHOD       NSStringFromSelector(_cmd)
 
+/**
+ * What an asynchronous log statement does when the logging queue is full.
+ *
+ * `VVLogQueueOverflowPolicyBlock`:
+ *   The issuing thread waits until the logging thread made room. Nothing is lost.
+ *   Log statements issued on the logging queue itself are dropped instead, waiting there would never end.
+ *
+ * `VVLogQueueOverflowPolicyDropNewest`:
+ *   The new log statement is dropped.
+ *
+ * `VVLogQueueOverflowPolicyDropOldest`:
+ *   The oldest queued log statement is dropped to make room for the new one.
+ *
+ * The policy only covers the logging queue. A logger whose backlog is full (see `maximumBacklog`)
+ * has new messages dropped for it alone under every policy, so a slow logger never holds back the others.
+ *
+ * When statements are dropped, loggers receive a warning telling how many before the next statement.
+ **/
+typedef NS_ENUM(NSUInteger, VVLogQueueOverflowPolicy){
+    VVLogQueueOverflowPolicyBlock      = 0,
+    VVLogQueueOverflowPolicyDropNewest = 1,
+    VVLogQueueOverflowPolicyDropOldest = 2
+};
+
+/**
+ * Counters of the asynchronous logging queue, since the `VVLog` instance was created.
+ * Times are in nanoseconds, measured around the enqueue of each asynchronous log statement.
+ **/
+typedef struct {
+    uint64_t enqueuedCount;
+    uint64_t droppedCount;
+    uint64_t blockedCount;       // enqueues which had to wait for room
+    uint64_t totalEnqueueNanos;
+    uint64_t maxEnqueueNanos;
+} VVLogQueueStatistics;
+
+/**
+ * State of one log statement for the binary record mode, see `recordsArguments`.
+ * The macros keep a zero initialized static one per statement, only VVLog touches it.
+ **/
+typedef struct {
+    void * _Nullable info;
+} VVLogCallSite;
+
+/**
+ * State of one rate limited log statement, see `VVLogRateLimitAllow`.
+ * The macros keep a zero initialized static one per statement.
+ **/
+typedef struct {
+    uint64_t nextNanos;
+    uint64_t count;
+    uint64_t suppressedCount;
+} VVLogRateLimit;
+
+/**
+ * Token bucket: lets through `ratePerSecond` statements per second on average, in bursts of up to `burst`.
+ * A `ratePerSecond` of 0 lets everything through.
+ *
+ * When it returns YES, `suppressedCount` is set to the number of statements rejected since the last one let through.
+ * A rejected statement costs a clock read and two atomic operations.
+ **/
+FOUNDATION_EXTERN BOOL VVLogRateLimitAllow(VVLogRateLimit *limit, double ratePerSecond, NSUInteger burst, uint64_t *suppressedCount);
+
+/**
+ * Lets through one statement out of every `n`, starting with the first. An `n` of 0 or 1 lets everything through.
+ **/
+FOUNDATION_EXTERN BOOL VVLogSampleAllow(VVLogRateLimit *limit, NSUInteger n);
+
+/**
+ * Lets through the first `n` statements of every `interval` seconds. The window opens with the first statement after
+ * the previous one ended; an `interval` of 0 never ends it.
+ *
+ * When it returns YES, `suppressedCount` is set to the number of statements rejected since the last one let through.
+ **/
+FOUNDATION_EXTERN BOOL VVLogFirstNAllow(VVLogRateLimit *limit, NSUInteger n, NSTimeInterval interval, uint64_t *suppressedCount);
+
+/**
+ * Union of the levels of the loggers added to the shared `VVLog`, updated as loggers are added and removed.
+ * The macros check it before evaluating any argument of a statement. Only `VVLog` writes it.
+ **/
+FOUNDATION_EXTERN NSUInteger VVLogEnabledLevels;
+
+/**
+ * Whether a logger of the shared `VVLog` takes statements with `flag`. A single relaxed atomic load.
+ **/
+static inline BOOL VVLogIsEnabledForFlag(VVLogFlag flag) {
+    return (__atomic_load_n(&VVLogEnabledLevels, __ATOMIC_RELAXED) & flag) != 0;
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma mark -
@@ -278,6 +368,52 @@ FOUNDATION_EXTERN NSString * __nullable VVExtractFileNameWithoutExtension(const
         tag:(nullable id)tag
      format:(NSString *)format, ... NS_FORMAT_FUNCTION(9,10);
 
+/**
+ * Logging Primitive.
+ *
+ * This method is used by the macros, `callSite` is the static state of the log statement.
+ * While `recordsArguments` is on, the arguments of a statement with a literal format are
+ * serialized instead of formatted, the message is formatted when first asked for.
+ * Otherwise same as `log:level:flag:context:file:function:line:tag:format:...`
+ *
+ *  @param asynchronous YES if the logging is done async, NO if you want to force sync
+ *  @param level        the log level
+ *  @param flag         the log flag
+ *  @param context      the context (if any is defined)
+ *  @param file         the current file
+ *  @param function     the current function
+ *  @param line         the current code line
+ *  @param tag          potential tag
+ *  @param callSite     the state of the log statement, must live as long as the process
+ *  @param format       the log format
+ */
++ (void)log:(BOOL)asynchronous
+      level:(VVLogLevel)level
+       flag:(VVLogFlag)flag
+    context:(NSInteger)context
+       file:(const char *)file
+   function:(nullable const char *)function
+       line:(NSUInteger)line
+        tag:(nullable id)tag
+   callSite:(nullable VVLogCallSite *)callSite
+     format:(NSString *)format, ... NS_FORMAT_FUNCTION(10,11);
+
+/**
+ * Logging Primitive.
+ *
+ * See `log:level:flag:context:file:function:line:tag:callSite:format:...`
+ */
+- (void)log:(BOOL)asynchronous
+      level:(VVLogLevel)level
+       flag:(VVLogFlag)flag
+    context:(NSInteger)context
+       file:(const char *)file
+   function:(nullable const char *)function
+       line:(NSUInteger)line
+        tag:(nullable id)tag
+   callSite:(nullable VVLogCallSite *)callSite
+     format:(NSString *)format, ... NS_FORMAT_FUNCTION(10,11);
+
 /**
  * Logging Primitive.
  *
@@ -368,6 +504,39 @@ FOUNDATION_EXTERN NSString * __nullable VVExtractFileNameWithoutExtension(const
  **/
 - (void)flushLog;
 
+/**
+ * Asynchronous log statements go through a bounded lock-free queue, drained in batches by the logging queue.
+ * This decides what happens when it is full. Default is `VVLogQueueOverflowPolicyBlock`.
+ **/
+@property (class, nonatomic, assign) VVLogQueueOverflowPolicy queueOverflowPolicy;
+
+/**
+ *  See description for the class property `queueOverflowPolicy`
+ */
+@property (nonatomic, assign) VVLogQueueOverflowPolicy queueOverflowPolicy;
+
+/**
+ * Counters of the asynchronous logging queue.
+ **/
+@property (class, nonatomic, readonly) VVLogQueueStatistics queueStatistics;
+
+/**
+ * Binary record mode, off by default.
+ *
+ * When on, log statements from the macros don't format their message on the calling thread.
+ * The format is registered once per statement, the arguments are serialized into the log message,
+ * with objects reduced to their description. A binary file logger writes them as they are,
+ * other loggers format them on their own queue when they ask for `message`.
+ * Statements whose format is built at runtime or uses conversions the mode does not support
+ * are formatted as before. See `VVLogRecordFormat.h`.
+ **/
+@property (class, nonatomic, assign) BOOL recordsArguments;
+
+/**
+ *  See description for the class property `queueStatistics`
+ */
+@property (nonatomic, readonly) VVLogQueueStatistics queueStatistics;
+
 /**
  * Loggers
  *
@@ -643,6 +812,16 @@ FOUNDATION_EXTERN NSString * __nullable VVExtractFileNameWithoutExtension(const
  **/
 @property (copy, nonatomic, readonly) VVLoggerName loggerName;
 
+/**
+ * Asynchronous log messages are handed to each logger in batches, without waiting for it.
+ * This is the most messages a logger may have been handed and not logged yet.
+ * Beyond it new messages are dropped for this logger only, whatever the queue overflow policy, so a slow logger
+ * never holds back the others. They are counted in its `droppedCount`, and it receives a warning telling how many
+ * once it caught up.
+ * If not implemented, VVLOG_MAX_LOGGER_BACKLOG is used. Read once, when the logger is added.
+ **/
+@property (nonatomic, readonly) NSUInteger maximumBacklog;
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -785,6 +964,10 @@ typedef NS_OPTIONS(NSInteger, VVLogMessageOptions){
     NSString *_threadName;
     NSString *_queueLabel;
     NSUInteger _qos;
+
+    // Set for messages logged in binary record mode, `_message` is nil until `message` is first read.
+    VVLogCallSiteInfo *_callSite;
+    NSData *_arguments;
 }
 
 /**
@@ -835,7 +1018,7 @@ typedef NS_OPTIONS(NSInteger, VVLogMessageOptions){
  **/
 
 /**
- *  The log message
+ *  The log message, formatted on first access for messages logged in binary record mode
  */
 @property (readonly, nonatomic) NSString *message;
 @property (readonly, nonatomic) VVLogLevel level;
@@ -908,10 +1091,16 @@ typedef NS_OPTIONS(NSInteger, VVLogMessageOptions){
 
 @property (nonatomic, readonly) id <VVLogger> logger;
 @property (nonatomic, readonly) VVLogLevel level;
+/// Messages dropped for this logger because its backlog was full
+@property (nonatomic, readonly) uint64_t droppedCount;
 
 + (instancetype)informationWithLogger:(id <VVLogger>)logger
                              andLevel:(VVLogLevel)level;
 
++ (instancetype)informationWithLogger:(id <VVLogger>)logger
+                             andLevel:(VVLogLevel)level
+                         droppedCount:(uint64_t)droppedCount;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -18,8 +18,11 @@
 #endif
 
 #import <pthread.h>
+#import <stdatomic.h>
 #import <objc/runtime.h>
+#import <os/lock.h>
 #import <sys/qos.h>
+#import <time.h>
 
 #if TARGET_OS_IOS
     #import <UIKit/UIDevice.h>
@@ -34,6 +37,7 @@
 #endif
 
 #import "VVLog.h"
+#import "VVLogRecord.h"
 
 // We probably shouldn't be using VVLog() statements within the VVLog implementation.
 // But we still want to leave our log statements for any future debugging,
@@ -56,13 +60,31 @@
 // but may also be possible if relatively slow loggers are being used.
 //
 // This property caps the queue size at a given number of outstanding log statements.
-// If a thread attempts to issue a log statement when the queue is already maxed out,
-// the issuing thread will block until the queue size drops below the max again.
+// It is rounded up to a power of two, the number of preallocated slots of the queue.
+// What happens when a thread issues a log statement while the queue is full is decided by
+// the queueOverflowPolicy, by default the issuing thread blocks until the queue has room again.
 
 #ifndef VVLOG_MAX_QUEUE_SIZE
     #define VVLOG_MAX_QUEUE_SIZE 1000 // Should not exceed INT32_MAX
 #endif
 
+// The logging queue takes at most this many log statements from the queue per autorelease pool.
+
+#ifndef VVLOG_QUEUE_BATCH_SIZE
+    #define VVLOG_QUEUE_BATCH_SIZE 64
+#endif
+
+// The most log messages a logger may have been handed and not logged yet,
+// unless it tells otherwise through its maximumBacklog property.
+
+#ifndef VVLOG_MAX_LOGGER_BACKLOG
+    #define VVLOG_MAX_LOGGER_BACKLOG 5000
+#endif
+
+// A blocked thread checks for room at least this often, in case it missed a wakeup.
+
+#define VVLOG_QUEUE_BLOCK_INTERVAL (10 * NSEC_PER_MSEC)
+
 // The "global logging queue" refers to [VVLog loggingQueue].
 // It is the queue that all log statements go through.
 //
@@ -71,6 +93,119 @@
 
 static void *const GlobalLoggingQueueIdentityKey = (void *)&GlobalLoggingQueueIdentityKey;
 
+// Bounded lock-free queue of log statements (Dmitry Vyukov's bounded MPMC queue).
+//
+// Every slot carries a sequence number telling whose turn it is: a producer may fill slot
+// (pos & mask) when its sequence is pos, the consumer may empty it when it is pos + 1.
+// Producers and the consumer only race on a compare-and-swap of their own position,
+// nobody ever waits on another thread in the kernel.
+//
+// Its only consumer is the logging queue, but a producer may dequeue too, to drop the oldest statement.
+
+#define VVLOG_CACHE_LINE 64
+
+typedef struct {
+    _Atomic(uintptr_t) sequence;
+    void *message; // retained VVLogMessage
+} VVLogQueueSlot;
+
+typedef struct {
+    _Atomic(uintptr_t) enqueuePos;
+    char padding0[VVLOG_CACHE_LINE - sizeof(uintptr_t)];
+    _Atomic(uintptr_t) dequeuePos;
+    char padding1[VVLOG_CACHE_LINE - sizeof(uintptr_t)];
+
+    _Atomic(bool) drainScheduled;
+    _Atomic(uint32_t) blockedProducers;
+    _Atomic(NSUInteger) overflowPolicy;
+    _Atomic(uint64_t) pendingDropped; // not yet reported to the loggers
+
+    _Atomic(uint64_t) enqueuedCount;
+    _Atomic(uint64_t) droppedCount;
+    _Atomic(uint64_t) blockedCount;
+    _Atomic(uint64_t) totalEnqueueNanos;
+    _Atomic(uint64_t) maxEnqueueNanos;
+
+    uintptr_t mask;
+    VVLogQueueSlot slots[];
+} VVLogQueue;
+
+static VVLogQueue *VVLogQueueCreate(NSUInteger minimumCapacity) {
+    uintptr_t capacity = 2;
+    while (capacity < minimumCapacity) {
+        capacity <<= 1;
+    }
+
+    VVLogQueue *queue = NULL;
+    size_t size = sizeof(VVLogQueue) + capacity * sizeof(VVLogQueueSlot);
+    if (posix_memalign((void **)&queue, VVLOG_CACHE_LINE, size) != 0) {
+        return NULL;
+    }
+    memset(queue, 0, size);
+
+    queue->mask = capacity - 1;
+    for (uintptr_t i = 0; i < capacity; i++) {
+        atomic_init(&queue->slots[i].sequence, i);
+    }
+
+    return queue;
+}
+
+static BOOL VVLogQueueTryEnqueue(VVLogQueue *queue, void *message) {
+    VVLogQueueSlot *slot;
+    uintptr_t pos = atomic_load_explicit(&queue->enqueuePos, memory_order_relaxed);
+
+    for (;;) {
+        slot = &queue->slots[pos & queue->mask];
+        uintptr_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->enqueuePos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return NO; // Full
+        } else {
+            pos = atomic_load_explicit(&queue->enqueuePos, memory_order_relaxed);
+        }
+    }
+
+    slot->message = message;
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+
+    return YES;
+}
+
+static void *VVLogQueueTryDequeue(VVLogQueue *queue) {
+    VVLogQueueSlot *slot;
+    uintptr_t pos = atomic_load_explicit(&queue->dequeuePos, memory_order_relaxed);
+
+    for (;;) {
+        slot = &queue->slots[pos & queue->mask];
+        uintptr_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->dequeuePos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return NULL; // Empty
+        } else {
+            pos = atomic_load_explicit(&queue->dequeuePos, memory_order_relaxed);
+        }
+    }
+
+    void *message = slot->message;
+    slot->message = NULL;
+    atomic_store_explicit(&slot->sequence, pos + queue->mask + 1, memory_order_release);
+
+    return message;
+}
+
 @interface VVLoggerNode : NSObject
 {
     // Direct accessors to be used only for performance
@@ -78,6 +213,15 @@ static void *const GlobalLoggingQueueIdentityKey = (void *)&GlobalLoggingQueueId
     id <VVLogger> _logger;
     VVLogLevel _level;
     dispatch_queue_t _loggerQueue;
+
+    // Messages handed to the logger queue and not logged yet.
+    // Incremented on the logging queue, decremented on the logger queue.
+    _Atomic(NSUInteger) _backlog;
+    NSUInteger _maximumBacklog;
+
+    // Only accessed on the logging queue.
+    uint64_t _droppedCount;
+    uint64_t _pendingDropped;
 }
 
 @property (nonatomic, readonly) id <VVLogger> logger;
@@ -88,6 +232,9 @@ static void *const GlobalLoggingQueueIdentityKey = (void *)&GlobalLoggingQueueId
                    loggerQueue:(dispatch_queue_t)loggerQueue
                          level:(VVLogLevel)level;
 
+/// Messages the logger can still be handed
+- (NSUInteger)roomInBacklog;
+
 @end
 
 
@@ -95,12 +242,48 @@ static void *const GlobalLoggingQueueIdentityKey = (void *)&GlobalLoggingQueueId
 #pragma mark -
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-@interface VVLog ()
+@interface VVLogMessage () {
+    // Guards formatting `_message` from the record, loggers may ask for it on their queues at once.
+    os_unfair_lock _messageLock;
+}
+
+// Binary record mode, the message is formatted from the arguments when first asked for.
+- (instancetype)initWithCallSite:(VVLogCallSiteInfo *)callSite
+                       arguments:(NSData *)arguments
+                           level:(VVLogLevel)level
+                            flag:(VVLogFlag)flag
+                         context:(NSInteger)context
+                             tag:(id)tag;
+
+@end
+
+@interface VVLog () {
+    // Asynchronous log statements waiting for the logging queue.
+    VVLogQueue *_queue;
+
+    // Signaled by the logging queue when it made room and threads are blocked.
+    dispatch_semaphore_t _queueSpaceSemaphore;
+
+    // Loggers passed to addLogger: which the logging queue has not added yet.
+    atomic_long _pendingLoggerAdds;
+}
 
 // An array used to manage all the individual loggers.
 // The array is only modified on the loggingQueue/loggingThread.
 @property (nonatomic, strong) NSMutableArray *_loggers;
 
+- (void)log:(BOOL)asynchronous
+      level:(VVLogLevel)level
+       flag:(VVLogFlag)flag
+    context:(NSInteger)context
+       file:(const char *)file
+   function:(const char *)function
+       line:(NSUInteger)line
+        tag:(id)tag
+   callSite:(VVLogCallSite *)callSite
+     format:(NSString *)format
+       args:(va_list)args;
+
 @end
 
 @implementation VVLog
@@ -112,13 +295,14 @@ static dispatch_queue_t _loggingQueue;
 // Each logger has it's own associated queue, and a dispatch group is used for synchronization.
 static dispatch_group_t _loggingGroup;
 
-// In order to prevent to queue from growing infinitely large,
-// a maximum size is enforced (VVLOG_MAX_QUEUE_SIZE).
-static dispatch_semaphore_t _queueSemaphore;
-
 // Minor optimization for uniprocessor machines
 static NSUInteger _numProcessors;
 
+// Read by every log statement, see recordsArguments.
+static atomic_bool _recordsArguments;
+
+NSUInteger VVLogEnabledLevels = 0;
+
 /**
  *  Returns the singleton `VVLog`.
  *  The instance is used by `VVLog` class methods.
@@ -156,8 +340,6 @@ static NSUInteger _numProcessors;
         void *nonNullValue = GlobalLoggingQueueIdentityKey; // Whatever, just not null
         dispatch_queue_set_specific(_loggingQueue, GlobalLoggingQueueIdentityKey, nonNullValue, NULL);
 
-        _queueSemaphore = dispatch_semaphore_create(VVLOG_MAX_QUEUE_SIZE);
-
         // Figure out how many processors are available.
         // This may be used later for an optimization on uniprocessor machines.
 
@@ -179,6 +361,12 @@ static NSUInteger _numProcessors;
     if (self) {
         self._loggers = [[NSMutableArray alloc] initWithCapacity:4];
 
+        // In order to prevent to queue from growing infinitely large,
+        // a maximum size is enforced (VVLOG_MAX_QUEUE_SIZE).
+        _queue = VVLogQueueCreate(VVLOG_MAX_QUEUE_SIZE);
+        NSAssert(_queue, @"Failed to allocate the logging queue");
+        _queueSpaceSemaphore = dispatch_semaphore_create(0);
+
 #if TARGET_OS_IOS
         NSString *notificationName = UIApplicationWillTerminateNotification;
 #else
@@ -213,6 +401,14 @@ static NSUInteger _numProcessors;
     return self;
 }
 
+- (void)dealloc {
+    void *message;
+    while ((message = VVLogQueueTryDequeue(_queue))) {
+        CFRelease(message);
+    }
+    free(_queue);
+}
+
 /**
  * Provides access to the logging queue.
  **/
@@ -249,8 +445,19 @@ static NSUInteger _numProcessors;
         return;
     }
 
+    // Widen the enabled levels right away, so the macros don't drop statements issued before the logging queue gets
+    // to add the logger.
+    atomic_fetch_add_explicit(&_pendingLoggerAdds, 1, memory_order_relaxed);
+    if (self == VVLog.sharedInstance) {
+        __atomic_fetch_or(&VVLogEnabledLevels, (NSUInteger)level, __ATOMIC_RELAXED);
+    }
+
     dispatch_async(_loggingQueue, ^{ @autoreleasepool {
+        // Statements issued before the change still go to the loggers as they were.
+        [self lt_drainQueue];
         [self lt_addLogger:logger level:level];
+        atomic_fetch_sub_explicit(&self->_pendingLoggerAdds, 1, memory_order_relaxed);
+        [self lt_updateEnabledLevels];
     } });
 }
 
@@ -264,7 +471,9 @@ static NSUInteger _numProcessors;
     }
 
     dispatch_async(_loggingQueue, ^{ @autoreleasepool {
+        [self lt_drainQueue];
         [self lt_removeLogger:logger];
+        [self lt_updateEnabledLevels];
     } });
 }
 
@@ -274,7 +483,9 @@ static NSUInteger _numProcessors;
 
 - (void)removeAllLoggers {
     dispatch_async(_loggingQueue, ^{ @autoreleasepool {
+        [self lt_drainQueue];
         [self lt_removeAllLoggers];
+        [self lt_updateEnabledLevels];
     } });
 }
 
@@ -311,56 +522,29 @@ static NSUInteger _numProcessors;
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 - (void)queueLogMessage:(VVLogMessage *)logMessage asynchronously:(BOOL)asyncFlag {
-    // We have a tricky situation here...
-    //
-    // In the common case, when the queueSize is below the maximumQueueSize,
-    // we want to simply enqueue the logMessage. And we want to do this as fast as possible,
-    // which means we don't want to block and we don't want to use any locks.
-    //
-    // However, if the queueSize gets too big, we want to block.
-    // But we have very strict requirements as to when we block, and how long we block.
+    // In the common case, when the queue has room, we want to simply enqueue the logMessage.
+    // And we want to do this as fast as possible, which means we don't want to block and we don't want to use any locks.
     //
-    // The following example should help illustrate our requirements:
+    // Asynchronous log statements are therefore put into a bounded lock-free queue of preallocated slots.
+    // The logging queue is woken once per burst, not per statement, and drains it in batches.
+    // Only when the queue is full does the overflow policy decide between blocking and dropping.
     //
-    // Imagine that the maximum queue size is configured to be 5,
-    // and that there are already 5 log messages queued.
-    // Let us call these 5 queued log messages A, B, C, D, and E. (A is next to be executed)
-    //
-    // Now if our thread issues a log statement (let us call the log message F),
-    // it should block before the message is added to the queue.
-    // Furthermore, it should be unblocked immediately after A has been unqueued.
-    //
-    // The requirements are strict in this manner so that we block only as long as necessary,
-    // and so that blocked threads are unblocked in the order in which they were blocked.
-    //
-    // Returning to our previous example, let us assume that log messages A through E are still queued.
-    // Our aforementioned thread is blocked attempting to queue log message F.
-    // Now assume we have another separate thread that attempts to issue log message G.
-    // It should block until log messages A and B have been unqueued.
+    // Synchronous log statements still go through the logging queue itself,
+    // after whatever was queued before them, so that FIFO order is kept.
 
-
-    // We are using a counting semaphore provided by GCD.
-    // The semaphore is initialized with our VVLOG_MAX_QUEUE_SIZE value.
-    // Every time we want to queue a log message we decrement this value.
-    // If the resulting value is less than zero,
-    // the semaphore function waits in FIFO order for a signal to occur before returning.
-    //
-    // A dispatch semaphore is an efficient implementation of a traditional counting semaphore.
-    // Dispatch semaphores call down to the kernel only when the calling thread needs to be blocked.
-    // If the calling semaphore does not need to block, no kernel call is made.
+    if (asyncFlag) {
+        [self enqueueLogMessage:logMessage];
+        return;
+    }
 
     dispatch_block_t logBlock = ^{
-        dispatch_semaphore_wait(_queueSemaphore, DISPATCH_TIME_FOREVER);
-        // We're now sure we won't overflow the queue.
-        // It is time to queue our log message.
         @autoreleasepool {
+            [self lt_drainQueue];
             [self lt_log:logMessage];
         }
     };
 
-    if (asyncFlag) {
-        dispatch_async(_loggingQueue, logBlock);
-    } else if (dispatch_get_specific(GlobalLoggingQueueIdentityKey)) {
+    if (dispatch_get_specific(GlobalLoggingQueueIdentityKey)) {
         // We've logged an error message while on the logging queue...
         logBlock();
     } else {
@@ -368,6 +552,171 @@ static NSUInteger _numProcessors;
     }
 }
 
+- (void)enqueueLogMessage:(VVLogMessage *)logMessage {
+    uint64_t start = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+    void *message = (void *)CFBridgingRetain(logMessage);
+    BOOL blocked = NO;
+
+    while (!VVLogQueueTryEnqueue(_queue, message)) {
+        VVLogQueueOverflowPolicy policy = atomic_load_explicit(&_queue->overflowPolicy, memory_order_relaxed);
+
+        if (policy == VVLogQueueOverflowPolicyDropOldest) {
+            void *oldest = VVLogQueueTryDequeue(_queue);
+            if (oldest) {
+                CFRelease(oldest);
+                atomic_fetch_add_explicit(&_queue->pendingDropped, 1, memory_order_relaxed);
+                atomic_fetch_add_explicit(&_queue->droppedCount, 1, memory_order_relaxed);
+            }
+            continue;
+        }
+
+        if (policy == VVLogQueueOverflowPolicyDropNewest || dispatch_get_specific(GlobalLoggingQueueIdentityKey)) {
+            // Blocking the logging queue would wait for itself.
+            // Not enqueued, so not counted in the enqueue stats; the full queue has a drain pending.
+            CFRelease(message);
+            atomic_fetch_add_explicit(&_queue->pendingDropped, 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&_queue->droppedCount, 1, memory_order_relaxed);
+            return;
+        }
+
+        // VVLogQueueOverflowPolicyBlock
+        blocked = YES;
+        [self scheduleDrain];
+        atomic_fetch_add_explicit(&_queue->blockedProducers, 1, memory_order_seq_cst);
+        dispatch_semaphore_wait(_queueSpaceSemaphore, dispatch_time(DISPATCH_TIME_NOW, VVLOG_QUEUE_BLOCK_INTERVAL));
+        atomic_fetch_sub_explicit(&_queue->blockedProducers, 1, memory_order_seq_cst);
+    }
+
+    [self scheduleDrain];
+
+    uint64_t elapsed = clock_gettime_nsec_np(CLOCK_UPTIME_RAW) - start;
+    atomic_fetch_add_explicit(&_queue->enqueuedCount, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&_queue->totalEnqueueNanos, elapsed, memory_order_relaxed);
+    if (blocked) {
+        atomic_fetch_add_explicit(&_queue->blockedCount, 1, memory_order_relaxed);
+    }
+
+    uint64_t maxElapsed = atomic_load_explicit(&_queue->maxEnqueueNanos, memory_order_relaxed);
+    while (elapsed > maxElapsed
+           && !atomic_compare_exchange_weak_explicit(&_queue->maxEnqueueNanos, &maxElapsed, elapsed,
+                                                     memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+- (void)scheduleDrain {
+    // One block per burst: only the thread which finds the logging queue idle wakes it.
+    if (atomic_exchange_explicit(&_queue->drainScheduled, true, memory_order_seq_cst)) {
+        return;
+    }
+
+    dispatch_async(_loggingQueue, ^{ @autoreleasepool {
+        [self lt_drainQueue];
+    } });
+}
+
+- (void)lt_drainQueue {
+    NSAssert(dispatch_get_specific(GlobalLoggingQueueIdentityKey),
+             @"This method should only be run on the logging thread/queue");
+
+    // Cleared before draining, so that a statement enqueued after our last look schedules another drain.
+    atomic_store_explicit(&_queue->drainScheduled, false, memory_order_seq_cst);
+
+    NSUInteger count;
+    do {
+        count = 0;
+
+        @autoreleasepool {
+            NSMutableArray<VVLogMessage *> *batch = [NSMutableArray arrayWithCapacity:VVLOG_QUEUE_BATCH_SIZE];
+            void *message;
+            while (count < VVLOG_QUEUE_BATCH_SIZE && (message = VVLogQueueTryDequeue(_queue))) {
+                VVLogMessage *droppedRecord = [self lt_droppedRecord];
+                if (droppedRecord) {
+                    [batch addObject:droppedRecord];
+                }
+                [batch addObject:(VVLogMessage *)CFBridgingRelease(message)];
+                count++;
+            }
+
+            VVLogMessage *droppedRecord = [self lt_droppedRecord];
+            if (droppedRecord) {
+                [batch addObject:droppedRecord];
+            }
+
+            if (batch.count > 0) {
+                [self lt_logBatch:batch];
+            }
+        }
+
+        // If our queue got too big, there may be blocked threads waiting to add log messages to the queue.
+        // Since we've now dequeued a batch, we need to unblock them.
+        uint32_t blockedProducers = atomic_load_explicit(&_queue->blockedProducers, memory_order_seq_cst);
+        for (uint32_t i = 0; i < blockedProducers && count > 0; i++) {
+            dispatch_semaphore_signal(_queueSpaceSemaphore);
+        }
+    } while (count == VVLOG_QUEUE_BATCH_SIZE);
+}
+
+- (nullable VVLogMessage *)lt_droppedRecord {
+    uint64_t dropped = atomic_exchange_explicit(&_queue->pendingDropped, 0, memory_order_relaxed);
+    if (dropped == 0) {
+        return nil;
+    }
+
+    NSString *message = [NSString stringWithFormat:@"VVLog: %llu log messages dropped, the logging queue was full", dropped];
+    return [self lt_warningMessage:message];
+}
+
+- (VVLogMessage *)lt_warningMessage:(NSString *)message {
+    return [[VVLogMessage alloc] initWithMessage:message
+                                           level:VVLogLevelAll
+                                            flag:VVLogFlagWarning
+                                         context:0
+                                            file:@(__FILE__)
+                                        function:@(__PRETTY_FUNCTION__)
+                                            line:__LINE__
+                                             tag:nil
+                                         options:(VVLogMessageOptions)0
+                                       timestamp:nil];
+}
+
++ (VVLogQueueOverflowPolicy)queueOverflowPolicy {
+    return self.sharedInstance.queueOverflowPolicy;
+}
+
++ (void)setQueueOverflowPolicy:(VVLogQueueOverflowPolicy)queueOverflowPolicy {
+    self.sharedInstance.queueOverflowPolicy = queueOverflowPolicy;
+}
+
+- (VVLogQueueOverflowPolicy)queueOverflowPolicy {
+    return atomic_load_explicit(&_queue->overflowPolicy, memory_order_relaxed);
+}
+
+- (void)setQueueOverflowPolicy:(VVLogQueueOverflowPolicy)queueOverflowPolicy {
+    atomic_store_explicit(&_queue->overflowPolicy, queueOverflowPolicy, memory_order_relaxed);
+}
+
++ (VVLogQueueStatistics)queueStatistics {
+    return self.sharedInstance.queueStatistics;
+}
+
+- (VVLogQueueStatistics)queueStatistics {
+    VVLogQueueStatistics statistics;
+    statistics.enqueuedCount = atomic_load_explicit(&_queue->enqueuedCount, memory_order_relaxed);
+    statistics.droppedCount = atomic_load_explicit(&_queue->droppedCount, memory_order_relaxed);
+    statistics.blockedCount = atomic_load_explicit(&_queue->blockedCount, memory_order_relaxed);
+    statistics.totalEnqueueNanos = atomic_load_explicit(&_queue->totalEnqueueNanos, memory_order_relaxed);
+    statistics.maxEnqueueNanos = atomic_load_explicit(&_queue->maxEnqueueNanos, memory_order_relaxed);
+    return statistics;
+}
+
++ (BOOL)recordsArguments {
+    return atomic_load_explicit(&_recordsArguments, memory_order_relaxed);
+}
+
++ (void)setRecordsArguments:(BOOL)recordsArguments {
+    atomic_store_explicit(&_recordsArguments, recordsArguments, memory_order_relaxed);
+}
+
 + (void)log:(BOOL)asynchronous
       level:(VVLogLevel)level
        flag:(VVLogFlag)flag
@@ -436,6 +785,99 @@ static NSUInteger _numProcessors;
     }
 }
 
++ (void)log:(BOOL)asynchronous
+      level:(VVLogLevel)level
+       flag:(VVLogFlag)flag
+    context:(NSInteger)context
+       file:(const char *)file
+   function:(const char *)function
+       line:(NSUInteger)line
+        tag:(id)tag
+   callSite:(VVLogCallSite *)callSite
+     format:(NSString *)format, ... {
+    va_list args;
+
+    if (format) {
+        va_start(args, format);
+
+        [self.sharedInstance log:asynchronous
+                           level:level
+                            flag:flag
+                         context:context
+                            file:file
+                        function:function
+                            line:line
+                             tag:tag
+                        callSite:callSite
+                          format:format
+                            args:args];
+
+        va_end(args);
+    }
+}
+
+- (void)log:(BOOL)asynchronous
+      level:(VVLogLevel)level
+       flag:(VVLogFlag)flag
+    context:(NSInteger)context
+       file:(const char *)file
+   function:(const char *)function
+       line:(NSUInteger)line
+        tag:(id)tag
+   callSite:(VVLogCallSite *)callSite
+     format:(NSString *)format, ... {
+    va_list args;
+
+    if (format) {
+        va_start(args, format);
+
+        [self log:asynchronous
+            level:level
+             flag:flag
+          context:context
+             file:file
+         function:function
+             line:line
+              tag:tag
+         callSite:callSite
+           format:format
+             args:args];
+
+        va_end(args);
+    }
+}
+
+- (void)log:(BOOL)asynchronous
+      level:(VVLogLevel)level
+       flag:(VVLogFlag)flag
+    context:(NSInteger)context
+       file:(const char *)file
+   function:(const char *)function
+       line:(NSUInteger)line
+        tag:(id)tag
+   callSite:(VVLogCallSite *)callSite
+     format:(NSString *)format
+       args:(va_list)args {
+    VVLogCallSiteInfo *info = nil;
+    if (callSite && atomic_load_explicit(&_recordsArguments, memory_order_relaxed)) {
+        info = [VVLogCallSiteInfo infoForCallSite:callSite format:format file:file function:function line:line];
+    }
+
+    if (!info) {
+        [self log:asynchronous level:level flag:flag context:context file:file function:function line:line tag:tag format:format args:args];
+        return;
+    }
+
+    VVLogMessage *logMessage = [[VVLogMessage alloc] initWithCallSite:info
+                                                            arguments:[info argumentsWithList:args]
+                                                                level:level
+                                                                 flag:flag
+                                                              context:context
+                                                                  tag:tag];
+
+    [self queueLogMessage:logMessage asynchronously:asynchronous];
+}
+
 + (void)log:(BOOL)asynchronous
       level:(VVLogLevel)level
        flag:(VVLogFlag)flag
@@ -522,6 +964,7 @@ static NSUInteger _numProcessors;
 
 - (void)flushLog {
     dispatch_sync(_loggingQueue, ^{ @autoreleasepool {
+        [self lt_drainQueue];
         [self lt_flush];
     } });
 }
@@ -783,6 +1226,28 @@ static NSUInteger _numProcessors;
     [self._loggers removeAllObjects];
 }
 
+- (void)lt_updateEnabledLevels {
+    NSAssert(dispatch_get_specific(GlobalLoggingQueueIdentityKey),
+             @"This method should only be run on the logging thread/queue");
+
+    // The macros only log through the shared instance.
+    if (self != VVLog.sharedInstance) {
+        return;
+    }
+
+    NSUInteger levels = 0;
+    for (VVLoggerNode *loggerNode in self._loggers) {
+        levels |= loggerNode->_level;
+    }
+
+    if (atomic_load_explicit(&_pendingLoggerAdds, memory_order_relaxed) > 0) {
+        // A logger still to be added has widened the levels already, keep its bits until it is in.
+        __atomic_fetch_or(&VVLogEnabledLevels, levels, __ATOMIC_RELAXED);
+    } else {
+        __atomic_store_n(&VVLogEnabledLevels, levels, __ATOMIC_RELAXED);
+    }
+}
+
 - (NSArray *)lt_allLoggers {
     NSAssert(dispatch_get_specific(GlobalLoggingQueueIdentityKey),
              @"This method should only be run on the logging thread/queue");
@@ -804,14 +1269,16 @@ static NSUInteger _numProcessors;
 
     for (VVLoggerNode *loggerNode in self._loggers) {
         [theLoggersWithLevel addObject:[VVLoggerInformation informationWithLogger:loggerNode->_logger
-                                                                         andLevel:loggerNode->_level]];
+                                                                         andLevel:loggerNode->_level
+                                                                     droppedCount:loggerNode->_droppedCount]];
     }
 
     return [theLoggersWithLevel copy];
 }
 
 - (void)lt_log:(VVLogMessage *)logMessage {
-    // Execute the given log message on each of our loggers.
+    // Execute the given synchronous log message on each of our loggers.
+    // It has been logged everywhere when this method returns. Asynchronous messages go through lt_logBatch:.
 
     NSAssert(dispatch_get_specific(GlobalLoggingQueueIdentityKey),
              @"This method should only be run on the logging thread/queue");
@@ -821,8 +1288,7 @@ static NSUInteger _numProcessors;
         // All blocks are added to same group.
         // After each block has been queued, wait on group.
         //
-        // The waiting ensures that a slow logger doesn't end up with a large queue of pending log messages.
-        // This would defeat the purpose of the efforts we made earlier to restrict the max queue size.
+        // The waiting is what makes the log statement synchronous.
 
         for (VVLoggerNode *loggerNode in self._loggers) {
             // skip the loggers that shouldn't write this message based on the log level
@@ -868,22 +1334,69 @@ static NSUInteger _numProcessors;
             } });
         }
     }
+}
 
-    // If our queue got too big, there may be blocked threads waiting to add log messages to the queue.
-    // Since we've now dequeued an item from the log, we may need to unblock the next thread.
+- (void)lt_logBatch:(NSArray<VVLogMessage *> *)batch {
+    // Hand a batch of asynchronous log messages to each of our loggers.
 
-    // We are using a counting semaphore provided by GCD.
-    // The semaphore is initialized with our VVLOG_MAX_QUEUE_SIZE value.
-    // When a log message is queued this value is decremented.
-    // When a log message is dequeued this value is incremented.
-    // If the value ever drops below zero,
-    // the queueing thread blocks and waits in FIFO order for us to signal it.
-    //
-    // A dispatch semaphore is an efficient implementation of a traditional counting semaphore.
-    // Dispatch semaphores call down to the kernel only when the calling thread needs to be blocked.
-    // If the calling semaphore does not need to block, no kernel call is made.
+    NSAssert(dispatch_get_specific(GlobalLoggingQueueIdentityKey),
+             @"This method should only be run on the logging thread/queue");
+
+    // Unlike lt_log:, nothing waits for the loggers here.
+    // Each logger works through its batches on its own queue, at its own pace.
+    // A logger whose backlog is full has new messages dropped for it alone, whatever the queue overflow policy,
+    // which only applies to the logging queue. So a slow logger never holds back the others or the issuing threads.
 
-    dispatch_semaphore_signal(_queueSemaphore);
+    for (VVLoggerNode *loggerNode in self._loggers) {
+        NSMutableArray<VVLogMessage *> *messages = [NSMutableArray arrayWithCapacity:batch.count + 1];
+        NSUInteger room = [loggerNode roomInBacklog];
+
+        if (loggerNode->_pendingDropped > 0 && room > 0) {
+            NSString *message = [NSString stringWithFormat:@"VVLog: %llu log messages dropped, this logger fell behind",
+                                 loggerNode->_pendingDropped];
+            [messages addObject:[self lt_warningMessage:message]];
+            loggerNode->_pendingDropped = 0;
+            room--;
+        }
+
+        for (VVLogMessage *logMessage in batch) {
+            // skip the loggers that shouldn't write this message based on the log level
+
+            if (!(logMessage->_flag & loggerNode->_level)) {
+                continue;
+            }
+
+            if (room == 0) {
+                loggerNode->_droppedCount++;
+                loggerNode->_pendingDropped++;
+                continue;
+            }
+
+            [messages addObject:logMessage];
+            room--;
+        }
+
+        [self lt_handMessages:messages toLoggerNode:loggerNode];
+    }
+}
+
+- (void)lt_handMessages:(NSArray<VVLogMessage *> *)messages toLoggerNode:(VVLoggerNode *)loggerNode {
+    NSUInteger count = messages.count;
+    if (count == 0) {
+        return;
+    }
+
+    atomic_fetch_add_explicit(&loggerNode->_backlog, count, memory_order_relaxed);
+
+    dispatch_async(loggerNode->_loggerQueue, ^{
+        for (VVLogMessage *logMessage in messages) {
+            @autoreleasepool {
+                [loggerNode->_logger logMessage:logMessage];
+            }
+        }
+
+        atomic_fetch_sub_explicit(&loggerNode->_backlog, count, memory_order_release);
+    });
 }
 
 - (void)lt_flush {
@@ -971,6 +1484,65 @@ NSString * __nullable VVExtractFileNameWithoutExtension(const char *filePath, BO
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma mark Rate Limiting
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BOOL VVLogRateLimitAllow(VVLogRateLimit *limit, double ratePerSecond, NSUInteger burst, uint64_t *suppressedCount) {
+    if (ratePerSecond <= 0) {
+        *suppressedCount = 0;
+        return YES;
+    }
+
+    // Kept as a single timestamp (GCRA): nextNanos is when the bucket will be full again. Each statement moves it one
+    // emission interval later, and a statement is let through while it is no more than a burst ahead of now.
+    uint64_t now = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+    uint64_t emissionNanos = (uint64_t)(NSEC_PER_SEC / ratePerSecond);
+    uint64_t toleranceNanos = emissionNanos * (burst > 1 ? burst - 1 : 0);
+
+    uint64_t next = __atomic_load_n(&limit->nextNanos, __ATOMIC_RELAXED);
+    do {
+        if (next > now + toleranceNanos) {
+            __atomic_fetch_add(&limit->suppressedCount, 1, __ATOMIC_RELAXED);
+            return NO;
+        }
+    } while (!__atomic_compare_exchange_n(&limit->nextNanos, &next, MAX(next, now) + emissionNanos,
+                                          YES, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    *suppressedCount = __atomic_exchange_n(&limit->suppressedCount, 0, __ATOMIC_RELAXED);
+    return YES;
+}
+
+BOOL VVLogSampleAllow(VVLogRateLimit *limit, NSUInteger n) {
+    if (n <= 1) {
+        return YES;
+    }
+
+    return __atomic_fetch_add(&limit->count, 1, __ATOMIC_RELAXED) % n == 0;
+}
+
+BOOL VVLogFirstNAllow(VVLogRateLimit *limit, NSUInteger n, NSTimeInterval interval, uint64_t *suppressedCount) {
+    uint64_t now = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+
+    // The first thread to see the window over opens the next one. A statement racing with it may still be counted
+    // against the old window, which only makes the limit approximate.
+    uint64_t windowEnd = __atomic_load_n(&limit->nextNanos, __ATOMIC_RELAXED);
+    if (now >= windowEnd) {
+        uint64_t newWindowEnd = interval > 0 ? now + (uint64_t)(interval * NSEC_PER_SEC) : UINT64_MAX;
+        if (__atomic_compare_exchange_n(&limit->nextNanos, &windowEnd, newWindowEnd, NO, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            __atomic_store_n(&limit->count, 0, __ATOMIC_RELAXED);
+        }
+    }
+
+    if (__atomic_fetch_add(&limit->count, 1, __ATOMIC_RELAXED) >= n) {
+        __atomic_fetch_add(&limit->suppressedCount, 1, __ATOMIC_RELAXED);
+        return NO;
+    }
+
+    *suppressedCount = __atomic_exchange_n(&limit->suppressedCount, 0, __ATOMIC_RELAXED);
+    return YES;
+}
+
 @end
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -991,10 +1563,20 @@ NSString * __nullable VVExtractFileNameWithoutExtension(const char *filePath, BO
         }
 
         _level = level;
+
+        _maximumBacklog = VVLOG_MAX_LOGGER_BACKLOG;
+        if ([logger respondsToSelector:@selector(maximumBacklog)] && logger.maximumBacklog > 0) {
+            _maximumBacklog = logger.maximumBacklog;
+        }
     }
     return self;
 }
 
+- (NSUInteger)roomInBacklog {
+    NSUInteger backlog = atomic_load_explicit(&_backlog, memory_order_acquire);
+    return _maximumBacklog > backlog ? _maximumBacklog - backlog : 0;
+}
+
 + (instancetype)nodeWithLogger:(id <VVLogger>)logger loggerQueue:(dispatch_queue_t)loggerQueue level:(VVLogLevel)level {
     return [[self alloc] initWithLogger:logger loggerQueue:loggerQueue level:level];
 }
@@ -1073,10 +1655,51 @@ NSString * __nullable VVExtractFileNameWithoutExtension(const char *filePath, BO
     return self;
 }
 
+- (instancetype)initWithCallSite:(VVLogCallSiteInfo *)callSite
+                       arguments:(NSData *)arguments
+                           level:(VVLogLevel)level
+                            flag:(VVLogFlag)flag
+                         context:(NSInteger)context
+                             tag:(id)tag {
+    // The strings of the call site live as long as the process, no need to copy them
+    if ((self = [self initWithMessage:callSite.format.string
+                                level:level
+                                 flag:flag
+                              context:context
+                                 file:callSite.file
+                             function:callSite.function
+                                 line:callSite.line
+                                  tag:tag
+                              options:VVLogMessageDontCopyMessage
+                            timestamp:nil])) {
+        _message = nil;
+        _callSite = callSite;
+        _arguments = arguments;
+    }
+    return self;
+}
+
+- (NSString *)message {
+    if (_callSite == nil) {
+        return _message;
+    }
+
+    os_unfair_lock_lock(&_messageLock);
+    if (_message == nil) {
+        _message = [_callSite messageWithArguments:_arguments];
+    }
+    NSString *message = _message;
+    os_unfair_lock_unlock(&_messageLock);
+
+    return message;
+}
+
 - (id)copyWithZone:(NSZone * __attribute__((unused)))zone {
     VVLogMessage *newMessage = [VVLogMessage new];
 
-    newMessage->_message = _message;
+    newMessage->_message = self.message;
+    newMessage->_callSite = _callSite;
+    newMessage->_arguments = _arguments;
     newMessage->_level = _level;
     newMessage->_flag = _flag;
     newMessage->_context = _context;
@@ -1282,16 +1905,21 @@ NSString * __nullable VVExtractFileNameWithoutExtension(const char *filePath, BO
 
 @implementation VVLoggerInformation
 
-- (instancetype)initWithLogger:(id <VVLogger>)logger andLevel:(VVLogLevel)level {
+- (instancetype)initWithLogger:(id <VVLogger>)logger andLevel:(VVLogLevel)level droppedCount:(uint64_t)droppedCount {
     if ((self = [super init])) {
         _logger = logger;
         _level = level;
+        _droppedCount = droppedCount;
     }
     return self;
 }
 
 + (instancetype)informationWithLogger:(id <VVLogger>)logger andLevel:(VVLogLevel)level {
-    return [[self alloc] initWithLogger:logger andLevel:level];
+    return [[self alloc] initWithLogger:logger andLevel:level droppedCount:0];
+}
+
++ (instancetype)informationWithLogger:(id <VVLogger>)logger andLevel:(VVLogLevel)level droppedCount:(uint64_t)droppedCount {
+    return [[self alloc] initWithLogger:logger andLevel:level droppedCount:droppedCount];
 }
 
 @end
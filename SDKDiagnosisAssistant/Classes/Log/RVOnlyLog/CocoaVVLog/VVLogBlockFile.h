@@ -0,0 +1,135 @@
+//
+//  VVLogBlockFile.h
+//  CocoaVVLog
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Compressed log files (`.logz`, `.vvlogz`)
+ *
+ * A file starts with `kVVLogBlockFileMagic`, a version byte and three reserved bytes, followed by blocks.
+ * A block is a header of `kVVLogBlockHeaderLength` little-endian bytes and its compressed bytes:
+ *
+ *   magic `kVVLogBlockMagic`, compressed length, uncompressed length,
+ *   CRC-32 of the uncompressed bytes                          uint32 each
+ *   offset of its first byte in the uncompressed content,
+ *   first and last write time, milliseconds since 1970        int64 each
+ *
+ * Each block is raw deflate (RFC 1951) of its own, ended by a sync flush: it inflates without
+ * the blocks before it. The compressed bytes of all blocks in order, followed by an empty final
+ * deflate block, are one deflate stream, so a zip entry is made of them without recompressing.
+ *
+ * The uncompressed content is what the file would hold uncompressed: text, or the records of a binary log file.
+ **/
+
+extern char const kVVLogBlockFileMagic[4];
+extern uint8_t const kVVLogBlockFileVersion;
+extern NSUInteger const kVVLogBlockFileHeaderLength;
+
+extern uint32_t const kVVLogBlockMagic;
+extern NSUInteger const kVVLogBlockHeaderLength;
+
+/**
+ * Compresses data into blocks. Not thread safe, VVFileLogger uses it on its logger queue.
+ **/
+@interface VVLogBlockCompressor : NSObject
+
+/// Magic and version, the first bytes of every compressed log file
++ (NSData *)fileHeader;
+
+/// `level` is a zlib compression level
+- (nullable instancetype)initWithLevel:(int)level NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ * Appends a block holding `data` to `buffer`, `offset` being the uncompressed length of the file before it.
+ * Returns NO, leaving `buffer` untouched, if zlib fails.
+ **/
+- (BOOL)appendBlockWithData:(NSData *)data
+         uncompressedOffset:(uint64_t)offset
+             firstTimestamp:(NSTimeInterval)firstTimestamp
+              lastTimestamp:(NSTimeInterval)lastTimestamp
+                   toBuffer:(NSMutableData *)buffer;
+
+@end
+
+/**
+ * One block of a compressed log file
+ **/
+@interface VVLogBlockInfo : NSObject
+
+/// Offset of the block header in the file
+@property (nonatomic, readonly) unsigned long long fileOffset;
+@property (nonatomic, readonly) NSUInteger compressedLength;
+@property (nonatomic, readonly) NSUInteger uncompressedLength;
+@property (nonatomic, readonly) unsigned long long uncompressedOffset;
+@property (nonatomic, readonly) uint32_t crc32;
+/// Seconds since 1970
+@property (nonatomic, readonly) NSTimeInterval firstTimestamp;
+@property (nonatomic, readonly) NSTimeInterval lastTimestamp;
+
+@end
+
+/**
+ * Reads a compressed log file through the index of its blocks.
+ *
+ * Opening reads the block headers only. A block cut short at the end, as left by a crash while
+ * writing, and anything after an invalid header are left out of the index.
+ **/
+@interface VVLogBlockFile : NSObject
+
+/// YES if `data` starts with the header of a compressed log file
++ (BOOL)isBlockData:(NSData *)data;
+
+/// YES if the file at `path` is a compressed log file, NO if it is empty, unreadable or not compressed.
++ (BOOL)isBlockFileAtPath:(NSString *)path;
+
+/// The empty final deflate block ending the stream made of the compressed bytes of all blocks
++ (NSData *)finalDeflateBlock;
+
+/// Returns nil with an error if the file can not be read or is not a compressed log file.
+- (nullable instancetype)initWithPath:(NSString *)path error:(NSError **)error NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@property (nonatomic, copy, readonly) NSString *path;
+
+@property (nonatomic, copy, readonly) NSArray<VVLogBlockInfo *> *blocks;
+
+/// Length of the file up to the end of its last indexed block
+@property (nonatomic, readonly) unsigned long long validLength;
+
+/// Length of the uncompressed content of the indexed blocks
+@property (nonatomic, readonly) unsigned long long uncompressedLength;
+
+/// CRC-32 of the uncompressed content of the indexed blocks
+@property (nonatomic, readonly) uint32_t crc32;
+
+/// Index of the block holding byte `offset` of the uncompressed content, NSNotFound if past the end.
+- (NSUInteger)indexOfBlockContainingOffset:(unsigned long long)offset;
+
+/// Index of the first block written to at or after `timestamp` (seconds since 1970), NSNotFound if none.
+- (NSUInteger)indexOfFirstBlockEndingAfter:(NSTimeInterval)timestamp;
+
+/// The compressed bytes of a block, as stored
+- (nullable NSData *)compressedDataOfBlockAtIndex:(NSUInteger)index error:(NSError **)error;
+
+/// The uncompressed bytes of a block, checked against its CRC-32
+- (nullable NSData *)dataOfBlockAtIndex:(NSUInteger)index error:(NSError **)error;
+
+/// The whole uncompressed content
+- (nullable NSData *)dataWithError:(NSError **)error;
+
+/// Writes the uncompressed content to `path`, a block at a time.
+- (BOOL)writeDataToPath:(NSString *)path error:(NSError **)error;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,436 @@
+//
+//  VVLogBlockFile.m
+//  CocoaVVLog
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+
+#if !__has_feature(objc_arc)
+#error This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+#import "VVLogBlockFile.h"
+
+#import <fcntl.h>
+#import <sys/stat.h>
+#import <unistd.h>
+#import <zlib.h>
+
+char const kVVLogBlockFileMagic[4] = { 'V', 'V', 'L', 'Z' };
+uint8_t const kVVLogBlockFileVersion = 1;
+NSUInteger const kVVLogBlockFileHeaderLength = 8;
+
+uint32_t const kVVLogBlockMagic = 0x4b425656; // "VVBK"
+NSUInteger const kVVLogBlockHeaderLength = 40;
+
+// Larger lengths are taken for a corrupt header, blocks are a buffer's worth of log.
+static uint32_t const kVVLogBlockMaxLength = 64 * 1024 * 1024;
+
+static NSString * const kVVLogBlockErrorDomain = @"VVLogBlockFile";
+
+static void VVLogBlockWrite32(uint8_t *bytes, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        bytes[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static void VVLogBlockWrite64(uint8_t *bytes, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static uint32_t VVLogBlockRead32(const uint8_t *bytes) {
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+static uint64_t VVLogBlockRead64(const uint8_t *bytes) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+static NSError *VVLogBlockError(NSInteger code, NSString *description) {
+    return [NSError errorWithDomain:kVVLogBlockErrorDomain
+                               code:code
+                           userInfo:@{ NSLocalizedDescriptionKey: description }];
+}
+
+#pragma mark -
+
+@interface VVLogBlockCompressor () {
+    z_stream _stream;
+}
+
+@end
+
+@implementation VVLogBlockCompressor
+
++ (NSData *)fileHeader {
+    uint8_t header[kVVLogBlockFileHeaderLength];
+    memset(header, 0, sizeof(header));
+    memcpy(header, kVVLogBlockFileMagic, sizeof(kVVLogBlockFileMagic));
+    header[sizeof(kVVLogBlockFileMagic)] = kVVLogBlockFileVersion;
+    return [NSData dataWithBytes:header length:sizeof(header)];
+}
+
+- (instancetype)initWithLevel:(int)level {
+    if ((self = [super init])) {
+        // Negative window bits: raw deflate, no zlib header nor trailer around the blocks
+        if (deflateInit2(&_stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return nil;
+        }
+    }
+
+    return self;
+}
+
+- (void)dealloc {
+    deflateEnd(&_stream);
+}
+
+- (BOOL)appendBlockWithData:(NSData *)data
+         uncompressedOffset:(uint64_t)offset
+             firstTimestamp:(NSTimeInterval)firstTimestamp
+              lastTimestamp:(NSTimeInterval)lastTimestamp
+                   toBuffer:(NSMutableData *)buffer {
+    NSUInteger length = data.length;
+    if (length == 0 || length > kVVLogBlockMaxLength) {
+        return NO;
+    }
+
+    NSUInteger start = buffer.length;
+
+    // A fresh stream per block: nothing refers to the bytes of an earlier block.
+    deflateReset(&_stream);
+    _stream.next_in = (Bytef *)data.bytes;
+    _stream.avail_in = (uInt)length;
+
+    // The sync flush adds an empty stored block to what deflateBound expects
+    NSUInteger capacity = deflateBound(&_stream, (uLong)length) + 16;
+    NSUInteger written = 0;
+    int status = Z_OK;
+
+    do {
+        buffer.length = start + kVVLogBlockHeaderLength + written + capacity;
+        _stream.next_out = (Bytef *)buffer.mutableBytes + start + kVVLogBlockHeaderLength + written;
+        _stream.avail_out = (uInt)capacity;
+
+        status = deflate(&_stream, Z_SYNC_FLUSH);
+        written += capacity - _stream.avail_out;
+    } while (status == Z_OK && _stream.avail_out == 0);
+
+    if (status != Z_OK || _stream.avail_in != 0) {
+        buffer.length = start;
+        return NO;
+    }
+
+    buffer.length = start + kVVLogBlockHeaderLength + written;
+
+    uint8_t *header = (uint8_t *)buffer.mutableBytes + start;
+    VVLogBlockWrite32(header, kVVLogBlockMagic);
+    VVLogBlockWrite32(header + 4, (uint32_t)written);
+    VVLogBlockWrite32(header + 8, (uint32_t)length);
+    VVLogBlockWrite32(header + 12, (uint32_t)crc32(crc32(0, Z_NULL, 0), data.bytes, (uInt)length));
+    VVLogBlockWrite64(header + 16, offset);
+    VVLogBlockWrite64(header + 24, (uint64_t)(int64_t)floor(firstTimestamp * 1000));
+    VVLogBlockWrite64(header + 32, (uint64_t)(int64_t)floor(lastTimestamp * 1000));
+
+    return YES;
+}
+
+@end
+
+#pragma mark -
+
+@interface VVLogBlockInfo ()
+
+@property (nonatomic, readwrite) unsigned long long fileOffset;
+@property (nonatomic, readwrite) NSUInteger compressedLength;
+@property (nonatomic, readwrite) NSUInteger uncompressedLength;
+@property (nonatomic, readwrite) unsigned long long uncompressedOffset;
+@property (nonatomic, readwrite) uint32_t crc32;
+@property (nonatomic, readwrite) NSTimeInterval firstTimestamp;
+@property (nonatomic, readwrite) NSTimeInterval lastTimestamp;
+
+@end
+
+@implementation VVLogBlockInfo
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<VVLogBlockInfo: fileOffset=%llu, compressed=%lu, uncompressed=%lu at %llu>",
+            _fileOffset, (unsigned long)_compressedLength, (unsigned long)_uncompressedLength, _uncompressedOffset];
+}
+
+@end
+
+#pragma mark -
+
+@interface VVLogBlockFile () {
+    int _fd;
+    z_stream _stream;
+    BOOL _streamReady;
+}
+
+@end
+
+@implementation VVLogBlockFile
+
++ (BOOL)isBlockData:(NSData *)data {
+    if (data.length < kVVLogBlockFileHeaderLength) {
+        return NO;
+    }
+    const uint8_t *bytes = data.bytes;
+    return memcmp(bytes, kVVLogBlockFileMagic, sizeof(kVVLogBlockFileMagic)) == 0
+        && bytes[sizeof(kVVLogBlockFileMagic)] == kVVLogBlockFileVersion;
+}
+
++ (BOOL)isBlockFileAtPath:(NSString *)path {
+    NSFileHandle *handle = [NSFileHandle fileHandleForReadingAtPath:path];
+    NSData *header = nil;
+    @try {
+        header = [handle readDataOfLength:kVVLogBlockFileHeaderLength];
+    } @catch (NSException *exception) {
+        header = nil;
+    }
+    [handle closeFile];
+    return [self isBlockData:header];
+}
+
++ (NSData *)finalDeflateBlock {
+    // Final bit set, fixed Huffman codes, end of block code only
+    static uint8_t const bytes[] = { 0x03, 0x00 };
+    return [NSData dataWithBytes:bytes length:sizeof(bytes)];
+}
+
+- (instancetype)initWithPath:(NSString *)path error:(NSError **)error {
+    if ((self = [super init])) {
+        _path = [path copy];
+        _fd = open(path.fileSystemRepresentation, O_RDONLY | O_CLOEXEC);
+        if (_fd < 0) {
+            if (error) {
+                *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+            }
+            return nil;
+        }
+
+        uint8_t fileHeader[kVVLogBlockFileHeaderLength];
+        ssize_t headerLength = pread(_fd, fileHeader, sizeof(fileHeader), 0);
+        if (headerLength != (ssize_t)sizeof(fileHeader)
+            || ![VVLogBlockFile isBlockData:[NSData dataWithBytesNoCopy:fileHeader length:sizeof(fileHeader) freeWhenDone:NO]]) {
+            if (error) {
+                *error = VVLogBlockError(1, @"Not a compressed log file.");
+            }
+            return nil;
+        }
+
+        [self indexBlocks];
+    }
+
+    return self;
+}
+
+- (void)dealloc {
+    if (_fd >= 0) {
+        close(_fd);
+    }
+    if (_streamReady) {
+        inflateEnd(&_stream);
+    }
+}
+
+- (void)indexBlocks {
+    struct stat st = { 0 };
+    unsigned long long fileSize = fstat(_fd, &st) == 0 ? (unsigned long long)st.st_size : 0;
+
+    NSMutableArray<VVLogBlockInfo *> *blocks = [NSMutableArray array];
+    unsigned long long offset = kVVLogBlockFileHeaderLength;
+    unsigned long long uncompressedLength = 0;
+    uLong crc = crc32(0, Z_NULL, 0);
+
+    // Hop from header to header, the compressed bytes are not read.
+    uint8_t header[kVVLogBlockHeaderLength];
+    while (offset + kVVLogBlockHeaderLength <= fileSize) {
+        if (pread(_fd, header, sizeof(header), (off_t)offset) != (ssize_t)sizeof(header)) {
+            break;
+        }
+
+        uint32_t compressedLength = VVLogBlockRead32(header + 4);
+        uint32_t blockLength = VVLogBlockRead32(header + 8);
+        BOOL isValid = VVLogBlockRead32(header) == kVVLogBlockMagic
+            && compressedLength > 0 && compressedLength <= kVVLogBlockMaxLength
+            && blockLength > 0 && blockLength <= kVVLogBlockMaxLength
+            && VVLogBlockRead64(header + 16) == uncompressedLength
+            && offset + kVVLogBlockHeaderLength + compressedLength <= fileSize;
+        if (!isValid) {
+            break;
+        }
+
+        VVLogBlockInfo *block = [VVLogBlockInfo new];
+        block.fileOffset = offset;
+        block.compressedLength = compressedLength;
+        block.uncompressedLength = blockLength;
+        block.uncompressedOffset = uncompressedLength;
+        block.crc32 = VVLogBlockRead32(header + 12);
+        block.firstTimestamp = (int64_t)VVLogBlockRead64(header + 24) / 1000.0;
+        block.lastTimestamp = (int64_t)VVLogBlockRead64(header + 32) / 1000.0;
+        [blocks addObject:block];
+
+        crc = crc32_combine(crc, block.crc32, (z_off_t)blockLength);
+        uncompressedLength += blockLength;
+        offset += kVVLogBlockHeaderLength + compressedLength;
+    }
+
+    _blocks = [blocks copy];
+    _validLength = offset;
+    _uncompressedLength = uncompressedLength;
+    _crc32 = (uint32_t)crc;
+}
+
+- (NSUInteger)indexOfBlockContainingOffset:(unsigned long long)offset {
+    if (offset >= _uncompressedLength) {
+        return NSNotFound;
+    }
+
+    NSUInteger low = 0, high = _blocks.count;
+    while (low + 1 < high) {
+        NSUInteger middle = low + (high - low) / 2;
+        if (_blocks[middle].uncompressedOffset <= offset) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+- (NSUInteger)indexOfFirstBlockEndingAfter:(NSTimeInterval)timestamp {
+    // Blocks are written in order, their last write times do not go back but for clock changes.
+    NSUInteger low = 0, high = _blocks.count;
+    while (low < high) {
+        NSUInteger middle = low + (high - low) / 2;
+        if (_blocks[middle].lastTimestamp < timestamp) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low < _blocks.count ? low : NSNotFound;
+}
+
+- (NSData *)compressedDataOfBlockAtIndex:(NSUInteger)index error:(NSError **)error {
+    VVLogBlockInfo *block = _blocks[index];
+    NSMutableData *data = [NSMutableData dataWithLength:block.compressedLength];
+
+    ssize_t length = pread(_fd, data.mutableBytes, block.compressedLength, (off_t)(block.fileOffset + kVVLogBlockHeaderLength));
+    if (length != (ssize_t)block.compressedLength) {
+        if (error) {
+            *error = length < 0
+                ? [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil]
+                : VVLogBlockError(2, @"Compressed log file was truncated.");
+        }
+        return nil;
+    }
+
+    return data;
+}
+
+- (NSData *)dataOfBlockAtIndex:(NSUInteger)index error:(NSError **)error {
+    NSData *compressed = [self compressedDataOfBlockAtIndex:index error:error];
+    if (!compressed) {
+        return nil;
+    }
+
+    VVLogBlockInfo *block = _blocks[index];
+    NSMutableData *data = [NSMutableData dataWithLength:block.uncompressedLength];
+
+    if (!_streamReady) {
+        if (inflateInit2(&_stream, -MAX_WBITS) != Z_OK) {
+            if (error) {
+                *error = VVLogBlockError(3, @"Failed to set up decompression.");
+            }
+            return nil;
+        }
+        _streamReady = YES;
+    } else {
+        inflateReset(&_stream);
+    }
+
+    _stream.next_in = (Bytef *)compressed.bytes;
+    _stream.avail_in = (uInt)compressed.length;
+    _stream.next_out = data.mutableBytes;
+    _stream.avail_out = (uInt)data.length;
+
+    // Blocks end in a sync flush, not a final block: all of the input is consumed without Z_STREAM_END.
+    int status = inflate(&_stream, Z_SYNC_FLUSH);
+    BOOL isComplete = (status == Z_OK || status == Z_STREAM_END)
+        && _stream.avail_out == 0
+        && crc32(crc32(0, Z_NULL, 0), data.bytes, (uInt)data.length) == block.crc32;
+
+    if (!isComplete) {
+        if (error) {
+            *error = VVLogBlockError(4, [NSString stringWithFormat:@"Block at offset %llu is corrupt.", block.fileOffset]);
+        }
+        return nil;
+    }
+
+    return data;
+}
+
+- (NSData *)dataWithError:(NSError **)error {
+    NSMutableData *data = [NSMutableData dataWithCapacity:(NSUInteger)_uncompressedLength];
+
+    for (NSUInteger i = 0; i < _blocks.count; i++) {
+        @autoreleasepool {
+            NSData *block = [self dataOfBlockAtIndex:i error:error];
+            if (!block) {
+                return nil;
+            }
+            [data appendData:block];
+        }
+    }
+
+    return data;
+}
+
+- (BOOL)writeDataToPath:(NSString *)path error:(NSError **)error {
+    if (![[NSFileManager defaultManager] createFileAtPath:path contents:nil attributes:nil]) {
+        if (error) {
+            *error = VVLogBlockError(5, [NSString stringWithFormat:@"Can not create %@.", path]);
+        }
+        return NO;
+    }
+
+    NSFileHandle *handle = [NSFileHandle fileHandleForWritingAtPath:path];
+    BOOL success = YES;
+
+    @try {
+        for (NSUInteger i = 0; i < _blocks.count && success; i++) {
+            @autoreleasepool {
+                NSData *block = [self dataOfBlockAtIndex:i error:error];
+                if (block) {
+                    [handle writeData:block];
+                } else {
+                    success = NO;
+                }
+            }
+        }
+    } @catch (NSException *exception) {
+        if (error) {
+            *error = VVLogBlockError(6, exception.reason ?: exception.name);
+        }
+        success = NO;
+    }
+
+    [handle closeFile];
+    return success;
+}
+
+@end
@@ -34,6 +34,23 @@
     #define LOG_ASYNC_ENABLED YES
 #endif
 
+/**
+ * The levels a build keeps at all. Statements whose flag is not in it are compiled out, whatever the loggers take.
+ * Define it before this file is imported, e.g. in GCC_PREPROCESSOR_DEFINITIONS: VV_LOG_LEVEL_FLOOR=VVLogLevelInfo
+ **/
+#ifndef VV_LOG_LEVEL_FLOOR
+    #define VV_LOG_LEVEL_FLOOR VVLogLevelAll
+#endif
+
+/**
+ * Whether a statement with the flag flg is logged: the flag has to be in the build's floor, in lvl, and taken by a
+ * logger of the shared VVLog (see `VVLogEnabledLevels`). The first two are compile time constants with the standard
+ * macros, so a statement failing them is stripped; the last is one relaxed atomic load. Either way nothing of the
+ * statement, its arguments included, is evaluated when it fails.
+ **/
+#define VV_LOG_FLAG_ENABLED(lvl, flg) \
+        (((flg) & VV_LOG_LEVEL_FLOOR) != 0 && ((lvl) & (flg)) != 0 && VVLogIsEnabledForFlag(flg))
+
 /**
  * These are the two macros that all other macros below compile into.
  * These big multiline macros makes all the other macros easier to read.
@@ -60,13 +77,34 @@
                tag : atag                                               \
             format : (frmt), ## __VA_ARGS__]
 
+/**
+ * Same as LOG_MACRO, with the static state of the log statement the binary record mode needs.
+ * See `VVLog.recordsArguments`.
+ **/
+#define LOG_MACRO_CALL_SITE(isAsynchronous, lvl, flg, ctx, atag, fnct, frmt, ...) \
+        do {                                                            \
+            static VVLogCallSite vvLogCallSite;                         \
+            [VVLog log : isAsynchronous                                 \
+                 level : lvl                                            \
+                  flag : flg                                            \
+               context : ctx                                            \
+                  file : __FILE__                                       \
+              function : fnct                                           \
+                  line : __LINE__                                       \
+                   tag : atag                                           \
+              callSite : &vvLogCallSite                                 \
+                format : (frmt), ## __VA_ARGS__];                       \
+        } while(0)
+
 /**
  * Define version of the macro that only execute if the log level is above the threshold.
  * The compiled versions essentially look like this:
  *
- * if (logFlagForThisLogMsg & vvLogLevel) { execute log message }
+ * if ((logFlagForThisLogMsg & VV_LOG_LEVEL_FLOOR) && (logFlagForThisLogMsg & vvLogLevel)
+ *     && VVLogIsEnabledForFlag(logFlagForThisLogMsg)) { execute log message }
  *
- * When LOG_LEVEL_DEF is defined as vvLogLevel.
+ * When LOG_LEVEL_DEF is defined as vvLogLevel. The _TO_VVLOG versions skip the last check, which is about the
+ * shared VVLog only.
  *
  * As shown further below, Lumberjack actually uses a bitmask as opposed to primitive log levels.
  * This allows for a great amount of flexibility and some pretty advanced fine grained logging techniques.
@@ -80,10 +118,10 @@
  * We also define shorthand versions for asynchronous and synchronous logging.
  **/
 #define LOG_MAYBE(async, lvl, flg, ctx, tag, fnct, frmt, ...) \
-        do { if((lvl & flg) != 0) LOG_MACRO(async, lvl, flg, ctx, tag, fnct, frmt, ##__VA_ARGS__); } while(0)
+        do { if(VV_LOG_FLAG_ENABLED(lvl, flg)) LOG_MACRO_CALL_SITE(async, lvl, flg, ctx, tag, fnct, frmt, ##__VA_ARGS__); } while(0)
 
 #define LOG_MAYBE_TO_VVLOG(vvlog, async, lvl, flg, ctx, tag, fnct, frmt, ...) \
-        do { if((lvl & flg) != 0) LOG_MACRO_TO_VVLOG(vvlog, async, lvl, flg, ctx, tag, fnct, frmt, ##__VA_ARGS__); } while(0)
+        do { if(((flg) & VV_LOG_LEVEL_FLOOR) != 0 && (lvl & flg) != 0) LOG_MACRO_TO_VVLOG(vvlog, async, lvl, flg, ctx, tag, fnct, frmt, ##__VA_ARGS__); } while(0)
 
 /**
  * Ready to use log macros with no context or tag.
@@ -99,3 +137,70 @@
 #define VVLogInfoToVVLog(vvlog, frmt, ...)    LOG_MAYBE_TO_VVLOG(vvlog, LOG_ASYNC_ENABLED, LOG_LEVEL_DEF, VVLogFlagInfo,    0, nil, __PRETTY_FUNCTION__, frmt, ##__VA_ARGS__)
 #define VVLogDebugToVVLog(vvlog, frmt, ...)   LOG_MAYBE_TO_VVLOG(vvlog, LOG_ASYNC_ENABLED, LOG_LEVEL_DEF, VVLogFlagDebug,   0, nil, __PRETTY_FUNCTION__, frmt, ##__VA_ARGS__)
 #define VVLogVerboseToVVLog(vvlog, frmt, ...) LOG_MAYBE_TO_VVLOG(vvlog, LOG_ASYNC_ENABLED, LOG_LEVEL_DEF, VVLogFlagVerbose, 0, nil, __PRETTY_FUNCTION__, frmt, ##__VA_ARGS__)
+
+/**
+ * Rate limited versions, for statements on hot paths such as every network callback.
+ * Each statement keeps its own static state. A rejected statement costs a clock read and a couple of atomic
+ * operations; its arguments are neither evaluated nor formatted.
+ *
+ * - Limited: `rate` statements per second on average, in bursts of up to `burst`. See `VVLogRateLimitAllow`.
+ * - Sampled: one statement out of every `n`. See `VVLogSampleAllow`.
+ * - FirstN:  the first `n` statements of every `interval` seconds. See `VVLogFirstNAllow`.
+ *
+ * Limited and FirstN count what they reject, and log "suppressed K similar messages" at the same level just before
+ * the next statement they let through.
+ **/
+#define LOG_SUPPRESSED(async, lvl, flg, ctx, tag, fnct, count) \
+        do { if((count) > 0) LOG_MACRO_CALL_SITE(async, lvl, flg, ctx, tag, fnct, @"suppressed %llu similar messages", (unsigned long long)(count)); } while(0)
+
+#define LOG_MAYBE_LIMITED(async, lvl, flg, ctx, tag, fnct, rate, burst, frmt, ...) \
+        do {                                                                        \
+            if(VV_LOG_FLAG_ENABLED(lvl, flg)) {                                     \
+                static VVLogRateLimit vvLogRateLimit;                               \
+                uint64_t vvLogSuppressedCount = 0;                                  \
+                if(VVLogRateLimitAllow(&vvLogRateLimit, rate, burst, &vvLogSuppressedCount)) { \
+                    LOG_SUPPRESSED(async, lvl, flg, ctx, tag, fnct, vvLogSuppressedCount); \
+                    LOG_MACRO_CALL_SITE(async, lvl, flg, ctx, tag, fnct, frmt, ##__VA_ARGS__); \
+                }                                                                   \
+            }                                                                       \
+        } while(0)
+
+#define LOG_MAYBE_SAMPLED(async, lvl, flg, ctx, tag, fnct, n, frmt, ...) \
+        do {                                                                        \
+            if(VV_LOG_FLAG_ENABLED(lvl, flg)) {                                     \
+                static VVLogRateLimit vvLogRateLimit;                               \
+                if(VVLogSampleAllow(&vvLogRateLimit, n)) {                          \
+                    LOG_MACRO_CALL_SITE(async, lvl, flg, ctx, tag, fnct, frmt, ##__VA_ARGS__); \
+                }                                                                   \
+            }                                                                       \
+        } while(0)
+
+#define LOG_MAYBE_FIRST_N(async, lvl, flg, ctx, tag, fnct, n, interval, frmt, ...) \
+        do {                                                                        \
+            if(VV_LOG_FLAG_ENABLED(lvl, flg)) {                                     \
+                static VVLogRateLimit vvLogRateLimit;                               \
+                uint64_t vvLogSuppressedCount = 0;                                  \
+                if(VVLogFirstNAllow(&vvLogRateLimit, n, interval, &vvLogSuppressedCount)) { \
+                    LOG_SUPPRESSED(async, lvl, flg, ctx, tag, fnct, vvLogSuppressedCount); \
+                    LOG_MACRO_CALL_SITE(async, lvl, flg, ctx, tag, fnct, frmt, ##__VA_ARGS__); \
+                }                                                                   \
+            }                                                                       \
+        } while(0)
+
+#define VVLogErrorLimited(rate, burst, frmt, ...)   LOG_MAYBE_LIMITED(NO,                LOG_LEVEL_DEF, VVLogFlagError,   0, nil, __PRETTY_FUNCTION__, rate, burst, frmt, ##__VA_ARGS__)
+#define VVLogWarnLimited(rate, burst, frmt, ...)    LOG_MAYBE_LIMITED(LOG_ASYNC_ENABLED, LOG_LEVEL_DEF, VVLogFlagWarning, 0, nil, __PRETTY_FUNCTION__, rate, burst, frmt, ##__VA_ARGS__)
+#define VVLogInfoLimited(rate, burst, frmt, ...)    LOG_MAYBE_LIMITED(LOG_ASYNC_ENABLED, LOG_LEVEL_DEF, VVLogFlagInfo,    0, nil, __PRETTY_FUNCTION__, rate, burst, frmt, ##__VA_ARGS__)
+#define VVLogDebugLimited(rate, burst, frmt, ...)   LOG_MAYBE_LIMITED(LOG_ASYNC_ENABLED, LOG_LEVEL_DEF, VVLogFlagDebug,   0, nil, __PRETTY_FUNCTION__, rate, burst, frmt, ##__VA_ARGS__)
+#define VVLogVerboseLimited(rate, burst, frmt, ...) LOG_MAYBE_LIMITED(LOG_ASYNC_ENABLED, LOG_LEVEL_DEF, VVLogFlagVerbose, 0, nil, __PRETTY_FUNCTION__, rate, burst, frmt, ##__VA_ARGS__)
+
+#define VVLogErrorSampled(n, frmt, ...)   LOG_MAYBE_SAMPLED(NO,                LOG_LEVEL_DEF, VVLogFlagError,   0, nil, __PRETTY_FUNCTION__, n, frmt, ##__VA_ARGS__)
+#define VVLogWarnSampled(n, frmt, ...)    LOG_MAYBE_SAMPLED(LOG_ASYNC_ENABLED, LOG_LEVEL_DEF, VVLogFlagWarning, 0, nil, __PRETTY_FUNCTION__, n, frmt, ##__VA_ARGS__)
+#define VVLogInfoSampled(n, frmt, ...)    LOG_MAYBE_SAMPLED(LOG_ASYNC_ENABLED, LOG_LEVEL_DEF, VVLogFlagInfo,    0, nil, __PRETTY_FUNCTION__, n, frmt, ##__VA_ARGS__)
+#define VVLogDebugSampled(n, frmt, ...)   LOG_MAYBE_SAMPLED(LOG_ASYNC_ENABLED, LOG_LEVEL_DEF, VVLogFlagDebug,   0, nil, __PRETTY_FUNCTION__, n, frmt, ##__VA_ARGS__)
+#define VVLogVerboseSampled(n, frmt, ...) LOG_MAYBE_SAMPLED(LOG_ASYNC_ENABLED, LOG_LEVEL_DEF, VVLogFlagVerbose, 0, nil, __PRETTY_FUNCTION__, n, frmt, ##__VA_ARGS__)
+
+#define VVLogErrorFirstN(n, interval, frmt, ...)   LOG_MAYBE_FIRST_N(NO,                LOG_LEVEL_DEF, VVLogFlagError,   0, nil, __PRETTY_FUNCTION__, n, interval, frmt, ##__VA_ARGS__)
+#define VVLogWarnFirstN(n, interval, frmt, ...)    LOG_MAYBE_FIRST_N(LOG_ASYNC_ENABLED, LOG_LEVEL_DEF, VVLogFlagWarning, 0, nil, __PRETTY_FUNCTION__, n, interval, frmt, ##__VA_ARGS__)
+#define VVLogInfoFirstN(n, interval, frmt, ...)    LOG_MAYBE_FIRST_N(LOG_ASYNC_ENABLED, LOG_LEVEL_DEF, VVLogFlagInfo,    0, nil, __PRETTY_FUNCTION__, n, interval, frmt, ##__VA_ARGS__)
+#define VVLogDebugFirstN(n, interval, frmt, ...)   LOG_MAYBE_FIRST_N(LOG_ASYNC_ENABLED, LOG_LEVEL_DEF, VVLogFlagDebug,   0, nil, __PRETTY_FUNCTION__, n, interval, frmt, ##__VA_ARGS__)
+#define VVLogVerboseFirstN(n, interval, frmt, ...) LOG_MAYBE_FIRST_N(LOG_ASYNC_ENABLED, LOG_LEVEL_DEF, VVLogFlagVerbose, 0, nil, __PRETTY_FUNCTION__, n, interval, frmt, ##__VA_ARGS__)
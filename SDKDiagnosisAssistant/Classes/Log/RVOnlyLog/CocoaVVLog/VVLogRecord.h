@@ -0,0 +1,73 @@
+//
+//  VVLogRecord.h
+//  CocoaVVLog
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+
+// Disable legacy macros
+#ifndef VV_LEGACY_MACROS
+    #define VV_LEGACY_MACROS 0
+#endif
+
+#import "VVLog.h"
+#import "VVLogRecordFormat.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * A log statement registered for the binary record mode.
+ *
+ * Registered the first time the statement is logged while `VVLog.recordsArguments` is on,
+ * and kept for the life of the process.
+ **/
+@interface VVLogCallSiteInfo : NSObject
+
+/**
+ * The info of `callSite`, registering it on its first use.
+ * nil if its format can not be recorded (see `VVLogRecordFormat`), or is not the format the
+ * call site was registered with, as happens when the format is not a literal.
+ **/
++ (nullable VVLogCallSiteInfo *)infoForCallSite:(VVLogCallSite *)callSite
+                                         format:(NSString *)format
+                                           file:(const char *)file
+                                       function:(nullable const char *)function
+                                           line:(NSUInteger)line;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/// Unique in the process, never 0
+@property (nonatomic, readonly) uint32_t identifier;
+@property (nonatomic, strong, readonly) VVLogRecordFormat *format;
+@property (nonatomic, copy, readonly) NSString *file;
+@property (nonatomic, copy, readonly, nullable) NSString *function;
+@property (nonatomic, readonly) NSUInteger line;
+
+/// Serializes the arguments of one statement
+- (NSData *)argumentsWithList:(va_list)args;
+
+/// Formats serialized arguments, as `initWithFormat:arguments:` would have at the call site
+- (NSString *)messageWithArguments:(NSData *)arguments;
+
+@end
+
+/**
+ * Turns log messages into the records of a binary log file, see `VVLogRecordFormat.h`.
+ * Remembers the call sites defined since the session began. Not thread safe, used on the logger queue.
+ **/
+@interface VVLogRecordWriter : NSObject
+
+/// Magic and version, the first bytes of every binary log file
++ (NSData *)fileHeader;
+
+/// Begins a session: the call sites defined in the file so far are forgotten.
+- (void)appendSessionToBuffer:(NSMutableData *)buffer;
+
+/// A message record, preceded by the definition of its call site if the session has not seen it.
+/// Messages that were formatted when logged become text records.
+- (void)appendLogMessage:(VVLogMessage *)logMessage toBuffer:(NSMutableData *)buffer;
+
+@end
+
+NS_ASSUME_NONNULL_END
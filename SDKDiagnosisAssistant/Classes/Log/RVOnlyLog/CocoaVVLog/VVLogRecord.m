@@ -0,0 +1,157 @@
+//
+//  VVLogRecord.m
+//  CocoaVVLog
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+
+#if !__has_feature(objc_arc)
+#error This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+#import "VVLogRecord.h"
+
+// State of a call site whose format can not be recorded
+static void *const kVVLogCallSiteUnsupported = (void *)&kVVLogCallSiteUnsupported;
+
+static uint32_t _lastCallSiteIdentifier = 0;
+
+@implementation VVLogCallSiteInfo
+
++ (VVLogCallSiteInfo *)infoForCallSite:(VVLogCallSite *)callSite
+                                format:(NSString *)format
+                                  file:(const char *)file
+                              function:(const char *)function
+                                  line:(NSUInteger)line {
+    void *state = __atomic_load_n(&callSite->info, __ATOMIC_ACQUIRE);
+
+    if (state == NULL) {
+        VVLogCallSiteInfo *info = [[self alloc] initWithFormat:format file:file function:function line:line];
+        void *newState = info ? (void *)CFBridgingRetain(info) : kVVLogCallSiteUnsupported;
+
+        // Another thread may register the same statement, the first one wins.
+        // The winner is never released, call sites are static.
+        void *expected = NULL;
+        if (__atomic_compare_exchange_n(&callSite->info, &expected, newState, NO, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            state = newState;
+        } else {
+            if (info) {
+                CFRelease(newState);
+            }
+            state = expected;
+        }
+    }
+
+    if (state == kVVLogCallSiteUnsupported) {
+        return nil;
+    }
+
+    // The format was copied when registered: a literal is the very same object,
+    // a format built at runtime never is and gets formatted on the spot.
+    VVLogCallSiteInfo *info = (__bridge VVLogCallSiteInfo *)state;
+    return info->_format.string == format ? info : nil;
+}
+
+- (nullable instancetype)initWithFormat:(NSString *)format
+                                   file:(const char *)file
+                               function:(const char *)function
+                                   line:(NSUInteger)line {
+    VVLogRecordFormat *recordFormat = [VVLogRecordFormat formatWithString:format];
+    if (!recordFormat) {
+        return nil;
+    }
+
+    if ((self = [super init])) {
+        _identifier = __atomic_add_fetch(&_lastCallSiteIdentifier, 1, __ATOMIC_RELAXED);
+        _format = recordFormat;
+        _file = [[NSString alloc] initWithUTF8String:file] ?: @"";
+        _function = function ? [[NSString alloc] initWithUTF8String:function] : nil;
+        _line = line;
+    }
+
+    return self;
+}
+
+- (NSData *)argumentsWithList:(va_list)args {
+    NSMutableData *arguments = [[NSMutableData alloc] initWithCapacity:_format.argumentCount * 8];
+    [_format appendArguments:args toBuffer:arguments];
+    return arguments;
+}
+
+- (NSString *)messageWithArguments:(NSData *)arguments {
+    return [_format stringWithArguments:arguments] ?: _format.string;
+}
+
+@end
+
+#pragma mark -
+
+@interface VVLogRecordWriter () {
+    NSMutableIndexSet *_definedCallSites;
+}
+
+@end
+
+@implementation VVLogRecordWriter
+
++ (NSData *)fileHeader {
+    NSMutableData *header = [NSMutableData dataWithBytes:kVVLogRecordFileMagic length:sizeof(kVVLogRecordFileMagic)];
+    [header appendBytes:&kVVLogRecordFileVersion length:1];
+    return header;
+}
+
+- (instancetype)init {
+    if ((self = [super init])) {
+        _definedCallSites = [NSMutableIndexSet new];
+    }
+
+    return self;
+}
+
+- (void)appendSessionToBuffer:(NSMutableData *)buffer {
+    [_definedCallSites removeAllIndexes];
+
+    int64_t secondsFromGMT = [NSTimeZone localTimeZone].secondsFromGMT;
+    uint8_t type = VVLogRecordTypeSession;
+    [buffer appendBytes:&type length:1];
+    VVLogRecordAppendVarint(buffer, ((uint64_t)secondsFromGMT << 1) ^ (uint64_t)(secondsFromGMT >> 63));
+}
+
+- (void)appendLogMessage:(VVLogMessage *)logMessage toBuffer:(NSMutableData *)buffer {
+    VVLogCallSiteInfo *callSite = logMessage->_callSite;
+    uint8_t flag = (uint8_t)logMessage->_flag;
+    // Truncated like the milliseconds of the text files
+    uint64_t milliseconds = (uint64_t)floor([logMessage->_timestamp timeIntervalSince1970] * 1000);
+    uint8_t type;
+
+    if (callSite == nil) {
+        type = VVLogRecordTypeText;
+        [buffer appendBytes:&type length:1];
+        [buffer appendBytes:&flag length:1];
+        VVLogRecordAppendVarint(buffer, milliseconds);
+        VVLogRecordAppendString(buffer, logMessage.message);
+        return;
+    }
+
+    if (![_definedCallSites containsIndex:callSite.identifier]) {
+        type = VVLogRecordTypeCallSite;
+        [buffer appendBytes:&type length:1];
+        VVLogRecordAppendVarint(buffer, callSite.identifier);
+        VVLogRecordAppendVarint(buffer, callSite.line);
+        VVLogRecordAppendString(buffer, callSite.file.lastPathComponent);
+        VVLogRecordAppendString(buffer, callSite.function);
+        VVLogRecordAppendString(buffer, callSite.format.string);
+        [_definedCallSites addIndex:callSite.identifier];
+    }
+
+    NSData *arguments = logMessage->_arguments;
+    type = VVLogRecordTypeMessage;
+    [buffer appendBytes:&type length:1];
+    VVLogRecordAppendVarint(buffer, callSite.identifier);
+    [buffer appendBytes:&flag length:1];
+    VVLogRecordAppendVarint(buffer, milliseconds);
+    VVLogRecordAppendBytes(buffer, arguments.bytes, arguments.length);
+}
+
+@end
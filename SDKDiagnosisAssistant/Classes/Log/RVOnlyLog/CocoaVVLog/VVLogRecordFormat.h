@@ -0,0 +1,102 @@
+//
+//  VVLogRecordFormat.h
+//  CocoaVVLog
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Binary log files (`.vvlog`)
+ *
+ * A file starts with `kVVLogRecordFileMagic` and a version byte, followed by records.
+ * Every record starts with its type byte. Integers are unsigned LEB128 varints, signed ones
+ * zigzag encoded first, strings are a varint byte count and UTF-8 bytes.
+ *
+ * `VVLogRecordTypeSession`   seconds from GMT. Starts a process writing to the file,
+ *                            call site identifiers of earlier sessions are no longer valid.
+ * `VVLogRecordTypeCallSite`  identifier, line, file, function, format.
+ *                            Precedes the first message of the call site in a session.
+ * `VVLogRecordTypeMessage`   identifier, flag byte, milliseconds since 1970, argument byte count, arguments.
+ * `VVLogRecordTypeText`      flag byte, milliseconds since 1970, message.
+ *                            For statements that were formatted before reaching the file logger.
+ *
+ * Arguments are stored in format order: integers, characters and pointers as varints,
+ * doubles as 8 little-endian bytes, C strings and objects as strings, the description of an object
+ * taken when it was logged. A C string of byte count zero is NULL, any other count is one more than its length.
+ **/
+
+extern char const kVVLogRecordFileMagic[4];
+extern uint8_t const kVVLogRecordFileVersion;
+extern NSUInteger const kVVLogRecordFileHeaderLength;
+
+typedef NS_ENUM(uint8_t, VVLogRecordType) {
+    VVLogRecordTypeSession  = 'H',
+    VVLogRecordTypeCallSite = 'S',
+    VVLogRecordTypeMessage  = 'M',
+    VVLogRecordTypeText     = 'T',
+};
+
+FOUNDATION_EXPORT void VVLogRecordAppendVarint(NSMutableData *buffer, uint64_t value);
+FOUNDATION_EXPORT void VVLogRecordAppendBytes(NSMutableData *buffer, const void *bytes, NSUInteger length);
+FOUNDATION_EXPORT void VVLogRecordAppendString(NSMutableData *buffer, NSString * _Nullable string);
+
+/**
+ * A printf style format, scanned once into the types of its arguments.
+ *
+ * Supports what log statements use: integer, floating point, character, C string, object and pointer
+ * conversions with flags, width and precision. Positional (`%1$d`) and `*` widths, `%n`, `%S` and
+ * long doubles are not, nor widths and precisions over 4096, those formats have to be formatted on the spot.
+ * A record file whose format has one is rejected by the decoder.
+ * Width and precision of `%@` are ignored when formatting the stored arguments.
+ **/
+@interface VVLogRecordFormat : NSObject
+
+/// nil if the format has conversions the record mode does not support
++ (nullable instancetype)formatWithString:(NSString *)format;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@property (nonatomic, copy, readonly) NSString *string;
+
+/// Number of arguments the format consumes
+@property (nonatomic, readonly) NSUInteger argumentCount;
+
+/// Reads the arguments of the format from `args` and appends them to `buffer`.
+- (void)appendArguments:(va_list)args toBuffer:(NSMutableData *)buffer;
+
+/// The formatted message, or nil if `arguments` do not match the format.
+- (nullable NSString *)stringWithArguments:(NSData *)arguments;
+
+@end
+
+/**
+ * Turns binary log files back into the lines `RVFileLogFormatter` would have written:
+ * `yyyy.MM.dd-HH.mm.ss.SSS GMT+8[I] message`, in the time zone of the writing session.
+ *
+ * Only needs Foundation, so the backend can build it with this file alone (see Tools/vvlogdecode).
+ **/
+@interface VVLogRecordDecoder : NSObject
+
+/// YES if `data` starts with the header of a binary log file
++ (BOOL)isRecordData:(NSData *)data;
+
+/// YES if the file at `path` is a binary log file, NO if it is empty, unreadable or text.
++ (BOOL)isRecordFileAtPath:(NSString *)path;
+
+/**
+ * Decodes a whole binary log file.
+ * Returns nil with an error if it is not one. A record cut short at the end, as left by a crash
+ * while writing, is skipped; bytes after the first undecodable record are reported in a last line.
+ **/
++ (nullable NSString *)textWithData:(NSData *)data error:(NSError **)error;
+
++ (nullable NSString *)textWithContentsOfFile:(NSString *)path error:(NSError **)error;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,758 @@
+//
+//  VVLogRecordFormat.m
+//  CocoaVVLog
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+
+#if !__has_feature(objc_arc)
+#error This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+#import "VVLogRecordFormat.h"
+
+char const kVVLogRecordFileMagic[4] = { 'V', 'V', 'L', 'B' };
+uint8_t const kVVLogRecordFileVersion = 1;
+NSUInteger const kVVLogRecordFileHeaderLength = sizeof(kVVLogRecordFileMagic) + 1;
+
+static NSString * const kVVLogRecordErrorDomain = @"VVLogRecordDecoder";
+
+typedef NS_ENUM(uint8_t, VVLogArgumentKind) {
+    VVLogArgumentNone,          // "%%"
+    VVLogArgumentSigned,
+    VVLogArgumentUnsigned,
+    VVLogArgumentDouble,
+    VVLogArgumentCharacter,
+    VVLogArgumentUnichar,
+    VVLogArgumentCString,
+    VVLogArgumentObject,
+    VVLogArgumentPointer,
+    VVLogArgumentUnsupported,
+};
+
+typedef NS_ENUM(uint8_t, VVLogArgumentLength) {
+    VVLogArgumentLengthDefault,
+    VVLogArgumentLengthChar,        // hh
+    VVLogArgumentLengthShort,       // h
+    VVLogArgumentLengthLong,        // l
+    VVLogArgumentLengthLongLong,    // ll, q
+    VVLogArgumentLengthSize,        // z
+    VVLogArgumentLengthPtrDiff,     // t
+    VVLogArgumentLengthIntMax,      // j
+    VVLogArgumentLengthLongDouble,  // L
+};
+
+typedef struct {
+    VVLogArgumentKind kind;
+    VVLogArgumentLength length;
+} VVLogArgument;
+
+typedef struct {
+    const char *start;      // The '%'
+    const char *modifier;   // The length modifier, or the conversion if there is none
+    const char *end;        // Past the conversion
+    VVLogArgument argument;
+} VVLogFormatSpec;
+
+#pragma mark - Format scanning
+
+static BOOL VVLogFormatIsFlag(char c) {
+    return c == '-' || c == '+' || c == ' ' || c == '#' || c == '0' || c == '\'';
+}
+
+static BOOL VVLogFormatIsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Widest width or precision accepted. The formats of a record file are read back as they were stored,
+// a crafted "%2000000000d" would otherwise have the decoder allocate gigabytes.
+static const NSUInteger kVVLogFormatMaxWidth = 4096;
+
+/// Skips the digits at `*p`, NO if their value is over kVVLogFormatMaxWidth.
+static BOOL VVLogFormatSkipWidth(const char **p) {
+    NSUInteger value = 0;
+    BOOL fits = YES;
+    while (VVLogFormatIsDigit(**p)) {
+        if (fits) {
+            value = value * 10 + (NSUInteger)(**p - '0');
+            fits = value <= kVVLogFormatMaxWidth;
+        }
+        (*p)++;
+    }
+    return fits;
+}
+
+/// Finds the next conversion from `cursor` on, NO at the end of the format.
+static BOOL VVLogFormatNextSpec(const char *cursor, VVLogFormatSpec *spec) {
+    const char *p = strchr(cursor, '%');
+    if (p == NULL) {
+        return NO;
+    }
+
+    spec->start = p++;
+    spec->argument.kind = VVLogArgumentUnsupported;
+    spec->argument.length = VVLogArgumentLengthDefault;
+
+    if (*p == '%') {
+        spec->modifier = p;
+        spec->end = p + 1;
+        spec->argument.kind = VVLogArgumentNone;
+        return YES;
+    }
+
+    while (VVLogFormatIsFlag(*p)) {
+        p++;
+    }
+    if (*p == '*') {
+        spec->modifier = spec->end = p;
+        return YES;
+    }
+    BOOL fits = VVLogFormatSkipWidth(&p);
+    if (*p == '$') {
+        spec->modifier = spec->end = p;
+        return YES;
+    }
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            spec->modifier = spec->end = p;
+            return YES;
+        }
+        fits = VVLogFormatSkipWidth(&p) && fits;
+    }
+
+    spec->modifier = p;
+    VVLogArgumentLength length = VVLogArgumentLengthDefault;
+    switch (*p) {
+        case 'h':
+            p++;
+            length = VVLogArgumentLengthShort;
+            if (*p == 'h') {
+                p++;
+                length = VVLogArgumentLengthChar;
+            }
+            break;
+        case 'l':
+            p++;
+            length = VVLogArgumentLengthLong;
+            if (*p == 'l') {
+                p++;
+                length = VVLogArgumentLengthLongLong;
+            }
+            break;
+        case 'q': p++; length = VVLogArgumentLengthLongLong;   break;
+        case 'z': p++; length = VVLogArgumentLengthSize;       break;
+        case 't': p++; length = VVLogArgumentLengthPtrDiff;    break;
+        case 'j': p++; length = VVLogArgumentLengthIntMax;     break;
+        case 'L': p++; length = VVLogArgumentLengthLongDouble; break;
+        default: break;
+    }
+
+    char conversion = *p;
+    spec->end = conversion ? p + 1 : p;
+
+    VVLogArgumentKind kind = VVLogArgumentUnsupported;
+    BOOL isDefaultLength = length == VVLogArgumentLengthDefault;
+    switch (conversion) {
+        case 'd': case 'i':
+            kind = VVLogArgumentSigned;
+            break;
+        case 'o': case 'u': case 'x': case 'X':
+            kind = VVLogArgumentUnsigned;
+            break;
+        case 'D':
+            kind = isDefaultLength ? VVLogArgumentSigned : VVLogArgumentUnsupported;
+            length = VVLogArgumentLengthLong;
+            break;
+        case 'O': case 'U':
+            kind = isDefaultLength ? VVLogArgumentUnsigned : VVLogArgumentUnsupported;
+            length = VVLogArgumentLengthLong;
+            break;
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            kind = VVLogArgumentDouble;
+            break;
+        case 'c':
+            kind = isDefaultLength ? VVLogArgumentCharacter : VVLogArgumentUnsupported;
+            break;
+        case 'C':
+            kind = isDefaultLength ? VVLogArgumentUnichar : VVLogArgumentUnsupported;
+            break;
+        case 's':
+            kind = isDefaultLength ? VVLogArgumentCString : VVLogArgumentUnsupported;
+            break;
+        case '@':
+            kind = isDefaultLength ? VVLogArgumentObject : VVLogArgumentUnsupported;
+            break;
+        case 'p':
+            kind = isDefaultLength ? VVLogArgumentPointer : VVLogArgumentUnsupported;
+            break;
+        default:
+            break;
+    }
+    if (length == VVLogArgumentLengthLongDouble || !fits) {
+        kind = VVLogArgumentUnsupported;
+    }
+
+    spec->argument.kind = kind;
+    spec->argument.length = length;
+    return YES;
+}
+
+#pragma mark - Encoding
+
+void VVLogRecordAppendVarint(NSMutableData *buffer, uint64_t value) {
+    uint8_t bytes[10];
+    NSUInteger count = 0;
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        bytes[count++] = value ? (byte | 0x80) : byte;
+    } while (value);
+    [buffer appendBytes:bytes length:count];
+}
+
+void VVLogRecordAppendBytes(NSMutableData *buffer, const void *bytes, NSUInteger length) {
+    VVLogRecordAppendVarint(buffer, length);
+    [buffer appendBytes:bytes length:length];
+}
+
+void VVLogRecordAppendString(NSMutableData *buffer, NSString *string) {
+    const char *utf8 = string ? CFStringGetCStringPtr((__bridge CFStringRef)string, kCFStringEncodingUTF8) : NULL;
+    if (utf8) {
+        VVLogRecordAppendBytes(buffer, utf8, strlen(utf8));
+        return;
+    }
+
+    NSData *data = [string dataUsingEncoding:NSUTF8StringEncoding allowLossyConversion:YES];
+    VVLogRecordAppendBytes(buffer, data.bytes, data.length);
+}
+
+static uint64_t VVLogRecordZigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t VVLogRecordUnzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+/// String arguments store one more than their length, so zero can stand for NULL
+static void VVLogRecordAppendArgumentBytes(NSMutableData *buffer, const char *bytes, NSUInteger length) {
+    if (bytes == NULL) {
+        VVLogRecordAppendVarint(buffer, 0);
+        return;
+    }
+    VVLogRecordAppendVarint(buffer, (uint64_t)length + 1);
+    [buffer appendBytes:bytes length:length];
+}
+
+#pragma mark - Decoding
+
+static BOOL VVLogRecordReadVarint(const uint8_t **cursor, const uint8_t *end, uint64_t *value) {
+    const uint8_t *p = *cursor;
+    uint64_t result = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (p >= end) {
+            return NO;
+        }
+        uint8_t byte = *p++;
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            *cursor = p;
+            *value = result;
+            return YES;
+        }
+    }
+    return NO;
+}
+
+static BOOL VVLogRecordReadBytes(const uint8_t **cursor, const uint8_t *end, const uint8_t **bytes, NSUInteger *length) {
+    uint64_t count;
+    if (!VVLogRecordReadVarint(cursor, end, &count) || count > (uint64_t)(end - *cursor)) {
+        return NO;
+    }
+    *bytes = *cursor;
+    *length = (NSUInteger)count;
+    *cursor += count;
+    return YES;
+}
+
+static NSString *VVLogRecordStringWithBytes(const void *bytes, NSUInteger length) {
+    return [[NSString alloc] initWithBytes:bytes length:length encoding:NSUTF8StringEncoding]
+        ?: [[NSString alloc] initWithBytes:bytes length:length encoding:NSISOLatin1StringEncoding];
+}
+
+static void VVLogRecordAppendFormatted(NSMutableData *output, const char *format, ...) {
+    char stackBuffer[128];
+    va_list args;
+
+    va_start(args, format);
+    int count = vsnprintf(stackBuffer, sizeof(stackBuffer), format, args);
+    va_end(args);
+
+    if (count < 0) {
+        return;
+    }
+    if ((size_t)count < sizeof(stackBuffer)) {
+        [output appendBytes:stackBuffer length:(NSUInteger)count];
+        return;
+    }
+
+    NSUInteger start = output.length;
+    output.length = start + (NSUInteger)count + 1;
+    va_start(args, format);
+    vsnprintf((char *)output.mutableBytes + start, (size_t)count + 1, format, args);
+    va_end(args);
+    output.length = start + (NSUInteger)count;
+}
+
+static void VVLogRecordAppendUnichar(NSMutableData *output, unichar character) {
+    uint8_t bytes[3];
+    NSUInteger count;
+    if (character >= 0xd800 && character <= 0xdfff) {
+        character = 0xfffd;
+    }
+    if (character < 0x80) {
+        bytes[0] = (uint8_t)character;
+        count = 1;
+    } else if (character < 0x800) {
+        bytes[0] = (uint8_t)(0xc0 | (character >> 6));
+        bytes[1] = (uint8_t)(0x80 | (character & 0x3f));
+        count = 2;
+    } else {
+        bytes[0] = (uint8_t)(0xe0 | (character >> 12));
+        bytes[1] = (uint8_t)(0x80 | ((character >> 6) & 0x3f));
+        bytes[2] = (uint8_t)(0x80 | (character & 0x3f));
+        count = 3;
+    }
+    [output appendBytes:bytes length:count];
+}
+
+/// Formats one stored argument the way its conversion asks for, widened to the longest C type of its kind.
+static BOOL VVLogRecordAppendArgument(NSMutableData *output, const VVLogFormatSpec *spec, const uint8_t **cursor, const uint8_t *end) {
+    // Flags, width and precision of the original conversion, followed by our own length and conversion
+    char format[64];
+    size_t prefixLength = (size_t)(spec->modifier - spec->start);
+    if (prefixLength > sizeof(format) - 4) {
+        prefixLength = 1;
+    }
+    memcpy(format, spec->start, prefixLength);
+    char *suffix = format + prefixLength;
+    char conversion = spec->end[-1];
+
+    uint64_t value = 0;
+    switch (spec->argument.kind) {
+        case VVLogArgumentSigned:
+            if (!VVLogRecordReadVarint(cursor, end, &value)) {
+                return NO;
+            }
+            snprintf(suffix, 4, "ll%c", conversion == 'D' ? 'd' : conversion);
+            VVLogRecordAppendFormatted(output, format, (long long)VVLogRecordUnzigzag(value));
+            return YES;
+
+        case VVLogArgumentUnsigned:
+            if (!VVLogRecordReadVarint(cursor, end, &value)) {
+                return NO;
+            }
+            snprintf(suffix, 4, "ll%c", conversion == 'U' ? 'u' : conversion == 'O' ? 'o' : conversion);
+            VVLogRecordAppendFormatted(output, format, (unsigned long long)value);
+            return YES;
+
+        case VVLogArgumentDouble: {
+            if (end - *cursor < 8) {
+                return NO;
+            }
+            uint64_t bits = 0;
+            for (int i = 7; i >= 0; i--) {
+                bits = (bits << 8) | (*cursor)[i];
+            }
+            *cursor += 8;
+            double number;
+            memcpy(&number, &bits, sizeof(number));
+            snprintf(suffix, 4, "%c", conversion);
+            VVLogRecordAppendFormatted(output, format, number);
+            return YES;
+        }
+
+        case VVLogArgumentCharacter:
+            if (!VVLogRecordReadVarint(cursor, end, &value)) {
+                return NO;
+            }
+            snprintf(suffix, 4, "c");
+            VVLogRecordAppendFormatted(output, format, (int)(unsigned char)value);
+            return YES;
+
+        case VVLogArgumentUnichar:
+            if (!VVLogRecordReadVarint(cursor, end, &value)) {
+                return NO;
+            }
+            VVLogRecordAppendUnichar(output, (unichar)value);
+            return YES;
+
+        case VVLogArgumentPointer:
+            if (!VVLogRecordReadVarint(cursor, end, &value)) {
+                return NO;
+            }
+            snprintf(suffix, 4, "p");
+            VVLogRecordAppendFormatted(output, format, (void *)(uintptr_t)value);
+            return YES;
+
+        case VVLogArgumentCString:
+        case VVLogArgumentObject: {
+            if (!VVLogRecordReadVarint(cursor, end, &value) || value > (uint64_t)(end - *cursor) + 1) {
+                return NO;
+            }
+            if (value == 0) {
+                [output appendBytes:"(null)" length:6];
+                return YES;
+            }
+            NSUInteger length = (NSUInteger)value - 1;
+            const uint8_t *bytes = *cursor;
+            *cursor += length;
+
+            if (spec->argument.kind == VVLogArgumentObject || prefixLength == 1) {
+                [output appendBytes:bytes length:length];
+                return YES;
+            }
+
+            // "%-20s", "%.8s" need the C string
+            char *string = malloc(length + 1);
+            if (string == NULL) {
+                return NO;
+            }
+            memcpy(string, bytes, length);
+            string[length] = '\0';
+            snprintf(suffix, 4, "s");
+            VVLogRecordAppendFormatted(output, format, string);
+            free(string);
+            return YES;
+        }
+
+        case VVLogArgumentNone:
+        case VVLogArgumentUnsupported:
+            break;
+    }
+    return NO;
+}
+
+#pragma mark -
+
+@interface VVLogRecordFormat () {
+    NSData *_utf8;          // NUL terminated
+    NSData *_arguments;     // VVLogArgument per argument
+}
+
+@end
+
+@implementation VVLogRecordFormat
+
++ (instancetype)formatWithString:(NSString *)format {
+    return [[self alloc] initWithString:format];
+}
+
+- (nullable instancetype)initWithString:(NSString *)format {
+    const char *utf8 = format.UTF8String;
+    if (utf8 == NULL) {
+        return nil;
+    }
+
+    if ((self = [super init])) {
+        _string = [format copy];
+        _utf8 = [NSData dataWithBytes:utf8 length:strlen(utf8) + 1];
+
+        NSMutableData *arguments = [NSMutableData data];
+        const char *cursor = _utf8.bytes;
+        VVLogFormatSpec spec;
+        while (VVLogFormatNextSpec(cursor, &spec)) {
+            if (spec.argument.kind == VVLogArgumentUnsupported) {
+                return nil;
+            }
+            if (spec.argument.kind != VVLogArgumentNone) {
+                [arguments appendBytes:&spec.argument length:sizeof(spec.argument)];
+            }
+            cursor = spec.end;
+        }
+        _arguments = [arguments copy];
+        _argumentCount = arguments.length / sizeof(VVLogArgument);
+    }
+
+    return self;
+}
+
+- (void)appendArguments:(va_list)args toBuffer:(NSMutableData *)buffer {
+    const VVLogArgument *arguments = _arguments.bytes;
+
+    for (NSUInteger i = 0; i < _argumentCount; i++) {
+        VVLogArgumentLength length = arguments[i].length;
+
+        switch (arguments[i].kind) {
+            case VVLogArgumentSigned: {
+                int64_t value;
+                switch (length) {
+                    case VVLogArgumentLengthChar:     value = (signed char)va_arg(args, int);   break;
+                    case VVLogArgumentLengthShort:    value = (short)va_arg(args, int);         break;
+                    case VVLogArgumentLengthLong:     value = va_arg(args, long);               break;
+                    case VVLogArgumentLengthLongLong: value = va_arg(args, long long);          break;
+                    case VVLogArgumentLengthSize:     value = va_arg(args, ssize_t);            break;
+                    case VVLogArgumentLengthPtrDiff:  value = va_arg(args, ptrdiff_t);          break;
+                    case VVLogArgumentLengthIntMax:   value = va_arg(args, intmax_t);           break;
+                    default:                          value = va_arg(args, int);                break;
+                }
+                VVLogRecordAppendVarint(buffer, VVLogRecordZigzag(value));
+                break;
+            }
+
+            case VVLogArgumentUnsigned: {
+                uint64_t value;
+                switch (length) {
+                    case VVLogArgumentLengthChar:     value = (unsigned char)va_arg(args, int);     break;
+                    case VVLogArgumentLengthShort:    value = (unsigned short)va_arg(args, int);    break;
+                    case VVLogArgumentLengthLong:     value = va_arg(args, unsigned long);          break;
+                    case VVLogArgumentLengthLongLong: value = va_arg(args, unsigned long long);     break;
+                    case VVLogArgumentLengthSize:     value = va_arg(args, size_t);                 break;
+                    case VVLogArgumentLengthPtrDiff:  value = (uint64_t)va_arg(args, ptrdiff_t);    break;
+                    case VVLogArgumentLengthIntMax:   value = va_arg(args, uintmax_t);              break;
+                    default:                          value = va_arg(args, unsigned int);           break;
+                }
+                VVLogRecordAppendVarint(buffer, value);
+                break;
+            }
+
+            case VVLogArgumentDouble: {
+                double number = va_arg(args, double);
+                uint64_t bits;
+                memcpy(&bits, &number, sizeof(bits));
+                uint8_t bytes[8];
+                for (int b = 0; b < 8; b++) {
+                    bytes[b] = (uint8_t)(bits >> (8 * b));
+                }
+                [buffer appendBytes:bytes length:sizeof(bytes)];
+                break;
+            }
+
+            case VVLogArgumentCharacter:
+                VVLogRecordAppendVarint(buffer, (unsigned char)va_arg(args, int));
+                break;
+
+            case VVLogArgumentUnichar:
+                VVLogRecordAppendVarint(buffer, (unichar)va_arg(args, int));
+                break;
+
+            case VVLogArgumentPointer:
+                VVLogRecordAppendVarint(buffer, (uintptr_t)va_arg(args, void *));
+                break;
+
+            case VVLogArgumentCString: {
+                const char *string = va_arg(args, const char *);
+                VVLogRecordAppendArgumentBytes(buffer, string, string ? strlen(string) : 0);
+                break;
+            }
+
+            case VVLogArgumentObject: {
+                // The description is taken now, the object may have changed by the time it is formatted.
+                id object = va_arg(args, id);
+                NSString *description = object ? [object description] : @"(null)";
+                const char *utf8 = description ? CFStringGetCStringPtr((__bridge CFStringRef)description, kCFStringEncodingUTF8) : NULL;
+                if (utf8) {
+                    VVLogRecordAppendArgumentBytes(buffer, utf8, strlen(utf8));
+                } else {
+                    NSData *data = [description dataUsingEncoding:NSUTF8StringEncoding allowLossyConversion:YES] ?: [NSData data];
+                    VVLogRecordAppendArgumentBytes(buffer, data.bytes, data.length);
+                }
+                break;
+            }
+
+            case VVLogArgumentNone:
+            case VVLogArgumentUnsupported:
+                break;
+        }
+    }
+}
+
+- (NSString *)stringWithArguments:(NSData *)arguments {
+    const char *cursor = _utf8.bytes;
+    const uint8_t *bytes = arguments.bytes;
+    const uint8_t *end = bytes + arguments.length;
+    NSMutableData *output = [[NSMutableData alloc] initWithCapacity:_utf8.length + arguments.length + 32];
+
+    VVLogFormatSpec spec;
+    while (VVLogFormatNextSpec(cursor, &spec)) {
+        [output appendBytes:cursor length:(NSUInteger)(spec.start - cursor)];
+        cursor = spec.end;
+
+        if (spec.argument.kind == VVLogArgumentNone) {
+            [output appendBytes:"%" length:1];
+        } else if (!VVLogRecordAppendArgument(output, &spec, &bytes, end)) {
+            return nil;
+        }
+    }
+    [output appendBytes:cursor length:strlen(cursor)];
+
+    return VVLogRecordStringWithBytes(output.bytes, output.length);
+}
+
+@end
+
+#pragma mark -
+
+@implementation VVLogRecordDecoder
+
++ (BOOL)isRecordData:(NSData *)data {
+    if (data.length < kVVLogRecordFileHeaderLength) {
+        return NO;
+    }
+    const uint8_t *bytes = data.bytes;
+    return memcmp(bytes, kVVLogRecordFileMagic, sizeof(kVVLogRecordFileMagic)) == 0
+        && bytes[sizeof(kVVLogRecordFileMagic)] == kVVLogRecordFileVersion;
+}
+
++ (BOOL)isRecordFileAtPath:(NSString *)path {
+    NSFileHandle *handle = [NSFileHandle fileHandleForReadingAtPath:path];
+    NSData *header = nil;
+    @try {
+        header = [handle readDataOfLength:kVVLogRecordFileHeaderLength];
+    } @catch (NSException *exception) {
+        header = nil;
+    }
+    [handle closeFile];
+    return [self isRecordData:header];
+}
+
++ (NSString *)textWithContentsOfFile:(NSString *)path error:(NSError **)error {
+    NSData *data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:error];
+    if (!data) {
+        return nil;
+    }
+    return [self textWithData:data error:error];
+}
+
++ (NSString *)textWithData:(NSData *)data error:(NSError **)error {
+    if (![self isRecordData:data]) {
+        if (error) {
+            *error = [NSError errorWithDomain:kVVLogRecordErrorDomain
+                                         code:1
+                                     userInfo:@{ NSLocalizedDescriptionKey: @"Not a binary log file." }];
+        }
+        return nil;
+    }
+
+    NSDateFormatter *dateFormatter = [NSDateFormatter new];
+    dateFormatter.locale = [NSLocale localeWithLocaleIdentifier:@"en_US_POSIX"];
+    dateFormatter.dateFormat = @"yyyy.MM.dd-HH.mm.ss.SSS z";
+    dateFormatter.timeZone = [NSTimeZone timeZoneForSecondsFromGMT:0];
+
+    NSMutableDictionary<NSNumber *, VVLogRecordFormat *> *callSites = [NSMutableDictionary dictionary];
+    NSMutableString *text = [NSMutableString stringWithCapacity:data.length * 2];
+
+    const uint8_t *start = data.bytes;
+    const uint8_t *end = start + data.length;
+    const uint8_t *cursor = start + kVVLogRecordFileHeaderLength;
+    const uint8_t *corrupt = NULL;
+
+    while (cursor < end && corrupt == NULL) {
+        const uint8_t *record = cursor;
+        uint8_t type = *cursor++;
+        uint64_t identifier = 0, line = 0, milliseconds = 0;
+        const uint8_t *bytes = NULL;
+        NSUInteger length = 0;
+        BOOL complete = YES;
+
+        switch (type) {
+            case VVLogRecordTypeSession: {
+                uint64_t offset;
+                complete = VVLogRecordReadVarint(&cursor, end, &offset);
+                if (complete) {
+                    dateFormatter.timeZone = [NSTimeZone timeZoneForSecondsFromGMT:(NSInteger)VVLogRecordUnzigzag(offset)];
+                    [callSites removeAllObjects];
+                }
+                break;
+            }
+
+            case VVLogRecordTypeCallSite: {
+                const uint8_t *file, *function;
+                NSUInteger fileLength, functionLength;
+                complete = VVLogRecordReadVarint(&cursor, end, &identifier)
+                    && VVLogRecordReadVarint(&cursor, end, &line)
+                    && VVLogRecordReadBytes(&cursor, end, &file, &fileLength)
+                    && VVLogRecordReadBytes(&cursor, end, &function, &functionLength)
+                    && VVLogRecordReadBytes(&cursor, end, &bytes, &length);
+                if (complete) {
+                    VVLogRecordFormat *format = [VVLogRecordFormat formatWithString:VVLogRecordStringWithBytes(bytes, length)];
+                    if (format) {
+                        callSites[@(identifier)] = format;
+                    } else {
+                        corrupt = record;
+                    }
+                }
+                break;
+            }
+
+            case VVLogRecordTypeMessage:
+            case VVLogRecordTypeText: {
+                uint8_t flag = 0;
+                if (type == VVLogRecordTypeMessage) {
+                    complete = VVLogRecordReadVarint(&cursor, end, &identifier);
+                }
+                complete = complete && cursor < end;
+                if (complete) {
+                    flag = *cursor++;
+                    complete = VVLogRecordReadVarint(&cursor, end, &milliseconds)
+                        && VVLogRecordReadBytes(&cursor, end, &bytes, &length);
+                }
+                if (!complete) {
+                    break;
+                }
+
+                NSString *message;
+                if (type == VVLogRecordTypeMessage) {
+                    VVLogRecordFormat *format = callSites[@(identifier)];
+                    message = [format stringWithArguments:[NSData dataWithBytesNoCopy:(void *)bytes length:length freeWhenDone:NO]];
+                } else {
+                    message = VVLogRecordStringWithBytes(bytes, length);
+                }
+                if (!message) {
+                    corrupt = record;
+                    break;
+                }
+
+                NSDate *date = [NSDate dateWithTimeIntervalSince1970:(NSTimeInterval)milliseconds / 1000];
+                [text appendString:[dateFormatter stringFromDate:date]];
+                [text appendFormat:@"[%c] ", [self levelForFlag:flag]];
+                [text appendString:message];
+                if (![message hasSuffix:@"\n"]) {
+                    [text appendString:@"\n"];
+                }
+                break;
+            }
+
+            default:
+                corrupt = record;
+                break;
+        }
+
+        if (!complete) {
+            // Cut short by a crash while it was written
+            break;
+        }
+    }
+
+    if (corrupt) {
+        [text appendFormat:@"<%lu undecodable bytes at offset %lu>\n",
+            (unsigned long)(end - corrupt), (unsigned long)(corrupt - start)];
+    }
+
+    return text;
+}
+
++ (char)levelForFlag:(uint8_t)flag {
+    // VVLogFlag values
+    switch (flag) {
+        case 1 << 0: return 'E';
+        case 1 << 1: return 'W';
+        case 1 << 2: return 'I';
+        case 1 << 3: return 'D';
+        default:     return 'V';
+    }
+}
+
+@end
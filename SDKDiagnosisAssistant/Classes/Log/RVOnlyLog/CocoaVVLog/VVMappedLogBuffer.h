@@ -0,0 +1,67 @@
+//
+//  VVMappedLogBuffer.h
+//  CocoaVVLog
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * A fixed-size append buffer backed by a memory-mapped file.
+ *
+ * Appending is a `memcpy` into shared pages, no system call. The pages belong to the file,
+ * so whatever was appended survives the process being killed or crashing (not a kernel panic
+ * or power loss), and is found again by the next instance opened on the same path.
+ *
+ * The first page of the file is a header holding the used length, the name of the log file
+ * the bytes belong to and when they were appended. Bytes of one log file only: the owner empties the buffer before the
+ * log file changes.
+ *
+ * Not thread safe, VVFileLogger uses it on its logger queue.
+ **/
+@interface VVMappedLogBuffer : NSObject
+
+/**
+ * Maps the buffer file at `path`, creating it if needed.
+ * If the file holds bytes left by a previous process, they are kept, and so is its capacity
+ * until the buffer is emptied; the owner should write them out and reopen with `capacity`.
+ * Returns nil if the file can not be created, sized or mapped.
+ **/
+- (nullable instancetype)initWithPath:(NSString *)path capacity:(NSUInteger)capacity NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@property (nonatomic, copy, readonly) NSString *path;
+
+/// Bytes the buffer can hold
+@property (nonatomic, readonly) NSUInteger capacity;
+
+/// Bytes currently held
+@property (nonatomic, readonly) NSUInteger length;
+
+/// Name of the log file the held bytes belong to, nil if empty
+@property (nonatomic, copy, readonly, nullable) NSString *fileName;
+
+/// Timestamps (seconds since 1970) of the first and last append, 0 if empty or unknown
+@property (nonatomic, readonly) NSTimeInterval firstTimestamp;
+@property (nonatomic, readonly) NSTimeInterval lastTimestamp;
+
+/**
+ * Appends `data`, remembering `fileName` if the buffer was empty.
+ * Returns NO, leaving the buffer untouched, if `data` does not fit.
+ **/
+- (BOOL)appendData:(NSData *)data fileName:(NSString *)fileName timestamp:(NSTimeInterval)timestamp;
+
+/// The held bytes without copying. Only valid until the next append or reset.
+- (NSData *)bufferedData;
+
+/// Empties the buffer
+- (void)reset;
+
+@end
+
+NS_ASSUME_NONNULL_END
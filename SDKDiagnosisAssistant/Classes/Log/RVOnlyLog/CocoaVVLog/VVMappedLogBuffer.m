@@ -0,0 +1,203 @@
+//
+//  VVMappedLogBuffer.m
+//  CocoaVVLog
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+
+#if !__has_feature(objc_arc)
+#error This file must be compiled with ARC. Use -fobjc-arc flag (or convert project to ARC).
+#endif
+
+#import "VVMappedLogBuffer.h"
+
+#import <fcntl.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import <unistd.h>
+
+static uint32_t const kVVMappedLogBufferMagic      = 0x424d5656; // "VVMB"
+static uint32_t const kVVMappedLogBufferVersion    = 2;
+// Version 1 had no timestamps, its leftover is kept and migrated in place
+static uint32_t const kVVMappedLogBufferVersion1   = 1;
+static size_t   const kVVMappedLogBufferHeaderSize = 4096;
+static size_t   const kVVMappedLogBufferMaxName    = 255;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    uint64_t length;
+    uint32_t fileNameLength;
+    char     fileName[kVVMappedLogBufferMaxName + 1];
+    // Since version 2
+    double   firstTimestamp;
+    double   lastTimestamp;
+} VVMappedLogBufferHeader;
+
+_Static_assert(sizeof(VVMappedLogBufferHeader) <= kVVMappedLogBufferHeaderSize, "Header must fit its page");
+
+@interface VVMappedLogBuffer () {
+    void *_map;
+    size_t _mapLength;
+    VVMappedLogBufferHeader *_header;
+    uint8_t *_bytes;
+}
+
+@end
+
+@implementation VVMappedLogBuffer
+
+- (instancetype)initWithPath:(NSString *)path capacity:(NSUInteger)capacity {
+    if ((self = [super init])) {
+        _path = [path copy];
+
+        int fd = open(path.fileSystemRepresentation, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return nil;
+        }
+
+        // Keep bytes a previous process left behind, at the capacity they were written with
+        struct stat st = { 0 };
+        VVMappedLogBufferHeader header = { 0 };
+        BOOL hasLeftover = NO;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            return nil;
+        }
+        if ((size_t)st.st_size >= kVVMappedLogBufferHeaderSize
+            && pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header)) {
+            hasLeftover = (header.magic == kVVMappedLogBufferMagic
+                           && (header.version == kVVMappedLogBufferVersion || header.version == kVVMappedLogBufferVersion1)
+                           && header.length > 0
+                           && header.length <= header.capacity
+                           && header.fileNameLength <= kVVMappedLogBufferMaxName
+                           && (uint64_t)st.st_size == kVVMappedLogBufferHeaderSize + header.capacity);
+        }
+
+        size_t mapCapacity = hasLeftover ? (size_t)header.capacity : capacity;
+        _mapLength = kVVMappedLogBufferHeaderSize + mapCapacity;
+
+        // A file of the right size was fully written when it was created
+        BOOL needsAllocation = !hasLeftover && (uint64_t)st.st_size != _mapLength;
+        if (needsAllocation && ![self allocateFile:fd length:_mapLength]) {
+            close(fd);
+            return nil;
+        }
+
+        _map = mmap(NULL, _mapLength, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (_map == MAP_FAILED) {
+            _map = NULL;
+            return nil;
+        }
+
+        _header = (VVMappedLogBufferHeader *)_map;
+        _bytes = (uint8_t *)_map + kVVMappedLogBufferHeaderSize;
+        _capacity = mapCapacity;
+
+        if (hasLeftover && _header->version == kVVMappedLogBufferVersion1) {
+            // Timestamps were not recorded, 0 means unknown
+            _header->firstTimestamp = 0;
+            _header->lastTimestamp = 0;
+            _header->version = kVVMappedLogBufferVersion;
+        }
+
+        if (hasLeftover) {
+            _fileName = [[NSString alloc] initWithBytes:_header->fileName
+                                                 length:_header->fileNameLength
+                                               encoding:NSUTF8StringEncoding];
+        } else {
+            _header->magic = kVVMappedLogBufferMagic;
+            _header->version = kVVMappedLogBufferVersion;
+            _header->capacity = mapCapacity;
+            [self reset];
+        }
+    }
+
+    return self;
+}
+
+- (void)dealloc {
+    if (_map) {
+        munmap(_map, _mapLength);
+    }
+}
+
+/// Resizes the file and writes every page once, so a full disk fails here instead of faulting later on a store.
+- (BOOL)allocateFile:(int)fd length:(size_t)length {
+    if (ftruncate(fd, 0) != 0) {
+        return NO;
+    }
+
+    static char const zeros[64 * 1024];
+    size_t offset = 0;
+    while (offset < length) {
+        size_t chunk = MIN(sizeof(zeros), length - offset);
+        ssize_t written = pwrite(fd, zeros, chunk, (off_t)offset);
+        if (written <= 0) {
+            return NO;
+        }
+        offset += (size_t)written;
+    }
+
+    return YES;
+}
+
+- (NSUInteger)length {
+    return (NSUInteger)_header->length;
+}
+
+- (NSTimeInterval)firstTimestamp {
+    return _header->length > 0 ? _header->firstTimestamp : 0;
+}
+
+- (NSTimeInterval)lastTimestamp {
+    return _header->length > 0 ? _header->lastTimestamp : 0;
+}
+
+- (BOOL)appendData:(NSData *)data fileName:(NSString *)fileName timestamp:(NSTimeInterval)timestamp {
+    NSUInteger length = data.length;
+    uint64_t used = _header->length;
+
+    if (length > _capacity - used) {
+        return NO;
+    }
+
+    if (used == 0) {
+        NSAssert(fileName.length > 0, @"Buffered bytes must belong to a log file.");
+        NSUInteger nameLength = 0;
+        [fileName getBytes:_header->fileName
+                 maxLength:kVVMappedLogBufferMaxName
+                usedLength:&nameLength
+                  encoding:NSUTF8StringEncoding
+                   options:0
+                     range:NSMakeRange(0, fileName.length)
+            remainingRange:NULL];
+        _header->fileNameLength = (uint32_t)nameLength;
+        _header->firstTimestamp = timestamp;
+        _fileName = [fileName copy];
+    } else {
+        NSAssert([fileName isEqualToString:_fileName], @"Buffer must be emptied before the log file changes.");
+    }
+
+    // Bytes first, then the length covering them
+    [data getBytes:_bytes + used length:length];
+    _header->lastTimestamp = timestamp;
+    _header->length = used + length;
+
+    return YES;
+}
+
+- (NSData *)bufferedData {
+    return [NSData dataWithBytesNoCopy:_bytes length:(NSUInteger)_header->length freeWhenDone:NO];
+}
+
+- (void)reset {
+    _header->length = 0;
+    _header->fileNameLength = 0;
+    _fileName = nil;
+}
+
+@end
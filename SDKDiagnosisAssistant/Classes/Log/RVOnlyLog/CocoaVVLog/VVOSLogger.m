@@ -89,7 +89,7 @@ static VVOSLogger *sharedInstance;
 - (void)logMessage:(VVLogMessage *)logMessage {
 
     if (@available(iOS 10.0, macOS 10.12, tvOS 10.0, watchOS 3.0, *)) {
-        NSString * message = _logFormatter ? [_logFormatter formatLogMessage:logMessage] : logMessage->_message;
+        NSString * message = _logFormatter ? [_logFormatter formatLogMessage:logMessage] : logMessage.message;
         if (message != nil) {
             const char *msg = [message UTF8String];
             __auto_type logger = [self logger];
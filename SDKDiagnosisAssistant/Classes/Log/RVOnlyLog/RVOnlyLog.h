@@ -26,6 +26,14 @@ extern const VVLogLevel vvLogLevel;
 #define NSLogDebug(frmt, ...)       VVLogDebug((frmt), ##__VA_ARGS__)
 #define NSLogVerbose(frmt, ...)     VVLogVerbose((frmt), ##__VA_ARGS__)
 
+// 限流的log：每个调用点单独限流，平均每秒rate条，最多连续burst条，被丢弃的log不会格式化，见VVLogMacros.h
+#define NSLogRVSDKLimited(rate, burst, frmt, ...)   NSLogDebugLimited(rate, burst, (frmt), ##__VA_ARGS__)
+#define NSLogErrorLimited(rate, burst, frmt, ...)   VVLogErrorLimited(rate, burst, (frmt), ##__VA_ARGS__)
+#define NSLogWarnLimited(rate, burst, frmt, ...)    VVLogWarnLimited(rate, burst, (frmt), ##__VA_ARGS__)
+#define NSLogInfoLimited(rate, burst, frmt, ...)    VVLogInfoLimited(rate, burst, (frmt), ##__VA_ARGS__)
+#define NSLogDebugLimited(rate, burst, frmt, ...)   VVLogDebugLimited(rate, burst, (frmt), ##__VA_ARGS__)
+#define NSLogVerboseLimited(rate, burst, frmt, ...) VVLogVerboseLimited(rate, burst, (frmt), ##__VA_ARGS__)
+
 
 //extern NSString *const RVFileLogLevelKey;
 
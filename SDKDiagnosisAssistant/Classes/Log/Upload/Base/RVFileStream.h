@@ -12,9 +12,15 @@
 //#define RVStreamFragmentMaxSize         1024 * 512
 @import CoreGraphics.CGBase;
 @class RVStreamFragment;
+@class RVLogZipSource;
 
 /**
  * 文件流操作类
+ *
+ * 数据来源有两种：
+ * - 文件：按分片大小切好分片，按分片读取文件。文件只读映射，分片数据直接引用映射的内存，可多线程读取
+ * - 压缩包清单(zipSource)：子线程边压缩边切出分片，最多领先读取2片，
+ *   分片按顺序产生，只能用readNextPendingFragment:error:读取，fileSize为已读取的长度，读到最后一片时为压缩包长度
  */
 @interface RVFileStream : NSObject<NSCoding>
 
@@ -28,6 +34,8 @@
 
 /// 文件所在的文件目录
 @property (nonatomic, copy) NSString *filePath;;
+/// 压缩包清单，为nil时数据来源是filePath
+@property (nonatomic, strong, readonly) RVLogZipSource *zipSource;
 /// 包括文件后缀名的文件名
 @property (nonatomic, copy, readonly) NSString *fileName;
 /// 文件大小
@@ -41,10 +49,31 @@
 /// 初始化方法，根据文件路径和上传ID进行分片等处理
 - (instancetype)initWithFilePath:(NSString *)path uploadId:(NSString *)uploadId cutFragmenSize:(CGFloat)cutFragmenSize;
 
-/// 通过分片信息读取对应的片数据
+/// 初始化方法，上传按清单边压缩边生成的压缩包，fileName为压缩包文件名
+- (instancetype)initWithZipSource:(RVLogZipSource *)zipSource fileName:(NSString *)fileName uploadId:(NSString *)uploadId cutFragmenSize:(CGFloat)cutFragmenSize;
+
+/// 数据来源是否还能读取：文件还在，或者清单里的文件都还在
+- (BOOL)isReadable;
+
+/// 按顺序读取下一个未上传成功的分片，需在同一个串行队列调用。
+/// 读完返回nil；读取失败(比如续传时重新生成的数据和上次不一致)返回nil并设置error。
+/// 压缩包清单模式下，下一片还没压缩出来时会等待，不想阻塞队列的话先用isNextFragmentReadyOrNotifyQueue:handler:
+- (NSData *)readNextPendingFragment:(RVStreamFragment **)fragment error:(NSError **)error;
+
+/// readNextPendingFragment:error:是否可以不等待直接返回。
+/// 返回NO时，压缩出下一片或者压缩结束后在queue上调用handler一次(只保留最后一次传入的)，cancelReading后不再调用
+- (BOOL)isNextFragmentReadyOrNotifyQueue:(dispatch_queue_t)queue handler:(dispatch_block_t)handler;
+
+/// 是否是最后一片
+- (BOOL)isLastFragment:(RVStreamFragment *)fragment;
+
+/// 停止读取，结束子线程的压缩
+- (void)cancelReading;
+
+/// 通过分片信息读取对应的片数据，不拷贝，可多线程调用。fragment为nil时释放映射(已读取的数据仍有效)
 - (NSData *)readDataOfFragment:(RVStreamFragment *)fragment;
 
-/// 通过分片信息读取对应的片数据（适应多线程）
+/// 通过分片信息读取对应的片数据（适应多线程），同readDataOfFragment:
 - (NSData *)multiThreadReadDataOfFragment:(RVStreamFragment*)fragment;
 
 @end
@@ -56,4 +85,5 @@
 @property (nonatomic, assign) NSUInteger      size;         // 片的大小
 @property (nonatomic, assign) NSUInteger      offset;       // 片的偏移量
 @property (nonatomic, assign) BOOL            status;       // 上传状态 YES上传成功
+@property (nonatomic, assign) uint32_t        crc32;        // 片数据的CRC32，续传重新生成压缩包时校验，0表示没有记录
 @end
@@ -7,17 +7,138 @@
 //
 
 #import "RVFileStream.h"
+#import "RVLogZipSource.h"
 #import "RVOnlyLog.h"
+#import "vv_mz_crc32.h"
+#import <fcntl.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import <unistd.h>
+
+static NSString *const RVFileStreamErrorDomain = @"RVFileStream";
+/// 压缩包清单模式下，压缩最多领先读取的分片数
+static const NSUInteger RVStreamMaxBufferedParts = 2;
+
+/// 压缩好等待读取的一片
+@interface RVStreamPart : NSObject
+@property (nonatomic, assign) NSUInteger index;
+@property (nonatomic, assign) NSUInteger offset;
+@property (nonatomic, strong) NSData *data;
+@property (nonatomic, assign) uint32_t crc32;
+@property (nonatomic, assign) BOOL isLast;
+@end
+
+@implementation RVStreamPart
+@end
+
+/// 只读映射的文件：分片数据直接引用映射的内存，不拷贝，可多线程读取。
+/// 分片数据都释放后才解除映射，映射失败时用pread读到新分配的内存
+@interface RVMappedFile : NSObject
+- (instancetype)initWithPath:(NSString *)path;
+- (NSData *)dataWithRange:(NSRange)range;
+@end
+
+@implementation RVMappedFile
+{
+    int _fd;
+    void *_map;
+    size_t _mapLength;
+}
+
+- (instancetype)initWithPath:(NSString *)path {
+    if (self = [super init]) {
+        _fd = open(path.fileSystemRepresentation, O_RDONLY | O_CLOEXEC);
+        if (_fd < 0) {
+            return nil;
+        }
+        struct stat st = { 0 };
+        if (fstat(_fd, &st) != 0 || st.st_size <= 0) {
+            close(_fd);
+            _fd = -1;
+            return nil;
+        }
+        _mapLength = (size_t)st.st_size;
+        //上传的压缩包只追加写入后不再修改，映射期间不会被截断
+        _map = mmap(NULL, _mapLength, PROT_READ, MAP_PRIVATE, _fd, 0);
+        if (_map == MAP_FAILED) {
+            _map = NULL;
+            NSLogWarn(@"mmap失败，改用pread errno=%d",errno);
+        } else {
+            close(_fd);
+            _fd = -1;
+        }
+    }
+    return self;
+}
+
+- (void)dealloc {
+    if (_map) {
+        munmap(_map, _mapLength);
+    }
+    if (_fd >= 0) {
+        close(_fd);
+    }
+}
+
+- (NSData *)dataWithRange:(NSRange)range {
+    if (range.length == 0 || NSMaxRange(range) > _mapLength) {
+        return nil;
+    }
+    
+    if (!_map) {
+        NSMutableData *data = [NSMutableData dataWithLength:range.length];
+        if (pread(_fd, data.mutableBytes, range.length, (off_t)range.location) != (ssize_t)range.length) {
+            return nil;
+        }
+        return data;
+    }
+    
+    //提前读入这一片的页，上传时不用逐页缺页等待
+    uint8_t *bytes = (uint8_t *)_map + range.location;
+    [self advise:MADV_WILLNEED bytes:bytes length:range.length];
+    //block持有self，分片数据还在就不会解除映射；释放后归还这一片的页，常驻内存只有上传中的分片
+    return [[NSData alloc] initWithBytesNoCopy:bytes length:range.length deallocator:^(void *viewBytes, NSUInteger viewLength) {
+        [self advise:MADV_DONTNEED bytes:viewBytes length:viewLength];
+    }];
+}
+
+//madvise要求按页对齐
+- (void)advise:(int)advice bytes:(void *)bytes length:(NSUInteger)length {
+    uintptr_t pageSize = (uintptr_t)getpagesize();
+    uintptr_t start = (uintptr_t)bytes & ~(pageSize - 1);
+    uintptr_t end = (uintptr_t)bytes + length;
+    madvise((void *)start, end - start, advice);
+}
+
+@end
+
 #pragma mark - RVFileStreamSeparation
 
 
 @interface RVFileStream ()
 
-@property (nonatomic, strong) NSFileHandle *readFileHandle;//读取处理器
+/// 文件模式下的只读映射，第一次读取时创建，由self加锁保护
+@property (nonatomic, strong) RVMappedFile *mappedFile;
+/// 文件模式下，readNextPendingFragment从这一片开始找
+@property (nonatomic, assign) NSUInteger nextFragmentIndex;
+/// 压缩包清单模式下的最后一片，读到时才知道
+@property (nonatomic, strong) RVStreamFragment *lastFragment;
 
 @end
 
 @implementation RVFileStream
+{
+    /// 以下只在压缩包清单模式使用，_parts等由_partsCondition保护
+    NSCondition *_partsCondition;
+    NSMutableArray<RVStreamPart *> *_parts;
+    BOOL _zipStarted;
+    BOOL _zipFinished;
+    BOOL _readingCancelled;
+    NSError *_zipError;
+    /// 等下一片的通知，由_partsCondition保护
+    dispatch_queue_t _readyQueue;
+    dispatch_block_t _readyHandler;
+}
 
 - (instancetype)initWithFilePath:(NSString *)path uploadId:(NSString *)uploadId cutFragmenSize:(CGFloat)cutFragmenSize {
     
@@ -30,7 +151,6 @@
             return nil;
         }
         
-        _readFileHandle = [NSFileHandle fileHandleForReadingAtPath:path];
         _uploadId = uploadId;
         //分片大小最低128K
         _cutFragmenSize = MAX(cutFragmenSize, 1024*128) ;
@@ -40,6 +160,30 @@
     return self;
 }
 
+- (instancetype)initWithZipSource:(RVLogZipSource *)zipSource fileName:(NSString *)fileName uploadId:(NSString *)uploadId cutFragmenSize:(CGFloat)cutFragmenSize {
+    
+    if (self = [super init]) {
+        
+        if (!zipSource || !uploadId) {
+            return nil;
+        }
+        _zipSource = zipSource;
+        _fileName = [fileName copy];
+        _uploadId = uploadId;
+        //分片大小最低128K
+        _cutFragmenSize = MAX(cutFragmenSize, 1024*128) ;
+        //分片在压缩时产生
+        _streamFragments = @[];
+        [self setupZipReading];
+    }
+    return self;
+}
+
+- (void)setupZipReading {
+    _partsCondition = [[NSCondition alloc] init];
+    _parts = [NSMutableArray array];
+}
+
 //根据文件路径进行设置
 - (BOOL)getFileInfoAtPath:(NSString*)path {
     
@@ -88,54 +232,268 @@
     _streamFragments = fragments;
 }
 
-//通过分片信息读取对应的片数据
+//通过分片信息读取对应的片数据，数据直接引用文件映射，不拷贝，可多线程调用
 - (NSData *)readDataOfFragment:(RVStreamFragment*)fragment {
     
     NSLogDebug(@"fragment=%@",fragment);
     if (!fragment) {
-        if (_readFileHandle) {
-            [_readFileHandle closeFile];
+        //已读取的分片数据不受影响，释放后才解除映射
+        @synchronized (self) {
+            self.mappedFile = nil;
         }
         return nil;
     }
     
-    if (self.readFileHandle==nil) {
-        
-        if(![[NSFileManager defaultManager] fileExistsAtPath:_filePath]) {
-            NSLogInfo(@"readDataOfFragment _filePath 不存在");
-            return nil;
+    RVMappedFile *mappedFile = nil;
+    @synchronized (self) {
+        if (!self.mappedFile) {
+            if(![[NSFileManager defaultManager] fileExistsAtPath:_filePath]) {
+                NSLogInfo(@"readDataOfFragment _filePath 不存在");
+                return nil;
+            }
+            self.mappedFile = [[RVMappedFile alloc] initWithPath:_filePath];
         }
-        self.readFileHandle = [NSFileHandle fileHandleForReadingAtPath:_filePath];
+        mappedFile = self.mappedFile;
     }
-
-    //移动到偏移位置
-    [self.readFileHandle seekToFileOffset:fragment.offset];
-    //从偏移位置开始，读取fragmentSize大小的数据
-    NSData *data = [self.readFileHandle readDataOfLength:fragment.size];
-    return data;
+    
+    return [mappedFile dataWithRange:NSMakeRange(fragment.offset, fragment.size)];
 }
 
 //通过分片信息读取对应的片数据（适应多线程）
 - (NSData *)multiThreadReadDataOfFragment:(RVStreamFragment*)fragment {
     
-    NSLogDebug(@"fragment=%@",fragment);
     if (!fragment) {
         return nil;
     }
+    //共用一个映射，本身就可以多线程读取
+    return [self readDataOfFragment:fragment];
+}
+
+- (BOOL)isReadable {
+    if (_zipSource) {
+        return [_zipSource isReadable];
+    }
+    return [[NSFileManager defaultManager] fileExistsAtPath:_filePath];
+}
+
+- (BOOL)isLastFragment:(RVStreamFragment *)fragment {
+    if (_zipSource) {
+        return fragment == self.lastFragment;
+    }
+    return fragment == _streamFragments.lastObject;
+}
+
+- (NSData *)readNextPendingFragment:(RVStreamFragment **)fragment error:(NSError **)error {
     
-    if(![[NSFileManager defaultManager] fileExistsAtPath:_filePath]) {
-        NSLogInfo(@"readDataOfFragment _filePath 不存在");
+    *fragment = nil;
+    if (!_zipSource) {
+        while (self.nextFragmentIndex < _streamFragments.count) {
+            RVStreamFragment *nextFragment = _streamFragments[self.nextFragmentIndex];
+            self.nextFragmentIndex += 1;
+            if (nextFragment.status) {
+                //已经上传成功的不再处理
+                continue;
+            }
+            NSData *data = [self readDataOfFragment:nextFragment];
+            if (!data && error) {
+                *error = [NSError errorWithDomain:RVFileStreamErrorDomain code:1 userInfo:@{NSLocalizedDescriptionKey:@"读取分片失败"}];
+            }
+            *fragment = nextFragment;
+            return data;
+        }
         return nil;
     }
     
-    // 每个线程新建一个NSFileHandle进行操作
-    NSFileHandle *readFileHandle = [NSFileHandle fileHandleForReadingAtPath:_filePath];
+    if (!_zipStarted) {
+        [self startZipping];
+    }
+    
+    [_partsCondition lock];
+    while (_parts.count == 0 && !_zipFinished) {
+        [_partsCondition wait];
+    }
+    RVStreamPart *part = _parts.firstObject;
+    if (part) {
+        [_parts removeObjectAtIndex:0];
+        [_partsCondition broadcast];
+    }
+    NSError *zipError = _zipError;
+    [_partsCondition unlock];
+    
+    if (!part) {
+        if (zipError && error) {
+            *error = zipError;
+        }
+        return nil;
+    }
+    
+    RVStreamFragment *partFragment = nil;
+    if (part.index < _streamFragments.count) {
+        partFragment = _streamFragments[part.index];
+    } else {
+        //第一次压缩到这一片，新建分片
+        partFragment = [[RVStreamFragment alloc] init];
+        partFragment.status = NO;
+        partFragment.fragmentId = [NSString stringWithFormat:@"%zd",part.index+1];
+        partFragment.offset = part.offset;
+        partFragment.size = part.data.length;
+        _streamFragments = [_streamFragments arrayByAddingObject:partFragment];
+    }
+    partFragment.crc32 = part.crc32;
+    if (part.isLast) {
+        self.lastFragment = partFragment;
+    }
+    _fileSize = MAX(_fileSize, part.offset + part.data.length);
+    
+    *fragment = partFragment;
+    return part.data;
+}
+
+- (BOOL)isNextFragmentReadyOrNotifyQueue:(dispatch_queue_t)queue handler:(dispatch_block_t)handler {
+    
+    if (!_zipSource) {
+        //文件模式直接读映射，不会等待
+        return YES;
+    }
+    if (!_zipStarted) {
+        [self startZipping];
+    }
+    
+    [_partsCondition lock];
+    BOOL isReady = _parts.count > 0 || _zipFinished;
+    if (!isReady && !_readingCancelled) {
+        _readyQueue = queue;
+        _readyHandler = [handler copy];
+    }
+    [_partsCondition unlock];
+    return isReady;
+}
+
+//有新分片或者压缩结束，通知等待的队列，需持有_partsCondition
+- (void)notifyReadyLocked {
+    if (_readyHandler) {
+        dispatch_async(_readyQueue, _readyHandler);
+        _readyHandler = nil;
+        _readyQueue = nil;
+    }
+}
+
+- (void)cancelReading {
+    
+    if (!_zipSource) {
+        @synchronized (self) {
+            self.mappedFile = nil;
+        }
+        return;
+    }
+    [_partsCondition lock];
+    _readingCancelled = YES;
+    [_parts removeAllObjects];
+    _readyHandler = nil;
+    _readyQueue = nil;
+    [_partsCondition broadcast];
+    [_partsCondition unlock];
+}
 
-    //移动到偏移位置
-    [readFileHandle seekToFileOffset:fragment.offset];
-    //从偏移位置开始，读取fragmentSize大小的数据
-    NSData *data = [readFileHandle readDataOfLength:fragment.size];
-    return data;
+#pragma mark - 边压缩边分片
+
+//在子线程按清单压缩，切出的分片交给readNextPendingFragment
+- (void)startZipping {
+    
+    _zipStarted = YES;
+    
+    //已有分片的上传状态和CRC在这里取一份，它们会在读取的队列被修改
+    NSMutableIndexSet *uploadedIndexes = [NSMutableIndexSet indexSet];
+    NSMutableArray<NSNumber *> *knownCrcs = [NSMutableArray arrayWithCapacity:_streamFragments.count];
+    [_streamFragments enumerateObjectsUsingBlock:^(RVStreamFragment *fragment, NSUInteger idx, BOOL *stop) {
+        if (fragment.status) {
+            [uploadedIndexes addIndex:idx];
+        }
+        [knownCrcs addObject:@(fragment.crc32)];
+    }];
+    
+    RVLogZipSource *zipSource = _zipSource;
+    NSUInteger partSize = (NSUInteger)_cutFragmenSize;
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0), ^{
+        [self zipSource:zipSource partSize:partSize knownCrcs:knownCrcs uploadedIndexes:uploadedIndexes];
+    });
+}
+
+- (void)zipSource:(RVLogZipSource *)zipSource partSize:(NSUInteger)partSize knownCrcs:(NSArray<NSNumber *> *)knownCrcs uploadedIndexes:(NSIndexSet *)uploadedIndexes {
+    
+    __block NSMutableData *partData = [NSMutableData dataWithCapacity:partSize];
+    __block NSUInteger index = 0;
+    __block NSUInteger offset = 0;
+    __block NSError *error = nil;
+    
+    //一片交出去，续传时跳过已上传的分片，并校验重新生成的数据和上次相同
+    BOOL (^finishPart)(BOOL) = ^BOOL(BOOL isLast) {
+        uint32_t crc = vv_mz_crc32_update(0, partData.bytes, (int64_t)partData.length);
+        if (index < knownCrcs.count) {
+            uint32_t knownCrc = knownCrcs[index].unsignedIntValue;
+            if (knownCrc != 0 && knownCrc != crc) {
+                error = [NSError errorWithDomain:RVFileStreamErrorDomain code:2 userInfo:@{NSLocalizedDescriptionKey:[NSString stringWithFormat:@"第%zd片和上次生成的不一致",index+1]}];
+                return NO;
+            }
+        }
+        BOOL success = YES;
+        if (![uploadedIndexes containsIndex:index]) {
+            RVStreamPart *part = [[RVStreamPart alloc] init];
+            part.index = index;
+            part.offset = offset;
+            part.data = partData;
+            part.crc32 = crc;
+            part.isLast = isLast;
+            success = [self pushPart:part];
+        }
+        offset += partData.length;
+        index += 1;
+        partData = [NSMutableData dataWithCapacity:partSize];
+        return success;
+    };
+    
+    BOOL success = [zipSource writeArchiveWithHandler:^BOOL(const void *bytes, NSUInteger length) {
+        while (length > 0) {
+            //一片满了还有数据才交出去，这样剩下的就是最后一片
+            if (partData.length == partSize && !finishPart(NO)) {
+                return NO;
+            }
+            NSUInteger appendLength = MIN(length, partSize - partData.length);
+            [partData appendBytes:bytes length:appendLength];
+            bytes = (const uint8_t *)bytes + appendLength;
+            length -= appendLength;
+        }
+        return YES;
+    }];
+    if (success) {
+        success = finishPart(YES);
+    }
+    if (!success && !error) {
+        error = [NSError errorWithDomain:RVFileStreamErrorDomain code:3 userInfo:@{NSLocalizedDescriptionKey:@"压缩失败"}];
+    }
+    
+    [_partsCondition lock];
+    _zipFinished = YES;
+    _zipError = success ? nil : error;
+    [self notifyReadyLocked];
+    [_partsCondition broadcast];
+    [_partsCondition unlock];
+}
+
+//缓存满了就等待读取，停止读取后返回NO
+- (BOOL)pushPart:(RVStreamPart *)part {
+    [_partsCondition lock];
+    while (_parts.count >= RVStreamMaxBufferedParts && !_readingCancelled) {
+        [_partsCondition wait];
+    }
+    BOOL isCancelled = _readingCancelled;
+    if (!isCancelled) {
+        [_parts addObject:part];
+        [self notifyReadyLocked];
+        [_partsCondition broadcast];
+    }
+    [_partsCondition unlock];
+    return !isCancelled;
 }
 
 #pragma mark - NSCoding
@@ -149,6 +507,8 @@
     [aCoder encodeObject:_uploadId forKey:@"uploadId"];
     [aCoder encodeObject:_uploadType forKey:@"uploadType"];
     [aCoder encodeObject:_uploadRelateId forKey:@"uploadRelateId"];
+    [aCoder encodeObject:_zipSource forKey:@"zipSource"];
+    [aCoder encodeObject:[NSNumber numberWithDouble:_cutFragmenSize] forKey:@"cutFragmenSize"];
 }
 
 - (nullable instancetype)initWithCoder:(NSCoder *)aDecoder {
@@ -162,6 +522,13 @@
         _uploadId = [aDecoder decodeObjectForKey:@"uploadId"];
         _uploadType = [aDecoder decodeObjectForKey:@"uploadType"];
         _uploadRelateId = [aDecoder decodeObjectForKey:@"uploadRelateId"];
+        _zipSource = [aDecoder decodeObjectForKey:@"zipSource"];
+        _cutFragmenSize = [[aDecoder decodeObjectForKey:@"cutFragmenSize"] doubleValue];
+        if (_zipSource) {
+            _cutFragmenSize = MAX(_cutFragmenSize, 1024*128);
+            _streamFragments = _streamFragments ?: @[];
+            [self setupZipReading];
+        }
     }
     return self;
 }
@@ -178,6 +545,7 @@
     [aCoder encodeObject:[NSNumber numberWithUnsignedInteger:self.size] forKey:@"size"];
     [aCoder encodeObject:[NSNumber numberWithUnsignedInteger:self.offset] forKey:@"offset"];
     [aCoder encodeObject:[NSNumber numberWithUnsignedInteger:self.status] forKey:@"status"];
+    [aCoder encodeObject:[NSNumber numberWithUnsignedInt:self.crc32] forKey:@"crc32"];
 }
 
 - (nullable instancetype)initWithCoder:(NSCoder *)aDecoder {
@@ -187,6 +555,7 @@
         self.size = [[aDecoder decodeObjectForKey:@"size"] unsignedIntegerValue];
         self.offset = [[aDecoder decodeObjectForKey:@"offset"] unsignedIntegerValue];
         self.status = [[aDecoder decodeObjectForKey:@"status"] boolValue];
+        self.crc32 = [[aDecoder decodeObjectForKey:@"crc32"] unsignedIntValue];
     }
     return self;
 }
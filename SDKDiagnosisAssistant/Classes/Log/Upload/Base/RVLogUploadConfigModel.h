@@ -20,6 +20,7 @@ typedef enum : NSUInteger {
 @property (nonatomic, assign)VVLogLevel logLevel;//默认日志等级为3
 @property (nonatomic, assign)RVLogUploadNetMode mode;//默认上传模式为0
 @property (nonatomic, assign)long long sliceSize;//默认256KB
+@property (nonatomic, assign)NSUInteger uploadWindow;//同时上传的分片数，默认4
 @property (nonatomic, copy)NSString *path;//研发日志路径
 @property (nonatomic, copy)NSString *sign;//研发路径md5值，规则为：md5(gameId+package+model+level+path)
 
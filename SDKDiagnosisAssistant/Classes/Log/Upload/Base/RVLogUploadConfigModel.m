@@ -21,6 +21,7 @@
         _logLevel = VVLogLevelInfo;
         _mode = RVLogUploadNetModeNormal;
         _sliceSize = 256*1024;
+        _uploadWindow = 4;
         _path = nil;
         
         if (![dict isKindOfClass:[NSDictionary class]]) {
@@ -31,6 +32,7 @@
         NSString *mode = dict[@"model"];
         NSString *sliceSize = dict[@"slice"];
         NSString *path = dict[@"path"];
+        NSString *window = dict[@"window"];
 
         //log等级设置
         if (!isStringEmpty(levelStr)) {
@@ -83,6 +85,10 @@
             //后台返回来的单位是K，我们用的单位是B 1K = 1024B
             _sliceSize = sliceSize.longLongValue * 1024;
         }
+        //同时上传分片数设置，1为逐片上传
+        if (!isStringEmpty(window) && window.integerValue > 0) {
+            _uploadWindow = MIN((NSUInteger)window.integerValue, 8);
+        }
         if (!isStringEmpty(path)) {
             _path = path;
         }
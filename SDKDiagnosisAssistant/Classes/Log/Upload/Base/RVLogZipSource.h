@@ -0,0 +1,62 @@
+//
+//  RVLogZipSource.h
+//
+//  Created by Ron-Samkulami on 2023/12/26.
+//  Copyright © 2023 Ron-Samkulami. All rights reserved.
+//  上传的压缩包内容清单：直接读log文件边压缩边上传，不拷贝文件也不落地压缩包
+
+#import <Foundation/Foundation.h>
+#import "VVZipArchive.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// 压缩包里的一个文件
+@interface RVLogZipEntry : NSObject<NSCoding>
+
+/// 文件路径，沙盒内的是相对NSHomeDirectory()的路径(沙盒路径会变化)
+@property (nonatomic, copy, readonly) NSString *relativePath;
+/// 压缩包内的文件名
+@property (nonatomic, copy, readonly) NSString *name;
+/// 加入时的文件长度，只压缩这部分(log文件只会追加)
+@property (nonatomic, assign, readonly) unsigned long long length;
+/// 加入时的修改时间，作为压缩包内的文件时间
+@property (nonatomic, strong, readonly) NSDate *date;
+
+/// 当前沙盒下的绝对路径
+- (NSString *)path;
+
+@end
+
+/**
+ * 压缩包内容清单
+ *
+ * 加入文件时记下长度和时间，之后只压缩这部分，所以同样的清单每次生成的压缩包字节都相同，
+ * 断点续传时重新生成压缩包，跳过已上传的分片即可。
+ * 清单随RVFileStream归档。
+ */
+@interface RVLogZipSource : NSObject<NSCoding>
+
+/// 压缩等级，默认Z_DEFAULT_COMPRESSION
+@property (nonatomic, assign) int compressionLevel;
+/// 文件切成小块多线程压缩，新建的清单为YES。
+/// 之前版本归档的清单为NO，仍然串行压缩，续传时生成的压缩包才和上次相同
+@property (nonatomic, assign) BOOL chunkedDeflate;
+/// 多线程压缩的线程数，0为每个核心一个。线程数不影响生成的压缩包
+@property (nonatomic, assign) NSUInteger deflateThreadCount;
+@property (nonatomic, copy, readonly) NSArray<RVLogZipEntry *> *entries;
+
+/// 加入一个文件，文件不存在或为空时返回NO
+- (BOOL)addFileAtPath:(NSString *)path withName:(NSString *)name;
+
+/// 加入文件夹下的所有文件，压缩包内的文件名为 name/相对路径
+- (void)addContentsOfDirectory:(NSString *)directoryPath withName:(NSString *)name;
+
+/// 清单里的文件都还在且没有变短，才能重新生成同样的压缩包
+- (BOOL)isReadable;
+
+/// 生成压缩包，字节按顺序交给writeHandler，writeHandler返回NO时中止并返回NO
+- (BOOL)writeArchiveWithHandler:(VVZipArchiveWriteHandler)writeHandler;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,188 @@
+//
+//  RVLogZipSource.m
+//
+//  Created by Ron-Samkulami on 2023/12/26.
+//  Copyright © 2023 Ron-Samkulami. All rights reserved.
+//
+
+#import "RVLogZipSource.h"
+#import "VVLogBlockFile.h"
+#import "RVOnlyLog.h"
+#import <zlib.h>
+
+@implementation RVLogZipEntry
+
+- (instancetype)initWithPath:(NSString *)path name:(NSString *)name length:(unsigned long long)length date:(NSDate *)date {
+    if (self = [super init]) {
+        NSString *homePath = [NSHomeDirectory() stringByAppendingString:@"/"];
+        if ([path hasPrefix:homePath]) {
+            _relativePath = [path substringFromIndex:homePath.length];
+        } else {
+            _relativePath = [path copy];
+        }
+        _name = [name copy];
+        _length = length;
+        _date = date;
+    }
+    return self;
+}
+
+- (NSString *)path {
+    if ([_relativePath isAbsolutePath]) {
+        return _relativePath;
+    }
+    return [NSHomeDirectory() stringByAppendingPathComponent:_relativePath];
+}
+
+#pragma mark - NSCoding
+
+- (void)encodeWithCoder:(NSCoder *)aCoder {
+    [aCoder encodeObject:_relativePath forKey:@"relativePath"];
+    [aCoder encodeObject:_name forKey:@"name"];
+    [aCoder encodeObject:[NSNumber numberWithUnsignedLongLong:_length] forKey:@"length"];
+    [aCoder encodeObject:_date forKey:@"date"];
+}
+
+- (nullable instancetype)initWithCoder:(NSCoder *)aDecoder {
+    self = [super init];
+    if (self) {
+        _relativePath = [aDecoder decodeObjectForKey:@"relativePath"];
+        _name = [aDecoder decodeObjectForKey:@"name"];
+        _length = [[aDecoder decodeObjectForKey:@"length"] unsignedLongLongValue];
+        _date = [aDecoder decodeObjectForKey:@"date"];
+    }
+    return self;
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"RVLogZipEntry name=%@,length=%llu,path=%@",_name,_length,_relativePath];
+}
+
+@end
+
+
+@interface RVLogZipSource ()
+
+@property (nonatomic, strong) NSMutableArray<RVLogZipEntry *> *mutableEntries;
+
+@end
+
+@implementation RVLogZipSource
+
+- (instancetype)init {
+    if (self = [super init]) {
+        _compressionLevel = Z_DEFAULT_COMPRESSION;
+        _chunkedDeflate = YES;
+        _mutableEntries = [NSMutableArray array];
+    }
+    return self;
+}
+
+- (NSArray<RVLogZipEntry *> *)entries {
+    return [_mutableEntries copy];
+}
+
+- (BOOL)addFileAtPath:(NSString *)path withName:(NSString *)name {
+    NSDictionary *attr = [[NSFileManager defaultManager] attributesOfItemAtPath:path error:nil];
+    if (!attr || ![attr.fileType isEqualToString:NSFileTypeRegular]) {
+        return NO;
+    }
+    unsigned long long length = attr.fileSize;
+    // 压缩log文件末尾可能有写了一半的块，只算完整的块
+    if ([VVLogBlockFile isBlockFileAtPath:path]) {
+        length = [[VVLogBlockFile alloc] initWithPath:path error:nil].validLength;
+    }
+    if (length == 0) {
+        return NO;
+    }
+    NSDate *date = attr.fileModificationDate ?: [NSDate date];
+    [_mutableEntries addObject:[[RVLogZipEntry alloc] initWithPath:path name:name length:length date:date]];
+    return YES;
+}
+
+- (void)addContentsOfDirectory:(NSString *)directoryPath withName:(NSString *)name {
+    NSFileManager *fileManager = [[NSFileManager alloc] init];
+    // 排序，同样的文件夹每次加入顺序相同
+    NSArray<NSString *> *subpaths = [[fileManager subpathsOfDirectoryAtPath:directoryPath error:nil] sortedArrayUsingSelector:@selector(compare:)];
+    for (NSString *subpath in subpaths) {
+        [self addFileAtPath:[directoryPath stringByAppendingPathComponent:subpath] withName:[name stringByAppendingPathComponent:subpath]];
+    }
+}
+
+- (BOOL)isReadable {
+    if (_mutableEntries.count == 0) {
+        return NO;
+    }
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    for (RVLogZipEntry *entry in _mutableEntries) {
+        NSDictionary *attr = [fileManager attributesOfItemAtPath:entry.path error:nil];
+        if (!attr || attr.fileSize < entry.length) {
+            NSLogInfo(@"文件已经不存在或变短了 %@",entry);
+            return NO;
+        }
+    }
+    return YES;
+}
+
+- (BOOL)writeArchiveWithHandler:(VVZipArchiveWriteHandler)writeHandler {
+    VVZipArchive *zipArchive = [[VVZipArchive alloc] initWithWriteHandler:writeHandler];
+    if (![zipArchive open]) {
+        return NO;
+    }
+    BOOL success = YES;
+    if (_chunkedDeflate) {
+        success = [self writeChunkedEntriesToZipArchive:zipArchive];
+    } else {
+        for (RVLogZipEntry *entry in _mutableEntries) {
+            @autoreleasepool {
+                success = [zipArchive writeFileAtPath:entry.path withFileName:entry.name length:entry.length date:entry.date compressionLevel:_compressionLevel];
+            }
+            if (!success) {
+                NSLogWarn(@"压缩失败 %@",entry);
+                break;
+            }
+        }
+    }
+    // 失败时也要关闭，释放minizip的资源
+    success &= [zipArchive close];
+    return success;
+}
+
+//文件切成小块多线程压缩，按顺序写入
+- (BOOL)writeChunkedEntriesToZipArchive:(VVZipArchive *)zipArchive {
+    NSMutableArray<NSString *> *paths = [NSMutableArray arrayWithCapacity:_mutableEntries.count];
+    NSMutableArray<NSString *> *names = [NSMutableArray arrayWithCapacity:_mutableEntries.count];
+    NSMutableArray<NSNumber *> *lengths = [NSMutableArray arrayWithCapacity:_mutableEntries.count];
+    NSMutableArray<NSDate *> *dates = [NSMutableArray arrayWithCapacity:_mutableEntries.count];
+    for (RVLogZipEntry *entry in _mutableEntries) {
+        [paths addObject:entry.path];
+        [names addObject:entry.name];
+        [lengths addObject:@(entry.length)];
+        [dates addObject:entry.date];
+    }
+    BOOL success = [zipArchive writeFilesAtPaths:paths withFileNames:names lengths:lengths dates:dates compressionLevel:_compressionLevel threadCount:_deflateThreadCount progressHandler:nil];
+    if (!success) {
+        NSLogWarn(@"压缩失败");
+    }
+    return success;
+}
+
+#pragma mark - NSCoding
+
+- (void)encodeWithCoder:(NSCoder *)aCoder {
+    [aCoder encodeObject:_mutableEntries forKey:@"entries"];
+    [aCoder encodeObject:[NSNumber numberWithInt:_compressionLevel] forKey:@"compressionLevel"];
+    [aCoder encodeBool:_chunkedDeflate forKey:@"chunkedDeflate"];
+}
+
+- (nullable instancetype)initWithCoder:(NSCoder *)aDecoder {
+    self = [super init];
+    if (self) {
+        _mutableEntries = [[aDecoder decodeObjectForKey:@"entries"] mutableCopy] ?: [NSMutableArray array];
+        _compressionLevel = [[aDecoder decodeObjectForKey:@"compressionLevel"] intValue];
+        _chunkedDeflate = [aDecoder decodeBoolForKey:@"chunkedDeflate"];
+    }
+    return self;
+}
+
+@end
@@ -9,8 +9,8 @@
 
 #import "AFRVSDKNetworking.h"
 #import "RVResponseParser.h"
-#import "VVZipArchive.h"
 #import "RVFileStream.h"
+#import "RVLogZipSource.h"
 #import "RVLogUploadSettingModel.h"
 #import "RVLogUploadNetManager.h"
 #import "RVLogService.h"
@@ -24,12 +24,27 @@
 static NSString *const RVUploadArchiveName = @"RVLogUploadArchive.archive";
 /// 上传的queue名
 static const char *RVLogUploadQueueName = "com.sdk.log.upload";
+/// 同时上传的分片数据总量上限
+static const long long RVLogUploadMaxInFlightBytes = 16 * 1024 * 1024;
+/// 每片最多上传次数(包括第一次)
+static const int RVLogUploadMaxAttempts = 4;
+/// 重试等待时间的基数和上限，单位秒
+static const NSTimeInterval RVLogUploadRetryBaseDelay = 2;
+static const NSTimeInterval RVLogUploadRetryMaxDelay = 30;
+/// 后台返回token无效
+static const NSInteger RVLogUploadInvalidTokenCode = -10001;
+/// 读取分片数据失败
+static const NSInteger RVLogUploadReadPartErrorCode = -1;
+
+/// 第attempt次失败后的重试等待时间：指数增长，在[上限/2, 上限]之间随机，避免多个分片同时重试
+static NSTimeInterval RVLogUploadRetryDelay(int attempt) {
+    NSTimeInterval ceiling = MIN(RVLogUploadRetryBaseDelay * (1 << MIN(attempt, 16)), RVLogUploadRetryMaxDelay);
+    return ceiling / 2 + ceiling / 2 * arc4random_uniform(1001) / 1000.0;
+}
 
 @interface RVLogUploadManager ()
 /// 文件流处理
 @property (nonatomic, strong) RVFileStream *fileStream;
-/// 信号量
-@property (nonatomic, strong) dispatch_semaphore_t semaphore;
 /// 串行队列
 @property (nonatomic, strong) dispatch_queue_t queue;
 /// 是否正在运行
@@ -44,15 +59,32 @@ static const char *RVLogUploadQueueName = "com.sdk.log.upload";
 /// 上传文件关联的单据ID
 @property (nonatomic, strong) NSString *uploadRelateId;
 
+/// 以下上传状态只在queue上读写
+/// 同时上传的分片数
+@property (nonatomic, assign) NSUInteger uploadWindow;
+/// 分片是否都已读取
+@property (nonatomic, assign) BOOL isReadFinished;
+/// 是否在等压缩出下一片(不在queue上等，压缩出来后回到queue继续)
+@property (nonatomic, assign) BOOL isWaitingForFragment;
+/// 等其他分片上传成功后再上传的最后一片
+@property (nonatomic, strong) RVStreamFragment *heldLastFragment;
+@property (nonatomic, strong) NSData *heldLastData;
+/// 正在上传(包括等待重试)的分片数
+@property (nonatomic, assign) NSUInteger inFlightCount;
+/// 是否有分片上传失败
+@property (nonatomic, assign) BOOL isFailed;
+/// 第一个失败分片的错误码
+@property (nonatomic, assign) NSInteger failedCode;
+
 /*
  沙盒缓存日志文件目录结构
  RVLog
     upload
-        xx.zip
         xx.archive
-        logs
-            sdklog
-            cplog
+ 
+ 压缩包不落地，上传时直接读log文件边压缩边上传，压缩包内的目录结构
+    sdklog
+    cplog
  */
 
 @end
@@ -245,17 +277,22 @@ static const char *RVLogUploadQueueName = "com.sdk.log.upload";
 - (void)uploadNewLogWithUploadId:(NSString *)uploadId {
     
     NSLogInfo(@"新上传...uploadId=%@",uploadId);
-    //压缩log文件夹
-    NSString *zipPath = [self zipArchiveLogs];
-    if (!zipPath) {
-        NSLogInfo(@"zipPath 不存在");
+    //记下要压缩的log文件，压缩包在上传时生成
+    RVLogZipSource *zipSource = [self zipSourceOfLogs];
+    if (zipSource.entries.count == 0) {
+        NSLogInfo(@"没有需要上传的log文件");
         [self sessionDealloc];
         return;
     }
     
-    //获取文件流(里面有文件信息和分片信息)
+    //压缩包文件名
+    NSDateFormatter *dateFormatter = [NSDateFormatter new];
+    [dateFormatter setDateFormat:@"yyyy.MM.dd-HH.mm.ss"];
+    NSString *fileName = [NSString stringWithFormat:@"%@.zip",[dateFormatter stringFromDate:NSDate.date]];
+    
+    //获取文件流(里面有压缩包清单，分片在压缩时产生)
     long long sliceSize = self.settingModel.config.sliceSize;
-    RVFileStream *fileStream = [[RVFileStream alloc] initWithFilePath:zipPath uploadId:uploadId cutFragmenSize:sliceSize];
+    RVFileStream *fileStream = [[RVFileStream alloc] initWithZipSource:zipSource fileName:fileName uploadId:uploadId cutFragmenSize:sliceSize];
     if (!fileStream) {
         [self sessionDealloc];
         return;
@@ -273,93 +310,19 @@ static const char *RVLogUploadQueueName = "com.sdk.log.upload";
     [self uploadFileDataInQueue];
 }
 
-//压缩RVLog/upload/logs文件夹，logs文件夹里面有SDK和研发的log文件
-- (NSString *)zipArchiveLogs {
-    
-    //拷贝SDK的log
-    [self copySDKLog];
-    
-    //拷贝研发的log
-    [self copyCPLog];
-
-    
-    //【upload】文件夹所在的路径
-    NSFileManager *fileMgr = [NSFileManager defaultManager];
-    NSString *uploadDir = [self getUploadDirPath];
-    if (![fileMgr fileExistsAtPath:uploadDir]) {
-        NSLogInfo(@"upload文件夹不存在");
-        return nil;
-    }
-    //需要处理的【logs】文件夹所在的路径
-    NSString *logsDirPath = [self getUploadLogsDirPath];;
-    if (![fileMgr fileExistsAtPath:logsDirPath]) {
-        NSLogInfo(@"logs文件夹不存在");
-        return nil;
-    }
-    
-    //压缩包文件路径
-    NSDateFormatter *dateFormatter = [NSDateFormatter new];
-    [dateFormatter setDateFormat:@"yyyy.MM.dd-HH.mm.ss"];
-    NSString *dateString = [dateFormatter stringFromDate:NSDate.date];
-    NSString *zipPath = [[self getUploadDirPath] stringByAppendingFormat:@"/%@.zip",dateString];
-    
-    
-    BOOL success = NO;
-    NSString *beforeSizeStr = nil;
-    NSString *afterSizeStr = nil;
-    
-    
-    //=====压缩整个logs文件夹======
-    //显示处理前文件大小
-    beforeSizeStr = [self getFileSizeStrWithPath:logsDirPath];
-    NSLogInfo(@"beforeSizeStr=%@",beforeSizeStr);
-    //压缩整个logs文件夹
-    success = [VVZipArchive createZipFileAtPath:zipPath withContentsOfDirectory:logsDirPath];
-    //显示处理后文件大小
-    afterSizeStr = [self getFileSizeStrWithPath:zipPath];
-    NSLogInfo(@"createZip logs success=%d,\n afterSizeStr=%@",success,afterSizeStr);
-    if (success) {
-        return zipPath;
-    }
-
+//要上传的log文件清单：SDK的log放在sdklog，研发的log放在cplog
+- (RVLogZipSource *)zipSourceOfLogs {
     
-    //=====压缩最新的sdklog文件======
-    //文件夹压缩失败后，直接压缩最新的sdklog文件
-    NSArray *logPaths = [RVLogService sharedInstance].filePaths;
-    if (logPaths.count <= 0) {
-        return nil;
-    }
-    NSString *logPath = [logPaths firstObject];
-    //显示处理前文件大小
-    beforeSizeStr = [self getFileSizeStrWithPath:logPath];
-    NSLogInfo(@"beforeSizeStr=%@",beforeSizeStr);
-    //压缩最新的log文件
-    success = [VVZipArchive createZipFileAtPath:zipPath withFilesAtPaths:@[logPath]];
-    //显示处理后文件大小
-    afterSizeStr = [self getFileSizeStrWithPath:zipPath];
-    NSLogInfo(@"createZip log success=%d,\n afterSizeStr=%@",success,afterSizeStr);
-    if (success) {
-        return zipPath;
-    }
+    RVLogZipSource *zipSource = [[RVLogZipSource alloc] init];
     
+    //SDK的log
+    [self addSDKLogToZipSource:zipSource];
     
-    //=====拷贝最新的sdklog文件======
-    //文件压缩也失败，直接拷贝最新的sdklog文件进行上传
-    NSString *logFileName = [logPath lastPathComponent];
-    NSString *desLogPath = [uploadDir stringByAppendingPathComponent:logFileName];
-    //显示处理后文件大小
-    afterSizeStr = [self getFileSizeStrWithPath:desLogPath];
-    NSLogInfo(@"copy log success=%d,\n afterSizeStr=%@",success,afterSizeStr);
-    //拷贝log文件
-    success = [[NSFileManager defaultManager] copyItemAtPath:logPath toPath:desLogPath error:nil];
-    if (success) {
-        return desLogPath;
-    }
-    
+    //研发的log
+    [self addCPLogToZipSource:zipSource];
     
-    //所有方式都失败
-    NSLogWarn(@"zip failed!");
-    return nil;
+    NSLogInfo(@"压缩包文件数=%zd",zipSource.entries.count);
+    return zipSource;
 }
 
 #pragma mark - 继续上次的上传
@@ -406,21 +369,17 @@ static const char *RVLogUploadQueueName = "com.sdk.log.upload";
 //文件上传操作
 - (void)uploadFileDataInQueue {
     
-    if (self.semaphore == nil) {
-        //用来限制并发个数，目前是限制为一个
-        self.semaphore = dispatch_semaphore_create(0);
-    }
     if (!_queue) {
         _queue = dispatch_queue_create(RVLogUploadQueueName, NULL);
     }
     dispatch_async(_queue, ^{
-        //需要在独立的queue上传，不影响主线程。而且semaphore也不能在主线程使用,否则很容易卡线程
+        //需要在独立的queue上传，不影响主线程。上传状态都只在这个queue上修改
         [self uploadLogData];
     });
 }
 
 
-//按顺序一片一片进行上传，不做并发上传
+//多片同时上传，每片完成后补上下一片，分片可以乱序完成
 - (void)uploadLogData {
     
     if ([NSThread isMainThread]) {
@@ -428,86 +387,171 @@ static const char *RVLogUploadQueueName = "com.sdk.log.upload";
         return;
     }
     
-    __block BOOL isFailed = NO;
-    __block BOOL isInvalidToken = NO;
-    
     NSLogDebug(@"fileStream fileSize=%zd",self.fileStream.fileSize);
     
-    int fragmentCount = (int)self.fileStream.streamFragments.count;
-    for (int i=0; i<fragmentCount; i++) {
-        //文件片信息
-        RVStreamFragment *fragment = self.fileStream.streamFragments[i];
-        if (fragment.status) {
-            //已经上传成功的不再处理
-            NSLogDebug(@"i=%d,fragmentStatus == YES",i);
-            continue;
+    //同时上传的分片数，分片数据都在内存里，按分片大小限制总量
+    long long sliceSize = MAX((long long)self.fileStream.cutFragmenSize, 1);
+    NSUInteger maxWindowForMemory = (NSUInteger)MAX(RVLogUploadMaxInFlightBytes / sliceSize, 1);
+    self.uploadWindow = MAX(MIN(self.settingModel.config.uploadWindow, maxWindowForMemory), 1);
+    
+    self.inFlightCount = 0;
+    self.isReadFinished = NO;
+    self.isWaitingForFragment = NO;
+    self.isFailed = NO;
+    self.failedCode = 0;
+    
+    NSLogInfo(@"同时上传数=%zd",self.uploadWindow);
+    [self fillUploadWindow];
+}
+
+//补满上传窗口，全部结束后收尾
+- (void)fillUploadWindow {
+    
+    while (!self.isFailed && !self.isReadFinished && !self.heldLastFragment && !self.isWaitingForFragment && self.inFlightCount < self.uploadWindow) {
+        //下一片还没压缩出来时不在queue上等，以免上传回调排在后面，压缩出来后再回来补
+        RVFileStream *fileStream = self.fileStream;
+        BOOL isReady = [fileStream isNextFragmentReadyOrNotifyQueue:self.queue handler:^{
+            if (self.fileStream != fileStream || !self.isWaitingForFragment) {
+                return;
+            }
+            self.isWaitingForFragment = NO;
+            [self fillUploadWindow];
+        }];
+        if (!isReady) {
+            self.isWaitingForFragment = YES;
+            break;
         }
-        @autoreleasepool {
-            //根据文件片信息来读取文件数据流(通过offset+size来定位)
-            NSData *partData = [self.fileStream readDataOfFragment:fragment];
-            
-            if (!partData) {
-                NSLogWarn(@"partData为空");
-                [self removeUploadFileCache];
-                isFailed = YES;
-                break;
+        //按顺序读取下一片(通过offset+size定位，或者边压缩边产生)，重试时复用
+        RVStreamFragment *fragment = nil;
+        NSError *error = nil;
+        NSData *partData = [self.fileStream readNextPendingFragment:&fragment error:&error];
+        if (!partData) {
+            if (error) {
+                NSLogWarn(@"partData为空 error=%@",error);
+                [self markUploadFailedWithCode:RVLogUploadReadPartErrorCode];
             }
-            NSString *uploadId = self.fileStream.uploadId;
-            NSString *partNum = fragment.fragmentId;
-            NSString *isLast = (i==(fragmentCount-1))?@"1":@"0";
-            NSString *fileSize = [NSString stringWithFormat:@"%zd",self.fileStream.fileSize];
-            NSString *fileName = self.fileStream.fileName;
-            // 上传类型和关联ID
-            LogUploadType uploadType = self.fileStream.uploadType;
-            NSString *uploadRelateId = self.fileStream.uploadRelateId;
-            
-            NSString *token = self.settingModel.token;
-            
-            //使用网络库上传，如果网络失败，会延时重试两次
-            [self uploadPartData:partData uploadId:uploadId partNumber:partNum token:token isLast:isLast size:fileSize fileName:fileName currentRepeatTimes:0 uploadType:uploadType uploadRelateId:uploadRelateId success:^(NSDictionary * _Nonnull result) {
+            self.isReadFinished = YES;
+            break;
+        }
+        //最后一片带isLast，后台收到后会合并文件，要等其他分片都成功后再传
+        if ([self.fileStream isLastFragment:fragment] && self.inFlightCount > 0) {
+            self.heldLastFragment = fragment;
+            self.heldLastData = partData;
+            break;
+        }
+        self.inFlightCount += 1;
+        [self uploadFragment:fragment partData:partData attempt:0];
+    }
+    
+    if (self.heldLastFragment && self.inFlightCount == 0 && !self.isFailed) {
+        RVStreamFragment *fragment = self.heldLastFragment;
+        NSData *partData = self.heldLastData;
+        self.heldLastFragment = nil;
+        self.heldLastData = nil;
+        self.inFlightCount += 1;
+        [self uploadFragment:fragment partData:partData attempt:0];
+    }
+    
+    //失败时不用再等压缩，收尾时会停止压缩
+    if (self.inFlightCount == 0 && (!self.isWaitingForFragment || self.isFailed)) {
+        self.isWaitingForFragment = NO;
+        [self finishUploadLogData];
+    }
+}
 
-                NSLogDebug(@"uploadPartData success=%@",result);
-                fragment.status = YES;
-                //上传配置保存到本地
-                [self archiveUploadFileStream];
-                
-                //通过semaphore来控制每次只上传一片，可以继续下一片了
-                dispatch_semaphore_signal(self.semaphore);
-
-            } failure:^(NSInteger code, NSString * _Nullable msg) {
-                NSLogInfo(@"uploadPartData error code=%zd,msg=%@",code,msg);
-                
-                isFailed = YES;
-                if (code == NETWORK_ERR_CODE) {
-                    //网络不删除文件缓存
-                } else if (code == -10001) {
-                    //-10001代表token无效，需要重新申请token
-                    isInvalidToken = YES;
-                    NSLogInfo(@"code == -10001");
-                } else {
-                    //除了上面的情况，其他失败都删除文件缓存，避免一直失败
-                    [self removeUploadFileCache];
-                }
-                
-                //通过semaphore来控制每次只上传一片，可以进行后面的操作了(就是break操作)
-                dispatch_semaphore_signal(self.semaphore);
-            }];
+//上传一片，网络失败时按指数退避重试，回调都切回上传queue
+- (void)uploadFragment:(RVStreamFragment *)fragment partData:(NSData *)partData attempt:(int)attempt {
+    
+    NSString *uploadId = self.fileStream.uploadId;
+    NSString *partNum = fragment.fragmentId;
+    BOOL isLastFragment = [self.fileStream isLastFragment:fragment];
+    NSString *isLast = isLastFragment?@"1":@"0";
+    //文件总大小：边压缩边上传时读到最后一片才知道，只随最后一片上传(它等其他分片都成功后才上传)，其他分片不传
+    NSString *fileSize = nil;
+    if (isLastFragment || !self.fileStream.zipSource) {
+        fileSize = [NSString stringWithFormat:@"%zd",self.fileStream.fileSize];
+    }
+    NSString *fileName = self.fileStream.fileName;
+    // 上传类型和关联ID
+    LogUploadType uploadType = self.fileStream.uploadType;
+    NSString *uploadRelateId = self.fileStream.uploadRelateId;
+    
+    NSString *token = self.settingModel.token;
+    dispatch_queue_t queue = self.queue;
+    
+    NSLogInfo(@"uploadPartData partNum=%@,attempt=%d",partNum,attempt);
+    [[RVLogUploadNetManager sharedManager] uploadPartData:partData uploadId:uploadId partNumber:partNum token:token isLast:isLast size:fileSize fileName:fileName uploadType:uploadType uploadRelateId:uploadRelateId success:^(NSDictionary * _Nonnull result) {
+        dispatch_async(queue, ^{
+            NSLogDebug(@"uploadPartData success partNum=%@,result=%@",partNum,result);
+            fragment.status = YES;
+            //每片完成都保存到本地，断点续传时只传未完成的分片
+            [self archiveUploadFileStream];
             
-            //通过semaphore来控制每次只上传一片，这里进行堵塞
-            dispatch_semaphore_wait(self.semaphore, DISPATCH_TIME_FOREVER);
+            self.inFlightCount -= 1;
+            [self fillUploadWindow];
+        });
+        
+    } failure:^(NSInteger code, NSString * _Nullable msg) {
+        dispatch_async(queue, ^{
+            NSLogInfo(@"uploadPartData error partNum=%@,code=%zd,msg=%@",partNum,code,msg);
             
-            if (isFailed) {
-                //为什么要加这玩意？因为在上传的block里面用break无效。。。
-                NSLogInfo(@"上传失败了，不再处理");
-                break;
+            //网络失败的话延迟重试，其他分片已经失败时不再重试
+            if (code == NETWORK_ERR_CODE && !self.isFailed && attempt + 1 < RVLogUploadMaxAttempts) {
+                NSTimeInterval delay = RVLogUploadRetryDelay(attempt);
+                NSLogInfo(@"partNum=%@ %.1fs后重试",partNum,delay);
+                dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), queue, ^{
+                    //等待期间其他分片失败了，不再重试，按结束处理
+                    if (self.isFailed) {
+                        self.inFlightCount -= 1;
+                        [self fillUploadWindow];
+                        return;
+                    }
+                    [self uploadFragment:fragment partData:partData attempt:attempt + 1];
+                });
+                return;
             }
-        }
+            
+            [self markUploadFailedWithCode:code];
+            self.inFlightCount -= 1;
+            [self fillUploadWindow];
+        });
+    }];
+}
+
+//记录第一次失败，不再发起新的分片，等正在上传的分片结束
+- (void)markUploadFailedWithCode:(NSInteger)code {
+    if (self.isFailed) {
+        return;
     }
+    self.isFailed = YES;
+    self.failedCode = code;
+}
+
+//所有分片结束后的收尾
+- (void)finishUploadLogData {
+    
+    NSLogInfo(@"完成了上传 isFailed=%d,failedCode=%zd",self.isFailed,self.failedCode);
     
-    NSLogInfo(@"完成了循环");
+    //失败时压缩可能还没结束
+    [self.fileStream cancelReading];
+    
+    //读取失败时去掉研发的log，只重新上传SDK的log
+    if (self.isFailed && self.failedCode == RVLogUploadReadPartErrorCode && [self restartUploadWithSDKLogOnly]) {
+        return;
+    }
     
-    if(!isFailed) {
-        //整个循环顺利走完了，删除文件缓存
+    BOOL isInvalidToken = NO;
+    if (!self.isFailed) {
+        //所有分片都上传成功了，删除文件缓存
+        [self removeUploadFileCache];
+    } else if (self.failedCode == NETWORK_ERR_CODE) {
+        //网络不删除文件缓存
+    } else if (self.failedCode == RVLogUploadInvalidTokenCode) {
+        //-10001代表token无效，需要重新申请token
+        isInvalidToken = YES;
+        NSLogInfo(@"code == -10001");
+    } else {
+        //除了上面的情况，其他失败都删除文件缓存，避免一直失败
         [self removeUploadFileCache];
     }
     
@@ -522,46 +566,47 @@ static const char *RVLogUploadQueueName = "com.sdk.log.upload";
             [self reStartUpload];
         }
     }
-    
 }
 
-//网络上传，网络失败会重试两次
-- (void)uploadPartData:(NSData *)partData
-              uploadId:(NSString *)uploadId
-            partNumber:(NSString *)partNumber
-                 token:(NSString *)token
-                isLast:(NSString *)isLast
-                  size:(NSString *)size
-              fileName:(NSString *)fileName
-     currentRepeatTimes:(int)times
-            uploadType:(LogUploadType)uploadType
-        uploadRelateId:(NSString *)uploadRelateId
-               success:(RVLogUploadSuccess)success
-               failure:(RVLogUploadFailure)failure
-{
-    static int const maxTimes = 3;//一共3次
-    if (times >= maxTimes) {
-        NSLogInfo(@"网络超时超过重试次数，返回失败");
-        if (failure) failure(NETWORK_ERR_CODE,@"网络超时超过重试次数，返回失败");
-        return;
-    }
-    NSLogInfo(@"uploadPartData times=%d",times);
-    [[RVLogUploadNetManager sharedManager] uploadPartData:partData uploadId:uploadId partNumber:partNumber token:token isLast:isLast size:size fileName:fileName uploadType:uploadType uploadRelateId:uploadRelateId success:success failure:^(NSInteger code, NSString * _Nullable msg) {
-        
-        //网络失败的话重试2次
-        if (code == NETWORK_ERR_CODE) {
-            //延迟重试
-            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(5 * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
-                //递归调用
-                [self uploadPartData:partData uploadId:uploadId partNumber:partNumber token:token isLast:isLast size:size fileName:fileName currentRepeatTimes:times+1 uploadType:uploadType uploadRelateId:uploadRelateId success:success failure:failure];
-            });
-            
-        } else {
-            
-            if (failure) failure(code,msg);
+//降级上传：压缩包清单依赖log文件只追加写入，研发的log可能被删除、截断或重写，
+//读到这样的文件时整个压缩包都会失败。这时只用SDK的log重新建清单，同一个uploadId从第一片重新上传。
+//新清单里没有研发的log，再失败就不会再降级
+- (BOOL)restartUploadWithSDKLogOnly {
+    
+    RVFileStream *failedStream = self.fileStream;
+    BOOL hasCPLog = NO;
+    for (RVLogZipEntry *entry in failedStream.zipSource.entries) {
+        if ([entry.name hasPrefix:@"cplog/"]) {
+            hasCPLog = YES;
+            break;
         }
-    }];
+    }
+    if (!hasCPLog) {
+        return NO;
+    }
+    
+    RVLogZipSource *zipSource = [[RVLogZipSource alloc] init];
+    [self addSDKLogToZipSource:zipSource];
+    if (zipSource.entries.count == 0) {
+        NSLogWarn(@"没有SDK的log，不降级上传");
+        return NO;
+    }
     
+    RVFileStream *fileStream = [[RVFileStream alloc] initWithZipSource:zipSource fileName:failedStream.fileName uploadId:failedStream.uploadId cutFragmenSize:failedStream.cutFragmenSize];
+    if (!fileStream) {
+        return NO;
+    }
+    fileStream.uploadType = failedStream.uploadType;
+    fileStream.uploadRelateId = failedStream.uploadRelateId;
+    
+    NSLogWarn(@"研发的log读取失败，只上传SDK的log 文件数=%zd",zipSource.entries.count);
+    self.fileStream = fileStream;
+    self.heldLastFragment = nil;
+    self.heldLastData = nil;
+    //覆盖归档，续传时用新的清单
+    [self archiveUploadFileStream];
+    [self uploadFileDataInQueue];
+    return YES;
 }
 
 #pragma mark - 配置文件操作
@@ -605,12 +650,14 @@ static const char *RVLogUploadQueueName = "com.sdk.log.upload";
         fileSteam = nil;
     } @finally {
         
-        //由于沙盒路径会变化，故重新赋值
-        fileSteam.filePath = [[self getUploadDirPath] stringByAppendingPathComponent:fileSteam.fileName];
+        //由于沙盒路径会变化，故重新赋值(压缩包清单里记的是相对路径)
+        if (!fileSteam.zipSource) {
+            fileSteam.filePath = [[self getUploadDirPath] stringByAppendingPathComponent:fileSteam.fileName];
+        }
         
-        if(![[NSFileManager defaultManager] fileExistsAtPath:fileSteam.filePath]) {
-            //上次压缩的文件已经不存在，删除记录
-            NSLogWarn(@"上次压缩的文件已经不存在");
+        if(![fileSteam isReadable]) {
+            //上次压缩的文件或者要压缩的log已经不存在，删除记录
+            NSLogWarn(@"上次上传的文件已经不存在");
             [self removeUploadFileCache];
             return;
         }
@@ -636,15 +683,8 @@ static const char *RVLogUploadQueueName = "com.sdk.log.upload";
     return uploadDir;
 }
 
-/// 暂时存放log文件的文件夹 upload/logs
-- (NSString *)getUploadLogsDirPath {
-    NSString *uploadDir = [self getUploadDirPath];
-    NSString *uploadLogsDir = [uploadDir stringByAppendingPathComponent:@"logs"];
-    return uploadLogsDir;
-}
-
-/// 拷贝SDK的log
-- (void)copySDKLog {
+/// SDK的log加入压缩包清单
+- (void)addSDKLogToZipSource:(RVLogZipSource *)zipSource {
     
     NSFileManager *fileMgr = [NSFileManager defaultManager];
     //SDK logs文件夹的路径
@@ -653,23 +693,14 @@ static const char *RVLogUploadQueueName = "com.sdk.log.upload";
         NSLogWarn(@"log文件夹不存在");
         return;
     }
-    NSString *uploadLogsDir = [self getUploadLogsDirPath];
-    NSString *sdkUploadPath = [uploadLogsDir stringByAppendingPathComponent:@"sdklog"];
-    if ([fileMgr fileExistsAtPath:sdkUploadPath]) {
-        [fileMgr removeItemAtPath:sdkUploadPath error:nil];
-    }
-    [fileMgr createDirectoryAtPath:uploadLogsDir withIntermediateDirectories:YES attributes:nil error:nil];
-    NSError *error = nil;
-    [fileMgr copyItemAtPath:logsDirPath toPath:sdkUploadPath error:&error];
-    if (error) {
-        NSLogInfo(@"sdkUploadPath error=%@",error);
-        return;
-    }
+    // 缓冲区里的log先写入文件，清单记下此时的文件长度
+    [VVLog flushLog];
+    [zipSource addContentsOfDirectory:logsDirPath withName:@"sdklog"];
 }
 
 
-//拷贝研发的log
-- (void)copyCPLog {
+//研发的log加入压缩包清单
+- (void)addCPLogToZipSource:(RVLogZipSource *)zipSource {
     
     NSFileManager *fileMgr = [NSFileManager defaultManager];
 
@@ -712,30 +743,11 @@ static const char *RVLogUploadQueueName = "com.sdk.log.upload";
         return;
     }
     
-    //删除之前的cplog文件夹及其内容，创建新的文件夹
-    NSString *uploadLogsDir = [self getUploadLogsDirPath];
-    NSString *cpUploadPath = [uploadLogsDir stringByAppendingPathComponent:@"cplog"];
-    if ([fileMgr fileExistsAtPath:cpUploadPath]) {
-        [fileMgr removeItemAtPath:cpUploadPath error:nil];
-    }
-    [fileMgr createDirectoryAtPath:uploadLogsDir withIntermediateDirectories:YES attributes:nil error:nil];
-    
-    //如果拷贝的是一个文件，需要特殊处理
-    if (!isDir) {
-        //创建文件夹
-        [fileMgr createDirectoryAtPath:cpUploadPath withIntermediateDirectories:YES attributes:nil error:nil];
-        //拼接文件路径
-        NSString *logFileName = logsPath.lastPathComponent;
-        cpUploadPath = [cpUploadPath stringByAppendingPathComponent:logFileName];
-    }
-   
-    NSLogDebug(@"cpUploadPath=%@",cpUploadPath);
-    NSError *error = nil;
-    //将logs拷贝到对应路径
-    [fileMgr copyItemAtPath:logsPath toPath:cpUploadPath error:&error];
-    if (error) {
-        NSLogInfo(@"cpUploadPath error=%@",error);
-        return;
+    if (isDir) {
+        [zipSource addContentsOfDirectory:logsPath withName:@"cplog"];
+    } else {
+        //单个文件放在cplog文件夹下
+        [zipSource addFileAtPath:logsPath withName:[@"cplog" stringByAppendingPathComponent:logsPath.lastPathComponent]];
     }
 }
 
@@ -762,7 +774,8 @@ static const char *RVLogUploadQueueName = "com.sdk.log.upload";
     NSEnumerator *e = [sortedPaths objectEnumerator];
     NSString *filename;
     while ((filename = [e nextObject])) {
-        BOOL isLog = [filename hasSuffix:@".txt"] || [filename hasSuffix:@".log"];;
+        BOOL isLog = [filename hasSuffix:@".txt"] || [filename hasSuffix:@".log"] || [filename hasSuffix:@".vvlog"]
+            || [filename hasSuffix:@".logz"] || [filename hasSuffix:@".vvlogz"];
         if (isLog) {
             NSString *path = [rootPath stringByAppendingPathComponent:filename];//由于文件夹是升序排列
             NSLogDebug(@"最新的文件路径=%@",path);
@@ -779,7 +792,8 @@ static const char *RVLogUploadQueueName = "com.sdk.log.upload";
 - (void)sessionDealloc {
     NSLogDebug(@"sessionDealloc");
     _fileStream = nil;
-    _semaphore = NULL;
+    _heldLastFragment = nil;
+    _heldLastData = nil;
     _queue = NULL;
     _isRunning = NO;
     _settingModel = nil;
@@ -787,50 +801,4 @@ static const char *RVLogUploadQueueName = "com.sdk.log.upload";
     _uploadRelateId = nil;
 }
 
-//MARK: - self getFileSizeStrWithPath 公用方法上浮
-//根据传入的文件路径返回显示的字符串 xxB,xxK,,xxM,xxG
-- (NSString *)getFileSizeStrWithPath:(NSString *)path {
-    
-    NSFileManager *fileMgr = [NSFileManager defaultManager];
-    
-    BOOL isDir = NO;
-    NSString *fileSizeStr = @"0B";
-    if(![fileMgr fileExistsAtPath:path isDirectory:&isDir]) {
-        return fileSizeStr;
-    }
-    
-    unsigned long long fileSize = 0;
-    if (!isDir) {
-        //显示文件大小
-        NSDictionary *attr = [[NSFileManager defaultManager] attributesOfItemAtPath:path error:nil];
-        fileSize = attr.fileSize;
-    } else {
-        //我们只算一层的
-        NSArray *subPaths =  [fileMgr subpathsAtPath:path];
-        if (subPaths && subPaths.count > 0) {
-            for (int i=0; i<subPaths.count; i++) {
-                NSString *subPath = [path stringByAppendingPathComponent:subPaths[i]];
-                NSDictionary *attr = [[NSFileManager defaultManager] attributesOfItemAtPath:subPath error:nil];
-                fileSize += attr.fileSize;
-            }
-        }
-    }
-    
-    if (fileSize <= 0) {
-        return fileSizeStr;
-    }
-    
-    CGFloat unitSize = 1000.0f;
-    
-    if (fileSize < unitSize) {
-        fileSizeStr = [NSString stringWithFormat:@"%lldB",fileSize];
-    } else if (fileSize < unitSize*unitSize) {
-        fileSizeStr = [NSString stringWithFormat:@"%fKB",fileSize/unitSize];
-    } else if (fileSize < unitSize*unitSize*unitSize) {
-        fileSizeStr = [NSString stringWithFormat:@"%.2fMB",fileSize/unitSize/unitSize];
-    } else {
-        fileSizeStr = [NSString stringWithFormat:@"%.2fGB",fileSize/unitSize/unitSize/unitSize];
-    }
-    return fileSizeStr;
-}
 @end
@@ -51,7 +51,7 @@ NS_ASSUME_NONNULL_BEGIN
  - partNumber: 分片序号
  - token: 授权token
  - isLast: 是否最后一片
- - size: 分片大小
+ - size: 文件总大小，边压缩边上传时只有最后一片传，其他分片为nil，传空字符串
  - fileName: 文件名
  - uploadType: 上传类型
  - uploadRelateId: 关联单据ID
@@ -26,6 +26,9 @@ typedef NS_ENUM(NSInteger, VVZipArchiveErrorCode) {
 
 @protocol VVZipArchiveDelegate;
 
+/// Receives the bytes of an archive in order as they are made, returns NO to fail the write.
+typedef BOOL (^VVZipArchiveWriteHandler)(const void *bytes, NSUInteger length);
+
 @interface VVZipArchive : NSObject
 
 // Password check
@@ -111,8 +114,21 @@ typedef NS_ENUM(NSInteger, VVZipArchiveErrorCode) {
                         AES:(BOOL)aes
             progressHandler:(void(^ _Nullable)(NSUInteger entryNumber, NSUInteger total))progressHandler;
 
+// compression spread over *threadCount* threads, 0 for one per active core, without password.
+// files are cut into 128 KiB chunks deflated on their own, each primed with the 32 KiB before it (as pigz does):
+// the archive is the same whatever the thread count, and a little larger than a serial one
++ (BOOL)createZipFileAtPath:(NSString *)path
+    withContentsOfDirectory:(NSString *)directoryPath
+        keepParentDirectory:(BOOL)keepParentDirectory
+           compressionLevel:(int)compressionLevel
+                threadCount:(NSUInteger)threadCount
+            progressHandler:(void(^ _Nullable)(NSUInteger entryNumber, NSUInteger total))progressHandler;
+
 - (instancetype)init NS_UNAVAILABLE;
 - (instancetype)initWithPath:(NSString *)path NS_DESIGNATED_INITIALIZER;
+/// writes the archive to *writeHandler* instead of a file: no byte is written twice nor read back,
+/// entries end in data descriptors and the central directory follows the last entry
+- (instancetype)initWithWriteHandler:(VVZipArchiveWriteHandler)writeHandler NS_DESIGNATED_INITIALIZER;
 - (BOOL)open;
 
 /// write empty folder
@@ -121,6 +137,18 @@ typedef NS_ENUM(NSInteger, VVZipArchiveErrorCode) {
 - (BOOL)writeFile:(NSString *)path withPassword:(nullable NSString *)password;
 - (BOOL)writeFileAtPath:(NSString *)path withFileName:(nullable NSString *)fileName withPassword:(nullable NSString *)password;
 - (BOOL)writeFileAtPath:(NSString *)path withFileName:(nullable NSString *)fileName compressionLevel:(int)compressionLevel password:(nullable NSString *)password AES:(BOOL)aes;
+/// write the first *length* bytes of a file dated *date*, the same entry is made again while the file only grows.
+/// a compressed log file is cut after its last block ending within *length*. NO if the file is shorter than *length*
+- (BOOL)writeFileAtPath:(NSString *)path withFileName:(NSString *)fileName length:(unsigned long long)length date:(NSDate *)date compressionLevel:(int)compressionLevel;
+/// write files in order with their chunks deflated ahead on *threadCount* threads, 0 for one per active core.
+/// *lengths* and *dates* as in the method above, nil for whole files and their modification dates. a directory gets an empty folder entry
+- (BOOL)writeFilesAtPaths:(NSArray<NSString *> *)paths
+             withFileNames:(NSArray<NSString *> *)fileNames
+                   lengths:(nullable NSArray<NSNumber *> *)lengths
+                     dates:(nullable NSArray<NSDate *> *)dates
+          compressionLevel:(int)compressionLevel
+               threadCount:(NSUInteger)threadCount
+           progressHandler:(void(^ _Nullable)(NSUInteger entryNumber, NSUInteger total))progressHandler;
 /// write data
 - (BOOL)writeData:(NSData *)data filename:(nullable NSString *)filename withPassword:(nullable NSString *)password;
 - (BOOL)writeData:(NSData *)data filename:(nullable NSString *)filename compressionLevel:(int)compressionLevel password:(nullable NSString *)password AES:(BOOL)aes;
@@ -7,16 +7,30 @@
 //
 
 #import "VVZipArchive.h"
+#import "VVLogBlockFile.h"
 #include "minizip/vv_mz_compat.h"
 #include "minizip/vv_mz_zip.h"
+#include "minizip/vv_mz_strm.h"
+#include "minizip/vv_mz_crc32.h"
 #include <zlib.h>
 #include <sys/stat.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 NSString *const VVZipArchiveErrorDomain = @"VVZipArchiveErrorDomain";
 
 #define CHUNK 16384
 
+// chunks deflated on their own by writeFilesAtPaths:..., each primed with the window before it
+static const NSUInteger kVVZipDeflateChunkLength = 128 * 1024;
+static const NSUInteger kVVZipDeflateDictionaryLength = 32 * 1024;
+
 int _vv_zipOpenEntry(zipFile entry, NSString *name, const zip_fileinfo *zipfi, int level, NSString *password, BOOL aes);
+int _vv_zipOpenRawEntry(zipFile entry, NSString *name, const zip_fileinfo *zipfi);
+zipFile _vv_zipOpenWriteHandler(VVZipArchiveWriteHandler writeHandler);
+NSData *_vv_deflateChunk(const uint8_t *bytes, NSUInteger length, const uint8_t *dictionary, NSUInteger dictionaryLength, int level, BOOL isLast);
+BOOL _vv_preadFully(int fd, void *buffer, size_t length, off_t offset);
 BOOL _vv_fileIsSymbolicLink(const vv_unz_file_info *fileInfo);
 
 #ifndef API_AVAILABLE
@@ -37,10 +51,41 @@ BOOL _vv_fileIsSymbolicLink(const vv_unz_file_info *fileInfo);
 - (instancetype)init NS_DESIGNATED_INITIALIZER;
 @end
 
+/// a chunk of a file deflated on a worker thread, waiting to be written in order
+@interface VVZipDeflateChunk : NSObject
+@property (nonatomic, assign) NSRange range;
+@property (nonatomic, assign) BOOL isLast;
+/// nil when it could not be read or deflated
+@property (nonatomic, strong, nullable) NSData *compressedData;
+@property (nonatomic, assign) uint32_t crc;
+/// signaled once compressedData is set, or the chunk is skipped
+@property (nonatomic, strong) dispatch_semaphore_t done;
+@end
+
+@implementation VVZipDeflateChunk
+@end
+
+/// an entry of writeFilesAtPaths:...
+@interface VVZipParallelEntry : NSObject
+@property (nonatomic, copy) NSString *path;
+@property (nonatomic, copy) NSString *fileName;
+@property (nonatomic, assign) unsigned long long length;
+@property (nonatomic, strong) NSDate *date;
+@property (nonatomic, assign) BOOL isDirectory;
+@property (nonatomic, assign) BOOL isBlockFile;
+/// empty for directories and compressed log files, which are written as they are
+@property (nonatomic, copy) NSArray<VVZipDeflateChunk *> *chunks;
+@end
+
+@implementation VVZipParallelEntry
+@end
+
 @implementation VVZipArchive
 {
     /// path for zip file
     NSString *_path;
+    /// receives the archive instead of _path
+    VVZipArchiveWriteHandler _writeHandler;
     zipFile _zip;
 }
 
@@ -844,6 +889,42 @@ BOOL _vv_fileIsSymbolicLink(const vv_unz_file_info *fileInfo);
     return success;
 }
 
++ (BOOL)createZipFileAtPath:(NSString *)path
+    withContentsOfDirectory:(NSString *)directoryPath
+        keepParentDirectory:(BOOL)keepParentDirectory
+           compressionLevel:(int)compressionLevel
+                threadCount:(NSUInteger)threadCount
+            progressHandler:(void(^ _Nullable)(NSUInteger entryNumber, NSUInteger total))progressHandler {
+    
+    VVZipArchive *zipArchive = [[VVZipArchive alloc] initWithPath:path];
+    BOOL success = [zipArchive open];
+    if (success) {
+        // use a local fileManager (queue/thread compatibility)
+        NSFileManager *fileManager = [[NSFileManager alloc] init];
+        NSArray<NSString *> *allObjects = [fileManager enumeratorAtPath:directoryPath].allObjects;
+        if (keepParentDirectory && !allObjects.count) {
+            allObjects = @[@""];
+        }
+        NSMutableArray<NSString *> *paths = [NSMutableArray arrayWithCapacity:allObjects.count];
+        NSMutableArray<NSString *> *fileNames = [NSMutableArray arrayWithCapacity:allObjects.count];
+        for (NSString *fileName in allObjects) {
+            NSString *fullFilePath = [directoryPath stringByAppendingPathComponent:fileName];
+            
+            BOOL isDir;
+            [fileManager fileExistsAtPath:fullFilePath isDirectory:&isDir];
+            if (isDir && [fileManager enumeratorAtPath:fullFilePath].nextObject) {
+                // only empty directories get an entry
+                continue;
+            }
+            [paths addObject:fullFilePath];
+            [fileNames addObject:keepParentDirectory ? [directoryPath.lastPathComponent stringByAppendingPathComponent:fileName] : fileName];
+        }
+        success &= [zipArchive writeFilesAtPaths:paths withFileNames:fileNames lengths:nil dates:nil compressionLevel:compressionLevel threadCount:threadCount progressHandler:progressHandler];
+        success &= [zipArchive close];
+    }
+    return success;
+}
+
 // disabling `init` because designated initializer is `initWithPath:`
 - (instancetype)init { @throw nil; }
 
@@ -856,11 +937,23 @@ BOOL _vv_fileIsSymbolicLink(const vv_unz_file_info *fileInfo);
     return self;
 }
 
+- (instancetype)initWithWriteHandler:(VVZipArchiveWriteHandler)writeHandler
+{
+    if ((self = [super init])) {
+        _writeHandler = [writeHandler copy];
+    }
+    return self;
+}
+
 
 - (BOOL)open
 {
     NSAssert((_zip == NULL), @"Attempting to open an archive which is already open");
-    _zip = vv_zipOpen(_path.fileSystemRepresentation, APPEND_STATUS_CREATE);
+    if (_writeHandler) {
+        _zip = _vv_zipOpenWriteHandler(_writeHandler);
+    } else {
+        _zip = vv_zipOpen(_path.fileSystemRepresentation, APPEND_STATUS_CREATE);
+    }
     return (NULL != _zip);
 }
 
@@ -896,6 +989,16 @@ BOOL _vv_fileIsSymbolicLink(const vv_unz_file_info *fileInfo);
 {
     NSAssert((_zip != NULL), @"Attempting to write to an archive which was never opened");
     
+    // compressed log files are already deflate, their blocks are copied as they are
+    if (password == nil && compressionLevel != Z_NO_COMPRESSION && [VVLogBlockFile isBlockFileAtPath:path]) {
+        VVLogBlockFile *blockFile = [[VVLogBlockFile alloc] initWithPath:path error:nil];
+        if (blockFile) {
+            zip_fileinfo zipInfo = {};
+            [VVZipArchive zipInfo:&zipInfo setAttributesOfItemAtPath:path];
+            return [self writeLogBlockFile:blockFile blockCount:blockFile.blocks.count withFileName:fileName ?: path.lastPathComponent zipInfo:&zipInfo];
+        }
+    }
+    
     FILE *input = fopen(path.fileSystemRepresentation, "r");
     if (NULL == input) {
         return NO;
@@ -930,6 +1033,257 @@ BOOL _vv_fileIsSymbolicLink(const vv_unz_file_info *fileInfo);
     return error == ZIP_OK;
 }
 
+- (BOOL)writeFileAtPath:(NSString *)path withFileName:(NSString *)fileName length:(unsigned long long)length date:(NSDate *)date compressionLevel:(int)compressionLevel
+{
+    NSAssert((_zip != NULL), @"Attempting to write to an archive which was never opened");
+    
+    zip_fileinfo zipInfo = {};
+    
+    [VVZipArchive zipInfo:&zipInfo setAttributesOfItemAtPath:path];
+    [VVZipArchive zipInfo:&zipInfo setDate:date];
+    
+    if (compressionLevel != Z_NO_COMPRESSION && [VVLogBlockFile isBlockFileAtPath:path]) {
+        VVLogBlockFile *blockFile = [[VVLogBlockFile alloc] initWithPath:path error:nil];
+        if (!blockFile || blockFile.validLength < length) {
+            return NO;
+        }
+        // blocks are only appended, the ones within *length* are those there were then
+        NSUInteger blockCount = 0;
+        for (VVLogBlockInfo *block in blockFile.blocks) {
+            if (block.fileOffset + kVVLogBlockHeaderLength + block.compressedLength > length) {
+                break;
+            }
+            blockCount++;
+        }
+        return [self writeLogBlockFile:blockFile blockCount:blockCount withFileName:fileName zipInfo:&zipInfo];
+    }
+    
+    FILE *input = fopen(path.fileSystemRepresentation, "r");
+    if (NULL == input) {
+        return NO;
+    }
+    
+    void *buffer = malloc(CHUNK);
+    if (buffer == NULL)
+    {
+        fclose(input);
+        return NO;
+    }
+    
+    int error = _vv_zipOpenEntry(_zip, fileName, &zipInfo, compressionLevel, nil, NO);
+    
+    unsigned long long remaining = length;
+    while (error == ZIP_OK && remaining > 0)
+    {
+        unsigned int len = (unsigned int) fread(buffer, 1, (size_t)MIN((unsigned long long)CHUNK, remaining), input);
+        if (len == 0) {
+            // shorter than it was
+            error = ZIP_ERRNO;
+            break;
+        }
+        error = vv_zipWriteInFileInZip(_zip, buffer, len);
+        remaining -= len;
+    }
+    
+    vv_zipCloseFileInZip(_zip);
+    free(buffer);
+    fclose(input);
+    return error == ZIP_OK;
+}
+
+// *fileName* of a compressed log file loses its trailing "z", the entry holds the uncompressed content of its first *blockCount* blocks
+- (BOOL)writeLogBlockFile:(VVLogBlockFile *)blockFile blockCount:(NSUInteger)blockCount withFileName:(NSString *)fileName zipInfo:(const zip_fileinfo *)zipInfo
+{
+    if ([fileName hasSuffix:@"z"]) {
+        fileName = [fileName substringToIndex:fileName.length - 1];
+    }
+    
+    int error = _vv_zipOpenRawEntry(_zip, fileName, zipInfo);
+    if (error != ZIP_OK) {
+        return NO;
+    }
+    
+    BOOL success = YES;
+    uint32_t crc = 0;
+    int64_t uncompressedLength = 0;
+    for (NSUInteger i = 0; i < blockCount && success; i++) {
+        @autoreleasepool {
+            NSData *block = [blockFile compressedDataOfBlockAtIndex:i error:nil];
+            success = block != nil && vv_zipWriteInFileInZip(_zip, block.bytes, (uint32_t)block.length) == ZIP_OK;
+        }
+        VVLogBlockInfo *info = blockFile.blocks[i];
+        crc = vv_mz_crc32_combine(crc, info.crc32, (int64_t)info.uncompressedLength);
+        uncompressedLength += (int64_t)info.uncompressedLength;
+    }
+    // the blocks end in sync flushes, the stream still needs its final block
+    NSData *finalBlock = [VVLogBlockFile finalDeflateBlock];
+    vv_zipWriteInFileInZip(_zip, finalBlock.bytes, (uint32_t)finalBlock.length);
+    
+    error = vv_zipCloseFileInZipRaw64(_zip, uncompressedLength, (uint32_t)crc);
+    return success && error == ZIP_OK;
+}
+
+- (BOOL)writeFilesAtPaths:(NSArray<NSString *> *)paths
+             withFileNames:(NSArray<NSString *> *)fileNames
+                   lengths:(nullable NSArray<NSNumber *> *)lengths
+                     dates:(nullable NSArray<NSDate *> *)dates
+          compressionLevel:(int)compressionLevel
+               threadCount:(NSUInteger)threadCount
+           progressHandler:(void(^ _Nullable)(NSUInteger entryNumber, NSUInteger total))progressHandler
+{
+    NSAssert((_zip != NULL), @"Attempting to write to an archive which was never opened");
+    NSParameterAssert(fileNames.count == paths.count);
+    NSParameterAssert(!lengths || lengths.count == paths.count);
+    NSParameterAssert(!dates || dates.count == paths.count);
+    
+    NSFileManager *fileManager = [[NSFileManager alloc] init];
+    NSMutableArray<VVZipParallelEntry *> *entries = [NSMutableArray arrayWithCapacity:paths.count];
+    for (NSUInteger i = 0; i < paths.count; i++) {
+        NSDictionary *attributes = [fileManager attributesOfItemAtPath:paths[i] error:nil];
+        if (!attributes) {
+            return NO;
+        }
+        VVZipParallelEntry *entry = [[VVZipParallelEntry alloc] init];
+        entry.path = paths[i];
+        entry.fileName = fileNames[i];
+        entry.date = dates[i] ?: attributes.fileModificationDate ?: [NSDate date];
+        entry.isDirectory = [attributes.fileType isEqualToString:NSFileTypeDirectory];
+        entry.isBlockFile = !entry.isDirectory && [VVLogBlockFile isBlockFileAtPath:entry.path];
+        if (lengths) {
+            entry.length = lengths[i].unsignedLongLongValue;
+        } else if (entry.isBlockFile) {
+            // a block being written at the end is left out
+            entry.length = [[VVLogBlockFile alloc] initWithPath:entry.path error:nil].validLength;
+        } else {
+            entry.length = attributes.fileSize;
+        }
+        
+        NSMutableArray<VVZipDeflateChunk *> *chunks = [NSMutableArray array];
+        if (!entry.isDirectory && !entry.isBlockFile) {
+            // an empty file still takes one chunk, its final deflate block
+            unsigned long long offset = 0;
+            do {
+                VVZipDeflateChunk *chunk = [[VVZipDeflateChunk alloc] init];
+                chunk.range = NSMakeRange((NSUInteger)offset, (NSUInteger)MIN((unsigned long long)kVVZipDeflateChunkLength, entry.length - offset));
+                chunk.done = dispatch_semaphore_create(0);
+                [chunks addObject:chunk];
+                offset += chunk.range.length;
+            } while (offset < entry.length);
+            chunks.lastObject.isLast = YES;
+        }
+        entry.chunks = chunks;
+        [entries addObject:entry];
+    }
+    
+    if (threadCount == 0) {
+        threadCount = [NSProcessInfo processInfo].activeProcessorCount;
+    }
+    // chunks being deflated or waiting to be written, which bounds the memory held
+    dispatch_semaphore_t window = dispatch_semaphore_create((long)threadCount * 2);
+    dispatch_semaphore_t workers = dispatch_semaphore_create((long)threadCount);
+    dispatch_queue_t workerQueue = dispatch_get_global_queue(qos_class_self(), 0);
+    __block atomic_bool cancelled = false;
+    
+    // hands chunks to the workers in the order they are written
+    dispatch_async(dispatch_queue_create("com.vvzip.deflate", DISPATCH_QUEUE_SERIAL), ^{
+        for (VVZipParallelEntry *entry in entries) {
+            if (entry.chunks.count == 0) {
+                continue;
+            }
+            // read, not mapped: a log truncated under a mapping would fault the worker touching the lost pages
+            int fd = atomic_load(&cancelled) ? -1 : open(entry.path.fileSystemRepresentation, O_RDONLY);
+            dispatch_group_t readers = dispatch_group_create();
+            for (VVZipDeflateChunk *chunk in entry.chunks) {
+                dispatch_semaphore_wait(window, DISPATCH_TIME_FOREVER);
+                if (fd < 0 || atomic_load(&cancelled)) {
+                    dispatch_semaphore_signal(chunk.done);
+                    continue;
+                }
+                dispatch_semaphore_wait(workers, DISPATCH_TIME_FOREVER);
+                dispatch_group_async(readers, workerQueue, ^{
+                    // each worker reads its chunk with the window before it into a buffer of its own
+                    NSUInteger dictionaryLength = MIN(chunk.range.location, kVVZipDeflateDictionaryLength);
+                    size_t readLength = dictionaryLength + chunk.range.length;
+                    uint8_t *buffer = malloc(MAX(readLength, 1));
+                    if (buffer && _vv_preadFully(fd, buffer, readLength, (off_t)(chunk.range.location - dictionaryLength))) {
+                        const uint8_t *bytes = buffer + dictionaryLength;
+                        chunk.compressedData = _vv_deflateChunk(bytes, chunk.range.length, buffer, dictionaryLength, compressionLevel, chunk.isLast);
+                        chunk.crc = vv_mz_crc32_update(0, bytes, (int64_t)chunk.range.length);
+                    }
+                    // a short read is a file shorter than it was, the chunk is left without data and the entry fails
+                    free(buffer);
+                    dispatch_semaphore_signal(workers);
+                    dispatch_semaphore_signal(chunk.done);
+                });
+            }
+            if (fd >= 0) {
+                dispatch_group_notify(readers, workerQueue, ^{
+                    close(fd);
+                });
+            }
+        }
+    });
+    
+    // writes in order, after a failure it only drains what the feeder hands out
+    BOOL success = YES;
+    NSUInteger complete = 0;
+    for (VVZipParallelEntry *entry in entries) {
+        @autoreleasepool {
+            if (entry.isDirectory) {
+                success = success && [self writeFolderAtPath:entry.path withFolderName:entry.fileName withPassword:nil];
+            } else if (entry.isBlockFile) {
+                success = success && [self writeFileAtPath:entry.path withFileName:entry.fileName length:entry.length date:entry.date compressionLevel:compressionLevel];
+            } else {
+                success = [self writeDeflatedChunksOfEntry:entry window:window write:success] && success;
+            }
+        }
+        if (!success) {
+            atomic_store(&cancelled, true);
+        }
+        if (progressHandler) {
+            complete++;
+            progressHandler(complete, entries.count);
+        }
+    }
+    return success;
+}
+
+// the chunks end in sync flushes but the last, together they make the raw deflate stream of the entry
+- (BOOL)writeDeflatedChunksOfEntry:(VVZipParallelEntry *)entry window:(dispatch_semaphore_t)window write:(BOOL)write
+{
+    int error = ZIP_ERRNO;
+    if (write) {
+        zip_fileinfo zipInfo = {};
+        [VVZipArchive zipInfo:&zipInfo setAttributesOfItemAtPath:entry.path];
+        [VVZipArchive zipInfo:&zipInfo setDate:entry.date];
+        error = _vv_zipOpenRawEntry(_zip, entry.fileName, &zipInfo);
+    }
+    BOOL isOpen = error == ZIP_OK;
+    
+    uint32_t crc = 0;
+    for (VVZipDeflateChunk *chunk in entry.chunks) {
+        dispatch_semaphore_wait(chunk.done, DISPATCH_TIME_FOREVER);
+        if (error == ZIP_OK) {
+            if (chunk.compressedData) {
+                error = vv_zipWriteInFileInZip(_zip, chunk.compressedData.bytes, (uint32_t)chunk.compressedData.length);
+                crc = vv_mz_crc32_combine(crc, chunk.crc, (int64_t)chunk.range.length);
+            } else {
+                error = ZIP_ERRNO;
+            }
+        }
+        chunk.compressedData = nil;
+        dispatch_semaphore_signal(window);
+    }
+    
+    if (isOpen) {
+        int closeError = vv_zipCloseFileInZipRaw64(_zip, (int64_t)entry.length, (uint32_t)crc);
+        if (error == ZIP_OK) {
+            error = closeError;
+        }
+    }
+    return error == ZIP_OK;
+}
+
 - (BOOL)writeData:(NSData *)data filename:(nullable NSString *)filename withPassword:(nullable NSString *)password
 {
     return [self writeData:data filename:filename compressionLevel:Z_DEFAULT_COMPRESSION password:password AES:YES];
@@ -1139,6 +1493,172 @@ int _vv_zipOpenEntry(zipFile entry, NSString *name, const zip_fileinfo *zipfi, i
     return vv_zipOpenNewFileInZip5(entry, name.fileSystemRepresentation, zipfi, NULL, 0, NULL, 0, NULL, Z_DEFLATED, level, 0, -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY, password.UTF8String, aes, made_on_darwin, flag_base, 0);
 }
 
+int _vv_zipOpenRawEntry(zipFile entry, NSString *name, const zip_fileinfo *zipfi)
+{
+    // same entry as _vv_zipOpenEntry without encryption, taking deflated bytes as they are
+    uint16_t made_on_darwin = 19 << 8;
+    uint16_t flag_base = 1 << 11;
+    return vv_zipOpenNewFileInZip5(entry, name.fileSystemRepresentation, zipfi, NULL, 0, NULL, 0, NULL, Z_DEFLATED, Z_DEFAULT_COMPRESSION, 1, -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY, NULL, NO, made_on_darwin, flag_base, 0);
+}
+
+// raw deflate of one chunk primed with the bytes before it, as pigz does: it ends in a sync flush so the next chunk
+// can follow it, the last one ends the stream
+NSData *_vv_deflateChunk(const uint8_t *bytes, NSUInteger length, const uint8_t *dictionary, NSUInteger dictionaryLength, int level, BOOL isLast)
+{
+    z_stream stream = {};
+    if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return nil;
+    }
+    if (dictionaryLength > 0 && deflateSetDictionary(&stream, dictionary, (uInt)dictionaryLength) != Z_OK) {
+        deflateEnd(&stream);
+        return nil;
+    }
+    // deflateBound covers Z_FINISH, a sync flush adds an empty stored block
+    NSMutableData *compressedData = [NSMutableData dataWithLength:deflateBound(&stream, (uLong)length) + 16];
+    stream.next_in = (Bytef *)bytes;
+    stream.avail_in = (uInt)length;
+    stream.next_out = compressedData.mutableBytes;
+    stream.avail_out = (uInt)compressedData.length;
+    int ret = deflate(&stream, isLast ? Z_FINISH : Z_SYNC_FLUSH);
+    BOOL success = isLast ? ret == Z_STREAM_END : (ret == Z_OK && stream.avail_in == 0 && stream.avail_out > 0);
+    compressedData.length = stream.total_out;
+    deflateEnd(&stream);
+    return success ? compressedData : nil;
+}
+
+// pread until *length* bytes are in, NO when the file ends first or on an error
+BOOL _vv_preadFully(int fd, void *buffer, size_t length, off_t offset)
+{
+    while (length > 0) {
+        ssize_t count = pread(fd, buffer, length, offset);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return NO;
+        }
+        buffer = (uint8_t *)buffer + count;
+        length -= (size_t)count;
+        offset += count;
+    }
+    return YES;
+}
+
+#pragma mark - Write handler stream
+
+// forward only: with data descriptors minizip never seeks back while writing, it only asks where it is
+typedef struct {
+    vv_mz_stream stream;
+    void *writeHandler;
+    int64_t position;
+    int32_t isOpen;
+} _vv_write_handler_stream;
+
+static int32_t _vv_write_handler_stream_open(void *stream, const char *path, int32_t mode)
+{
+    ((_vv_write_handler_stream *)stream)->isOpen = 1;
+    return VV_MZ_OK;
+}
+
+static int32_t _vv_write_handler_stream_is_open(void *stream)
+{
+    return ((_vv_write_handler_stream *)stream)->isOpen ? VV_MZ_OK : VV_MZ_OPEN_ERROR;
+}
+
+static int32_t _vv_write_handler_stream_read(void *stream, void *buf, int32_t size)
+{
+    return VV_MZ_READ_ERROR;
+}
+
+static int32_t _vv_write_handler_stream_write(void *stream, const void *buf, int32_t size)
+{
+    _vv_write_handler_stream *handlerStream = (_vv_write_handler_stream *)stream;
+    VVZipArchiveWriteHandler writeHandler = (__bridge VVZipArchiveWriteHandler)handlerStream->writeHandler;
+    if (!writeHandler(buf, (NSUInteger)size)) {
+        return VV_MZ_WRITE_ERROR;
+    }
+    handlerStream->position += size;
+    return size;
+}
+
+static int64_t _vv_write_handler_stream_tell(void *stream)
+{
+    return ((_vv_write_handler_stream *)stream)->position;
+}
+
+static int32_t _vv_write_handler_stream_seek(void *stream, int64_t offset, int32_t origin)
+{
+    _vv_write_handler_stream *handlerStream = (_vv_write_handler_stream *)stream;
+    BOOL staysInPlace = (origin == VV_MZ_SEEK_SET) ? (offset == handlerStream->position) : (offset == 0);
+    return staysInPlace ? VV_MZ_OK : VV_MZ_SEEK_ERROR;
+}
+
+static int32_t _vv_write_handler_stream_close(void *stream)
+{
+    ((_vv_write_handler_stream *)stream)->isOpen = 0;
+    return VV_MZ_OK;
+}
+
+static int32_t _vv_write_handler_stream_error(void *stream)
+{
+    return VV_MZ_OK;
+}
+
+static void *_vv_write_handler_stream_create(void **stream);
+
+static void _vv_write_handler_stream_delete(void **stream)
+{
+    if (stream == NULL) {
+        return;
+    }
+    free(*stream);
+    *stream = NULL;
+}
+
+static vv_mz_stream_vtbl _vv_write_handler_stream_vtbl = {
+    _vv_write_handler_stream_open,
+    _vv_write_handler_stream_is_open,
+    _vv_write_handler_stream_read,
+    _vv_write_handler_stream_write,
+    _vv_write_handler_stream_tell,
+    _vv_write_handler_stream_seek,
+    _vv_write_handler_stream_close,
+    _vv_write_handler_stream_error,
+    _vv_write_handler_stream_create,
+    _vv_write_handler_stream_delete,
+    NULL,
+    NULL
+};
+
+static void *_vv_write_handler_stream_create(void **stream)
+{
+    _vv_write_handler_stream *handlerStream = calloc(1, sizeof(_vv_write_handler_stream));
+    if (handlerStream != NULL) {
+        handlerStream->stream.vtbl = &_vv_write_handler_stream_vtbl;
+    }
+    if (stream != NULL) {
+        *stream = handlerStream;
+    }
+    return handlerStream;
+}
+
+// the archive keeps *writeHandler* alive, vv_zipClose deletes the stream
+zipFile _vv_zipOpenWriteHandler(VVZipArchiveWriteHandler writeHandler)
+{
+    void *stream = NULL;
+    if (vv_mz_stream_create(&stream, &_vv_write_handler_stream_vtbl) == NULL) {
+        return NULL;
+    }
+    ((_vv_write_handler_stream *)stream)->writeHandler = (__bridge void *)writeHandler;
+    vv_mz_stream_open(stream, NULL, VV_MZ_OPEN_MODE_WRITE | VV_MZ_OPEN_MODE_CREATE);
+    
+    zipFile zip = vv_zipOpen_MZ(stream, APPEND_STATUS_CREATE, NULL);
+    if (zip == NULL) {
+        vv_mz_stream_delete(&stream);
+    }
+    return zip;
+}
+
 #pragma mark - Private tools for file info
 
 BOOL _vv_fileIsSymbolicLink(const vv_unz_file_info *fileInfo)
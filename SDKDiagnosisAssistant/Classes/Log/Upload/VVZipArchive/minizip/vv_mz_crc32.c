@@ -0,0 +1,430 @@
+/* vv_mz_crc32.c -- CRC-32 of zip entries
+   part of the MiniZip project
+
+   This program is distributed under the terms of the same license as zlib.
+   See the accompanying LICENSE file for the full text of the license.
+*/
+
+
+#include "vv_mz.h"
+#include "vv_mz_crc32.h"
+
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#  define VV_MZ_CRC32_X86
+#  include <cpuid.h>
+#  include <immintrin.h>
+#elif defined(__aarch64__)
+#  define VV_MZ_CRC32_ARM
+#  include <arm_acle.h>
+#  if defined(__APPLE__)
+#    include <sys/sysctl.h>
+#  elif defined(__linux__)
+#    include <sys/auxv.h>
+#    include <asm/hwcap.h>
+#  endif
+#endif
+
+/***************************************************************************/
+
+#define VV_MZ_CRC32_POLY                (0xedb88320)    /* reflected 0x04c11db7 */
+
+typedef uint32_t (*vv_mz_crc32_kernel)(uint32_t crc, const uint8_t *buf, int64_t size);
+
+static uint32_t vv_mz_crc32_table[8][256];
+/* x^(2^n) mod p, to move a CRC past 2^n zero bits */
+static uint32_t vv_mz_crc32_x2n_table[32];
+static int32_t vv_mz_crc32_selected = VV_MZ_CRC32_KERNEL_SLICE8;
+static vv_mz_crc32_kernel vv_mz_crc32_selected_kernel = NULL;
+static pthread_once_t vv_mz_crc32_once = PTHREAD_ONCE_INIT;
+
+/***************************************************************************/
+
+/* a * b mod p, polynomials in the reflected bit order */
+static uint32_t vv_mz_crc32_multmodp(uint32_t a, uint32_t b)
+{
+    uint32_t m = (uint32_t)1 << 31;
+    uint32_t p = 0;
+
+    for (;;)
+    {
+        if (a & m)
+        {
+            p ^= b;
+            if ((a & (m - 1)) == 0)
+                break;
+        }
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ VV_MZ_CRC32_POLY : b >> 1;
+    }
+    return p;
+}
+
+/* x^(n * 2^k) mod p */
+static uint32_t vv_mz_crc32_x2nmodp(int64_t n, uint32_t k)
+{
+    uint32_t p = (uint32_t)1 << 31;     /* x^0 */
+
+    while (n)
+    {
+        if (n & 1)
+            p = vv_mz_crc32_multmodp(vv_mz_crc32_x2n_table[k & 31], p);
+        n >>= 1;
+        k += 1;
+    }
+    return p;
+}
+
+/***************************************************************************/
+
+static uint32_t vv_mz_crc32_slice8(uint32_t crc, const uint8_t *buf, int64_t size)
+{
+    while (size > 0 && ((uintptr_t)buf & 7) != 0)
+    {
+        crc = vv_mz_crc32_table[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+        size -= 1;
+    }
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    while (size >= 8)
+    {
+        uint32_t one = 0;
+        uint32_t two = 0;
+
+        memcpy(&one, buf, sizeof(one));
+        memcpy(&two, buf + 4, sizeof(two));
+        one ^= crc;
+        crc = vv_mz_crc32_table[7][one & 0xff] ^
+              vv_mz_crc32_table[6][(one >> 8) & 0xff] ^
+              vv_mz_crc32_table[5][(one >> 16) & 0xff] ^
+              vv_mz_crc32_table[4][one >> 24] ^
+              vv_mz_crc32_table[3][two & 0xff] ^
+              vv_mz_crc32_table[2][(two >> 8) & 0xff] ^
+              vv_mz_crc32_table[1][(two >> 16) & 0xff] ^
+              vv_mz_crc32_table[0][two >> 24];
+        buf += 8;
+        size -= 8;
+    }
+#endif
+
+    while (size > 0)
+    {
+        crc = vv_mz_crc32_table[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+        size -= 1;
+    }
+    return crc;
+}
+
+/***************************************************************************/
+
+#if defined(VV_MZ_CRC32_ARM)
+#  if defined(__ARM_FEATURE_CRC32)
+#    define VV_MZ_CRC32_ARM_TARGET
+#  elif defined(__clang__)
+#    define VV_MZ_CRC32_ARM_TARGET __attribute__((target("crc")))
+#  else
+#    define VV_MZ_CRC32_ARM_TARGET __attribute__((target("+crc")))
+#  endif
+
+VV_MZ_CRC32_ARM_TARGET
+static uint32_t vv_mz_crc32_armv8(uint32_t crc, const uint8_t *buf, int64_t size)
+{
+    while (size > 0 && ((uintptr_t)buf & 7) != 0)
+    {
+        crc = __crc32b(crc, *buf++);
+        size -= 1;
+    }
+    /* four independent loads per round keep the load unit ahead of the crc unit */
+    while (size >= 32)
+    {
+        uint64_t words[4];
+
+        memcpy(words, buf, sizeof(words));
+        crc = __crc32d(crc, words[0]);
+        crc = __crc32d(crc, words[1]);
+        crc = __crc32d(crc, words[2]);
+        crc = __crc32d(crc, words[3]);
+        buf += 32;
+        size -= 32;
+    }
+    while (size >= 8)
+    {
+        uint64_t word = 0;
+
+        memcpy(&word, buf, sizeof(word));
+        crc = __crc32d(crc, word);
+        buf += 8;
+        size -= 8;
+    }
+    while (size > 0)
+    {
+        crc = __crc32b(crc, *buf++);
+        size -= 1;
+    }
+    return crc;
+}
+
+static int32_t vv_mz_crc32_armv8_is_supported(void)
+{
+#  if defined(__ARM_FEATURE_CRC32)
+    return 1;
+#  elif defined(__APPLE__)
+    int32_t value = 0;
+    size_t value_size = sizeof(value);
+    if (sysctlbyname("hw.optional.armv8_crc32", &value, &value_size, NULL, 0) != 0)
+        return 0;
+    return value != 0;
+#  elif defined(__linux__) && defined(HWCAP_CRC32)
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#  else
+    return 0;
+#  endif
+}
+#endif
+
+/***************************************************************************/
+
+#if defined(VV_MZ_CRC32_X86)
+/* Folding with carry-less multiplication, "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+   Instruction" (Intel, 2009), with the constants of the reflected gzip polynomial. Needs at least 64 bytes,
+   a multiple of 16, and the crc before its final inversion. */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t vv_mz_crc32_pclmul_fold(uint32_t crc, const uint8_t *buf, int64_t size)
+{
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+    const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163cd6124);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+    x1 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    buf += 64;
+    size -= 64;
+
+    /* four lanes of 128 bits folded 64 bytes ahead */
+    x0 = k1k2;
+    while (size >= 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)(buf + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)(buf + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)(buf + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)(buf + 0x30)));
+
+        buf += 64;
+        size -= 64;
+    }
+
+    /* the four lanes into one */
+    x0 = k3k4;
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    /* what is left, 16 bytes at a time */
+    while (size >= 16)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i *)buf)), x5);
+        buf += 16;
+        size -= 16;
+    }
+
+    /* 128 bits to 64 */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+    x0 = k5k0;
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask32);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduction to 32 bits */
+    x0 = poly;
+    x2 = _mm_and_si128(x1, mask32);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, mask32);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+static uint32_t vv_mz_crc32_pclmul(uint32_t crc, const uint8_t *buf, int64_t size)
+{
+    if (size >= 64)
+    {
+        int64_t fold_size = size & ~(int64_t)15;
+        crc = vv_mz_crc32_pclmul_fold(crc, buf, fold_size);
+        buf += fold_size;
+        size -= fold_size;
+    }
+    return vv_mz_crc32_slice8(crc, buf, size);
+}
+
+static int32_t vv_mz_crc32_pclmul_is_supported(void)
+{
+    uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return 0;
+    return (ecx & bit_PCLMUL) != 0 && (ecx & bit_SSE4_1) != 0;
+}
+#endif
+
+/***************************************************************************/
+
+static void vv_mz_crc32_init(void)
+{
+    uint32_t n = 0;
+    uint32_t k = 0;
+    uint32_t c = 0;
+    uint32_t p = 0;
+
+    for (n = 0; n < 256; n += 1)
+    {
+        c = n;
+        for (k = 0; k < 8; k += 1)
+            c = (c & 1) ? (c >> 1) ^ VV_MZ_CRC32_POLY : c >> 1;
+        vv_mz_crc32_table[0][n] = c;
+    }
+    /* table k holds a byte followed by k zero bytes */
+    for (n = 0; n < 256; n += 1)
+    {
+        c = vv_mz_crc32_table[0][n];
+        for (k = 1; k < 8; k += 1)
+        {
+            c = vv_mz_crc32_table[0][c & 0xff] ^ (c >> 8);
+            vv_mz_crc32_table[k][n] = c;
+        }
+    }
+
+    p = (uint32_t)1 << 30;      /* x^1 */
+    vv_mz_crc32_x2n_table[0] = p;
+    for (n = 1; n < 32; n += 1)
+        vv_mz_crc32_x2n_table[n] = p = vv_mz_crc32_multmodp(p, p);
+
+    vv_mz_crc32_selected = VV_MZ_CRC32_KERNEL_SLICE8;
+    if (vv_mz_crc32_kernel_is_supported(VV_MZ_CRC32_KERNEL_ARMV8))
+        vv_mz_crc32_selected = VV_MZ_CRC32_KERNEL_ARMV8;
+    else if (vv_mz_crc32_kernel_is_supported(VV_MZ_CRC32_KERNEL_PCLMUL))
+        vv_mz_crc32_selected = VV_MZ_CRC32_KERNEL_PCLMUL;
+
+    switch (vv_mz_crc32_selected)
+    {
+#if defined(VV_MZ_CRC32_ARM)
+    case VV_MZ_CRC32_KERNEL_ARMV8:
+        vv_mz_crc32_selected_kernel = vv_mz_crc32_armv8;
+        break;
+#endif
+#if defined(VV_MZ_CRC32_X86)
+    case VV_MZ_CRC32_KERNEL_PCLMUL:
+        vv_mz_crc32_selected_kernel = vv_mz_crc32_pclmul;
+        break;
+#endif
+    default:
+        vv_mz_crc32_selected_kernel = vv_mz_crc32_slice8;
+        break;
+    }
+}
+
+/***************************************************************************/
+
+uint32_t vv_mz_crc32_update(uint32_t value, const uint8_t *buf, int64_t size)
+{
+    pthread_once(&vv_mz_crc32_once, vv_mz_crc32_init);
+    if (buf == NULL || size <= 0)
+        return value;
+    return ~vv_mz_crc32_selected_kernel(~value, buf, size);
+}
+
+uint32_t vv_mz_crc32_combine(uint32_t crc1, uint32_t crc2, int64_t size2)
+{
+    pthread_once(&vv_mz_crc32_once, vv_mz_crc32_init);
+    if (size2 <= 0)
+        return crc1 ^ crc2;
+    /* crc1 moved past size2 zero bytes, then crc2 on top */
+    return vv_mz_crc32_multmodp(vv_mz_crc32_x2nmodp(size2, 3), crc1) ^ crc2;
+}
+
+int32_t vv_mz_crc32_kernel_is_supported(int32_t kernel)
+{
+    switch (kernel)
+    {
+    case VV_MZ_CRC32_KERNEL_SLICE8:
+        return 1;
+#if defined(VV_MZ_CRC32_ARM)
+    case VV_MZ_CRC32_KERNEL_ARMV8:
+        return vv_mz_crc32_armv8_is_supported();
+#endif
+#if defined(VV_MZ_CRC32_X86)
+    case VV_MZ_CRC32_KERNEL_PCLMUL:
+        return vv_mz_crc32_pclmul_is_supported();
+#endif
+    default:
+        return 0;
+    }
+}
+
+int32_t vv_mz_crc32_kernel_selected(void)
+{
+    pthread_once(&vv_mz_crc32_once, vv_mz_crc32_init);
+    return vv_mz_crc32_selected;
+}
+
+const char *vv_mz_crc32_kernel_name(int32_t kernel)
+{
+    switch (kernel)
+    {
+    case VV_MZ_CRC32_KERNEL_SLICE8:
+        return "slice-by-8";
+    case VV_MZ_CRC32_KERNEL_ARMV8:
+        return "armv8-crc32";
+    case VV_MZ_CRC32_KERNEL_PCLMUL:
+        return "pclmulqdq";
+    default:
+        return "unknown";
+    }
+}
+
+uint32_t vv_mz_crc32_update_kernel(int32_t kernel, uint32_t value, const uint8_t *buf, int64_t size)
+{
+    vv_mz_crc32_kernel function = vv_mz_crc32_slice8;
+
+    pthread_once(&vv_mz_crc32_once, vv_mz_crc32_init);
+    if (buf == NULL || size <= 0)
+        return value;
+#if defined(VV_MZ_CRC32_ARM)
+    if (kernel == VV_MZ_CRC32_KERNEL_ARMV8)
+        function = vv_mz_crc32_armv8;
+#endif
+#if defined(VV_MZ_CRC32_X86)
+    if (kernel == VV_MZ_CRC32_KERNEL_PCLMUL)
+        function = vv_mz_crc32_pclmul;
+#endif
+    return ~function(~value, buf, size);
+}
@@ -0,0 +1,47 @@
+/* vv_mz_crc32.h -- CRC-32 of zip entries
+   part of the MiniZip project
+
+   This program is distributed under the terms of the same license as zlib.
+   See the accompanying LICENSE file for the full text of the license.
+*/
+
+#ifndef VV_MZ_CRC32_H
+#define VV_MZ_CRC32_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************************************************/
+
+/* Kernels, the fastest one the cpu supports is picked at the first call */
+#define VV_MZ_CRC32_KERNEL_SLICE8       (0)     /* portable, 8 bytes per step with 8 tables */
+#define VV_MZ_CRC32_KERNEL_ARMV8        (1)     /* ARMv8 CRC32 instructions */
+#define VV_MZ_CRC32_KERNEL_PCLMUL       (2)     /* x86 carry-less multiply folding */
+#define VV_MZ_CRC32_KERNEL_COUNT        (3)
+
+/***************************************************************************/
+
+/* Same value as zlib's crc32(), start from 0 */
+uint32_t vv_mz_crc32_update(uint32_t value, const uint8_t *buf, int64_t size);
+
+/* CRC of two pieces put together from the CRC of each and the length of the second,
+   so chunks computed apart (in parallel, out of order) can be merged */
+uint32_t vv_mz_crc32_combine(uint32_t crc1, uint32_t crc2, int64_t size2);
+
+/***************************************************************************/
+
+int32_t  vv_mz_crc32_kernel_is_supported(int32_t kernel);
+int32_t  vv_mz_crc32_kernel_selected(void);
+const char *vv_mz_crc32_kernel_name(int32_t kernel);
+
+/* Runs the given kernel, which must be supported, for benchmarks and checks */
+uint32_t vv_mz_crc32_update_kernel(int32_t kernel, uint32_t value, const uint8_t *buf, int64_t size);
+
+/***************************************************************************/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
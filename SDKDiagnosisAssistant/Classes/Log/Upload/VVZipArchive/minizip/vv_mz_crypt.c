@@ -11,38 +11,16 @@
 
 
 #include "vv_mz.h"
+#include "vv_mz_crc32.h"
 #include "vv_mz_crypt.h"
 
 
-#  include "zlib.h"
-#  if defined(ZLIBNG_VERNUM) && !defined(ZLIB_COMPAT)
-#    include "zlib-ng.h"
-#  endif
-
-
-/***************************************************************************/
-/* Define z_crc_t in zlib 1.2.5 and less or if using zlib-ng */
-
-#if defined(ZLIBNG_VERNUM)
-#  if defined(ZLIB_COMPAT)
-#    define ZLIB_PREFIX(x) x
-#  else
-#    define ZLIB_PREFIX(x) zng_ ## x
-#  endif
-   typedef uint32_t z_crc_t;
-#else
-#  define ZLIB_PREFIX(x) x
-#  if (ZLIB_VERNUM < 0x1270)
-     typedef unsigned long z_crc_t;
-#  endif
-#endif
-
 /***************************************************************************/
 
 uint32_t vv_mz_crypt_crc32_update(uint32_t value, const uint8_t *buf, int32_t size)
 {
-
-    return (uint32_t)ZLIB_PREFIX(crc32)((z_crc_t)value, buf, (uInt)size);
+    /* hardware kernels when the cpu has them, same value as zlib's crc32() */
+    return vv_mz_crc32_update(value, buf, size);
 }
 
 #ifndef VV_MZ_ZIP_NO_ENCRYPTION
@@ -366,7 +366,13 @@ int32_t vv_mz_file_get_crc(const char *path, uint32_t *result_crc)
     uint32_t crc32 = 0;
     int32_t read = 0;
     int32_t err = VV_MZ_OK;
-    uint8_t buf[16384];
+    int32_t buf_size = 256 * 1024;
+    uint8_t *buf = NULL;
+
+    /* larger reads than a stack buffer, the crc kernels outrun the syscalls */
+    buf = (uint8_t *)VV_MZ_ALLOC(buf_size);
+    if (buf == NULL)
+        return VV_MZ_MEM_ERROR;
 
     vv_mz_stream_os_create(&stream);
 
@@ -376,7 +382,7 @@ int32_t vv_mz_file_get_crc(const char *path, uint32_t *result_crc)
     {
         do
         {
-            read = vv_mz_stream_os_read(stream, buf, sizeof(buf));
+            read = vv_mz_stream_os_read(stream, buf, buf_size);
 
             if (read < 0)
             {
@@ -394,6 +400,7 @@ int32_t vv_mz_file_get_crc(const char *path, uint32_t *result_crc)
     *result_crc = crc32;
 
     vv_mz_stream_os_delete(&stream);
+    VV_MZ_FREE(buf);
 
     return err;
 }
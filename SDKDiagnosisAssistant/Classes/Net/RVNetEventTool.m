@@ -237,12 +237,12 @@
     //判断是否需要上报URL耗时(根据白名单设置过滤，减少事件上报的数量)
     BOOL canReport = [self isAllowReport:URL];
     if (canReport == NO) {
-        NSLogRVSDK(@"未通过验证，不上报URL耗时 urlString=%@",urlString);
+        NSLogRVSDKLimited(2, 10, @"未通过验证，不上报URL耗时 urlString=%@",urlString);
         // 不上报的话从字典删除Metricks，避免内存一直增长
         [self removeMetricksWithTaskIdentifier:userInfo];
         return;
     }
-    NSLogRVSDK(@"已通过验证，将上报URL耗时 urlString=%@",urlString);
+    NSLogRVSDKLimited(2, 10, @"已通过验证，将上报URL耗时 urlString=%@",urlString);
     
     //有errorValues代表是失败了
     BOOL isFailed = (errorValues != nil);
@@ -273,7 +273,7 @@
     //TODO: 这里也可以做数据上报
     //    [RVInSDKEventTools addSDKStatisticsEvent:@"network" eventValues:eventValues];
     
-    NSLogDebug(@"网络耗时数据：%@",eventValues);
+    NSLogDebugLimited(2, 10, @"网络耗时数据：%@",eventValues);
     if (self.handler) {
         self.handler(eventValues);
     }
@@ -17,9 +17,9 @@ NS_ASSUME_NONNULL_BEGIN
 
 #pragma mark - Dectect All Items
 
-/// There can only be one detection process at the same time.
-/// Opening two icmp at the same time will cause packet stringing.
-@property (nonatomic, assign) BOOL isDetecting;
+/// YES while at least one detection is in progress.
+/// ICMP replies are demultiplexed by identifier in `RSICMPReactor`, so several detections can run at the same time.
+@property (nonatomic, assign, readonly) BOOL isDetecting;
 
 /// Detect a domain
 /// - Parameters:
@@ -29,7 +29,7 @@ NS_ASSUME_NONNULL_BEGIN
           complete:(void(^)(NSString *detectLog))complete;
 
 
-/// Detect a group of domain, by sequence
+/// Detect a group of domain in parallel, logs are joined in the order of `hostList`
 /// - Parameters:
 ///   - hostList: List of domain name
 ///   - complete: callback
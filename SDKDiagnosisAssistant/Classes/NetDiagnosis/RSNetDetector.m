@@ -15,6 +15,10 @@
 #import "RSAsyncTaskQueue.h"
 #import <UIKit/UIKit.h>
 
+@interface RSNetDetector()
+@property (nonatomic, assign) NSInteger detectingCount;
+@end
+
 @implementation RSNetDetector
 
 + (instancetype)shared 
@@ -27,13 +31,19 @@
     return instace;
 }
 
+- (BOOL)isDetecting
+{
+    @synchronized (self) {
+        return _detectingCount > 0;
+    }
+}
+
 - (void)detectHost:(NSString *)host 
           complete:(void(^)(NSString *detectLog))complete
 {
-    if (_isDetecting) {
-        return;
+    @synchronized (self) {
+        _detectingCount++;
     }
-    _isDetecting = YES;
     
     // create async task queue
     NSString *queueID = [NSString stringWithFormat:@"com.RVSDK.NetworkDetector-%f",[[NSDate date] timeIntervalSince1970]];
@@ -102,7 +112,9 @@
     
     
     queue.completeHandler = ^{
-        self.isDetecting = NO;
+        @synchronized (self) {
+            self.detectingCount--;
+        }
         if (complete) {
             complete(log);
         }
@@ -121,23 +133,25 @@
 
     CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
     
-    __block NSMutableString *log = [[NSMutableString alloc] initWithString:@""];
+    // Every host is detected at the same time, logs are joined in the order of hostList
+    NSMutableArray<NSString *> *hostLogs = [NSMutableArray arrayWithCapacity:hostList.count];
+    for (NSUInteger i = 0; i < hostList.count; i++) {
+        [hostLogs addObject:@""];
+    }
     dispatch_group_t group = dispatch_group_create();
     
-    dispatch_group_async(group, dispatch_get_global_queue(0, 0), ^{
-        for (NSString *host in hostList) {
-            
-            dispatch_semaphore_t sema = dispatch_semaphore_create(0);
-            [self detectHost:host complete:^(NSString * _Nonnull detectLog) {
-                [log appendString:detectLog];
-                dispatch_semaphore_signal(sema);
-            }];
-            dispatch_semaphore_wait(sema, DISPATCH_TIME_FOREVER);
-            
-        }
-    });
+    [hostList enumerateObjectsUsingBlock:^(NSString *host, NSUInteger idx, BOOL *stop) {
+        dispatch_group_enter(group);
+        [self detectHost:host complete:^(NSString * _Nonnull detectLog) {
+            @synchronized (hostLogs) {
+                hostLogs[idx] = detectLog;
+            }
+            dispatch_group_leave(group);
+        }];
+    }];
     
     dispatch_group_notify(group, dispatch_get_main_queue(), ^{
+        NSMutableString *log = [NSMutableString stringWithString:[hostLogs componentsJoinedByString:@""]];
         CFAbsoluteTime endTime = (CFAbsoluteTimeGetCurrent() - startTime);
         [log appendFormat:@"\n============== All Done! Time consuming in total: %f s",endTime];
         // NSLog(@"============== All Done! Time consuming in total: %f s",endTime);
@@ -158,11 +172,15 @@
     }
     [[RSDomainLookup shareInstance] lookupDomain:host completeHandler:^(NSMutableArray<RSDomainLookUpResult *> * _Nullable lookupRes, NSError * _Nullable error) {
 //        NSLog(@"%@", lookupRes.description);
-        if (complete) {
-            dispatch_async(dispatch_get_main_queue(), ^{
-                complete(lookupRes.description);
-            });
-        }
+        // Ask every system resolver as well, to tell a slow resolver from a slow network
+        [[RSDomainLookup shareInstance] lookupDomain:host dnsServers:nil completeHandler:^(NSMutableArray<RSDomainLookUpResult *> * _Nullable serverRes, NSError * _Nullable serverError) {
+            NSString *detectLog = [NSString stringWithFormat:@"%@\nper server = %@", lookupRes.description, serverRes.description ?: serverError.domain];
+            if (complete) {
+                dispatch_async(dispatch_get_main_queue(), ^{
+                    complete(detectLog);
+                });
+            }
+        }];
     }];
 }
 
@@ -197,7 +215,9 @@
     
     __block NSMutableString *log = [[NSMutableString alloc] initWithString:@""];
     int packetCount = 10;
-    [[RSPingService shareInstance] startPingHost:host packetCount:packetCount resultHandler:^(NSString * _Nullable pingres, BOOL isDone) {
+    // A service per call, so pings of concurrent detections do not cancel each other
+    RSPingService *pingService = [[RSPingService alloc] init];
+    [pingService startPingHost:host packetCount:packetCount resultHandler:^(NSString * _Nullable pingres, BOOL isDone) {
 //        NSLog(@"%@", pingres);
         [log appendFormat:@"%@\n",pingres];
         if (isDone) {
@@ -219,7 +239,9 @@
         return;
     }
     __block NSMutableString *log = [[NSMutableString alloc] initWithString:@""];
-    [[RSTraceRouteService shareInstance] startTracerouteHost:host resultHandler:^(NSString * _Nullable tracertRes, NSString * _Nullable destIp, BOOL isDone) {
+    // A service per call, so traceroutes of concurrent detections do not cancel each other
+    RSTraceRouteService *tracerouteService = [[RSTraceRouteService alloc] init];
+    [tracerouteService startTracerouteHost:host resultHandler:^(NSString * _Nullable tracertRes, NSString * _Nullable destIp, BOOL isDone) {
         if (tracertRes) {
 //            NSLog(@"%@\n",tracertRes);
             [log appendFormat:@"%@\n",tracertRes];
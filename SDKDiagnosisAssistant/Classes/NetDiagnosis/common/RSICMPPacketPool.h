@@ -0,0 +1,49 @@
+//
+//  RSICMPPacketPool.h
+//  RSNetDiagnosis
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+#define kICMPPacketPoolDefaultSlots     64
+#define kICMPPacketPoolCacheLine        64
+
+typedef NS_ENUM(NSInteger, RSICMPPacketKind) {
+    RSICMPPacketKindEcho,           // `RSICMPPacket`, 56 bytes payload
+    RSICMPPacketKindTraceRoute,     // `RSICMPTraceRoutePacket`, header only
+};
+
+/**
+ Preallocated echo request packets of one ping or traceroute session.
+
+ @discussion Slots are cache-line aligned copies of one template, summed once when the pool is
+ created. Taking a packet only stamps identifier and seq into the next slot and patches the
+ checksum incrementally, so probing allocates nothing. A slot is reused after `slotCount` more
+ packets were taken, keep no more than that many in use. Not thread safe, use it from the thread
+ sending the probes.
+ */
+@interface RSICMPPacketPool : NSObject
+
+/// Byte, length to send for every packet of this pool
+@property (nonatomic, assign, readonly) size_t packetLength;
+@property (nonatomic, assign, readonly) NSUInteger slotCount;
+
+- (instancetype)initWithKind:(RSICMPPacketKind)kind isIPv6:(BOOL)isIPv6 slotCount:(NSUInteger)slotCount;
+
+/**
+ @brief Take the next slot, stamped and ready to send.
+
+ @param identifier ICMP identifier, host byte order
+ @param seq ICMP seq, host byte order
+ @return packet of `packetLength` bytes, owned by the pool
+ */
+- (const void *)packetWithIdentifier:(uint16_t)identifier seq:(uint16_t)seq;
+
+@end
+
+NS_ASSUME_NONNULL_END
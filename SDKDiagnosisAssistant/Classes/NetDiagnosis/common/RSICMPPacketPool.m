@@ -0,0 +1,80 @@
+//
+//  RSICMPPacketPool.m
+//  RSNetDiagnosis
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+
+#import "RSICMPPacketPool.h"
+#import "RSNetDiagnosisHelper.h"
+#import "RSNetChecksum.h"
+#import "RSNetDiagnosisLog.h"
+
+@interface RSICMPPacketPool()
+{
+    uint8_t *_slots;
+    size_t _slotStride;
+    NSUInteger _nextSlot;
+    BOOL _needsChecksum;
+}
+@end
+
+@implementation RSICMPPacketPool
+
+- (instancetype)initWithKind:(RSICMPPacketKind)kind isIPv6:(BOOL)isIPv6 slotCount:(NSUInteger)slotCount
+{
+    if (self = [super init]) {
+        _packetLength = kind == RSICMPPacketKindEcho ? sizeof(RSICMPPacket) : sizeof(RSICMPTraceRoutePacket);
+        _slotCount = MAX(slotCount, (NSUInteger)1);
+        _slotStride = (_packetLength + kICMPPacketPoolCacheLine - 1) / kICMPPacketPoolCacheLine * kICMPPacketPoolCacheLine;
+        // ICMPv6 checksum covers a pseudo header and is filled by the kernel
+        _needsChecksum = !isIPv6;
+
+        if (posix_memalign((void **)&_slots, kICMPPacketPoolCacheLine, _slotStride * _slotCount) != 0) {
+            log4cplus_warn("RSICMPPacketPool", "allocate packet pool error..\n");
+            return nil;
+        }
+        memset(_slots, 0, _slotStride * _slotCount);
+
+        // Template with identifier and seq 0, every slot starts as a copy of it
+        RSICMPTraceRoutePacket *header = (RSICMPTraceRoutePacket *)_slots;
+        header->type = isIPv6 ? RSICMPv6Type_EchoRequest : RSICMPType_EchoRequest;
+        if (kind == RSICMPPacketKindEcho) {
+            memset(((RSICMPPacket *)_slots)->data, 65, sizeof(((RSICMPPacket *)_slots)->data));
+        }
+        if (_needsChecksum) {
+            header->checksum = RSNetChecksum(_slots, _packetLength);
+        }
+        for (NSUInteger i = 1; i < _slotCount; i++) {
+            memcpy(_slots + i * _slotStride, _slots, _packetLength);
+        }
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_slots);
+}
+
+- (const void *)packetWithIdentifier:(uint16_t)identifier seq:(uint16_t)seq
+{
+    RSICMPTraceRoutePacket *header = (RSICMPTraceRoutePacket *)(_slots + _nextSlot * _slotStride);
+    _nextSlot = (_nextSlot + 1) % _slotCount;
+
+    uint16_t newIdentifier = OSSwapHostToBigInt16(identifier);
+    uint16_t newSeq = OSSwapHostToBigInt16(seq);
+    if (_needsChecksum) {
+        // Slot still holds the words of its last use, patch the checksum from them
+        uint16_t checksum = header->checksum;
+        checksum = RSNetChecksumUpdate16(checksum, header->identifier, newIdentifier);
+        checksum = RSNetChecksumUpdate16(checksum, header->seq, newSeq);
+        header->checksum = checksum;
+    }
+    header->identifier = newIdentifier;
+    header->seq = newSeq;
+    return header;
+}
+
+@end
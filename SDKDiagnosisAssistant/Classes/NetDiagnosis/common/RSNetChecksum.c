@@ -0,0 +1,246 @@
+//
+//  RSNetChecksum.c
+//  RSNetDiagnosis
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+
+#include "RSNetChecksum.h"
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RS_CHECKSUM_X86 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RS_CHECKSUM_NEON 1
+#endif
+
+/// Sum `length` bytes into `sum`, odd byte counted as the high half of a word in memory order
+typedef uint64_t (*RSNetChecksumKernel)(const uint8_t *buffer, size_t length, uint64_t sum);
+
+static uint64_t RSNetChecksumScalar(const uint8_t *buffer, size_t length, uint64_t sum)
+{
+    // 32-bit words into 64-bit accumulator, carries are folded once at the end
+    uint32_t word;
+    while (length >= 16) {
+        uint32_t w0, w1, w2, w3;
+        memcpy(&w0, buffer, 4);
+        memcpy(&w1, buffer + 4, 4);
+        memcpy(&w2, buffer + 8, 4);
+        memcpy(&w3, buffer + 12, 4);
+        sum += (uint64_t)w0 + w1 + w2 + w3;
+        buffer += 16;
+        length -= 16;
+    }
+    while (length >= 4) {
+        memcpy(&word, buffer, 4);
+        sum += word;
+        buffer += 4;
+        length -= 4;
+    }
+    if (length >= 2) {
+        uint16_t half;
+        memcpy(&half, buffer, 2);
+        sum += half;
+        buffer += 2;
+        length -= 2;
+    }
+    if (length == 1) {
+        union {
+            uint16_t    us;
+            uint8_t     uc[2];
+        } last;
+        last.uc[0] = *buffer;
+        last.uc[1] = 0;
+        sum += last.us;
+    }
+    return sum;
+}
+
+#if RS_CHECKSUM_X86
+
+__attribute__((target("avx2")))
+static uint64_t RSNetChecksumAVX2(const uint8_t *buffer, size_t length, uint64_t sum)
+{
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    while (length >= 32) {
+        __m256i data = _mm256_loadu_si256((const __m256i *)buffer);
+        acc0 = _mm256_add_epi64(acc0, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(data)));
+        acc1 = _mm256_add_epi64(acc1, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(data, 1)));
+        buffer += 32;
+        length -= 32;
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, _mm256_add_epi64(acc0, acc1));
+    return RSNetChecksumScalar(buffer, length, sum + lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+}
+
+#endif
+
+#if RS_CHECKSUM_NEON
+
+static uint64_t RSNetChecksumNEON(const uint8_t *buffer, size_t length, uint64_t sum)
+{
+    // Pairwise add-accumulate long, 32-bit words into 64-bit lanes
+    uint64x2_t acc0 = vdupq_n_u64(0);
+    uint64x2_t acc1 = vdupq_n_u64(0);
+    while (length >= 32) {
+        acc0 = vpadalq_u32(acc0, vreinterpretq_u32_u8(vld1q_u8(buffer)));
+        acc1 = vpadalq_u32(acc1, vreinterpretq_u32_u8(vld1q_u8(buffer + 16)));
+        buffer += 32;
+        length -= 32;
+    }
+    if (length >= 16) {
+        acc0 = vpadalq_u32(acc0, vreinterpretq_u32_u8(vld1q_u8(buffer)));
+        buffer += 16;
+        length -= 16;
+    }
+    uint64x2_t acc = vaddq_u64(acc0, acc1);
+    return RSNetChecksumScalar(buffer, length, sum + vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1));
+}
+
+#endif
+
+#define kChecksumVectorThreshold    256     // Byte, shorter buffers do not pay for the indirect call
+#define kChecksumCalibrationLength  4096    // Byte, buffer each kernel is timed on
+#define kChecksumCalibrationRounds  16      // Best of, so a preemption does not decide
+
+static RSNetChecksumKernel RSNetChecksumFunctionOf(RSNetChecksumKernelType kernel)
+{
+#if RS_CHECKSUM_X86
+    if (kernel == RSNetChecksumKernelAVX2) {
+        return RSNetChecksumAVX2;
+    }
+#elif RS_CHECKSUM_NEON
+    if (kernel == RSNetChecksumKernelNEON) {
+        return RSNetChecksumNEON;
+    }
+#endif
+    return RSNetChecksumScalar;
+}
+
+static uint64_t RSNetChecksumNowNanos(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/// Best time of `kernel` over the calibration buffer
+static uint64_t RSNetChecksumTimeKernel(RSNetChecksumKernel kernel, const uint8_t *buffer)
+{
+    uint64_t best = UINT64_MAX;
+    volatile uint64_t sink = 0;
+    for (int round = 0; round < kChecksumCalibrationRounds; round++) {
+        uint64_t start = RSNetChecksumNowNanos();
+        sink += kernel(buffer, kChecksumCalibrationLength, 0);
+        uint64_t elapsed = RSNetChecksumNowNanos() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+    (void)sink;
+    return best;
+}
+
+static RSNetChecksumKernel g_checksumKernel = RSNetChecksumScalar;
+static RSNetChecksumKernelType g_checksumKernelType = RSNetChecksumKernelScalar;
+static pthread_once_t g_checksumKernelOnce = PTHREAD_ONCE_INIT;
+
+/// A vector kernel is only used if it beats the scalar one on this cpu, which the compiler may vectorize too
+static void RSNetChecksumSelectKernelOnce(void)
+{
+    static uint8_t buffer[kChecksumCalibrationLength];
+    for (size_t i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = (uint8_t)(i * 131 + 7);
+    }
+    uint64_t bestTime = RSNetChecksumTimeKernel(RSNetChecksumScalar, buffer);
+    for (int kernel = RSNetChecksumKernelScalar + 1; kernel < RSNetChecksumKernelCount; kernel++) {
+        if (!RSNetChecksumKernelIsSupported(kernel)) {
+            continue;
+        }
+        uint64_t time = RSNetChecksumTimeKernel(RSNetChecksumFunctionOf(kernel), buffer);
+        if (time < bestTime) {
+            bestTime = time;
+            g_checksumKernelType = kernel;
+        }
+    }
+    g_checksumKernel = RSNetChecksumFunctionOf(g_checksumKernelType);
+}
+
+static RSNetChecksumKernel RSNetChecksumSelectKernel(void)
+{
+    pthread_once(&g_checksumKernelOnce, RSNetChecksumSelectKernelOnce);
+    return g_checksumKernel;
+}
+
+/// Fold a 64-bit sum to 16 bits, end-around carry included
+static inline uint16_t RSNetChecksumFold(uint64_t sum)
+{
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    return (uint16_t)sum;
+}
+
+static inline uint64_t RSNetChecksumSum(const void *buffer, size_t length)
+{
+    if (length < kChecksumVectorThreshold) {
+        return RSNetChecksumScalar((const uint8_t *)buffer, length, 0);
+    }
+    return RSNetChecksumSelectKernel()((const uint8_t *)buffer, length, 0);
+}
+
+uint16_t RSNetChecksum(const void *buffer, size_t length)
+{
+    uint64_t sum = RSNetChecksumSum(buffer, length);
+    return (uint16_t)~RSNetChecksumFold(sum);
+}
+
+int RSNetChecksumVerify(const void *buffer, size_t length)
+{
+    uint64_t sum = RSNetChecksumSum(buffer, length);
+    return RSNetChecksumFold(sum) == 0xffff;
+}
+
+const char *RSNetChecksumKernelName(void)
+{
+    RSNetChecksumSelectKernel();
+    return RSNetChecksumKernelNameOf(g_checksumKernelType);
+}
+
+int RSNetChecksumKernelIsSupported(RSNetChecksumKernelType kernel)
+{
+    switch (kernel) {
+        case RSNetChecksumKernelScalar:
+            return 1;
+#if RS_CHECKSUM_X86
+        case RSNetChecksumKernelAVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") != 0;
+#elif RS_CHECKSUM_NEON
+        case RSNetChecksumKernelNEON:
+            return 1;
+#endif
+        default:
+            return 0;
+    }
+}
+
+const char *RSNetChecksumKernelNameOf(RSNetChecksumKernelType kernel)
+{
+    static const char *const names[RSNetChecksumKernelCount] = { "scalar", "avx2", "neon" };
+    return kernel < RSNetChecksumKernelCount ? names[kernel] : "unknown";
+}
+
+uint16_t RSNetChecksumWithKernel(RSNetChecksumKernelType kernel, const void *buffer, size_t length)
+{
+    return (uint16_t)~RSNetChecksumFold(RSNetChecksumFunctionOf(kernel)((const uint8_t *)buffer, length, 0));
+}
@@ -0,0 +1,73 @@
+//
+//  RSNetChecksum.h
+//  RSNetDiagnosis
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+
+#ifndef RSNetChecksum_h
+#define RSNetChecksum_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ Internet checksum (RFC 1071).
+
+ Words are summed in memory order, so the result can be stored into a packet as is, on any
+ byte order. The kernel is picked once at first use, thread safe: AVX2 on x86 or NEON on arm64
+ if it times faster than a scalar loop folding 32-bit words into a 64-bit accumulator, else the scalar loop.
+ */
+
+/// Checksum of `length` bytes, ready to be stored in the checksum field (which must be 0 while summing)
+uint16_t RSNetChecksum(const void *buffer, size_t length);
+
+/// 1 if a packet carrying its checksum sums to all ones, i.e. is intact. Buffer is not modified.
+int RSNetChecksumVerify(const void *buffer, size_t length);
+
+/**
+ Incremental update (RFC 1624, eqn. 3) when one 16-bit word of a packet changes.
+
+ @param checksum checksum currently stored in the packet
+ @param oldWord word as it was in the packet, memory order
+ @param newWord word as it is now, memory order
+ @return checksum to store
+ */
+static inline uint16_t RSNetChecksumUpdate16(uint16_t checksum, uint16_t oldWord, uint16_t newWord)
+{
+    uint32_t sum = (uint16_t)~checksum + (uint16_t)~oldWord + (uint32_t)newWord;
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+/// Name of the kernel in use, "avx2", "neon" or "scalar"
+const char *RSNetChecksumKernelName(void);
+
+/// Kernels, for benchmarks and checks
+typedef enum {
+    RSNetChecksumKernelScalar,
+    RSNetChecksumKernelAVX2,
+    RSNetChecksumKernelNEON,
+    RSNetChecksumKernelCount,
+} RSNetChecksumKernelType;
+
+/// 1 if the cpu runs `kernel`
+int RSNetChecksumKernelIsSupported(RSNetChecksumKernelType kernel);
+
+/// "scalar", "avx2" or "neon"
+const char *RSNetChecksumKernelNameOf(RSNetChecksumKernelType kernel);
+
+/// `RSNetChecksum` computed by `kernel`, which must be supported, whatever the length
+uint16_t RSNetChecksumWithKernel(RSNetChecksumKernelType kernel, const void *buffer, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RSNetChecksum_h */
@@ -14,6 +14,7 @@
 #import <netinet/in.h>
 #import <sys/socket.h>
 #import <unistd.h>
+#import <time.h>
 
 //MARK: - IP Header
 typedef struct RSNetIPHeader {
@@ -68,6 +69,7 @@ __Check_Compile_Time(offsetof(RSNetIPv6Header, destinationAddress) == 24);
 // reference to netinet/icmp.h
 typedef enum RSICMPType {
     RSICMPType_EchoReply    = 0,
+    RSICMPType_UNREACH      = 3,
     RSICMPType_EchoRequest  = 8,
     RSICMPType_TimeOut      = 11
 } RSICMPType;
@@ -123,11 +125,23 @@ __Check_Compile_Time(offsetof(RSICMPTraceRoutePacket, seq) == 6);
 
 
 
+//MARK: - Time
+
+/// Monotonic clock in microsecond, not affected by wall-clock changes
+static inline uint64_t RSNetMonotonicMicros(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
 //MARK: - RSNetDiagnosisHelper
 
 @interface RSNetDiagnosisHelper : NSObject
 
 //MARK: - Resolve host
+/// Blocking, answered by `RSHostResolver` and cached
 + (NSArray<NSString *> *)resolveHost:(NSString *)hostname;
 
 //MARK: - ICMP Ping Packet
@@ -160,5 +174,23 @@ __Check_Compile_Time(offsetof(RSICMPTraceRoutePacket, seq) == 6);
                    length:(int)length
                    isIPv6:(BOOL)isIPv6;
 
+/**
+ @brief Find the echo request a received packet answers.
+ 
+ @discussion Echo reply carries identifier and seq itself, Time Exceeded and Destination Unreachable
+ quote the header of the original echo request after their own header.
+ 
+ @param type ICMP type of the received packet
+ @param identifier identifier of the original echo request, host byte order
+ @param seq seq of the original echo request, host byte order
+ @return NO if packet is neither an echo reply nor an error quoting an echo request
+ */
++ (BOOL)parseICMPResponseWithBuffer:(char *)buffer
+                             length:(int)length
+                             isIPv6:(BOOL)isIPv6
+                               type:(uint8_t *)type
+                         identifier:(uint16_t *)identifier
+                                seq:(uint16_t *)seq;
+
 
 @end
@@ -7,6 +7,8 @@
 //
 
 #import "RSNetDiagnosisHelper.h"
+#import "RSHostResolver.h"
+#import "RSNetChecksum.h"
 
 
 
@@ -15,78 +17,8 @@
 
 #pragma mark - Resolve host
 + (NSArray<NSString *> *)resolveHost:(NSString *)hostname {
-//    NSMutableArray<NSString *> *resolve = [NSMutableArray array];
-//    CFHostRef hostRef = CFHostCreateWithName(kCFAllocatorDefault, (__bridge CFStringRef)hostname);
-//    if (hostRef != NULL) {
-//        Boolean result = CFHostStartInfoResolution(hostRef, kCFHostAddresses, NULL);
-//        if (result == true) {
-//            CFArrayRef addresses = CFHostGetAddressing(hostRef, &result);
-//            for(int i = 0; i < CFArrayGetCount(addresses); i++){
-//                CFDataRef saData = (CFDataRef)CFArrayGetValueAtIndex(addresses, i);
-//                struct sockaddr *addressGeneric = (struct sockaddr *)CFDataGetBytePtr(saData);
-//
-//                if (addressGeneric != NULL) {
-//                    switch (addressGeneric->sa_family) {
-//                        case AF_INET:
-//                        {
-//                            struct sockaddr_in *remoteAddr = (struct sockaddr_in *)CFDataGetBytePtr(saData);
-//                            [resolve addObject:[self formatIPv4Address:remoteAddr->sin_addr]];
-//                        }
-//                            break;
-//                        case AF_INET6:
-//                        {
-//                            struct sockaddr_in6 *remoteAddr6 = (struct sockaddr_in6 *)CFDataGetBytePtr(saData);
-//                            [resolve addObject:[self formatIPv6Address:remoteAddr6->sin6_addr]];
-//                        }
-//                            break;
-//                        default:
-//                            break;
-//                    }
-//
-//                }
-//            }
-//        }
-//    }
-//
-//    return [resolve copy];
-
-    /**
-     Qos warning might appear with previous method, try using following method. Don't forget to link libresolv.9.tdb
-     */
-    NSMutableArray<NSString *> *resolve = [NSMutableArray array];
-
-    struct addrinfo hints, *res, *p;
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
-
-    int status = getaddrinfo([hostname UTF8String], NULL, &hints, &res);
-    if (status != 0) {
-        NSLog(@"getaddrinfo error: %s", gai_strerror(status));
-        return [resolve copy];
-    }
-
-    for (p = res; p != NULL; p = p->ai_next) {
-        char ipstr[INET6_ADDRSTRLEN];
-        void *addr;
-
-        if (p->ai_family == AF_INET) { // IPv4
-            struct sockaddr_in *ipv4 = (struct sockaddr_in *)p->ai_addr;
-            addr = &(ipv4->sin_addr);
-        } else if (p->ai_family == AF_INET6) { // IPv6
-            struct sockaddr_in6 *ipv6 = (struct sockaddr_in6 *)p->ai_addr;
-            addr = &(ipv6->sin6_addr);
-        } else {
-            continue;
-        }
-
-        // convert pointer to string
-        inet_ntop(p->ai_family, addr, ipstr, sizeof(ipstr));
-        [resolve addObject:[NSString stringWithUTF8String:ipstr]];
-    }
-
-    freeaddrinfo(res);
-    return [resolve copy];
+    // Shared resolver, so tools probing one host reuse a single answer
+    return [[RSHostResolver shareInstance] resolveHostSync:hostname].addresses;
 }
 
 + (NSString *)formatIPv4Address:(struct in_addr)ipv4Addr {
@@ -118,14 +50,27 @@
                                    andIdentifier:(uint16_t)identifier
                                           isIPv6:(BOOL)isIPv6
 {
+    // Template with identifier and seq 0, summed once; a probe only patches the two words
+    static RSICMPPacket templates[2];
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        for (int i = 0; i < 2; i++) {
+            templates[i].type = i ? RSICMPv6Type_EchoRequest : RSICMPType_EchoRequest;
+            templates[i].code = 0;
+            templates[i].identifier = 0;
+            templates[i].seq = 0;
+            memset(templates[i].data, 65, 56);
+            templates[i].checksum = 0;
+            templates[i].checksum = RSNetChecksum(&templates[i], sizeof(RSICMPPacket));
+        }
+    });
+    
     RSICMPPacket *packet = (RSICMPPacket *)malloc(sizeof(RSICMPPacket));
-    packet->type  = isIPv6 ? RSICMPv6Type_EchoRequest : RSICMPType_EchoRequest;
-    packet->code = 0;
+    memcpy(packet, &templates[isIPv6 ? 1 : 0], sizeof(RSICMPPacket));
     packet->identifier = OSSwapHostToBigInt16(identifier);
     packet->seq = OSSwapHostToBigInt16(seq);
-    memset(packet->data, 65, 56);
-    packet->checksum = 0;
-    packet->checksum = [self in_cksumWithBuffer:packet andSize:sizeof(RSICMPPacket)];
+    packet->checksum = RSNetChecksumUpdate16(packet->checksum, 0, packet->identifier);
+    packet->checksum = RSNetChecksumUpdate16(packet->checksum, 0, packet->seq);
 //    NSLog(@"Send packet with identifier：%d", identifier);
     return packet;
 }
@@ -143,19 +88,17 @@
     }
     
 //    NSLog(@"Receive packet with identifier：%d ,type：%hu ", OSSwapBigToHostInt16(icmpPtr->identifier), icmpPtr->type);
+    // All requests of a ping session share one identifier, requests are told apart by seq
     if (isIPv6) {
-        return icmpPtr->type == RSICMPv6Type_EchoReply && icmpPtr->code == 0;
+        return icmpPtr->type == RSICMPv6Type_EchoReply &&
+        icmpPtr->code == 0 &&
+        OSSwapBigToHostInt16(icmpPtr->identifier) == identifier;
     } else {
-        uint16_t receivedChecksum = icmpPtr->checksum;
-        icmpPtr->checksum = 0;
-        uint16_t calculatedChecksum = [self in_cksumWithBuffer:icmpPtr andSize:length-((char*)icmpPtr - buffer)];
-        
-        return receivedChecksum == calculatedChecksum &&
+        // Summing the packet with its checksum in place gives all ones if intact, buffer is left untouched
+        return RSNetChecksumVerify(icmpPtr, length - ((char *)icmpPtr - buffer)) &&
         icmpPtr->type == RSICMPType_EchoReply &&
         icmpPtr->code == 0 &&
-        OSSwapBigToHostInt16(icmpPtr->identifier) >= identifier;
-//        OSSwapBigToHostInt16(icmpPtr->identifier) == identifier;
-//        OSSwapBigToHostInt16(icmpPtr->seq) <= seq;
+        OSSwapBigToHostInt16(icmpPtr->identifier) == identifier;
     }
 }
 
@@ -265,6 +208,66 @@
     return icmpPacket->type == (isIPv6 ? RSICMPv6Type_EchoReply : RSICMPType_EchoReply);
 }
 
++ (BOOL)parseICMPResponseWithBuffer:(char *)buffer
+                             length:(int)length
+                             isIPv6:(BOOL)isIPv6
+                               type:(uint8_t *)type
+                         identifier:(uint16_t *)identifier
+                                seq:(uint16_t *)seq
+{
+    RSICMPTraceRoutePacket *icmpPacket = (RSICMPTraceRoutePacket *)[self icmpTraceRoutePacketFromBuffer:buffer length:length isIPv6:isIPv6];
+    if (icmpPacket == NULL || length - ((char *)icmpPacket - buffer) < (int)sizeof(RSICMPTraceRoutePacket)) {
+        return NO;
+    }
+    *type = icmpPacket->type;
+    
+    if (icmpPacket->type == (isIPv6 ? RSICMPv6Type_EchoReply : RSICMPType_EchoReply)) {
+        *identifier = OSSwapBigToHostInt16(icmpPacket->identifier);
+        *seq = OSSwapBigToHostInt16(icmpPacket->seq);
+        return YES;
+    }
+    
+    BOOL isError = isIPv6 ? (icmpPacket->type == RSICMPv6Type_EXCEEDED || icmpPacket->type == RSICMPv6Type_UNREACH)
+                          : (icmpPacket->type == RSICMPType_TimeOut || icmpPacket->type == RSICMPType_UNREACH);
+    if (!isError) {
+        return NO;
+    }
+    
+    // Original datagram is quoted right after the 8 bytes error header
+    char *inner = (char *)icmpPacket + sizeof(RSICMPTraceRoutePacket);
+    int innerLength = length - (int)(inner - buffer);
+    size_t innerHeaderLength = 0;
+    if (isIPv6) {
+        if (innerLength < (int)(sizeof(RSNetIPv6Header) + sizeof(RSICMPTraceRoutePacket))) {
+            return NO;
+        }
+        const RSNetIPv6Header *ipPtr = (const RSNetIPv6Header *)inner;
+        if (ipPtr->nextHeader != IPPROTO_ICMPV6) {
+            return NO;
+        }
+        innerHeaderLength = sizeof(RSNetIPv6Header);
+    } else {
+        if (innerLength < (int)(sizeof(RSNetIPHeader) + sizeof(RSICMPTraceRoutePacket))) {
+            return NO;
+        }
+        const RSNetIPHeader *ipPtr = (const RSNetIPHeader *)inner;
+        if ((ipPtr->versionAndHeaderLength & 0xF0) != 0x40 || ipPtr->protocol != 1) {
+            return NO;
+        }
+        innerHeaderLength = (ipPtr->versionAndHeaderLength & 0x0F) * sizeof(uint32_t);
+        if (innerLength < (int)(innerHeaderLength + sizeof(RSICMPTraceRoutePacket))) {
+            return NO;
+        }
+    }
+    
+    const RSICMPTraceRoutePacket *quoted = (const RSICMPTraceRoutePacket *)(inner + innerHeaderLength);
+    if (quoted->type != (isIPv6 ? RSICMPv6Type_EchoRequest : RSICMPType_EchoRequest)) {
+        return NO;
+    }
+    *identifier = OSSwapBigToHostInt16(quoted->identifier);
+    *seq = OSSwapBigToHostInt16(quoted->seq);
+    return YES;
+}
 
 + (char *)icmpTraceRoutePacketFromBuffer:(char *)buffer
                                   length:(int)length
@@ -324,64 +327,13 @@
 + (uint16_t) in_cksumWithBuffer:(const void *)buffer andSize:(size_t)bufferLen
 {
     /*
-     将数据以字（16位）为单位累加到一个双字中
-     如果数据长度为奇数，最后一个字节将被扩展到字，累加的结果是一个双字，
-     最后将这个双字的高16位和低16位相加后取反
+     将数据以字（16位）为单位累加，奇数长度的最后一个字节扩展为字，
+     进位折回低16位后取反。由 RSNetChecksum 按 CPU 选择向量实现
      */
-    size_t              bytesLeft;
-    int32_t             sum;
-    const uint16_t *    cursor;
-    union {
-        uint16_t        us;
-        uint8_t         uc[2];
-    } last;
-    uint16_t            answer;
-    
-    bytesLeft = bufferLen;
-    sum = 0;
-    cursor = (uint16_t*)buffer;
-    
-    while (bytesLeft > 1) {
-        sum += *cursor;
-        cursor += 1;
-        bytesLeft -= 2;
-    }
-    
-    /* mop up an odd byte, if necessary */
-    if (bytesLeft == 1) {
-        last.uc[0] = * (const uint8_t *) cursor;
-        last.uc[1] = 0;
-        sum += last.us;
-    }
-    
-    /* add back carry outs from top 16 bits to low 16 bits */
-    sum = (sum >> 16) + (sum & 0xffff);    /* add hi 16 to low 16 */
-    sum += (sum >> 16);            /* add carry */
-    answer = (uint16_t) ~sum;   /* truncate to 16 bits */
-    
-    return answer;
+    return RSNetChecksum(buffer, bufferLen);
 }
 
 + (uint16_t)calculateChecksum:(const void *)icmpRequest withLength:(size_t)packetLength {
-    uint32_t checksum = 0;
-    uint16_t *dataPointer = (uint16_t *)icmpRequest;
-    
-    for (int i = 0; i < packetLength / 2; i++) {
-        checksum += *dataPointer++;
-    }
-    
-    // Handle any bytes in the last odd-sized block
-    if (packetLength & 1) {
-        uint16_t oddByte = 0;
-        *((uint8_t *)&oddByte) = *(uint8_t *)dataPointer;
-        checksum += oddByte;
-    }
-    
-    // Fold 32-bit checksum to 16 bits
-    while (checksum >> 16) {
-        checksum = (checksum & 0xffff) + (checksum >> 16);
-    }
-    
-    return ~checksum;
+    return RSNetChecksum(icmpRequest, packetLength);
 }
 @end
@@ -0,0 +1,92 @@
+//
+//  RSAddressSelector.h
+//  RSNetDiagnosis
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+#define kAddressConnectionAttemptDelay  250000      // microsecond, RFC 8305 recommended delay before the next attempt
+#define kAddressAttemptTimeout          2000000     // microsecond, deadline of a single attempt
+
+typedef NS_ENUM(NSInteger, RSAddressRaceMethod) {
+    RSAddressRaceMethodTCP,     // TCP connect to the given port
+    RSAddressRaceMethodICMP,    // One ICMP echo request
+};
+
+//MARK: - RSAddressFamilyResult
+
+@interface RSAddressFamilyResult : NSObject
+/// AF_INET or AF_INET6
+@property (nonatomic, assign, readonly) int family;
+/// Address of this family which was attempted last, or which answered
+@property (nonatomic, copy, readonly) NSString *address;
+/// 0 if answered, `ECANCELED` if still waiting when the other family won, `ETIMEDOUT` or errno otherwise
+@property (nonatomic, assign, readonly) int error;
+/// Microsecond from sending to the answer or failure, monotonic
+@property (nonatomic, assign, readonly) uint64_t latencyMicros;
+@end
+
+
+//MARK: - RSAddressSelection
+
+@interface RSAddressSelection : NSObject
+@property (nonatomic, copy, readonly) NSString *host;
+/// Address to probe, the winner of the race. If no address answered, one which timed out rather than failed to send,
+/// else the first one in RFC 8305 order. nil if host can not be resolved.
+@property (nonatomic, copy, readonly, nullable) NSString *address;
+/// YES if `address` answered during the race, NO if there was no race or every attempt failed
+@property (nonatomic, assign, readonly) BOOL isReachable;
+/// One result per family attempted, empty if host resolved to a single family and no race was needed
+@property (nonatomic, copy, readonly) NSArray<RSAddressFamilyResult *> *familyResults;
+@end
+
+
+//MARK: - RSAddressSelector
+
+typedef void (^RSAddressSelectHandler)(RSAddressSelection *selection);
+
+/**
+ Dual-stack address selection, following Happy Eyeballs (RFC 8305).
+
+ @discussion Resolved addresses are interleaved by family, IPv6 first. Attempts start one after
+ another, each `kAddressConnectionAttemptDelay` after the previous one or as soon as it failed,
+ and the first address to answer wins; attempts still running are cancelled. So a broken family
+ costs at most one attempt delay instead of a full timeout.
+ */
+@interface RSAddressSelector : NSObject
+
++ (instancetype)shareInstance;
+
+/**
+ @brief Order addresses as RFC 8305 section 4, alternating families, IPv6 first.
+ */
++ (NSArray<NSString *> *)sortedAddresses:(NSArray<NSString *> *)addresses;
+
+/**
+ @brief Resolve a host and race its addresses.
+
+ @param host domain or ip
+ @param method how an address is probed
+ @param port destination port of `RSAddressRaceMethodTCP`, ignored by ICMP
+ @param handler called once, on the selector queue
+ */
+- (void)selectAddressForHost:(NSString *)host
+                      method:(RSAddressRaceMethod)method
+                        port:(uint16_t)port
+             completeHandler:(RSAddressSelectHandler)handler;
+
+/**
+ @brief Same as `selectAddressForHost:method:port:completeHandler:`, blocking the calling thread until done.
+ */
+- (RSAddressSelection *)selectAddressForHostSync:(NSString *)host
+                                          method:(RSAddressRaceMethod)method
+                                            port:(uint16_t)port;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,400 @@
+//
+//  RSAddressSelector.m
+//  RSNetDiagnosis
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+
+#import "RSAddressSelector.h"
+#import "RSNetDiagnosisLog.h"
+#import "RSNetDiagnosisHelper.h"
+#import "RSHostResolver.h"
+#import "RSICMPReactor.h"
+#import "RSTCPProbeEngine.h"
+
+typedef void (^RSAddressAttemptHandler)(int error, uint64_t latencyMicros);
+
+/// Fill a sockaddr for an ip string, NO if not an ip
+static BOOL RSAddressFromString(NSString *ip, uint16_t port, struct sockaddr_storage *address)
+{
+    memset(address, 0, sizeof(*address));
+    if ([ip rangeOfString:@":"].location != NSNotFound) {
+        struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *)address;
+        addr6->sin6_len = sizeof(struct sockaddr_in6);
+        addr6->sin6_family = AF_INET6;
+        addr6->sin6_port = htons(port);
+        return inet_pton(AF_INET6, ip.UTF8String, &addr6->sin6_addr) == 1;
+    }
+    struct sockaddr_in *addr4 = (struct sockaddr_in *)address;
+    addr4->sin_len = sizeof(struct sockaddr_in);
+    addr4->sin_family = AF_INET;
+    addr4->sin_port = htons(port);
+    return inet_pton(AF_INET, ip.UTF8String, &addr4->sin_addr) == 1;
+}
+
+static int RSAddressFamily(NSString *ip)
+{
+    return [ip rangeOfString:@":"].location != NSNotFound ? AF_INET6 : AF_INET;
+}
+
+
+//MARK: - RSAddressFamilyResult
+
+@interface RSAddressFamilyResult()
+@property (nonatomic, assign, readwrite) int family;
+@property (nonatomic, copy, readwrite) NSString *address;
+@property (nonatomic, assign, readwrite) int error;
+@property (nonatomic, assign, readwrite) uint64_t latencyMicros;
+@end
+
+@implementation RSAddressFamilyResult
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"%@ %@ : %@ , time:%.3fms", self.family == AF_INET6 ? @"IPv6" : @"IPv4", self.address,
+            self.error == 0 ? @"reachable" : [NSString stringWithUTF8String:strerror(self.error)], self.latencyMicros / 1000.0];
+}
+
+@end
+
+
+//MARK: - RSAddressSelection
+
+@interface RSAddressSelection()
+@property (nonatomic, copy, readwrite) NSString *host;
+@property (nonatomic, copy, readwrite, nullable) NSString *address;
+@property (nonatomic, assign, readwrite) BOOL isReachable;
+@property (nonatomic, copy, readwrite) NSArray<RSAddressFamilyResult *> *familyResults;
+@end
+
+@implementation RSAddressSelection
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"host:%@ , selected:%@%@ , families:%@", self.host, self.address,
+            self.isReachable ? @"" : @" (unverified)", [self.familyResults componentsJoinedByString:@" | "]];
+}
+
+@end
+
+
+//MARK: - RSAddressEchoAttempt
+
+/// A single ICMP echo to one address, driven by `RSICMPReactor`
+@interface RSAddressEchoAttempt : NSObject <RSICMPReactorSession>
+{
+    struct sockaddr_storage _destination;
+    uint16_t _identifier;
+    uint64_t _sendTime;
+    uint64_t _deadline;
+    BOOL _isSent;
+    BOOL _isFinished;
+}
+@property (nonatomic, copy) RSAddressAttemptHandler handler;
+@property (atomic, assign) BOOL cancelled;
+@end
+
+@implementation RSAddressEchoAttempt
+
+- (BOOL)startWithAddress:(const struct sockaddr_storage *)address
+{
+    memcpy(&_destination, address, sizeof(_destination));
+    return [[RSICMPReactor shareInstance] registerSession:self family:_destination.ss_family identifier:&_identifier];
+}
+
+- (void)cancel
+{
+    self.cancelled = YES;
+    [[RSICMPReactor shareInstance] wakeup];
+}
+
+- (void)finishWithError:(int)error now:(uint64_t)now
+{
+    _isFinished = YES;
+    self.handler(error, _isSent ? now - _sendTime : 0);
+}
+
+- (uint64_t)icmpReactorTick:(uint64_t)now
+{
+    if (_isFinished) {
+        return 0;
+    }
+    if (self.cancelled) {
+        [self finishWithError:ECANCELED now:now];
+        return 0;
+    }
+    if (!_isSent) {
+        RSICMPPacket *packet = [RSNetDiagnosisHelper constructICMPEchoPacketWithSeq:0 andIdentifier:_identifier isIPv6:_destination.ss_family == AF_INET6];
+        _sendTime = RSNetMonotonicMicros();
+        ssize_t sent = [[RSICMPReactor shareInstance] sendPacket:packet length:sizeof(RSICMPPacket) toAddress:(struct sockaddr *)&_destination];
+        free(packet);
+        _isSent = YES;
+        if (sent < 0) {
+            [self finishWithError:errno now:RSNetMonotonicMicros()];
+            return 0;
+        }
+        _deadline = _sendTime + kAddressAttemptTimeout;
+    }
+    if (now >= _deadline) {
+        [self finishWithError:ETIMEDOUT now:now];
+        return 0;
+    }
+    return _deadline;
+}
+
+- (void)icmpReactorDidReceivePacket:(char *)buffer
+                             length:(int)length
+                        fromAddress:(const struct sockaddr *)address
+                        receiveTime:(uint64_t)receiveTime
+{
+    if (_isFinished) {
+        return;
+    }
+    BOOL isIPv6 = _destination.ss_family == AF_INET6;
+    uint8_t type = 0;
+    uint16_t identifier = 0, seq = 0;
+    if (![RSNetDiagnosisHelper parseICMPResponseWithBuffer:buffer length:length isIPv6:isIPv6 type:&type identifier:&identifier seq:&seq] ||
+        identifier != _identifier) {
+        return;
+    }
+    BOOL isReply = type == (isIPv6 ? RSICMPv6Type_EchoReply : RSICMPType_EchoReply);
+    [self finishWithError:isReply ? 0 : EHOSTUNREACH now:receiveTime];
+    [[RSICMPReactor shareInstance] wakeup];     // Tick again so the session is removed
+}
+
+@end
+
+
+//MARK: - RSAddressRace
+
+/// State of one selection, only touched on the selector queue
+@interface RSAddressRace : NSObject
+@property (nonatomic, copy) NSString *host;
+@property (nonatomic, assign) RSAddressRaceMethod method;
+@property (nonatomic, assign) uint16_t port;
+@property (nonatomic, copy) NSArray<NSString *> *addresses;
+@property (nonatomic, assign) NSUInteger nextIndex;
+@property (nonatomic, assign) NSUInteger runningCount;
+@property (nonatomic, assign) BOOL isDone;
+/// Cancel blocks of attempts in flight, keyed by address
+@property (nonatomic, strong) NSMutableDictionary<NSString *, dispatch_block_t> *cancelBlocks;
+@property (nonatomic, strong) NSMutableDictionary<NSNumber *, RSAddressFamilyResult *> *familyResults;
+@property (nonatomic, copy) RSAddressSelectHandler handler;
+@end
+
+@implementation RSAddressRace
+@end
+
+
+//MARK: - RSAddressSelector
+
+@interface RSAddressSelector()
+@property (nonatomic, strong) dispatch_queue_t selectQueue;
+@end
+
+@implementation RSAddressSelector
+
++ (instancetype)shareInstance
+{
+    static id instace = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        instace = [[self alloc] init];
+    });
+    return instace;
+}
+
+- (instancetype)init
+{
+    if (self = [super init]) {
+        _selectQueue = dispatch_queue_create("rs_net_address_select_queue", DISPATCH_QUEUE_SERIAL);
+    }
+    return self;
+}
+
++ (NSArray<NSString *> *)sortedAddresses:(NSArray<NSString *> *)addresses
+{
+    NSMutableArray<NSString *> *ipv6 = [NSMutableArray array];
+    NSMutableArray<NSString *> *ipv4 = [NSMutableArray array];
+    for (NSString *address in addresses) {
+        [(RSAddressFamily(address) == AF_INET6 ? ipv6 : ipv4) addObject:address];
+    }
+    NSMutableArray<NSString *> *sorted = [NSMutableArray arrayWithCapacity:addresses.count];
+    for (NSUInteger i = 0; i < MAX(ipv6.count, ipv4.count); i++) {
+        if (i < ipv6.count) {
+            [sorted addObject:ipv6[i]];
+        }
+        if (i < ipv4.count) {
+            [sorted addObject:ipv4[i]];
+        }
+    }
+    return sorted;
+}
+
+#pragma mark - Select
+
+- (void)selectAddressForHost:(NSString *)host
+                      method:(RSAddressRaceMethod)method
+                        port:(uint16_t)port
+             completeHandler:(RSAddressSelectHandler)handler
+{
+    [[RSHostResolver shareInstance] resolveHost:host completeHandler:^(RSHostResolution *resolution) {
+        NSArray<NSString *> *sorted = [RSAddressSelector sortedAddresses:resolution.addresses];
+        dispatch_async(self.selectQueue, ^{
+            RSAddressRace *race = [[RSAddressRace alloc] init];
+            race.host = host;
+            race.method = method;
+            race.port = port;
+            race.addresses = sorted;
+            race.cancelBlocks = [NSMutableDictionary dictionary];
+            race.familyResults = [NSMutableDictionary dictionary];
+            race.handler = handler;
+
+            // Nothing to race with a single family, the first address is as good as any
+            BOOL hasIPv6 = sorted.count > 0 && RSAddressFamily(sorted.firstObject) == AF_INET6;
+            BOOL hasIPv4 = [sorted indexOfObjectPassingTest:^BOOL(NSString *obj, NSUInteger idx, BOOL *stop) {
+                return RSAddressFamily(obj) == AF_INET;
+            }] != NSNotFound;
+            if (!(hasIPv6 && hasIPv4)) {
+                [self finishRace:race winner:sorted.firstObject isReachable:NO];
+                return;
+            }
+            [self startNextAttempt:race];
+        });
+    }];
+}
+
+- (RSAddressSelection *)selectAddressForHostSync:(NSString *)host
+                                          method:(RSAddressRaceMethod)method
+                                            port:(uint16_t)port
+{
+    __block RSAddressSelection *result = nil;
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    [self selectAddressForHost:host method:method port:port completeHandler:^(RSAddressSelection *selection) {
+        result = selection;
+        dispatch_semaphore_signal(semaphore);
+    }];
+    dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+    return result;
+}
+
+/// Called on `selectQueue`
+- (void)startNextAttempt:(RSAddressRace *)race
+{
+    if (race.isDone || race.nextIndex >= race.addresses.count) {
+        return;
+    }
+    NSString *address = race.addresses[race.nextIndex++];
+    race.runningCount++;
+
+    RSAddressAttemptHandler attemptHandler = ^(int error, uint64_t latencyMicros) {
+        dispatch_async(self.selectQueue, ^{
+            [self race:race attemptOfAddress:address finishedWithError:error latency:latencyMicros];
+        });
+    };
+
+    struct sockaddr_storage destination;
+    if (!RSAddressFromString(address, race.port, &destination)) {
+        attemptHandler(EINVAL, 0);
+    } else if (race.method == RSAddressRaceMethodTCP) {
+        RSTCPProbeEngine *engine = [RSTCPProbeEngine shareInstance];
+        uint64_t probeId = [engine connectToAddress:(struct sockaddr *)&destination timeout:kAddressAttemptTimeout handler:attemptHandler];
+        race.cancelBlocks[address] = ^{
+            [engine cancelProbe:probeId];
+        };
+    } else {
+        RSAddressEchoAttempt *attempt = [[RSAddressEchoAttempt alloc] init];
+        attempt.handler = attemptHandler;
+        if ([attempt startWithAddress:&destination]) {
+            race.cancelBlocks[address] = ^{
+                [attempt cancel];
+            };
+        } else {
+            attemptHandler(EAFNOSUPPORT, 0);
+        }
+    }
+
+    // Next attempt starts after the delay, or earlier if this one fails
+    NSUInteger attemptIndex = race.nextIndex;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)kAddressConnectionAttemptDelay * NSEC_PER_USEC), self.selectQueue, ^{
+        if (race.nextIndex == attemptIndex) {
+            [self startNextAttempt:race];
+        }
+    });
+}
+
+/// Called on `selectQueue`
+- (void)race:(RSAddressRace *)race attemptOfAddress:(NSString *)address finishedWithError:(int)error latency:(uint64_t)latencyMicros
+{
+    race.runningCount--;
+    [race.cancelBlocks removeObjectForKey:address];
+    if (race.isDone) {
+        return;
+    }
+
+    // A family keeps its latest answer, see `finishRace:` for attempts still running
+    NSNumber *family = @(RSAddressFamily(address));
+    RSAddressFamilyResult *familyResult = [[RSAddressFamilyResult alloc] init];
+    familyResult.family = family.intValue;
+    familyResult.address = address;
+    familyResult.error = error;
+    familyResult.latencyMicros = latencyMicros;
+    race.familyResults[family] = familyResult;
+
+    if (error == 0) {
+        [self finishRace:race winner:address isReachable:YES];
+        return;
+    }
+    if (race.runningCount == 0) {
+        if (race.nextIndex < race.addresses.count) {
+            [self startNextAttempt:race];
+        } else {
+            // Prefer a family which could send but got no answer over one which could not send at all
+            NSString *fallback = race.addresses.firstObject;
+            for (NSNumber *family in @[@(AF_INET6), @(AF_INET)]) {
+                if (race.familyResults[family].error == ETIMEDOUT) {
+                    fallback = race.familyResults[family].address;
+                    break;
+                }
+            }
+            [self finishRace:race winner:fallback isReachable:NO];
+        }
+    }
+}
+
+/// Called on `selectQueue`
+- (void)finishRace:(RSAddressRace *)race winner:(NSString *)address isReachable:(BOOL)isReachable
+{
+    race.isDone = YES;
+    // Families still waiting when the race ended lost it
+    for (NSString *pending in race.cancelBlocks.allKeys) {
+        NSNumber *family = @(RSAddressFamily(pending));
+        if (!race.familyResults[family]) {
+            RSAddressFamilyResult *familyResult = [[RSAddressFamilyResult alloc] init];
+            familyResult.family = family.intValue;
+            familyResult.address = pending;
+            familyResult.error = ECANCELED;
+            race.familyResults[family] = familyResult;
+        }
+    }
+    for (dispatch_block_t cancel in race.cancelBlocks.allValues) {
+        cancel();
+    }
+
+    RSAddressSelection *selection = [[RSAddressSelection alloc] init];
+    selection.host = race.host;
+    selection.address = address;
+    selection.isReachable = isReachable;
+    NSMutableArray<RSAddressFamilyResult *> *familyResults = [NSMutableArray array];
+    for (NSNumber *family in @[@(AF_INET6), @(AF_INET)]) {
+        if (race.familyResults[family]) {
+            [familyResults addObject:race.familyResults[family]];
+        }
+    }
+    selection.familyResults = familyResults;
+    log4cplus_debug("RSAddressSelector", "%s\n", [selection.description UTF8String]);
+    race.handler(selection);
+}
+
+@end
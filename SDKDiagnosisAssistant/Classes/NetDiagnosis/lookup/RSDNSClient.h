@@ -0,0 +1,97 @@
+//
+//  RSDNSClient.h
+//  RSNetDiagnosis
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+#define kDNSClientDefaultTimeout    3000000     // microsecond, deadline of one lookup
+#define kDNSClientPort              53
+
+typedef NS_ENUM(uint16_t, RSDNSRecordType) {
+    RSDNSRecordTypeA        = 1,
+    RSDNSRecordTypeCNAME    = 5,
+    RSDNSRecordTypeAAAA     = 28,
+};
+
+//MARK: - RSDNSRecord
+
+@interface RSDNSRecord : NSObject
+@property (nonatomic, copy, readonly) NSString *name;
+@property (nonatomic, assign, readonly) RSDNSRecordType type;
+/// Address for A/AAAA, target name for CNAME
+@property (nonatomic, copy, readonly) NSString *value;
+/// Second, as returned by the server
+@property (nonatomic, assign, readonly) uint32_t ttl;
+@end
+
+
+//MARK: - RSDNSQueryResult
+
+/**
+ Answer of one resolver to one question (A or AAAA).
+ */
+@interface RSDNSQueryResult : NSObject
+/// Resolver ip
+@property (nonatomic, copy, readonly) NSString *server;
+@property (nonatomic, assign, readonly) RSDNSRecordType queryType;
+/// 0 if an answer was received, `ETIMEDOUT` when deadline passed, otherwise errno of socket/send/recv,
+/// `EBADMSG` for a malformed response
+@property (nonatomic, assign, readonly) int error;
+/// DNS response code, valid when `error` is 0
+@property (nonatomic, assign, readonly) int rcode;
+/// Microsecond from the first send to the answer, including TCP retry, monotonic
+@property (nonatomic, assign, readonly) uint64_t latencyMicros;
+/// YES if the UDP answer was truncated and the question was asked again over TCP
+@property (nonatomic, assign, readonly) BOOL usedTCP;
+/// A/AAAA records of the queried type, at the end of the CNAME chain
+@property (nonatomic, copy, readonly) NSArray<RSDNSRecord *> *addresses;
+/// Names followed from the queried name to the one holding addresses, queried name excluded
+@property (nonatomic, copy, readonly) NSArray<NSString *> *cnameChain;
+@end
+
+
+//MARK: - RSDNSClient
+
+typedef void (^RSDNSQueryHandler)(NSArray<RSDNSQueryResult *> *results);
+
+/**
+ Minimal DNS wire-format client.
+
+ @discussion A and AAAA questions are sent to every resolver at once over UDP, a truncated
+ answer is asked again over TCP. Every (resolver, question) pair is timed separately, so a slow
+ resolver can be told apart from a slow network.
+ */
+@interface RSDNSClient : NSObject
+
++ (instancetype)shareInstance;
+
+/// Port every resolver is asked on, `kDNSClientPort` by default
+@property (nonatomic, assign) uint16_t port;
+
+/**
+ @brief Resolvers configured for the system, empty if none can be read.
+ */
++ (NSArray<NSString *> *)systemDNSServers;
+
+/**
+ @brief Ask A and AAAA of a domain to each resolver.
+
+ @param domain domain name
+ @param servers resolver ips, IPv4 or IPv6, asked on `port`
+ @param timeoutMicros deadline of the whole lookup in microsecond
+ @param handler called once on a client thread, results ordered by server then A before AAAA
+ */
+- (void)queryDomain:(NSString *)domain
+            servers:(NSArray<NSString *> *)servers
+            timeout:(uint64_t)timeoutMicros
+    completeHandler:(RSDNSQueryHandler)handler;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,605 @@
+//
+//  RSDNSClient.m
+//  RSNetDiagnosis
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+
+#import "RSDNSClient.h"
+#import "RSNetDiagnosisLog.h"
+#import "RSNetDiagnosisHelper.h"
+
+#include <poll.h>
+#include <fcntl.h>
+#include <resolv.h>
+
+#define kDNSHeaderLength        12
+#define kDNSUDPBufferLength     4096
+#define kDNSMaxNameJumps        16      // Bound of compression pointers followed in one name
+#define kDNSMaxCNAMEChain       16
+
+#define kDNSFlagResponse        0x8000
+#define kDNSFlagTruncated       0x0200
+#define kDNSFlagRecursion       0x0100
+#define kDNSClassIN             1
+
+typedef NS_ENUM(NSInteger, RSDNSTransactionState) {
+    RSDNSTransactionStateUDPWaiting,
+    RSDNSTransactionStateTCPConnecting,
+    RSDNSTransactionStateTCPReading,
+    RSDNSTransactionStateDone,
+};
+
+//MARK: - RSDNSRecord
+
+@interface RSDNSRecord()
+@property (nonatomic, copy, readwrite) NSString *name;
+@property (nonatomic, assign, readwrite) RSDNSRecordType type;
+@property (nonatomic, copy, readwrite) NSString *value;
+@property (nonatomic, assign, readwrite) uint32_t ttl;
+@end
+
+@implementation RSDNSRecord
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"%@ %u %@ %@", self.name, self.ttl,
+            self.type == RSDNSRecordTypeCNAME ? @"CNAME" : (self.type == RSDNSRecordTypeAAAA ? @"AAAA" : @"A"), self.value];
+}
+
+@end
+
+
+//MARK: - RSDNSQueryResult
+
+@interface RSDNSQueryResult()
+@property (nonatomic, copy, readwrite) NSString *server;
+@property (nonatomic, assign, readwrite) RSDNSRecordType queryType;
+@property (nonatomic, assign, readwrite) int error;
+@property (nonatomic, assign, readwrite) int rcode;
+@property (nonatomic, assign, readwrite) uint64_t latencyMicros;
+@property (nonatomic, assign, readwrite) BOOL usedTCP;
+@property (nonatomic, copy, readwrite) NSArray<RSDNSRecord *> *addresses;
+@property (nonatomic, copy, readwrite) NSArray<NSString *> *cnameChain;
+@end
+
+@implementation RSDNSQueryResult
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"server:%@ , type:%@ , error:%d , rcode:%d , time:%.3fms%@ , cname:%@ , addresses:%@",
+            self.server, self.queryType == RSDNSRecordTypeAAAA ? @"AAAA" : @"A", self.error, self.rcode,
+            self.latencyMicros / 1000.0, self.usedTCP ? @" (tcp)" : @"",
+            [self.cnameChain componentsJoinedByString:@"->"], [self.addresses valueForKey:@"value"]];
+}
+
+@end
+
+
+//MARK: - RSDNSTransaction
+
+/// One question to one resolver
+@interface RSDNSTransaction : NSObject
+{
+@public
+    struct sockaddr_storage _address;
+    socklen_t _addressLength;
+}
+@property (nonatomic, strong) RSDNSQueryResult *result;
+@property (nonatomic, assign) RSDNSTransactionState state;
+@property (nonatomic, assign) int fd;
+@property (nonatomic, assign) uint16_t queryId;
+@property (nonatomic, strong) NSData *query;
+@property (nonatomic, strong) NSMutableData *tcpBuffer;
+@property (nonatomic, assign) uint64_t startTime;   // microsecond, monotonic
+@end
+
+@implementation RSDNSTransaction
+@end
+
+
+//MARK: - Wire format
+
+/// Question section of a query for `domain`, nil if the name cannot be encoded
+static NSData *RSDNSEncodeQuery(NSString *domain, uint16_t queryId, uint16_t queryType)
+{
+    NSMutableData *query = [NSMutableData dataWithCapacity:kDNSHeaderLength + domain.length + 6];
+    uint16_t header[6] = { htons(queryId), htons(kDNSFlagRecursion), htons(1), 0, 0, 0 };
+    [query appendBytes:header length:sizeof(header)];
+
+    NSUInteger nameLength = 0;
+    for (NSString *label in [domain componentsSeparatedByString:@"."]) {
+        if (label.length == 0) {
+            continue;   // Trailing dot
+        }
+        NSData *labelData = [label dataUsingEncoding:NSUTF8StringEncoding];
+        if (labelData.length > 63) {
+            return nil;
+        }
+        uint8_t labelLength = (uint8_t)labelData.length;
+        [query appendBytes:&labelLength length:1];
+        [query appendData:labelData];
+        nameLength += labelData.length + 1;
+    }
+    if (nameLength == 0 || nameLength + 1 > 255) {
+        return nil;
+    }
+    uint8_t root = 0;
+    [query appendBytes:&root length:1];
+
+    uint16_t question[2] = { htons(queryType), htons(kDNSClassIN) };
+    [query appendBytes:question length:sizeof(question)];
+    return query;
+}
+
+/// Read a possibly compressed name at `*offset`, advancing it past the name. Dots joined, no trailing dot.
+static NSString *RSDNSReadName(const uint8_t *buffer, size_t length, size_t *offset)
+{
+    NSMutableString *name = [NSMutableString string];
+    size_t pos = *offset;
+    int jumps = 0;
+    BOOL jumped = NO;
+    while (YES) {
+        if (pos >= length) {
+            return nil;
+        }
+        uint8_t labelLength = buffer[pos];
+        if ((labelLength & 0xC0) == 0xC0) {
+            if (pos + 1 >= length || ++jumps > kDNSMaxNameJumps) {
+                return nil;
+            }
+            if (!jumped) {
+                *offset = pos + 2;
+                jumped = YES;
+            }
+            pos = ((labelLength & 0x3F) << 8) | buffer[pos + 1];
+            continue;
+        }
+        if (labelLength & 0xC0) {
+            return nil;     // Extended label types are not used by answers we ask for
+        }
+        pos++;
+        if (labelLength == 0) {
+            break;
+        }
+        if (pos + labelLength > length) {
+            return nil;
+        }
+        NSString *label = [[NSString alloc] initWithBytes:buffer + pos length:labelLength encoding:NSUTF8StringEncoding];
+        if (!label) {
+            return nil;
+        }
+        if (name.length > 0) {
+            [name appendString:@"."];
+        }
+        [name appendString:label];
+        pos += labelLength;
+    }
+    if (!jumped) {
+        *offset = pos;
+    }
+    return name;
+}
+
+static uint16_t RSDNSReadUInt16(const uint8_t *buffer)
+{
+    return (uint16_t)((buffer[0] << 8) | buffer[1]);
+}
+
+/**
+ Parse a response to `transaction`.
+
+ @return NO if the message is not an answer to this transaction, and should be ignored
+ */
+static BOOL RSDNSParseResponse(const uint8_t *buffer, size_t length, RSDNSTransaction *transaction, NSString *domain, BOOL *truncated)
+{
+    if (length < kDNSHeaderLength || RSDNSReadUInt16(buffer) != transaction.queryId) {
+        return NO;
+    }
+    uint16_t flags = RSDNSReadUInt16(buffer + 2);
+    if (!(flags & kDNSFlagResponse)) {
+        return NO;
+    }
+    *truncated = (flags & kDNSFlagTruncated) != 0;
+    if (*truncated) {
+        return YES;     // Answers may be cut anywhere, asked again over TCP
+    }
+
+    RSDNSQueryResult *result = transaction.result;
+    result.rcode = flags & 0x000F;
+    uint16_t questionCount = RSDNSReadUInt16(buffer + 4);
+    uint16_t answerCount = RSDNSReadUInt16(buffer + 6);
+
+    size_t offset = kDNSHeaderLength;
+    for (uint16_t i = 0; i < questionCount; i++) {
+        if (!RSDNSReadName(buffer, length, &offset) || offset + 4 > length) {
+            result.error = EBADMSG;
+            return YES;
+        }
+        offset += 4;
+    }
+
+    NSMutableArray<RSDNSRecord *> *records = [NSMutableArray arrayWithCapacity:answerCount];
+    for (uint16_t i = 0; i < answerCount; i++) {
+        NSString *name = RSDNSReadName(buffer, length, &offset);
+        if (!name || offset + 10 > length) {
+            result.error = EBADMSG;
+            return YES;
+        }
+        uint16_t type = RSDNSReadUInt16(buffer + offset);
+        uint16_t rclass = RSDNSReadUInt16(buffer + offset + 2);
+        uint32_t ttl = ((uint32_t)RSDNSReadUInt16(buffer + offset + 4) << 16) | RSDNSReadUInt16(buffer + offset + 6);
+        uint16_t dataLength = RSDNSReadUInt16(buffer + offset + 8);
+        offset += 10;
+        if (offset + dataLength > length) {
+            result.error = EBADMSG;
+            return YES;
+        }
+
+        NSString *value = nil;
+        if (rclass == kDNSClassIN && type == RSDNSRecordTypeA && dataLength == 4) {
+            char ip[INET_ADDRSTRLEN];
+            value = inet_ntop(AF_INET, buffer + offset, ip, sizeof(ip)) ? [NSString stringWithUTF8String:ip] : nil;
+        } else if (rclass == kDNSClassIN && type == RSDNSRecordTypeAAAA && dataLength == 16) {
+            char ip[INET6_ADDRSTRLEN];
+            value = inet_ntop(AF_INET6, buffer + offset, ip, sizeof(ip)) ? [NSString stringWithUTF8String:ip] : nil;
+        } else if (rclass == kDNSClassIN && type == RSDNSRecordTypeCNAME) {
+            size_t nameOffset = offset;
+            value = RSDNSReadName(buffer, length, &nameOffset);
+        }
+        offset += dataLength;
+        if (!value) {
+            continue;
+        }
+
+        RSDNSRecord *record = [[RSDNSRecord alloc] init];
+        record.name = name;
+        record.type = (RSDNSRecordType)type;
+        record.value = value;
+        record.ttl = ttl;
+        [records addObject:record];
+    }
+
+    // Follow CNAMEs from the queried name
+    NSMutableArray<NSString *> *chain = [NSMutableArray array];
+    NSString *current = [domain hasSuffix:@"."] ? [domain substringToIndex:domain.length - 1] : domain;
+    for (int depth = 0; depth < kDNSMaxCNAMEChain; depth++) {
+        NSString *target = nil;
+        for (RSDNSRecord *record in records) {
+            if (record.type == RSDNSRecordTypeCNAME && [record.name caseInsensitiveCompare:current] == NSOrderedSame) {
+                target = record.value;
+                break;
+            }
+        }
+        if (!target) {
+            break;
+        }
+        [chain addObject:target];
+        current = target;
+    }
+
+    NSMutableArray<RSDNSRecord *> *addresses = [NSMutableArray array];
+    for (RSDNSRecord *record in records) {
+        if (record.type == result.queryType && [record.name caseInsensitiveCompare:current] == NSOrderedSame) {
+            [addresses addObject:record];
+        }
+    }
+    result.cnameChain = chain;
+    result.addresses = addresses;
+    return YES;
+}
+
+
+//MARK: - RSDNSClient
+
+@interface RSDNSClient()
+@property (nonatomic, strong) dispatch_queue_t queryQueue;
+@end
+
+@implementation RSDNSClient
+
++ (instancetype)shareInstance
+{
+    static id instace = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        instace = [[self alloc] init];
+    });
+    return instace;
+}
+
+- (instancetype)init
+{
+    if (self = [super init]) {
+        _queryQueue = dispatch_queue_create("rs_net_dns_query_queue", DISPATCH_QUEUE_CONCURRENT);
+        _port = kDNSClientPort;
+    }
+    return self;
+}
+
++ (NSArray<NSString *> *)systemDNSServers
+{
+    NSMutableArray<NSString *> *servers = [NSMutableArray array];
+    struct __res_state state;
+    memset(&state, 0, sizeof(state));
+    if (res_ninit(&state) != 0) {
+        log4cplus_warn("RSDNSClient", "res_ninit error\n");
+        return servers;
+    }
+    union res_sockaddr_union addresses[MAXNS];
+    int count = res_getservers(&state, addresses, MAXNS);
+    for (int i = 0; i < count; i++) {
+        const struct sockaddr *sa = (const struct sockaddr *)&addresses[i];
+        socklen_t saLength = sa->sa_family == AF_INET6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+        char host[NI_MAXHOST];
+        if (getnameinfo(sa, saLength, host, sizeof(host), NULL, 0, NI_NUMERICHOST) == 0) {
+            NSString *server = [NSString stringWithUTF8String:host];
+            if (![servers containsObject:server]) {
+                [servers addObject:server];
+            }
+        }
+    }
+    res_ndestroy(&state);
+    return servers;
+}
+
+#pragma mark - Query
+
+- (void)queryDomain:(NSString *)domain
+            servers:(NSArray<NSString *> *)servers
+            timeout:(uint64_t)timeoutMicros
+    completeHandler:(RSDNSQueryHandler)handler
+{
+    NSString *queryDomain = [domain copy];
+    NSArray<NSString *> *queryServers = [servers copy];
+    dispatch_async(self.queryQueue, ^{
+        handler([self runQueryDomain:queryDomain servers:queryServers timeout:timeoutMicros]);
+    });
+}
+
+/// Blocking, one poll loop for every transaction of a lookup
+- (NSArray<RSDNSQueryResult *> *)runQueryDomain:(NSString *)domain
+                                        servers:(NSArray<NSString *> *)servers
+                                        timeout:(uint64_t)timeoutMicros
+{
+    NSMutableArray<RSDNSTransaction *> *transactions = [NSMutableArray arrayWithCapacity:servers.count * 2];
+    for (NSString *server in servers) {
+        for (NSNumber *type in @[@(RSDNSRecordTypeA), @(RSDNSRecordTypeAAAA)]) {
+            RSDNSTransaction *transaction = [[RSDNSTransaction alloc] init];
+            transaction.fd = -1;
+            transaction.result = [[RSDNSQueryResult alloc] init];
+            transaction.result.server = server;
+            transaction.result.queryType = (RSDNSRecordType)type.unsignedShortValue;
+            transaction.result.addresses = @[];
+            transaction.result.cnameChain = @[];
+            [transactions addObject:transaction];
+        }
+    }
+
+    uint64_t deadline = RSNetMonotonicMicros() + timeoutMicros;
+    for (RSDNSTransaction *transaction in transactions) {
+        [self startUDPTransaction:transaction domain:domain];
+    }
+
+    uint8_t buffer[kDNSUDPBufferLength];
+    while (YES) {
+        NSMutableArray<RSDNSTransaction *> *waiting = [NSMutableArray arrayWithCapacity:transactions.count];
+        for (RSDNSTransaction *transaction in transactions) {
+            if (transaction.state != RSDNSTransactionStateDone) {
+                [waiting addObject:transaction];
+            }
+        }
+        uint64_t now = RSNetMonotonicMicros();
+        if (waiting.count == 0) {
+            break;
+        }
+        if (now >= deadline) {
+            for (RSDNSTransaction *transaction in waiting) {
+                [self finishTransaction:transaction error:ETIMEDOUT now:now];
+            }
+            break;
+        }
+
+        struct pollfd *fds = (struct pollfd *)calloc(waiting.count, sizeof(struct pollfd));
+        for (NSUInteger i = 0; i < waiting.count; i++) {
+            short events = waiting[i].state == RSDNSTransactionStateTCPConnecting ? POLLOUT : POLLIN;
+            fds[i] = (struct pollfd){ waiting[i].fd, events, 0 };
+        }
+        int ready = poll(fds, (nfds_t)waiting.count, (int)((deadline - now + 999) / 1000));
+        uint64_t readyTime = RSNetMonotonicMicros();
+        if (ready < 0 && errno != EINTR) {
+            log4cplus_warn("RSDNSClient", "poll error: %s\n", strerror(errno));
+        }
+
+        for (NSUInteger i = 0; i < waiting.count && ready > 0; i++) {
+            if (!(fds[i].revents & (POLLIN | POLLOUT | POLLERR | POLLHUP))) {
+                continue;
+            }
+            RSDNSTransaction *transaction = waiting[i];
+            switch (transaction.state) {
+                case RSDNSTransactionStateUDPWaiting:
+                    [self readUDPTransaction:transaction domain:domain buffer:buffer now:readyTime];
+                    break;
+                case RSDNSTransactionStateTCPConnecting:
+                    [self sendTCPTransaction:transaction now:readyTime];
+                    break;
+                case RSDNSTransactionStateTCPReading:
+                    [self readTCPTransaction:transaction domain:domain buffer:buffer now:readyTime];
+                    break;
+                default:
+                    break;
+            }
+        }
+        free(fds);
+    }
+
+    NSMutableArray<RSDNSQueryResult *> *results = [NSMutableArray arrayWithCapacity:transactions.count];
+    for (RSDNSTransaction *transaction in transactions) {
+        [results addObject:transaction.result];
+        log4cplus_debug("RSDNSClient", "%s\n", [transaction.result.description UTF8String]);
+    }
+    return results;
+}
+
+- (void)finishTransaction:(RSDNSTransaction *)transaction error:(int)error now:(uint64_t)now
+{
+    if (transaction.fd >= 0) {
+        close(transaction.fd);
+        transaction.fd = -1;
+    }
+    if (error != 0) {
+        transaction.result.error = error;
+    }
+    transaction.result.latencyMicros = transaction.startTime > 0 ? now - transaction.startTime : 0;
+    transaction.state = RSDNSTransactionStateDone;
+}
+
+#pragma mark - UDP
+
+- (void)startUDPTransaction:(RSDNSTransaction *)transaction domain:(NSString *)domain
+{
+    struct addrinfo hints, *res = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_NUMERICHOST;
+    NSString *port = [NSString stringWithFormat:@"%u", self.port];
+    if (getaddrinfo([transaction.result.server UTF8String], [port UTF8String], &hints, &res) != 0 || !res) {
+        log4cplus_warn("RSDNSClient", "invalid dns server: %s\n", [transaction.result.server UTF8String]);
+        [self finishTransaction:transaction error:EINVAL now:0];
+        return;
+    }
+    memcpy(&transaction->_address, res->ai_addr, res->ai_addrlen);
+    transaction->_addressLength = res->ai_addrlen;
+    freeaddrinfo(res);
+
+    transaction.queryId = (uint16_t)arc4random_uniform(UINT16_MAX + 1);
+    transaction.query = RSDNSEncodeQuery(domain, transaction.queryId, transaction.result.queryType);
+    if (!transaction.query) {
+        [self finishTransaction:transaction error:EINVAL now:0];
+        return;
+    }
+
+    int fd = socket(transaction->_address.ss_family, SOCK_DGRAM, IPPROTO_UDP);
+    if (fd < 0) {
+        [self finishTransaction:transaction error:errno now:0];
+        return;
+    }
+    transaction.fd = fd;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    // Connected, so only this server's datagrams are delivered and ICMP errors surface in recv
+    transaction.startTime = RSNetMonotonicMicros();
+    if (connect(fd, (struct sockaddr *)&transaction->_address, transaction->_addressLength) < 0 ||
+        send(fd, transaction.query.bytes, transaction.query.length, 0) < 0) {
+        [self finishTransaction:transaction error:errno now:RSNetMonotonicMicros()];
+        return;
+    }
+    transaction.state = RSDNSTransactionStateUDPWaiting;
+}
+
+- (void)readUDPTransaction:(RSDNSTransaction *)transaction domain:(NSString *)domain buffer:(uint8_t *)buffer now:(uint64_t)now
+{
+    ssize_t length = recv(transaction.fd, buffer, kDNSUDPBufferLength, 0);
+    if (length < 0) {
+        if (errno != EAGAIN && errno != EINTR) {
+            [self finishTransaction:transaction error:errno now:now];
+        }
+        return;
+    }
+
+    BOOL truncated = NO;
+    if (!RSDNSParseResponse(buffer, (size_t)length, transaction, domain, &truncated)) {
+        return;     // Stray or spoofed datagram, keep waiting
+    }
+    if (truncated) {
+        [self startTCPTransaction:transaction now:now];
+        return;
+    }
+    [self finishTransaction:transaction error:0 now:now];
+}
+
+#pragma mark - TCP
+
+- (void)startTCPTransaction:(RSDNSTransaction *)transaction now:(uint64_t)now
+{
+    close(transaction.fd);
+    transaction.fd = -1;
+    transaction.result.usedTCP = YES;
+    transaction.result.addresses = @[];
+    transaction.result.cnameChain = @[];
+
+    int fd = socket(transaction->_address.ss_family, SOCK_STREAM, IPPROTO_TCP);
+    if (fd < 0) {
+        [self finishTransaction:transaction error:errno now:now];
+        return;
+    }
+    transaction.fd = fd;
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    if (connect(fd, (struct sockaddr *)&transaction->_address, transaction->_addressLength) == 0) {
+        transaction.state = RSDNSTransactionStateTCPConnecting;
+        [self sendTCPTransaction:transaction now:now];
+    } else if (errno == EINPROGRESS) {
+        transaction.state = RSDNSTransactionStateTCPConnecting;
+    } else {
+        [self finishTransaction:transaction error:errno now:now];
+    }
+}
+
+- (void)sendTCPTransaction:(RSDNSTransaction *)transaction now:(uint64_t)now
+{
+    int err = 0;
+    socklen_t errLen = sizeof(err);
+    if (getsockopt(transaction.fd, SOL_SOCKET, SO_ERROR, &err, &errLen) < 0) {
+        err = errno;
+    }
+    if (err != 0) {
+        [self finishTransaction:transaction error:err now:now];
+        return;
+    }
+
+    // Messages over TCP are prefixed with their length
+    NSMutableData *message = [NSMutableData dataWithCapacity:transaction.query.length + 2];
+    uint16_t length = htons((uint16_t)transaction.query.length);
+    [message appendBytes:&length length:sizeof(length)];
+    [message appendData:transaction.query];
+    ssize_t sent = send(transaction.fd, message.bytes, message.length, 0);
+    if (sent != (ssize_t)message.length) {
+        [self finishTransaction:transaction error:sent < 0 ? errno : EIO now:now];
+        return;
+    }
+    transaction.tcpBuffer = [NSMutableData data];
+    transaction.state = RSDNSTransactionStateTCPReading;
+}
+
+- (void)readTCPTransaction:(RSDNSTransaction *)transaction domain:(NSString *)domain buffer:(uint8_t *)buffer now:(uint64_t)now
+{
+    ssize_t length = recv(transaction.fd, buffer, kDNSUDPBufferLength, 0);
+    if (length < 0) {
+        if (errno != EAGAIN && errno != EINTR) {
+            [self finishTransaction:transaction error:errno now:now];
+        }
+        return;
+    }
+    if (length == 0) {
+        [self finishTransaction:transaction error:ECONNRESET now:now];
+        return;
+    }
+    [transaction.tcpBuffer appendBytes:buffer length:(NSUInteger)length];
+
+    const uint8_t *bytes = (const uint8_t *)transaction.tcpBuffer.bytes;
+    if (transaction.tcpBuffer.length < 2 || transaction.tcpBuffer.length < 2 + (size_t)RSDNSReadUInt16(bytes)) {
+        return;     // Wait for the rest of the message
+    }
+    BOOL truncated = NO;
+    if (!RSDNSParseResponse(bytes + 2, RSDNSReadUInt16(bytes), transaction, domain, &truncated)) {
+        transaction.result.error = EBADMSG;
+    }
+    [self finishTransaction:transaction error:0 now:now];
+}
+
+@end
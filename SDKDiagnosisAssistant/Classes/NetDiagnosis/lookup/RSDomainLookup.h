@@ -16,6 +16,14 @@ NS_ASSUME_NONNULL_BEGIN
 @property (nonatomic, copy) NSString * name;
 @property (nonatomic, copy) NSString * ip;
 @property (nonatomic, assign) int ipVersion;    // AF_INET or AF_INET6
+@property (nonatomic, assign) NSTimeInterval lookupTime;   // ms, time of the query that resolved it
+@property (nonatomic, assign) BOOL fromCache;
+/// Second, 0 if not known, e.g. answered by the system resolver
+@property (nonatomic, assign) uint32_t ttl;
+/// Names followed from the queried domain to `name`, empty if not known
+@property (nonatomic, copy) NSArray<NSString *> *cnameChain;
+/// Resolver that answered, nil for the system resolver
+@property (nonatomic, copy, nullable) NSString *server;
 
 + (instancetype)instanceWithName:(NSString *)name address:(NSString *)address ipVersion:(int)ipVersion;
 
@@ -32,7 +40,7 @@ typedef void (^RSLookupResultHandler)(NSMutableArray<RSDomainLookUpResult *>  *_
 
 /**
  @brief Loopup domain
- @discussion Only support IPv4
+ @discussion Only IPv4 addresses are returned. Answered by `RSHostResolver`, handler is called on a resolver thread
  
  @param domain domain name
  @param handler lookup result callback
@@ -41,13 +49,28 @@ typedef void (^RSLookupResultHandler)(NSMutableArray<RSDomainLookUpResult *>  *_
 
 /**
  @brief Loopup domain
- @discussion Support both IPv4 & IPv6
+ @discussion Support both IPv4 & IPv6. Answered by `RSHostResolver`, handler is called on a resolver thread
  
  @param domain domain name
  @param handler lookup result callback
  */
 - (void)lookupDomain:(NSString * _Nonnull)domain completeHandler:(RSLookupResultHandler _Nonnull)handler;
 
+/**
+ @brief Loopup domain on each resolver
+ @discussion A and AAAA are asked to every resolver in parallel by `RSDNSClient`, one result per answered
+ address and resolver, carrying the latency of that resolver, the TTL and the CNAME chain.
+ Resolvers which did not answer are logged, error is only returned if none answered.
+ Handler is called on a client thread
+ 
+ @param domain domain name
+ @param servers resolver ips, nil for `+[RSDNSClient systemDNSServers]`
+ @param handler lookup result callback
+ */
+- (void)lookupDomain:(NSString * _Nonnull)domain
+          dnsServers:(NSArray<NSString *> * _Nullable)servers
+     completeHandler:(RSLookupResultHandler _Nonnull)handler;
+
 @end
 
 NS_ASSUME_NONNULL_END
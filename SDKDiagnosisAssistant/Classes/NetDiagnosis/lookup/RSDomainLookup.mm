@@ -12,6 +12,8 @@
 #import <netdb.h>
 
 #import "RSNetDiagnosisLog.h"
+#import "RSHostResolver.h"
+#import "RSDNSClient.h"
 
 //MARK: - RSDomainLookUpResult
 
@@ -23,6 +25,7 @@
         _name = name;
         _ip = address;
         _ipVersion = ipVersion;
+        _cnameChain = @[];
     }
     return self;
 }
@@ -38,7 +41,14 @@
     if (_ipVersion == AF_INET6) {
         ipVersionDesc = @"IPv6";
     }
-    return [NSString stringWithFormat:@"Name: %@, ipVersion: %@, IP: %@", _name, ipVersionDesc, _ip];
+    NSMutableString *desc = [NSMutableString stringWithFormat:@"Name: %@, ipVersion: %@, IP: %@, lookup time: %.3fms%@", _name, ipVersionDesc, _ip, _lookupTime, _fromCache ? @" (cached)" : @""];
+    if (_server) {
+        [desc appendFormat:@", server: %@, ttl: %us", _server, _ttl];
+    }
+    if (_cnameChain.count > 0) {
+        [desc appendFormat:@", cname: %@", [_cnameChain componentsJoinedByString:@" -> "]];
+    }
+    return desc;
 }
 
 @end
@@ -47,10 +57,6 @@
 //MARK: - RSDomainLookup
 
 @interface RSDomainLookup()
-{
-    int socket_client;
-    struct sockaddr_in remote_addr;
-}
 @end
 
 @implementation RSDomainLookup
@@ -79,34 +85,40 @@
         handler(nil, [NSError errorWithDomain:@"domain invalid" code:-1 userInfo:nil]);
         return;
     }
-    const char *hostaddr = [domain UTF8String];
-    memset(&remote_addr, 0, sizeof(remote_addr));
-    remote_addr.sin_addr.s_addr = inet_addr(hostaddr);
     
-    if (remote_addr.sin_addr.s_addr == INADDR_NONE) {
-        struct hostent *remoteHost = gethostbyname(hostaddr);
-        if (remoteHost == NULL || remoteHost->h_addr == NULL) {
+    [[RSHostResolver shareInstance] resolveHost:domain completeHandler:^(RSHostResolution *resolution) {
+        NSMutableArray *mutArray = [self lookupResultsWithResolution:resolution family:AF_INET];
+        if (mutArray.count == 0) {
             log4cplus_warn("RSNetDiagnosisLookup", "DNS parsing error...\n");
             handler(nil, [NSError errorWithDomain:@"DNS Parsing failure" code:-1 userInfo:nil]);
             return;
         }
-        
-        NSMutableArray *mutArray = [NSMutableArray array];
-        for (int i = 0; remoteHost->h_addr_list[i]; i++) {
-            log4cplus_debug("RSNetDiagnosisLookup", "IP addr %d , name: %s , addr:%s  \n",i+1,remoteHost->h_name,inet_ntoa(*(struct in_addr*)remoteHost->h_addr_list[i]));
-            [mutArray addObject:[RSDomainLookUpResult  instanceWithName:[NSString stringWithUTF8String:remoteHost->h_name] address:[NSString stringWithUTF8String:inet_ntoa(*(struct in_addr*)remoteHost->h_addr_list[i])] ipVersion:AF_INET]];
-        }
-        handler(mutArray,nil);
+        handler(mutArray, nil);
+    }];
+}
+
+
+- (void)lookupDomain:(NSString * _Nonnull)domain
+     completeHandler:(RSLookupResultHandler _Nonnull)handler
+{
+    if (![self isValidDomain:domain]) {
+        log4cplus_warn("RSNetDiagnosisLookup", "your setting domain invalid..\n");
+        handler(nil, [NSError errorWithDomain:@"domain invalid" code:-1 userInfo:nil]);
         return;
     }
     
-    log4cplus_warn("RSNetDiagnosisLookup", "your setting domain error..\n");
-    handler(nil, [NSError errorWithDomain:@"domain error" code:-1 userInfo:nil]);
-    return;
+    [[RSHostResolver shareInstance] resolveHost:domain completeHandler:^(RSHostResolution *resolution) {
+        if (resolution.error != 0) {
+            log4cplus_warn("RSNetDiagnosisLookup", "getaddrinfo error: %s\n", gai_strerror(resolution.error));
+            handler(nil, [NSError errorWithDomain:@"DNS Parsing failure" code:-1 userInfo:nil]);
+            return;
+        }
+        handler([self lookupResultsWithResolution:resolution family:AF_UNSPEC], nil);
+    }];
 }
 
-
 - (void)lookupDomain:(NSString * _Nonnull)domain
+          dnsServers:(NSArray<NSString *> * _Nullable)servers
      completeHandler:(RSLookupResultHandler _Nonnull)handler
 {
     if (![self isValidDomain:domain]) {
@@ -114,45 +126,54 @@
         handler(nil, [NSError errorWithDomain:@"domain invalid" code:-1 userInfo:nil]);
         return;
     }
-    const char *hostName = [domain UTF8String];
-    NSMutableArray *result = [NSMutableArray array];
-    
-    struct addrinfo hints, *res, *res0;
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family = PF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
-    hints.ai_flags = AI_DEFAULT;
-    
-    int error = getaddrinfo(hostName, NULL, &hints, &res0);
-    if (error) {
-        NSLog(@"getaddrinfo host :%s ,error: %s", hostName, gai_strerror(error));
-        log4cplus_warn("RSNetDiagnosisLookup", "getaddrinfo error: %s", gai_strerror(error));
-        handler(nil, [NSError errorWithDomain:@"DNS Parsing failure" code:-1 userInfo:nil]);
+    NSArray<NSString *> *dnsServers = servers ?: [RSDNSClient systemDNSServers];
+    if (dnsServers.count == 0) {
+        log4cplus_warn("RSNetDiagnosisLookup", "no dns server to query...\n");
+        handler(nil, [NSError errorWithDomain:@"No DNS server" code:-1 userInfo:nil]);
         return;
     }
     
-    for (res = res0; res; res = res->ai_next) {
-        char buf[INET6_ADDRSTRLEN];
-        if (res->ai_family == AF_INET) {
-            struct sockaddr_in *s = (struct sockaddr_in *)res->ai_addr;
-            inet_ntop(res->ai_family, &s->sin_addr, buf, sizeof(buf));
-        } else if (res->ai_family == AF_INET6) {
-            struct sockaddr_in6 *s = (struct sockaddr_in6 *)res->ai_addr;
-            inet_ntop(res->ai_family, &s->sin6_addr, buf, sizeof(buf));
-        } else {
-            buf[0] = '\0';
+    [[RSDNSClient shareInstance] queryDomain:domain servers:dnsServers timeout:kDNSClientDefaultTimeout completeHandler:^(NSArray<RSDNSQueryResult *> *results) {
+        NSMutableArray<RSDomainLookUpResult *> *mutArray = [NSMutableArray array];
+        for (RSDNSQueryResult *queryResult in results) {
+            if (queryResult.error != 0 || queryResult.rcode != 0) {
+                log4cplus_warn("RSNetDiagnosisLookup", "server: %s, error: %d, rcode: %d, time: %.3fms\n", [queryResult.server UTF8String], queryResult.error, queryResult.rcode, queryResult.latencyMicros / 1000.0);
+                continue;
+            }
+            for (RSDNSRecord *record in queryResult.addresses) {
+                int ipVersion = record.type == RSDNSRecordTypeAAAA ? AF_INET6 : AF_INET;
+                RSDomainLookUpResult *lookUpResult = [RSDomainLookUpResult instanceWithName:record.name address:record.value ipVersion:ipVersion];
+                lookUpResult.lookupTime = queryResult.latencyMicros / 1000.0;
+                lookUpResult.ttl = record.ttl;
+                lookUpResult.cnameChain = queryResult.cnameChain;
+                lookUpResult.server = queryResult.server;
+                [mutArray addObject:lookUpResult];
+            }
+        }
+        if (mutArray.count == 0) {
+            log4cplus_warn("RSNetDiagnosisLookup", "DNS parsing error...\n");
+            handler(nil, [NSError errorWithDomain:@"DNS Parsing failure" code:-1 userInfo:nil]);
+            return;
         }
-        NSString *ip = [NSString stringWithUTF8String:buf];
-        NSString *name = domain;
-        if (res->ai_canonname) {
-            name = [NSString stringWithUTF8String:res->ai_canonname];
+        handler(mutArray, nil);
+    }];
+}
+
+/// Results of addresses in `family`, AF_UNSPEC for all
+- (NSMutableArray<RSDomainLookUpResult *> *)lookupResultsWithResolution:(RSHostResolution *)resolution family:(int)family
+{
+    NSMutableArray<RSDomainLookUpResult *> *result = [NSMutableArray array];
+    for (NSString *ip in resolution.addresses) {
+        int ipVersion = [ip rangeOfString:@":"].location != NSNotFound ? AF_INET6 : AF_INET;
+        if (family != AF_UNSPEC && family != ipVersion) {
+            continue;
         }
-        [result addObject:[RSDomainLookUpResult instanceWithName:name address:ip ipVersion:res->ai_family]];
+        RSDomainLookUpResult *lookUpResult = [RSDomainLookUpResult instanceWithName:resolution.canonicalName address:ip ipVersion:ipVersion];
+        lookUpResult.lookupTime = resolution.resolveMicros / 1000.0;
+        lookUpResult.fromCache = resolution.fromCache;
+        [result addObject:lookUpResult];
     }
-    freeaddrinfo(res0);
-    
-    handler(result, nil);
-    return;
+    return result;
 }
 
 - (BOOL)isValidDomain:(NSString *)domain
@@ -0,0 +1,75 @@
+//
+//  RSHostResolver.h
+//  RSNetDiagnosis
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+#define kHostResolverPositiveTTL    60      // second, how long resolved addresses are reused
+#define kHostResolverNegativeTTL    10      // second, how long a name that does not exist is remembered
+
+//MARK: - RSHostResolution
+
+@interface RSHostResolution : NSObject
+@property (nonatomic, copy, readonly) NSString *host;
+/// IPv4 and IPv6 addresses in the order returned by the system
+@property (nonatomic, copy, readonly) NSArray<NSString *> *addresses;
+/// Canonical name, host itself if none
+@property (nonatomic, copy, readonly) NSString *canonicalName;
+/// 0 on success, otherwise `getaddrinfo` error code
+@property (nonatomic, assign, readonly) int error;
+/// Microsecond spent by the query that produced this resolution, monotonic
+@property (nonatomic, assign, readonly) uint64_t resolveMicros;
+/// YES if served from cache without waiting for a query
+@property (nonatomic, assign, readonly) BOOL fromCache;
+@end
+
+
+//MARK: - RSHostResolver
+
+typedef void (^RSHostResolveHandler)(RSHostResolution *resolution);
+
+/**
+ Asynchronous host resolver shared by every diagnosis tool.
+
+ @discussion Answers are cached, positive ones for `positiveTTL`, names which do not exist for
+ `negativeTTL`; transient failures are not cached. Concurrent lookups of one name share one
+ query, so ping, tcp ping, traceroute and lookup of one detection resolve the host once.
+ */
+@interface RSHostResolver : NSObject
+
+/// Second, default `kHostResolverPositiveTTL`
+@property (nonatomic, assign) NSTimeInterval positiveTTL;
+/// Second, default `kHostResolverNegativeTTL`
+@property (nonatomic, assign) NSTimeInterval negativeTTL;
+
++ (instancetype)shareInstance;
+
+/**
+ @brief Resolve a host asynchronously.
+
+ @param host domain or ip
+ @param handler called once, on a resolver thread
+ */
+- (void)resolveHost:(NSString *)host completeHandler:(RSHostResolveHandler)handler;
+
+/**
+ @brief Resolve a host, blocking the calling thread until done.
+
+ @discussion Shares cache and in-flight queries with `resolveHost:completeHandler:`.
+ */
+- (RSHostResolution *)resolveHostSync:(NSString *)host;
+
+/**
+ @brief Drop every cached answer, e.g. when network changed.
+ */
+- (void)clearCache;
+
+@end
+
+NS_ASSUME_NONNULL_END
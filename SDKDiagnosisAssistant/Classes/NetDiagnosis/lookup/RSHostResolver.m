@@ -0,0 +1,212 @@
+//
+//  RSHostResolver.m
+//  RSNetDiagnosis
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+
+#import "RSHostResolver.h"
+#import <arpa/inet.h>
+#import <netdb.h>
+
+#import "RSNetDiagnosisLog.h"
+#import "RSNetDiagnosisHelper.h"
+
+//MARK: - RSHostResolution
+
+@interface RSHostResolution()
+@property (nonatomic, copy, readwrite) NSString *host;
+@property (nonatomic, copy, readwrite) NSArray<NSString *> *addresses;
+@property (nonatomic, copy, readwrite) NSString *canonicalName;
+@property (nonatomic, assign, readwrite) int error;
+@property (nonatomic, assign, readwrite) uint64_t resolveMicros;
+@property (nonatomic, assign, readwrite) BOOL fromCache;
+@property (nonatomic, assign) uint64_t expireTime;     // microsecond, monotonic
+@end
+
+@implementation RSHostResolution
+
+- (instancetype)cachedCopy
+{
+    RSHostResolution *copy = [[RSHostResolution alloc] init];
+    copy.host = self.host;
+    copy.addresses = self.addresses;
+    copy.canonicalName = self.canonicalName;
+    copy.error = self.error;
+    copy.resolveMicros = self.resolveMicros;
+    copy.expireTime = self.expireTime;
+    copy.fromCache = YES;
+    return copy;
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"host:%@ , canonicalName:%@ , addresses:%@ , error:%d , time:%.3fms%@",
+            self.host, self.canonicalName, [self.addresses componentsJoinedByString:@","], self.error,
+            self.resolveMicros / 1000.0, self.fromCache ? @" (cached)" : @""];
+}
+
+@end
+
+
+//MARK: - RSHostResolver
+
+@interface RSHostResolver()
+@property (nonatomic, strong) NSMutableDictionary<NSString *, RSHostResolution *> *cache;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSMutableArray<RSHostResolveHandler> *> *pendingHandlers;
+@property (nonatomic, strong) dispatch_queue_t resolveQueue;
+@end
+
+@implementation RSHostResolver
+
++ (instancetype)shareInstance
+{
+    static id instace = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        instace = [[self alloc] init];
+    });
+    return instace;
+}
+
+- (instancetype)init
+{
+    if (self = [super init]) {
+        _positiveTTL = kHostResolverPositiveTTL;
+        _negativeTTL = kHostResolverNegativeTTL;
+        _cache = [NSMutableDictionary dictionary];
+        _pendingHandlers = [NSMutableDictionary dictionary];
+        _resolveQueue = dispatch_queue_create("rs_net_resolve_queue", DISPATCH_QUEUE_CONCURRENT);
+    }
+    return self;
+}
+
+#pragma mark - Resolve
+
+- (void)resolveHost:(NSString *)host completeHandler:(RSHostResolveHandler)handler
+{
+    NSString *key = host.lowercaseString;
+    RSHostResolution *cached = nil;
+    BOOL isQuerying = NO;
+    @synchronized (self) {
+        RSHostResolution *entry = self.cache[key];
+        if (entry && entry.expireTime > RSNetMonotonicMicros()) {
+            cached = [entry cachedCopy];
+        } else {
+            if (entry) {
+                [self.cache removeObjectForKey:key];
+            }
+            // Join the query in flight, or start one
+            NSMutableArray<RSHostResolveHandler> *handlers = self.pendingHandlers[key];
+            isQuerying = handlers != nil;
+            if (!handlers) {
+                handlers = [NSMutableArray array];
+                self.pendingHandlers[key] = handlers;
+            }
+            [handlers addObject:[handler copy]];
+        }
+    }
+
+    if (cached) {
+        dispatch_async(self.resolveQueue, ^{
+            handler(cached);
+        });
+        return;
+    }
+    if (isQuerying) {
+        return;
+    }
+
+    dispatch_async(self.resolveQueue, ^{
+        RSHostResolution *resolution = [self queryHost:host];
+
+        NSArray<RSHostResolveHandler> *handlers = nil;
+        @synchronized (self) {
+            NSTimeInterval ttl = 0;
+            if (resolution.error == 0 && resolution.addresses.count > 0) {
+                ttl = self.positiveTTL;
+            } else if (resolution.error == EAI_NONAME) {
+                ttl = self.negativeTTL;
+            }
+            if (ttl > 0) {
+                resolution.expireTime = RSNetMonotonicMicros() + (uint64_t)(ttl * 1000000);
+                self.cache[key] = resolution;
+            }
+            handlers = self.pendingHandlers[key];
+            [self.pendingHandlers removeObjectForKey:key];
+        }
+        for (RSHostResolveHandler pending in handlers) {
+            pending(resolution);
+        }
+    });
+}
+
+- (RSHostResolution *)resolveHostSync:(NSString *)host
+{
+    __block RSHostResolution *result = nil;
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    [self resolveHost:host completeHandler:^(RSHostResolution *resolution) {
+        result = resolution;
+        dispatch_semaphore_signal(semaphore);
+    }];
+    dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+    return result;
+}
+
+- (void)clearCache
+{
+    @synchronized (self) {
+        [self.cache removeAllObjects];
+    }
+}
+
+/// Blocking `getaddrinfo`, only called on `resolveQueue`
+- (RSHostResolution *)queryHost:(NSString *)host
+{
+    RSHostResolution *resolution = [[RSHostResolution alloc] init];
+    resolution.host = host;
+    resolution.canonicalName = host;
+
+    struct addrinfo hints, *res0 = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_DEFAULT | AI_CANONNAME;
+
+    uint64_t startTime = RSNetMonotonicMicros();
+    int error = getaddrinfo([host UTF8String], NULL, &hints, &res0);
+    resolution.resolveMicros = RSNetMonotonicMicros() - startTime;
+    resolution.error = error;
+    if (error != 0) {
+        log4cplus_warn("RSHostResolver", "getaddrinfo host: %s, error: %s\n", [host UTF8String], gai_strerror(error));
+        resolution.addresses = @[];
+        return resolution;
+    }
+
+    NSMutableArray<NSString *> *addresses = [NSMutableArray array];
+    for (struct addrinfo *res = res0; res; res = res->ai_next) {
+        char buf[INET6_ADDRSTRLEN];
+        if (res->ai_family == AF_INET) {
+            inet_ntop(AF_INET, &((struct sockaddr_in *)res->ai_addr)->sin_addr, buf, sizeof(buf));
+        } else if (res->ai_family == AF_INET6) {
+            inet_ntop(AF_INET6, &((struct sockaddr_in6 *)res->ai_addr)->sin6_addr, buf, sizeof(buf));
+        } else {
+            continue;
+        }
+        NSString *address = [NSString stringWithUTF8String:buf];
+        if (![addresses containsObject:address]) {
+            [addresses addObject:address];
+        }
+        if (res->ai_canonname) {
+            resolution.canonicalName = [NSString stringWithUTF8String:res->ai_canonname];
+        }
+    }
+    freeaddrinfo(res0);
+
+    resolution.addresses = addresses;
+    log4cplus_debug("RSHostResolver", "resolved host: %s, %lu addresses in %.3fms\n", [host UTF8String], (unsigned long)addresses.count, resolution.resolveMicros / 1000.0);
+    return resolution;
+}
+
+@end
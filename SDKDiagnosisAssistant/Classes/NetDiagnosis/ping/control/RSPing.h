@@ -26,8 +26,17 @@
 @property (nonatomic,strong) id<RSPingDelegate> delegate;
 
 /// milisecond, default is 500 ms
+/// Pause between a probe being answered (or timing out) and the next probe sent from the same window slot.
 @property (nonatomic, assign) float pingInterval;
 
+/// Max count of echo requests in flight at the same time, default is 5, max is 64.
+/// 1 behaves like the classic send-wait-sleep ping.
+@property (nonatomic, assign) int windowSize;
+
+/// milisecond, default is 1000 ms
+/// A probe without reply after this time is reported as `RSPingStatusTimeout`.
+@property (nonatomic, assign) float timeout;
+
 - (void)startPingHosts:(NSString *)host packetCount:(int)count;
 
 - (void)stopPing;
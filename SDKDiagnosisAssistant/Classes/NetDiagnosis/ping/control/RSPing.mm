@@ -8,12 +8,16 @@
 
 #import "RSPing.h"
 #import "RSNetDiagnosisLog.h"
-#import "RSNetQueue.h"
 #import "RSNetInfoUtils.h"
 #import "RSNetDiagnosisHelper.h"
+#import "RSICMPReactor.h"
+#import "RSAddressSelector.h"
+#import "RSICMPPacketPool.h"
 
-#define KPingICMPIdBeginNum     8000
 #define KDefaultPingInterval    500
+#define KDefaultPingWindowSize  5
+#define KPingMaxWindowSize      64
+#define KDefaultPingTimeout     1000
 
 /**
  * RSPing class handles ICMP ping operations for network diagnosis
@@ -23,20 +27,48 @@
  * - Receive and process ICMP echo responses
  * - Support both IPv4 and IPv6
  * - Report ping results through delegate methods
+ *
+ * Every ping is a session of the shared `RSICMPReactor`, so pings to different
+ * hosts run at the same time. Up to `windowSize` echo requests are kept in
+ * flight. Every request of a session shares the identifier reserved by the
+ * reactor, replies are matched back to their request by sequence through a
+ * small table of outstanding probes.
+ *
+ * Session state is confined to the reactor thread: starting and stopping go
+ * through `-[RSICMPReactor performBlock:]`, so a restart registers only after
+ * the previous session has been removed. The caller thread only touches the
+ * atomic `pinging` and `generation` fields.
  */
 
-@interface RSPing()
+/// One slot of the outstanding probe table
+typedef struct RSPingProbe {
+    BOOL        inUse;
+    uint16_t    seq;
+    uint64_t    sendTime;   // microsecond, monotonic
+    uint64_t    deadline;   // microsecond, monotonic, when inUse
+    uint64_t    readyTime;  // microsecond, monotonic, when slot can send again
+} RSPingProbe;
+
+@interface RSPing() <RSICMPReactorSession>
 {
-    int socket_client;
-    struct sockaddr *destination;
+    // Read and written with __atomic builtins from any thread
+    BOOL pinging;
+    uint32_t generation;        // Bumped on every start and stop, a session ticks only while it matches
+    
+    // Only touched on reactor thread
+    uint32_t sessionGeneration;
+    int packetCount;
+    struct sockaddr_storage destination;
     uint16_t identifier;
+    RSPingProbe probes[KPingMaxWindowSize];
+    int window;
+    int sentCount;
+    int doneCount;
+    RSICMPPacketPool *packetPool;
 }
 
-@property (nonatomic,assign) BOOL stopPingFlag;
-@property (nonatomic,assign) BOOL isPinging;
-@property (nonatomic,strong) NSString *ipAddress;
-@property (nonatomic,strong) NSDate   *sendDate;
-@property (nonatomic,assign) int pingPacketCount;
+@property (atomic,strong) NSString *ipAddress;
+@property (atomic,assign) int pingPacketCount;
 @end
 
 @implementation RSPing
@@ -45,214 +77,244 @@
 {
     self = [super init];
     if (self) {
-        _stopPingFlag = NO;
-        _isPinging = NO;
         _pingInterval = KDefaultPingInterval;
+        _windowSize = KDefaultPingWindowSize;
+        _timeout = KDefaultPingTimeout;
     }
     return self;
 }
 
 - (void)stopPing
 {
-    _stopPingFlag = YES;
-    _isPinging = NO;
-    [self reportPingResFromIp:_ipAddress ttl:0 timeMillSecond:0 seq:0 icmpId:0 dataSize:0 pingStatus:RSPingStatusFinished];
+    __atomic_add_fetch(&generation, 1, __ATOMIC_ACQ_REL);
+    [self finishPing];
+}
+
+/// Stop only if the ping started as `startGeneration` is still the current one
+- (void)stopPingOfGeneration:(uint32_t)startGeneration
+{
+    uint32_t expected = startGeneration;
+    if (!__atomic_compare_exchange_n(&generation, &expected, startGeneration + 1, NO, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        return;     // Already stopped, maybe restarted, by the caller
+    }
+    [self finishPing];
+}
+
+- (void)finishPing
+{
+    // Removed on the reactor thread. Queued before `pinging` is cleared, so the
+    // registration of a later start always runs after it
+    RSICMPReactor *reactor = [RSICMPReactor shareInstance];
+    [reactor performBlock:^{
+        [reactor unregisterSession:self];
+    }];
+    __atomic_store_n(&pinging, NO, __ATOMIC_RELEASE);
+    [self reportPingResFromIp:self.ipAddress ttl:0 timeMillSecond:0 seq:0 icmpId:0 dataSize:0 pingStatus:RSPingStatusFinished];
 }
 
 - (BOOL)isPinging
 {
-    return _isPinging;
+    return __atomic_load_n(&pinging, __ATOMIC_ACQUIRE);
 }
 
 - (void)startPingHosts:(NSString *)host 
            packetCount:(int)count
 {
-    if (![self verificationHost:host]) {
-        [self stopPing];
-        log4cplus_warn("RSPing", "There is no valid domain...\n");
+    BOOL expected = NO;
+    if (!__atomic_compare_exchange_n(&pinging, &expected, YES, NO, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
         return;
     }
     
     if (count > 0) {
-        _pingPacketCount = count;
+        self.pingPacketCount = count;
     }
+    int packetCount = self.pingPacketCount;
+    uint32_t startGeneration = __atomic_add_fetch(&generation, 1, __ATOMIC_ACQ_REL);
     
-    [RSNetQueue rs_net_ping_async:^{
-        if ([self buildICMPSocket]) {
-            [self sendAndReceivePingPacket];
+    [self verificationHost:host completeHandler:^(BOOL isValid) {
+        if (__atomic_load_n(&self->generation, __ATOMIC_ACQUIRE) != startGeneration) {
+            return;     // Stopped while the address was selected, finish already reported
         }
+        if (!isValid) {
+            [self stopPingOfGeneration:startGeneration];
+            log4cplus_warn("RSPing", "There is no valid domain...\n");
+            return;
+        }
+        [[RSICMPReactor shareInstance] performBlock:^{
+            [self startSessionWithGeneration:startGeneration packetCount:packetCount];
+        }];
     }];
 }
 
-- (BOOL)verificationHost:(NSString *)host
+/// Called on reactor thread
+- (void)startSessionWithGeneration:(uint32_t)startGeneration packetCount:(int)count
 {
-    // Doing host resolve here
-    NSArray *address = [RSNetDiagnosisHelper resolveHost:host];
-    if (address.count > 0) {
-        NSString *ipAddress = [address firstObject];
-//        if ([[RSNetInfoUtils shareInstance] isIPv6Environment]) {
-//             // IPv6 net, try reach IPv6 IPAddress
-//            for (NSString *add in address) {
-//                if ([add rangeOfString:@":"].location != NSNotFound) {
-//                    ipAddress = add;
-//                }
-//            }
-//        }
-        _ipAddress = ipAddress;
-    } else {
-       log4cplus_warn("RSPing", "access %s DNS error , remove this ip..\n",[host UTF8String]);
+    if (__atomic_load_n(&generation, __ATOMIC_ACQUIRE) != startGeneration) {
+        return;     // Stopped before the reactor got here
     }
+    sessionGeneration = startGeneration;
+    packetCount = count;
+    [self buildDestination];
+    memset(probes, 0, sizeof(probes));
+    window = MAX(1, MIN(_windowSize, packetCount));
+    sentCount = 0;
+    doneCount = 0;
+    // One slot per outstanding probe, so steady-state probing allocates nothing
+    packetPool = [[RSICMPPacketPool alloc] initWithKind:RSICMPPacketKindEcho isIPv6:destination.ss_family == AF_INET6 slotCount:window];
     
-    if (_ipAddress == NULL) {
-        return NO;
+    if (![[RSICMPReactor shareInstance] registerSession:self family:destination.ss_family identifier:&identifier]) {
+        log4cplus_warn("RSPing", "ping %s , create icmp session error..\n", self.ipAddress.UTF8String);
+        [self stopPingOfGeneration:startGeneration];
     }
-    return YES;
 }
 
-- (BOOL)buildICMPSocket {
-    NSData *addrData = nil;
-    BOOL isIPv6 = [_ipAddress rangeOfString:@":"].location != NSNotFound;
+- (void)verificationHost:(NSString *)host completeHandler:(void (^)(BOOL isValid))handler
+{
+    // Doing host resolve here, on dual-stack hosts the family answering echo first is probed.
+    // Raced on the selector queue, the caller may be the main queue
+    [[RSAddressSelector shareInstance] selectAddressForHost:host method:RSAddressRaceMethodICMP port:0 completeHandler:^(RSAddressSelection *selection) {
+        if (selection.address) {
+            self.ipAddress = selection.address;
+            if (selection.familyResults.count > 0) {
+                log4cplus_info("RSPing", "select address: %s\n", [selection.description UTF8String]);
+            }
+        } else {
+           log4cplus_warn("RSPing", "access %s DNS error , remove this ip..\n",[host UTF8String]);
+        }
+        handler(self.ipAddress != NULL);
+    }];
+}
+
+- (void)buildDestination {
+    NSString *ipAddress = self.ipAddress;
+    BOOL isIPv6 = [ipAddress rangeOfString:@":"].location != NSNotFound;
+    memset(&destination, 0, sizeof(destination));
     if (isIPv6) {
-        struct sockaddr_in6 nativeAddr6;
-        memset(&nativeAddr6,0,sizeof(nativeAddr6));
-        nativeAddr6.sin6_len = sizeof(nativeAddr6);
-        nativeAddr6.sin6_family = AF_INET6;
-        inet_pton(AF_INET6, _ipAddress.UTF8String, &nativeAddr6.sin6_addr);
-        addrData = [NSData dataWithBytes:&nativeAddr6 length:sizeof(nativeAddr6)];
+        struct sockaddr_in6 *nativeAddr6 = (struct sockaddr_in6 *)&destination;
+        nativeAddr6->sin6_len = sizeof(struct sockaddr_in6);
+        nativeAddr6->sin6_family = AF_INET6;
+        inet_pton(AF_INET6, ipAddress.UTF8String, &nativeAddr6->sin6_addr);
     } else {
-        struct sockaddr_in nativeAddr4;
-        memset(&nativeAddr4,0,sizeof(nativeAddr4));
-        nativeAddr4.sin_len =sizeof(nativeAddr4);
-        nativeAddr4.sin_family = AF_INET;
-        inet_pton(AF_INET, _ipAddress.UTF8String, &nativeAddr4.sin_addr.s_addr);
-        addrData = [NSData dataWithBytes:&nativeAddr4 length:sizeof(nativeAddr4)];
+        struct sockaddr_in *nativeAddr4 = (struct sockaddr_in *)&destination;
+        nativeAddr4->sin_len = sizeof(struct sockaddr_in);
+        nativeAddr4->sin_family = AF_INET;
+        inet_pton(AF_INET, ipAddress.UTF8String, &nativeAddr4->sin_addr.s_addr);
+    }
+}
+
+#pragma mark - RSICMPReactorSession
+
+- (uint64_t)icmpReactorTick:(uint64_t)now
+{
+    if (__atomic_load_n(&generation, __ATOMIC_ACQUIRE) != sessionGeneration) {
+        return 0;
     }
     
-    destination = (struct sockaddr *)[addrData bytes];
+    uint64_t timeoutMicros = (uint64_t)(_timeout * 1000);
+    uint64_t intervalMicros = (uint64_t)(_pingInterval * 1000);
     
-    struct timeval timeout;
-    timeout.tv_sec = 1;
-    timeout.tv_usec = 0;
+    // Fill every free slot whose interval has passed
+    for (int i = 0; i < window && sentCount < packetCount; i++) {
+        RSPingProbe *probe = &probes[i];
+        if (probe->inUse || now < probe->readyTime) {
+            continue;
+        }
+        if ([self sendProbe:probe seq:(uint16_t)sentCount]) {
+            probe->deadline = probe->sendTime + timeoutMicros;
+        } else {
+            [self reportPingResFromIp:self.ipAddress ttl:0 timeMillSecond:0 seq:sentCount icmpId:0 dataSize:0 pingStatus:RSPingStatusTimeout];
+            probe->readyTime = now + intervalMicros;
+            doneCount++;
+        }
+        sentCount++;
+    }
     
-    socket_client = socket(destination->sa_family, SOCK_DGRAM, isIPv6?IPPROTO_ICMPV6:IPPROTO_ICMP);
-    if (socket_client < 0) {
-        log4cplus_warn("RSPing", "Error creating socket: %s\n", strerror(errno));
-        return NO;
+    // Expire probes without reply
+    for (int i = 0; i < window; i++) {
+        RSPingProbe *probe = &probes[i];
+        if (probe->inUse && now >= probe->deadline) {
+            probe->inUse = NO;
+            probe->readyTime = now + intervalMicros;
+            doneCount++;
+            [self reportPingResFromIp:self.ipAddress ttl:0 timeMillSecond:0 seq:probe->seq icmpId:0 dataSize:0 pingStatus:RSPingStatusTimeout];
+        }
     }
-    int res = setsockopt(socket_client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
-    if (res < 0) {
-        log4cplus_warn("RSPing", "ping %s , set timeout error..\n", _ipAddress.UTF8String);
+    
+    if (doneCount >= packetCount) {
+        log4cplus_debug("RSPing", "ping complete..\n");
+        [self stopPingOfGeneration:sessionGeneration];
+        return 0;
     }
     
-    // IPv6 must set IPV6_RECVPKTINFO on
-    if (isIPv6) {
-        int on = 1;
-        int res = setsockopt(socket_client, IPPROTO_IPV6, IPV6_RECVPKTINFO, &on, sizeof(on));
-        if (res < 0) {
-            log4cplus_warn("RSPing", "ping %s , set ipv6 receive on error..\n", _ipAddress.UTF8String);
+    // Nearest deadline or slot ready time
+    uint64_t wakeTime = UINT64_MAX;
+    for (int i = 0; i < window; i++) {
+        if (probes[i].inUse) {
+            wakeTime = MIN(wakeTime, probes[i].deadline);
+        } else if (sentCount < packetCount) {
+            wakeTime = MIN(wakeTime, probes[i].readyTime);
         }
     }
-    return YES;
+    return wakeTime;
 }
 
-- (void)sendAndReceivePingPacket
+- (BOOL)sendProbe:(RSPingProbe *)probe seq:(uint16_t)seq
 {
-    if (_isPinging) {
-        return;
-    }
-    _isPinging = YES;
-    _stopPingFlag = NO;
-
-    
-    BOOL isIPv6 = destination->sa_family == AF_INET6;
-    
-    int index = 0;
-    BOOL isReceiveRemoteIpPingRes = NO;
-    
-    do {
-        _sendDate = [NSDate date];
-        identifier = (uint16_t)(getpid() + KPingICMPIdBeginNum + index);
-        socklen_t length = isIPv6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
-        
-        RSICMPPacket *packet = [RSNetDiagnosisHelper constructICMPEchoPacketWithSeq:index andIdentifier:identifier isIPv6:isIPv6];
-        ssize_t sent = sendto(socket_client, packet, sizeof(RSICMPPacket), 0, (struct sockaddr *)destination, length);
-       
-        if (sent < 0) {
-            log4cplus_warn("RSPing", "ping %s , send icmp packet error..\n", _ipAddress.UTF8String);
-        }
-        
-        isReceiveRemoteIpPingRes = [self receiveRemoteIpPingRes];
-        
-        if (isReceiveRemoteIpPingRes) {
-            index++;
-        }
-        usleep(1000*_pingInterval);
-    } while (!self.stopPingFlag && index < _pingPacketCount && isReceiveRemoteIpPingRes);
+    const void *packet = [packetPool packetWithIdentifier:identifier seq:seq];
+    // Stamp after the packet is built, so construction cost is not counted in RTT
+    probe->sendTime = RSNetMonotonicMicros();
+    ssize_t sent = [[RSICMPReactor shareInstance] sendPacket:packet length:packetPool.packetLength toAddress:(struct sockaddr *)&destination];
     
-    if (index == _pingPacketCount) {
-        log4cplus_debug("RSPing", "ping complete..\n");
-        /*
-         int shutdown(int s, int how); // s is socket descriptor
-         int how can be:
-         SHUT_RD or 0 Further receives are disallowed
-         SHUT_WR or 1 Further sends are disallowed
-         SHUT_RDWR or 2 Further sends and receives are disallowed
-         */
-        shutdown(socket_client, SHUT_RDWR); //
-        close(socket_client);
-        
-        [self stopPing];
+    if (sent < 0) {
+        log4cplus_warn("RSPing", "ping %s , send icmp packet error..\n", self.ipAddress.UTF8String);
+        return NO;
     }
-    
+    probe->inUse = YES;
+    probe->seq = seq;
+    return YES;
 }
 
-- (BOOL)receiveRemoteIpPingRes
+- (void)icmpReactorDidReceivePacket:(char *)buffer
+                             length:(int)bytesRead
+                        fromAddress:(const struct sockaddr *)address
+                        receiveTime:(uint64_t)receiveTime
 {
-    BOOL isIPv6 = destination->sa_family == AF_INET6;
-    BOOL res = NO;
-    char buffer[1024];
+    if (__atomic_load_n(&generation, __ATOMIC_ACQUIRE) != sessionGeneration) {
+        return;     // Stopped, waiting to be unregistered
+    }
+    BOOL isIPv6 = destination.ss_family == AF_INET6;
     
-    ssize_t bytesRead = 0;
-    if (isIPv6) {
-        struct sockaddr_in6 ret_addr6;
-        socklen_t addrLen6 = sizeof(sockaddr_in6);
-        bytesRead = recvfrom(socket_client, buffer, sizeof(buffer), 0, (struct sockaddr *)&ret_addr6, &addrLen6);
-    } else {
-        struct sockaddr_in ret_addr;
-        socklen_t addrLen = sizeof(sockaddr_in);
-        bytesRead = recvfrom(socket_client, buffer, sizeof(buffer), 0, (struct sockaddr *)&ret_addr, &addrLen);
+    if (![RSNetDiagnosisHelper isValidICMPPingResponseWithBuffer:buffer length:bytesRead identifier:identifier isIPv6:isIPv6]) {
+        [self reportPingResFromIp:self.ipAddress ttl:0 timeMillSecond:0 seq:0 icmpId:0 dataSize:0 pingStatus:RSPingStatusReceiveUnexpectedPacket];
+        return;
     }
     
-    if (bytesRead < 0) {
-        [self reportPingResFromIp:_ipAddress ttl:0 timeMillSecond:0 seq:0 icmpId:0 dataSize:0 pingStatus:RSPingStatusTimeout];
-        res = YES;
-        
-    } else if(bytesRead == 0) {
-        log4cplus_warn("RSPing", "ping %s , receive icmp packet error , bytesRead=0", _ipAddress.UTF8String);
-        
-    } else {
-        if ([RSNetDiagnosisHelper isValidICMPPingResponseWithBuffer:(char *)buffer length:(int)bytesRead identifier:identifier isIPv6:isIPv6]) {
-            
-            RSICMPPacket *icmpPtr = (RSICMPPacket *)[RSNetDiagnosisHelper icmpPacketFromBuffer:(char *)buffer length:(int)bytesRead isIPv6:isIPv6];
-            int seq = OSSwapBigToHostInt16(icmpPtr->seq);
-            int identifier = OSSwapBigToHostInt16(icmpPtr->identifier);
-            //FIXME: IPv6 hopLimit equals to seq, don't know why
-            int ttl = isIPv6 ? ((RSNetIPv6Header *)buffer)->hopLimit : ((RSNetIPHeader *)buffer)->timeToLive;
-            int size = isIPv6 ? (int)bytesRead : (int)(bytesRead-sizeof(RSNetIPHeader));
-            
-            NSTimeInterval duration = [[NSDate date] timeIntervalSinceDate:_sendDate];
-            
-            [self reportPingResFromIp:_ipAddress ttl:ttl timeMillSecond:duration*1000 seq:seq icmpId:identifier dataSize:size pingStatus:RSPingStatusReceivePacket];
-            res = YES;
-        } else {
-            [self reportPingResFromIp:_ipAddress ttl:0 timeMillSecond:0 seq:0 icmpId:0 dataSize:0 pingStatus:RSPingStatusReceiveUnexpectedPacket];
-            res = YES;
+    RSICMPPacket *icmpPtr = (RSICMPPacket *)[RSNetDiagnosisHelper icmpPacketFromBuffer:buffer length:bytesRead isIPv6:isIPv6];
+    uint16_t seq = OSSwapBigToHostInt16(icmpPtr->seq);
+    
+    RSPingProbe *probe = NULL;
+    for (int i = 0; i < window; i++) {
+        if (probes[i].inUse && probes[i].seq == seq) {
+            probe = &probes[i];
+            break;
         }
-        
-        usleep(_pingInterval);
     }
+    if (probe == NULL) {
+        // Late reply of a probe already reported as timeout, or a duplicate
+        log4cplus_debug("RSPing", "ping %s , drop reply of icmp_seq=%d without outstanding request\n", self.ipAddress.UTF8String, seq);
+        return;
+    }
+    
+    //FIXME: IPv6 hopLimit equals to seq, don't know why
+    int ttl = isIPv6 ? ((RSNetIPv6Header *)buffer)->hopLimit : ((RSNetIPHeader *)buffer)->timeToLive;
+    int size = isIPv6 ? (int)bytesRead : (int)(bytesRead-sizeof(RSNetIPHeader));
+    float duration = (receiveTime - probe->sendTime) / 1000.0;
     
-    return res;
+    probe->inUse = NO;
+    probe->readyTime = receiveTime + (uint64_t)(_pingInterval * 1000);
+    doneCount++;
+    
+    [self reportPingResFromIp:self.ipAddress ttl:ttl timeMillSecond:duration seq:seq icmpId:identifier dataSize:size pingStatus:RSPingStatusReceivePacket];
 }
 
 - (void)reportPingResFromIp:(NSString *)ipAddress
@@ -278,7 +340,7 @@
             break;
         case RSPingStatusFinished:
         {
-            pingResModel.ICMPSequence = _pingPacketCount;
+            pingResModel.ICMPSequence = self.pingPacketCount;
         }
             break;
         case RSPingStatusTimeout:
@@ -306,4 +368,15 @@
         _pingInterval = KDefaultPingInterval;
     }
 }
+
+- (void)setWindowSize:(int)windowSize {
+    _windowSize = MIN(MAX(windowSize, 1), KPingMaxWindowSize);
+}
+
+- (void)setTimeout:(float)timeout {
+    _timeout = timeout;
+    if (timeout <= 0) {
+        _timeout = KDefaultPingTimeout;
+    }
+}
 @end
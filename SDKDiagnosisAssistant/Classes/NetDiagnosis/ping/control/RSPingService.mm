@@ -10,10 +10,21 @@
 #import "RSPing.h"
 #import "RSPingResult.h"
 #import "RSNetDiagnosisLog.h"
+#import "RSLatencyStatistics.h"
+
+/// Running summary of replies from one ip address
+@interface RSPingAccumulation : NSObject
+@property (nonatomic, strong) RSLatencyStatistics *statistics;
+@property (nonatomic, assign) NSInteger ttlSum;
+@end
+
+@implementation RSPingAccumulation
+@end
+
 
 @interface RSPingService() <RSPingDelegate>
 @property (nonatomic, strong) RSPing *icmpPing;
-@property (nonatomic, strong) NSMutableDictionary *pingResDic;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, RSPingAccumulation *> *pingResDic;
 @property (nonatomic, copy, readonly) RSPingResultHandler pingResultHandler;
 @property (nonatomic, copy, readonly) RSPingConclusionHandler pingConclusionHandler;
 @end
@@ -101,6 +112,8 @@
     if (status == RSPingStatusFinished) {
         // caclute loss and report
         [self calculateLossOfIp:pingRes.IPAddress];
+        // Ping is over, break the delegate cycle so a service created per detection can be freed
+        ping.delegate = nil;
         return;
     }
     
@@ -119,18 +132,25 @@
         return;
     }
     
-    NSMutableArray *pingItems = [self.pingResDic objectForKey:ipAddress];
-    if (pingItems == NULL) {
-        pingItems = [NSMutableArray arrayWithArray:@[pingRes]];
-    } else {
-        try {
-            [pingItems addObject:pingRes];
-        } catch (NSException *exception) {
-            log4cplus_warn("RSPing", "func: %s, exception info: %s , line: %d",__func__,[exception.description UTF8String],__LINE__);
-        }
+    RSPingAccumulation *accumulation = [self.pingResDic objectForKey:ipAddress];
+    if (accumulation == NULL) {
+        accumulation = [[RSPingAccumulation alloc] init];
+        accumulation.statistics = [[RSLatencyStatistics alloc] init];
+        [self.pingResDic setObject:accumulation forKey:ipAddress];
     }
     
-    [self.pingResDic setObject:pingItems forKey:ipAddress];
+    switch (pingRes.status) {
+        case RSPingStatusReceivePacket:
+            accumulation.ttlSum += pingRes.timeToLive;
+            [accumulation.statistics addSampleMicros:(uint64_t)(pingRes.timeMilliseconds * 1000)];
+            break;
+        case RSPingStatusFinished:
+        case RSPingStatusError:
+            break;
+        default:
+            [accumulation.statistics addLoss];
+            break;
+    }
 }
 
 - (void)calculateLossOfIp:(NSString *)ipAddress
@@ -142,11 +162,13 @@
         return;
     }
     
-    NSArray *pingResultArr = [self.pingResDic objectForKey:ipAddress];
-    RSPingConclusion *pingConclusion = [RSPingConclusion pingConclusionWithPingResults:pingResultArr];
+    RSPingAccumulation *accumulation = [self.pingResDic objectForKey:ipAddress];
+    RSLatencyStatistics *statistics = accumulation.statistics ?: [[RSLatencyStatistics alloc] init];
+    NSInteger avgTTL = statistics.receivedCount > 0 ? accumulation.ttlSum / (NSInteger)statistics.receivedCount : 0;
+    RSPingConclusion *pingConclusion = [RSPingConclusion pingConclusionWithStatistics:statistics dstIp:ipAddress ttl:avgTTL];
     if (_pingConclusionHandler) _pingConclusionHandler(pingConclusion);
     
-    NSString *pingSummary = [NSString stringWithFormat:@"%d packets transmitted , loss:%d%% , min:%0.3fms , avg:%0.3fms , max:%0.3fms , stddev:%0.3fms , ttl:%d", pingConclusion.totolPackets, pingConclusion.loss, pingConclusion.min, pingConclusion.avg, pingConclusion.max, pingConclusion.stddev, pingConclusion.ttl];
+    NSString *pingSummary = [NSString stringWithFormat:@"%d packets transmitted , loss:%d%% , min:%0.3fms , avg:%0.3fms , max:%0.3fms , stddev:%0.3fms , jitter:%0.3fms , p50/p90/p99:%0.3f/%0.3f/%0.3fms , ttl:%d", pingConclusion.totolPackets, pingConclusion.loss, pingConclusion.min, pingConclusion.avg, pingConclusion.max, pingConclusion.stddev, pingConclusion.jitter, pingConclusion.p50, pingConclusion.p90, pingConclusion.p99, pingConclusion.ttl];
     if (_pingResultHandler) _pingResultHandler(pingSummary, YES);
     
     [self removePingResForIpAddress:ipAddress];
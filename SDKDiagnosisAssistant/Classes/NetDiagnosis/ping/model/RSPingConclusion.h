@@ -8,6 +8,7 @@
 
 #import <Foundation/Foundation.h>
 #import "RSPingResult.h"
+#import "RSLatencyStatistics.h"
 
 @interface RSPingConclusion : NSObject
 
@@ -18,6 +19,10 @@
 @property (nonatomic, assign) float stddev;
 @property (nonatomic, assign) float max;
 @property (nonatomic, assign) float min;
+@property (nonatomic, assign) float jitter;
+@property (nonatomic, assign) float p50;
+@property (nonatomic, assign) float p90;
+@property (nonatomic, assign) float p99;
 @property (nonatomic, copy) NSString *src_ip;
 @property (nonatomic, copy) NSString *dst_ip;
 @property (nonatomic, copy) NSString *dst_host;
@@ -28,6 +33,15 @@
  */
 + (instancetype)pingConclusionWithPingResults:(NSArray <RSPingResult *>*)pingResultArr;
 
+/**
+ Create a conclusion from statistics accumulated while pinging, no ping result needs to be kept
+
+ @param statistics round trip times and losses of the ping
+ @param dstIp destination ip address
+ @param ttl average ttl of replies
+ */
++ (instancetype)pingConclusionWithStatistics:(RSLatencyStatistics *)statistics dstIp:(NSString *)dstIp ttl:(NSInteger)ttl;
+
 /**
  @discussion Dictionary must be conclusion info
  */
@@ -21,50 +21,26 @@
     RSPingResult *firstRes = pingResultArr.firstObject;
     NSString *dst     = [firstRes IPAddress];
     
-    NSMutableArray<RSPingResult *> *validPingResultArr = [NSMutableArray array];
-    __block int allCount = 0;
-    __block NSInteger ttlSum = 0;
-    __block double    timeSum = 0;
-    __block double    timeMax = [firstRes timeMilliseconds];
-    __block double    timeMin = [firstRes timeMilliseconds];
-    [pingResultArr enumerateObjectsUsingBlock:^(RSPingResult *obj, NSUInteger idx, BOOL *stop) {
-        if (obj.status != RSPingStatusFinished && obj.status != RSPingStatusError) {
-            allCount ++;
-            if (obj.status == RSPingStatusReceivePacket) {
-                [validPingResultArr addObject:obj];
-                ttlSum += obj.timeToLive;
-                timeSum += obj.timeMilliseconds;
-                timeMax = MAX(timeMax, obj.timeMilliseconds);
-                timeMin = MIN(timeMin, obj.timeMilliseconds);
-            }
+    RSLatencyStatistics *statistics = [[RSLatencyStatistics alloc] init];
+    NSInteger ttlSum = 0;
+    for (RSPingResult *obj in pingResultArr) {
+        if (obj.status == RSPingStatusFinished || obj.status == RSPingStatusError) {
+            continue;
         }
-    }];
-    
-    NSUInteger validCount = validPingResultArr.count;
-    // caclute loss
-    float lossPercent = (allCount - validCount) / MAX(1.0, allCount) * 100;
-    
-    // caclute average time and ttl
-    double avgTime = 0;
-    NSInteger avgTTL = 0;
-    if (validCount > 0) {
-        avgTime = timeSum/validCount;
-        avgTTL = ttlSum/validCount;
-    }
-    
-    // caclute standardDeviation
-    
-    double standardDeviation = 0;
-    if (validCount > 0) {
-        double varianceSum = 0.0;
-        for (RSPingResult *pingRes in validPingResultArr) {
-            double diff = pingRes.timeMilliseconds - avgTime;
-            varianceSum += diff * diff;
+        if (obj.status == RSPingStatusReceivePacket) {
+            ttlSum += obj.timeToLive;
+            [statistics addSampleMicros:(uint64_t)(obj.timeMilliseconds * 1000)];
+        } else {
+            [statistics addLoss];
         }
-        standardDeviation = sqrt(varianceSum / validCount);
     }
     
-    
+    NSInteger avgTTL = statistics.receivedCount > 0 ? ttlSum / (NSInteger)statistics.receivedCount : 0;
+    return [self pingConclusionWithStatistics:statistics dstIp:dst ttl:avgTTL];
+}
+
++ (instancetype)pingConclusionWithStatistics:(RSLatencyStatistics *)statistics dstIp:(NSString *)dstIp ttl:(NSInteger)ttl
+{
     NSDictionary *ipInfo = [[RSNetInfoUtils shareInstance] getLocalIpAddress];
     NSString *address = ipInfo[@"en0/ipv4"];
     if (address == NULL) {
@@ -74,18 +50,21 @@
     //
     NSDictionary *dict = @{
         @"src_ip": address,
-        @"dst_ip": dst,
-        @"totolPackets": [NSNumber numberWithInt:allCount],
-        @"loss": [NSNumber numberWithFloat:lossPercent],
-        @"avg": [NSNumber numberWithDouble:avgTime],
-        @"stddev": [NSNumber numberWithDouble:standardDeviation],
-        @"max": [NSNumber numberWithDouble:timeMax],
-        @"min": [NSNumber numberWithDouble:timeMin],
-        @"ttl": [NSNumber numberWithLong:avgTTL]
+        @"dst_ip": dstIp ?: @"null",
+        @"totolPackets": [NSNumber numberWithUnsignedInteger:statistics.totalCount],
+        @"loss": [NSNumber numberWithDouble:statistics.lossPercent],
+        @"avg": [NSNumber numberWithDouble:statistics.mean],
+        @"stddev": [NSNumber numberWithDouble:statistics.stddev],
+        @"max": [NSNumber numberWithDouble:statistics.max],
+        @"min": [NSNumber numberWithDouble:statistics.min],
+        @"jitter": [NSNumber numberWithDouble:statistics.jitter],
+        @"p50": [NSNumber numberWithDouble:statistics.p50],
+        @"p90": [NSNumber numberWithDouble:statistics.p90],
+        @"p99": [NSNumber numberWithDouble:statistics.p99],
+        @"ttl": [NSNumber numberWithLong:ttl]
     };
     
     return [[self alloc] initWithDict:dict];
-
 }
 
 - (instancetype)init
@@ -109,6 +88,10 @@
         self.stddev = [dict[@"stddev"] floatValue];
         self.max    = [dict[@"max"] floatValue];
         self.min    = [dict[@"min"] floatValue];
+        self.jitter = [dict[@"jitter"] floatValue];
+        self.p50    = [dict[@"p50"] floatValue];
+        self.p90    = [dict[@"p90"] floatValue];
+        self.p99    = [dict[@"p99"] floatValue];
         self.ttl    = [dict[@"ttl"] intValue];
         self.timestamp = [dict[@"timestamp"] floatValue];
     }
@@ -127,6 +110,10 @@
         @"stddev": @(self.stddev),
         @"max": @(self.max),
         @"min": @(self.min),
+        @"jitter": @(self.jitter),
+        @"p50": @(self.p50),
+        @"p90": @(self.p90),
+        @"p99": @(self.p99),
         @"ttl": @(self.ttl),
         @"timestamp": @(self.timestamp)
     };
@@ -134,7 +121,7 @@
 
 - (NSString *)description
 {
-    return [NSString stringWithFormat:@"src_ip:%@ , dst_host:%@, dst_ip:%@ , totalPackets:%d , loss:%d%% , min:%@ , avg:%@ ,  max:%@ , stddev:%@ , ttl:%d , timestamp:%f",
+    return [NSString stringWithFormat:@"src_ip:%@ , dst_host:%@, dst_ip:%@ , totalPackets:%d , loss:%d%% , min:%@ , avg:%@ ,  max:%@ , stddev:%@ , jitter:%@ , p50/p90/p99:%@ , ttl:%d , timestamp:%f",
             self.src_ip,
             self.dst_host,
             self.dst_ip,
@@ -144,6 +131,8 @@
             [NSString stringWithFormat:@"%.3fms",self.avg],
             [NSString stringWithFormat:@"%.3fms",self.max],
             [NSString stringWithFormat:@"%.3fms",self.stddev],
+            [NSString stringWithFormat:@"%.3fms",self.jitter],
+            [NSString stringWithFormat:@"%.3f/%.3f/%.3fms",self.p50,self.p90,self.p99],
             self.ttl,
             self.timestamp];
 }
@@ -8,6 +8,8 @@
 
 #import <Foundation/Foundation.h>
 
+@class RSLatencyStatistics;
+
 NS_ASSUME_NONNULL_BEGIN
 
 //MARK: - RSTCPPingResult
@@ -18,6 +20,11 @@ NS_ASSUME_NONNULL_BEGIN
 @property (readonly) NSTimeInterval max_time;
 @property (readonly) NSTimeInterval avg_time;
 @property (readonly) NSTimeInterval min_time;
+@property (readonly) NSTimeInterval stddev;
+@property (readonly) NSTimeInterval jitter;
+@property (readonly) NSTimeInterval p50_time;
+@property (readonly) NSTimeInterval p90_time;
+@property (readonly) NSTimeInterval p99_time;
 
 - (instancetype)init:(NSString *)ip
                 loss:(NSUInteger)loss
@@ -25,6 +32,12 @@ NS_ASSUME_NONNULL_BEGIN
                  max:(NSTimeInterval)maxTime
                  min:(NSTimeInterval)minTime
                  avg:(NSTimeInterval)avgTime;
+
+/**
+ @brief Create a result from connect times accumulated while pinging, in millisecond
+ */
+- (instancetype)init:(NSString *)ip
+          statistics:(RSLatencyStatistics *)statistics;
 @end
 
 
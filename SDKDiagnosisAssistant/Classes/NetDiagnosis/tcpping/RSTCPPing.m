@@ -18,6 +18,9 @@
 
 #import "RSNetDiagnosisHelper.h"
 #import "RSNetInfoUtils.h"
+#import "RSTCPProbeEngine.h"
+#import "RSAddressSelector.h"
+#import "RSLatencyStatistics.h"
 
 //MARK: - RSTCPPingResult
 
@@ -41,9 +44,22 @@
     return self;
 }
 
+- (instancetype)init:(NSString *)ip
+          statistics:(RSLatencyStatistics *)statistics
+{
+    if (self = [self init:ip loss:statistics.lossCount count:statistics.totalCount max:statistics.max min:statistics.min avg:statistics.mean]) {
+        _stddev = statistics.stddev;
+        _jitter = statistics.jitter;
+        _p50_time = statistics.p50;
+        _p90_time = statistics.p90;
+        _p99_time = statistics.p99;
+    }
+    return self;
+}
+
 - (NSString *)description
 {
-    return [NSString stringWithFormat:@"TCP connect loss=%lu,  min/avg/max = %.2f/%.2f/%.2fms",(unsigned long)self.loss,self.min_time,self.avg_time,self.max_time];
+    return [NSString stringWithFormat:@"TCP connect loss=%lu,  min/avg/max = %.2f/%.2f/%.2fms, stddev = %.2fms, jitter = %.2fms, p50/p90/p99 = %.2f/%.2f/%.2fms",(unsigned long)self.loss,self.min_time,self.avg_time,self.max_time,self.stddev,self.jitter,self.p50_time,self.p90_time,self.p99_time];
 }
 
 @end
@@ -51,18 +67,12 @@
 
 //MARK: - RSTCPPing
 
-static RSTCPPing *g_tcpPing = nil;
-void tcp_connect_handler(int value)
-{
-    if (g_tcpPing) {
-        [g_tcpPing processLongConnect];
-    }
-}
-
+#define kTCPPingConnectTimeout  1000000     // microsecond, deadline of every connect
+#define kTCPPingInterval        100         // milisecond, gap between two connects
 
 @interface RSTCPPing()
 {
-    int sock;
+    struct sockaddr_storage destination;
 }
 @property (nonatomic,readonly) NSString  *host;
 @property (nonatomic,readonly) NSUInteger port;
@@ -71,6 +81,12 @@ void tcp_connect_handler(int value)
 @property (atomic) BOOL isStop;
 @property (nonatomic,assign) BOOL isSucc;
 @property (nonatomic,copy) NSMutableString *pingDetails;
+@property (nonatomic,strong) NSString *ip;
+@property (nonatomic,assign) BOOL isIPv6;
+@property (nonatomic,assign) NSUInteger index;
+@property (nonatomic,strong) RSLatencyStatistics *statistics;
+@property (nonatomic,assign) BOOL isSuccess;
+@property (atomic,assign) uint64_t probeId;
 @end
 
 @implementation RSTCPPing
@@ -104,10 +120,7 @@ void tcp_connect_handler(int value)
              complete:(RSTCPPingHandler _Nonnull)complete
 {
     RSTCPPing *tcpPing = [[RSTCPPing alloc] init:host port:port count:count complete:complete];
-    g_tcpPing = tcpPing;
-    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-        [tcpPing sendAndRec];
-    });
+    [tcpPing sendAndRec];
     return tcpPing;
 }
 
@@ -119,23 +132,24 @@ void tcp_connect_handler(int value)
 - (void)stopPing
 {
     _isStop = YES;
+    [[RSTCPProbeEngine shareInstance] cancelProbe:self.probeId];
 }
 
 - (void)sendAndRec
 {
     _pingDetails = [NSMutableString stringWithString:@"\n"];
-    NSString *ip = nil;
-    NSArray *address = [RSNetDiagnosisHelper resolveHost:self.host];
-    if (address.count > 0) {
-        ip = [address firstObject];
-//        if ([[RSNetInfoUtils shareInstance] isIPv6Environment]) {
-//            // IPv6 net, try reach IPv6 IPAddress
-//            for (NSString *add in address) {
-//                if ([add rangeOfString:@":"].location != NSNotFound) {
-//                    ip = add;
-//                }
-//            }
-//        }
+    // On dual-stack hosts, the family connecting first is probed. Raced on the selector queue and
+    // connected on the probe engine, so no thread of the caller is held
+    [[RSAddressSelector shareInstance] selectAddressForHost:self.host method:RSAddressRaceMethodTCP port:_port completeHandler:^(RSAddressSelection *selection) {
+        [self startWithSelection:selection];
+    }];
+}
+
+- (void)startWithSelection:(RSAddressSelection *)selection
+{
+    NSString *ip = selection.address;
+    if (selection.familyResults.count > 0) {
+        [_pingDetails appendFormat:@"select address: %@\n", [selection.familyResults componentsJoinedByString:@" | "]];
     }
     if (ip == NULL) {
         [_pingDetails appendString:[NSString stringWithFormat:@"access %@ DNS error..\n", self.host]];
@@ -143,141 +157,109 @@ void tcp_connect_handler(int value)
         return;
     }
     
-    BOOL isIPv6 = [ip rangeOfString:@":"].location != NSNotFound;
+    _ip = ip;
+    _isIPv6 = [ip rangeOfString:@":"].location != NSNotFound;
+    memset(&destination, 0, sizeof(destination));
+    if (_isIPv6) {
+        struct sockaddr_in6 *nativeAddr6 = (struct sockaddr_in6 *)&destination;
+        nativeAddr6->sin6_len = sizeof(struct sockaddr_in6);
+        nativeAddr6->sin6_family = AF_INET6;
+        nativeAddr6->sin6_port = htons(_port);
+        inet_pton(AF_INET6, ip.UTF8String, &nativeAddr6->sin6_addr);
+    } else {
+        struct sockaddr_in *nativeAddr4 = (struct sockaddr_in *)&destination;
+        nativeAddr4->sin_len = sizeof(struct sockaddr_in);
+        nativeAddr4->sin_family = AF_INET;
+        nativeAddr4->sin_port = htons(_port);
+        inet_pton(AF_INET, ip.UTF8String, &nativeAddr4->sin_addr.s_addr);
+    }
     
-    NSTimeInterval *intervals = (NSTimeInterval *)malloc(sizeof(NSTimeInterval) * _count);
-    int index = 0;
-    int r = 0;
-    BOOL isSuccess = NO;
-    int loss = 0;
-    do {
-        NSDate *t_begin = [NSDate date];
-        r = [self connect:ip isIPv6:isIPv6];
-        NSTimeInterval connect_time = [[NSDate date] timeIntervalSinceDate:t_begin];
-        intervals[index] = connect_time * 1000;
-        // IPv4 , socket connect success with return code 0
-        // IPv6, socket connect success with return code non -1
-        if ((!isIPv6 && r == 0) || (isIPv6 && r != -1)) {
-            isSuccess = YES;
-        }
-        if (isSuccess) {
-            [_pingDetails appendString:[NSString stringWithFormat:@"connect to %@:%lu,  %.2f ms \n",ip,_port,connect_time * 1000]];
-        } else {
-            [_pingDetails appendString:[NSString stringWithFormat:@"connect failed to %@:%lu, %f ms, error %d\n", ip, (unsigned long)_port, connect_time * 1000, r]];
-            loss++;
-        }
-        _complete(_pingDetails, NO);
-        if (index < _count && !_isStop && isSuccess) {
-            usleep(1000*100);
+    _statistics = [[RSLatencyStatistics alloc] init];
+    _index = 0;
+    _isSuccess = NO;
+    [self connectNext];
+}
+
+/// Start next connect on `RSTCPProbeEngine`, connects of one tcp ping go one after another
+- (void)connectNext
+{
+    if (_isStop) {
+        [self finishPing];
+        return;
+    }
+    // The handler can run before the id is returned, it takes the lock so it sees the id of its own probe,
+    // and only clears `probeId` if no later probe replaced it
+    @synchronized (self) {
+        __block uint64_t probeId = 0;
+        probeId = [[RSTCPProbeEngine shareInstance] connectToAddress:(struct sockaddr *)&destination
+                                                              timeout:kTCPPingConnectTimeout
+                                                              handler:^(int error, uint64_t latencyMicros) {
+            @synchronized (self) {
+                if (self.probeId == probeId) {
+                    self.probeId = 0;
+                }
+            }
+            [self handleConnectResult:error latency:latencyMicros];
+        }];
+        self.probeId = probeId;
+    }
+}
+
+- (void)handleConnectResult:(int)error latency:(uint64_t)latencyMicros
+{
+    NSTimeInterval connect_time = latencyMicros / 1000.0;
+    if (error == 0) {
+        _isSuccess = YES;
+        [_statistics addSampleMicros:latencyMicros];
+        [_pingDetails appendString:[NSString stringWithFormat:@"connect to %@:%lu,  %.2f ms \n",_ip,(unsigned long)_port,connect_time]];
+    } else {
+        // A connect cancelled by stop is not a loss
+        if (error != ECANCELED) {
+            [_statistics addLoss];
         }
-    } while (++index < _count && !_isStop && isSuccess);
+        [_pingDetails appendString:[NSString stringWithFormat:@"connect failed to %@:%lu, %f ms, error %d\n", _ip, (unsigned long)_port, connect_time, error]];
+    }
+    _complete(_pingDetails, NO);
     
-    NSInteger code = r;
-    if (_isStop) {
-        code = -5;
-    }else{
-        _isStop = YES;
+    if (++_index < _count && !_isStop && _isSuccess) {
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kTCPPingInterval * NSEC_PER_MSEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            [self connectNext];
+        });
+        return;
     }
+    [self finishPing];
+}
+
+- (void)finishPing
+{
+    _isStop = YES;
     
     dispatch_async(dispatch_get_main_queue(), ^(void) {
         
         if (self.isSucc) {
-            RSTCPPingResult *pingRes = [self conclusePingRes:code ip:ip durations:intervals loss:loss count:index isIPv6:isIPv6];
+            RSTCPPingResult *pingRes = [self conclusePingRes:self.ip statistics:self.statistics];
             [self.pingDetails appendString:pingRes.description];
         }
         self.complete(self.pingDetails, YES);
-        free(intervals);
     });
 }
 
 
 - (void)processLongConnect 
 {
-    close(sock);
     _isStop = YES;
     _isSucc = NO;
+    [[RSTCPProbeEngine shareInstance] cancelProbe:self.probeId];
 }
 
-- (int)connect:(NSString *)ipAddr 
-        isIPv6:(BOOL)isIPv6
+- (RSTCPPingResult *)conclusePingRes:(NSString *)ip
+                          statistics:(RSLatencyStatistics *)statistics
 {
-    NSData *addrData = nil;
-    if (isIPv6) {
-        struct sockaddr_in6 nativeAddr6;
-        memset(&nativeAddr6,0,sizeof(nativeAddr6));
-        nativeAddr6.sin6_len = sizeof(nativeAddr6);
-        nativeAddr6.sin6_family = AF_INET6;
-        nativeAddr6.sin6_port = htons(_port);
-        inet_pton(AF_INET6, ipAddr.UTF8String, &nativeAddr6.sin6_addr);
-        addrData = [NSData dataWithBytes:&nativeAddr6 length:sizeof(nativeAddr6)];
-    } else {
-        struct sockaddr_in nativeAddr4;
-        memset(&nativeAddr4,0,sizeof(nativeAddr4));
-        nativeAddr4.sin_len =sizeof(nativeAddr4);
-        nativeAddr4.sin_family = AF_INET;
-        nativeAddr4.sin_port = htons(_port);
-        inet_pton(AF_INET, ipAddr.UTF8String, &nativeAddr4.sin_addr.s_addr);
-        addrData = [NSData dataWithBytes:&nativeAddr4 length:sizeof(nativeAddr4)];
-    }
-    
-    const struct sockaddr * destination = (struct sockaddr *)[addrData bytes];
-    
-    sock = socket(destination->sa_family, SOCK_STREAM, IPPROTO_TCP);
-    
-    if (sock == -1) {
-        return errno;
-    }
-    int on = 1;
-    setsockopt(sock, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
-    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (char *)&on, sizeof(on));
-    
-    struct timeval timeout;
-    timeout.tv_sec = 10;
-    timeout.tv_usec = 0;
-    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout));
-    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, (char *)&timeout, sizeof(timeout));
-    
-    sigset(SIGALRM, tcp_connect_handler);
-    alarm(1);
-    int connect_res = connect(sock, destination, sizeof(struct sockaddr));
-    alarm(0);
-    sigrelse(SIGALRM);
-    
-    if (connect_res < 0) {
-        int err = errno;
-        close(sock);
-        return err;
-    }
-    close(sock);
-    return 0;
-}
-
-- (RSTCPPingResult *)conclusePingRes:(NSInteger)code
-                                  ip:(NSString *)ip
-                           durations:(NSTimeInterval *)durations
-                                loss:(NSUInteger)loss
-                               count:(NSUInteger)count
-                              isIPv6:(BOOL)isIPv6
-{
-    if ((!isIPv6 && code != 0 && code != -5) || (isIPv6 && code == -1)) {
+    if (statistics.totalCount == 0) {
+        // Stopped before any connect finished
         return [[RSTCPPingResult alloc] init:ip loss:1 count:1 max:0 min:0 avg:0];
     }
-    
-    NSTimeInterval max = 0;
-    NSTimeInterval min = 10000000;
-    NSTimeInterval sum = 0;
-    for (int i= 0; i < count; i++) {
-        if (durations[i] > max) {
-            max = durations[i];
-        }
-        if (durations[i] < min) {
-            min = durations[i];
-        }
-        sum += durations[i];
-    }
-    
-    NSTimeInterval avg = sum/count;
-    return [[RSTCPPingResult alloc] init:ip loss:loss count:count max:max min:min avg:avg];
+    return [[RSTCPPingResult alloc] init:ip statistics:statistics];
 }
 
 @end
@@ -0,0 +1,50 @@
+//
+//  RSTCPProbeEngine.h
+//  RSNetDiagnosis
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <sys/socket.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ @param error 0 if connected, `ETIMEDOUT` when deadline passed, otherwise errno of socket/connect
+ @param latencyMicros microsecond from `connect()` to completion, monotonic
+ */
+typedef void (^RSTCPProbeHandler)(int error, uint64_t latencyMicros);
+
+/**
+ Non-blocking TCP connect prober.
+
+ @discussion Every probe is a non-blocking socket waited by one poll loop, so any number of
+ host:port targets can be probed at the same time, each with a deadline of its own.
+ Handlers are called on the engine queue, keep them short.
+ */
+@interface RSTCPProbeEngine : NSObject
+
++ (instancetype)shareInstance;
+
+/**
+ @brief Start a TCP connect probe.
+
+ @param address destination, sockaddr_in or sockaddr_in6 with port set
+ @param timeoutMicros deadline of this probe in microsecond
+ @param handler called once when connected, failed or timed out
+ @return probe id, can be used to cancel the probe. 0 if probe failed to start, handler is still called.
+ */
+- (uint64_t)connectToAddress:(const struct sockaddr *)address
+                     timeout:(uint64_t)timeoutMicros
+                     handler:(RSTCPProbeHandler)handler;
+
+/**
+ @brief Cancel a probe in flight, its handler is called with `ECANCELED`.
+ */
+- (void)cancelProbe:(uint64_t)probeId;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,224 @@
+//
+//  RSTCPProbeEngine.m
+//  RSNetDiagnosis
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+
+#import "RSTCPProbeEngine.h"
+#import "RSNetDiagnosisLog.h"
+#import "RSNetDiagnosisHelper.h"
+
+#include <poll.h>
+#include <fcntl.h>
+
+#define KProbeEngineMaxWaitMillis   1000    // Upper bound of a single poll wait
+
+//MARK: - RSTCPProbe
+
+@interface RSTCPProbe : NSObject
+@property (nonatomic, assign) uint64_t probeId;
+@property (nonatomic, assign) int fd;
+@property (nonatomic, assign) uint64_t startTime;   // microsecond, monotonic
+@property (nonatomic, assign) uint64_t deadline;    // microsecond, monotonic
+@property (nonatomic, assign) BOOL cancelled;
+@property (nonatomic, copy) RSTCPProbeHandler handler;
+@end
+
+@implementation RSTCPProbe
+@end
+
+
+//MARK: - RSTCPProbeEngine
+
+@interface RSTCPProbeEngine()
+{
+    int _wakeupPipe[2];
+    uint64_t _nextProbeId;
+    BOOL _isRunning;
+}
+@property (nonatomic, strong) NSMutableDictionary<NSNumber *, RSTCPProbe *> *probes;
+@property (nonatomic, strong) dispatch_queue_t loopQueue;
+@end
+
+@implementation RSTCPProbeEngine
+
++ (instancetype)shareInstance
+{
+    static id instace = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        instace = [[self alloc] init];
+    });
+    return instace;
+}
+
+- (instancetype)init
+{
+    if (self = [super init]) {
+        if (pipe(_wakeupPipe) == 0) {
+            fcntl(_wakeupPipe[0], F_SETFL, fcntl(_wakeupPipe[0], F_GETFL, 0) | O_NONBLOCK);
+            fcntl(_wakeupPipe[1], F_SETFL, fcntl(_wakeupPipe[1], F_GETFL, 0) | O_NONBLOCK);
+        } else {
+            _wakeupPipe[0] = -1;
+            _wakeupPipe[1] = -1;
+            log4cplus_warn("RSTCPProbeEngine", "create wakeup pipe error: %s\n", strerror(errno));
+        }
+        _nextProbeId = 1;
+        _probes = [NSMutableDictionary dictionary];
+        _loopQueue = dispatch_queue_create("rs_net_tcp_probe_queue", DISPATCH_QUEUE_SERIAL);
+    }
+    return self;
+}
+
+#pragma mark - Probe
+
+- (uint64_t)connectToAddress:(const struct sockaddr *)address
+                     timeout:(uint64_t)timeoutMicros
+                     handler:(RSTCPProbeHandler)handler
+{
+    int fd = socket(address->sa_family, SOCK_STREAM, IPPROTO_TCP);
+    if (fd < 0) {
+        int err = errno;
+        dispatch_async(self.loopQueue, ^{
+            handler(err, 0);
+        });
+        return 0;
+    }
+
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (char *)&on, sizeof(on));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    socklen_t addrLen = address->sa_family == AF_INET6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+    uint64_t startTime = RSNetMonotonicMicros();
+    int res = connect(fd, address, addrLen);
+    if (res == 0 || errno != EINPROGRESS) {
+        // Done at once, e.g. loopback, or refused before waiting
+        int err = res == 0 ? 0 : errno;
+        uint64_t latency = RSNetMonotonicMicros() - startTime;
+        close(fd);
+        dispatch_async(self.loopQueue, ^{
+            handler(err, latency);
+        });
+        return 0;
+    }
+
+    RSTCPProbe *probe = [[RSTCPProbe alloc] init];
+    probe.fd = fd;
+    probe.startTime = startTime;
+    probe.deadline = startTime + timeoutMicros;
+    probe.handler = handler;
+
+    @synchronized (self) {
+        probe.probeId = _nextProbeId++;
+        self.probes[@(probe.probeId)] = probe;
+        if (!_isRunning) {
+            _isRunning = YES;
+            dispatch_async(self.loopQueue, ^{
+                [self runLoop];
+            });
+        }
+    }
+    [self wakeup];
+    return probe.probeId;
+}
+
+- (void)cancelProbe:(uint64_t)probeId
+{
+    @synchronized (self) {
+        self.probes[@(probeId)].cancelled = YES;
+    }
+    [self wakeup];
+}
+
+- (void)wakeup
+{
+    if (_wakeupPipe[1] >= 0) {
+        char byte = 0;
+        write(_wakeupPipe[1], &byte, 1);
+    }
+}
+
+- (void)finishProbe:(RSTCPProbe *)probe error:(int)error now:(uint64_t)now
+{
+    @synchronized (self) {
+        [self.probes removeObjectForKey:@(probe.probeId)];
+    }
+    close(probe.fd);
+    probe.handler(error, now - probe.startTime);
+}
+
+#pragma mark - Loop
+
+- (void)runLoop
+{
+    while (YES) {
+        NSArray<RSTCPProbe *> *probes = nil;
+        @synchronized (self) {
+            if (self.probes.count == 0) {
+                _isRunning = NO;
+                return;
+            }
+            probes = self.probes.allValues;
+        }
+
+        // Settle cancelled and expired probes, collect the nearest deadline
+        uint64_t now = RSNetMonotonicMicros();
+        uint64_t wakeTime = UINT64_MAX;
+        NSMutableArray<RSTCPProbe *> *waiting = [NSMutableArray arrayWithCapacity:probes.count];
+        for (RSTCPProbe *probe in probes) {
+            BOOL cancelled = NO;
+            @synchronized (self) {
+                cancelled = probe.cancelled;
+            }
+            if (cancelled) {
+                [self finishProbe:probe error:ECANCELED now:now];
+            } else if (now >= probe.deadline) {
+                [self finishProbe:probe error:ETIMEDOUT now:now];
+            } else {
+                wakeTime = MIN(wakeTime, probe.deadline);
+                [waiting addObject:probe];
+            }
+        }
+        if (waiting.count == 0) {
+            continue;
+        }
+
+        int timeout = (int)MIN((wakeTime - now + 999) / 1000, (uint64_t)KProbeEngineMaxWaitMillis);
+        NSUInteger fdCount = waiting.count + 1;
+        struct pollfd *fds = (struct pollfd *)calloc(fdCount, sizeof(struct pollfd));
+        for (NSUInteger i = 0; i < waiting.count; i++) {
+            fds[i] = (struct pollfd){ waiting[i].fd, POLLOUT, 0 };
+        }
+        fds[waiting.count] = (struct pollfd){ _wakeupPipe[0], POLLIN, 0 };
+
+        int ready = poll(fds, (nfds_t)fdCount, timeout);
+        uint64_t readyTime = RSNetMonotonicMicros();
+        if (ready < 0 && errno != EINTR) {
+            log4cplus_warn("RSTCPProbeEngine", "poll error: %s\n", strerror(errno));
+        }
+
+        for (NSUInteger i = 0; i < waiting.count && ready > 0; i++) {
+            if (!(fds[i].revents & (POLLOUT | POLLERR | POLLHUP))) {
+                continue;
+            }
+            // Writable means connect finished, SO_ERROR tells how
+            int err = 0;
+            socklen_t errLen = sizeof(err);
+            if (getsockopt(fds[i].fd, SOL_SOCKET, SO_ERROR, &err, &errLen) < 0) {
+                err = errno;
+            }
+            [self finishProbe:waiting[i] error:err now:readyTime];
+        }
+        if (ready > 0 && (fds[waiting.count].revents & POLLIN)) {
+            char drain[64];
+            while (read(_wakeupPipe[0], drain, sizeof(drain)) > 0) {}
+        }
+        free(fds);
+    }
+}
+
+@end
@@ -0,0 +1,114 @@
+//
+//  RSICMPReactor.h
+//  RSNetDiagnosis
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+
+// Add this to use some newer macro
+#define __APPLE_USE_RFC_3542
+
+#import <Foundation/Foundation.h>
+#import <sys/socket.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ A session driven by `RSICMPReactor`.
+
+ @discussion All methods are called on the reactor thread, one at a time.
+ */
+@protocol RSICMPReactorSession <NSObject>
+
+/**
+ @brief Give the session a chance to send probes and expire timeouts.
+
+ @param now monotonic microsecond, see `RSNetMonotonicMicros()`
+ @return monotonic microsecond the session wants to be ticked again, or 0 when the session is finished and should be removed.
+ */
+- (uint64_t)icmpReactorTick:(uint64_t)now;
+
+/**
+ @brief An ICMP packet carrying the identifier of this session arrived.
+
+ @param buffer packet as returned by `recvfrom`, IPv4 packet includes IP header
+ @param length packet length
+ @param address source address of the packet
+ @param receiveTime monotonic microsecond, taken right after `recvfrom` returned
+ */
+- (void)icmpReactorDidReceivePacket:(char *)buffer
+                             length:(int)length
+                        fromAddress:(const struct sockaddr *)address
+                        receiveTime:(uint64_t)receiveTime;
+
+@end
+
+
+/**
+ Shared ICMP socket reactor.
+
+ @discussion One ICMP socket per address family is shared by every session. A single poll loop
+ waits for readiness, and demultiplexes packets to sessions by ICMP identifier, taken from echo
+ replies or from the request quoted in Time Exceeded / Destination Unreachable. So several ping
+ and traceroute sessions can run at the same time without stringing packets.
+ */
+@interface RSICMPReactor : NSObject
+
++ (instancetype)shareInstance;
+
+/**
+ @brief Register a session, and start the loop if needed.
+
+ @param session session to be driven, retained until its tick returns 0 or it is unregistered
+ @param family AF_INET or AF_INET6
+ @param identifier on success, the ICMP identifier reserved for this session
+ @return NO if socket of this family can not be created
+ */
+- (BOOL)registerSession:(id<RSICMPReactorSession>)session
+                 family:(int)family
+             identifier:(uint16_t *)identifier;
+
+/**
+ @brief Remove a session, its identifier can be reused afterwards.
+ */
+- (void)unregisterSession:(id<RSICMPReactorSession>)session;
+
+/**
+ @brief Send a packet on the shared socket of the destination family.
+
+ @return same as `sendto`
+ */
+- (ssize_t)sendPacket:(const void *)packet
+               length:(size_t)length
+            toAddress:(const struct sockaddr *)destination;
+
+/**
+ @brief Send a packet with a TTL (hop limit for IPv6) of its own.
+
+ @discussion TTL of the shared socket is restored after sending. Must be called on the reactor
+ thread, i.e. from `icmpReactorTick:`, so no other session sends in between.
+
+ @return same as `sendto`
+ */
+- (ssize_t)sendPacket:(const void *)packet
+               length:(size_t)length
+            toAddress:(const struct sockaddr *)destination
+                  ttl:(int)ttl;
+
+/**
+ @brief Run a block on the reactor thread, before the sessions are ticked again.
+
+ @discussion Blocks run one at a time in the order they are submitted, so a block unregistering a
+ session always completes before a block submitted after it registers that session again.
+ */
+- (void)performBlock:(dispatch_block_t)block;
+
+/**
+ @brief Interrupt the current wait, so every session is ticked again immediately.
+ */
+- (void)wakeup;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,349 @@
+//
+//  RSICMPReactor.m
+//  RSNetDiagnosis
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+
+#import "RSICMPReactor.h"
+#import "RSNetDiagnosisLog.h"
+#import "RSNetDiagnosisHelper.h"
+
+#include <poll.h>
+#include <fcntl.h>
+
+#define KReactorICMPIdBeginNum  8000
+#define KReactorMaxWaitMillis   1000    // Upper bound of a single poll wait
+
+/// Index of socket in `_sockets`
+static inline int RSReactorFamilyIndex(int family)
+{
+    return family == AF_INET6 ? 1 : 0;
+}
+
+/// Key of session in `sessions`, identifiers are reserved per family
+static inline NSNumber *RSReactorSessionKey(int family, uint16_t identifier)
+{
+    return @((RSReactorFamilyIndex(family) << 16) | identifier);
+}
+
+@interface RSICMPReactor()
+{
+    int _sockets[2];        // [0] AF_INET, [1] AF_INET6
+    int _wakeupPipe[2];
+    uint16_t _nextIdentifier;
+    BOOL _isRunning;
+}
+@property (nonatomic, strong) NSMutableDictionary<NSNumber *, id<RSICMPReactorSession>> *sessions;
+@property (nonatomic, strong) NSMutableArray<dispatch_block_t> *pendingBlocks;
+@property (nonatomic, strong) dispatch_queue_t loopQueue;
+@end
+
+@implementation RSICMPReactor
+
++ (instancetype)shareInstance
+{
+    static id instace = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        instace = [[self alloc] init];
+    });
+    return instace;
+}
+
+- (instancetype)init
+{
+    if (self = [super init]) {
+        _sockets[0] = -1;
+        _sockets[1] = -1;
+        if (pipe(_wakeupPipe) == 0) {
+            fcntl(_wakeupPipe[0], F_SETFL, fcntl(_wakeupPipe[0], F_GETFL, 0) | O_NONBLOCK);
+            fcntl(_wakeupPipe[1], F_SETFL, fcntl(_wakeupPipe[1], F_GETFL, 0) | O_NONBLOCK);
+        } else {
+            _wakeupPipe[0] = -1;
+            _wakeupPipe[1] = -1;
+            log4cplus_warn("RSICMPReactor", "create wakeup pipe error: %s\n", strerror(errno));
+        }
+        _nextIdentifier = (uint16_t)(getpid() + KReactorICMPIdBeginNum);
+        _sessions = [NSMutableDictionary dictionary];
+        _pendingBlocks = [NSMutableArray array];
+        _loopQueue = dispatch_queue_create("rs_net_icmp_reactor_queue", DISPATCH_QUEUE_SERIAL);
+    }
+    return self;
+}
+
+#pragma mark - Session
+
+- (BOOL)registerSession:(id<RSICMPReactorSession>)session
+                 family:(int)family
+             identifier:(uint16_t *)identifier
+{
+    @synchronized (self) {
+        if (![self openSocketForFamily:family]) {
+            return NO;
+        }
+
+        // Find an identifier not used by a living session of this family
+        uint16_t candidate = _nextIdentifier;
+        while (self.sessions[RSReactorSessionKey(family, candidate)] != nil) {
+            candidate++;
+        }
+        _nextIdentifier = candidate + 1;
+
+        *identifier = candidate;
+        self.sessions[RSReactorSessionKey(family, candidate)] = session;
+
+        [self startLoopIfNeeded];
+    }
+    [self wakeup];
+    return YES;
+}
+
+- (void)unregisterSession:(id<RSICMPReactorSession>)session
+{
+    @synchronized (self) {
+        NSArray *keys = [self.sessions allKeysForObject:session];
+        [self.sessions removeObjectsForKeys:keys];
+    }
+    [self wakeup];
+}
+
+- (void)performBlock:(dispatch_block_t)block
+{
+    @synchronized (self) {
+        [self.pendingBlocks addObject:[block copy]];
+        [self startLoopIfNeeded];
+    }
+    [self wakeup];
+}
+
+/// Must be called inside `@synchronized (self)`
+- (void)startLoopIfNeeded
+{
+    if (!_isRunning) {
+        _isRunning = YES;
+        dispatch_async(self.loopQueue, ^{
+            [self runLoop];
+        });
+    }
+}
+
+#pragma mark - Socket
+
+- (BOOL)openSocketForFamily:(int)family
+{
+    int index = RSReactorFamilyIndex(family);
+    if (_sockets[index] >= 0) {
+        return YES;
+    }
+
+    BOOL isIPv6 = family == AF_INET6;
+    int sock = socket(family, SOCK_DGRAM, isIPv6 ? IPPROTO_ICMPV6 : IPPROTO_ICMP);
+    if (sock < 0) {
+        log4cplus_warn("RSICMPReactor", "Error creating socket: %s\n", strerror(errno));
+        return NO;
+    }
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+
+    // IPv6 must set IPV6_RECVPKTINFO on
+    if (isIPv6) {
+        int on = 1;
+        if (setsockopt(sock, IPPROTO_IPV6, IPV6_RECVPKTINFO, &on, sizeof(on)) < 0) {
+            log4cplus_warn("RSICMPReactor", "set ipv6 receive on error..\n");
+        }
+    }
+    _sockets[index] = sock;
+    return YES;
+}
+
+- (void)closeSockets
+{
+    for (int i = 0; i < 2; i++) {
+        if (_sockets[i] >= 0) {
+            shutdown(_sockets[i], SHUT_RDWR);
+            close(_sockets[i]);
+            _sockets[i] = -1;
+        }
+    }
+}
+
+- (ssize_t)sendPacket:(const void *)packet
+               length:(size_t)length
+            toAddress:(const struct sockaddr *)destination
+{
+    int sock = -1;
+    @synchronized (self) {
+        sock = _sockets[RSReactorFamilyIndex(destination->sa_family)];
+    }
+    if (sock < 0) {
+        errno = EBADF;
+        return -1;
+    }
+    socklen_t addrLen = destination->sa_family == AF_INET6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+    return sendto(sock, packet, length, 0, destination, addrLen);
+}
+
+- (ssize_t)sendPacket:(const void *)packet
+               length:(size_t)length
+            toAddress:(const struct sockaddr *)destination
+                  ttl:(int)ttl
+{
+    int sock = -1;
+    @synchronized (self) {
+        sock = _sockets[RSReactorFamilyIndex(destination->sa_family)];
+    }
+    if (sock < 0) {
+        errno = EBADF;
+        return -1;
+    }
+
+    BOOL isIPv6 = destination->sa_family == AF_INET6;
+    int level = isIPv6 ? IPPROTO_IPV6 : IPPROTO_IP;
+    int option = isIPv6 ? IPV6_UNICAST_HOPS : IP_TTL;
+    int originTTL = 0;
+    socklen_t optionLen = sizeof(originTTL);
+    if (getsockopt(sock, level, option, &originTTL, &optionLen) < 0) {
+        originTTL = isIPv6 ? -1 : 64;    // -1 means kernel default for IPV6_UNICAST_HOPS
+    }
+    if (setsockopt(sock, level, option, &ttl, sizeof(ttl)) < 0) {
+        log4cplus_debug("RSICMPReactor", "set TTL for icmp packet error..\n");
+    }
+    ssize_t sent = [self sendPacket:packet length:length toAddress:destination];
+    setsockopt(sock, level, option, &originTTL, sizeof(originTTL));
+    return sent;
+}
+
+- (void)wakeup
+{
+    if (_wakeupPipe[1] >= 0) {
+        char byte = 0;
+        write(_wakeupPipe[1], &byte, 1);
+    }
+}
+
+#pragma mark - Loop
+
+- (void)runLoop
+{
+    while (YES) {
+        // Blocks run outside the lock, they may register or unregister sessions
+        NSArray<dispatch_block_t> *blocks = nil;
+        @synchronized (self) {
+            blocks = [self.pendingBlocks copy];
+            [self.pendingBlocks removeAllObjects];
+        }
+        for (dispatch_block_t block in blocks) {
+            block();
+        }
+
+        NSDictionary<NSNumber *, id<RSICMPReactorSession>> *sessions = nil;
+        int sockets[2];
+        @synchronized (self) {
+            if (self.sessions.count == 0) {
+                if (self.pendingBlocks.count > 0) {
+                    continue;   // Submitted after the drain above, run them before leaving
+                }
+                // Nothing to drive, release the sockets until next session comes
+                [self closeSockets];
+                _isRunning = NO;
+                return;
+            }
+            sessions = [self.sessions copy];
+            sockets[0] = _sockets[0];
+            sockets[1] = _sockets[1];
+        }
+
+        // Tick every session, collect the nearest wake time
+        uint64_t now = RSNetMonotonicMicros();
+        uint64_t wakeTime = UINT64_MAX;
+        for (NSNumber *key in sessions) {
+            id<RSICMPReactorSession> session = sessions[key];
+            uint64_t next = [session icmpReactorTick:now];
+            if (next == 0) {
+                @synchronized (self) {
+                    if (self.sessions[key] == session) {
+                        [self.sessions removeObjectForKey:key];
+                    }
+                }
+            } else {
+                wakeTime = MIN(wakeTime, next);
+            }
+        }
+
+        int timeout = KReactorMaxWaitMillis;
+        now = RSNetMonotonicMicros();
+        if (wakeTime <= now) {
+            timeout = 0;
+        } else if (wakeTime != UINT64_MAX) {
+            timeout = (int)MIN((wakeTime - now + 999) / 1000, (uint64_t)KReactorMaxWaitMillis);
+        }
+
+        struct pollfd fds[3];
+        int fdCount = 0;
+        for (int i = 0; i < 2; i++) {
+            if (sockets[i] >= 0) {
+                fds[fdCount++] = (struct pollfd){ sockets[i], POLLIN, 0 };
+            }
+        }
+        if (_wakeupPipe[0] >= 0) {
+            fds[fdCount++] = (struct pollfd){ _wakeupPipe[0], POLLIN, 0 };
+        }
+
+        int ready = poll(fds, fdCount, timeout);
+        if (ready < 0) {
+            if (errno != EINTR) {
+                log4cplus_warn("RSICMPReactor", "poll error: %s\n", strerror(errno));
+                usleep(1000 * 10);
+            }
+            continue;
+        }
+
+        for (int i = 0; i < fdCount && ready > 0; i++) {
+            if (!(fds[i].revents & POLLIN)) {
+                continue;
+            }
+            if (fds[i].fd == _wakeupPipe[0]) {
+                char drain[64];
+                while (read(_wakeupPipe[0], drain, sizeof(drain)) > 0) {}
+            } else {
+                [self drainSocket:fds[i].fd isIPv6:(fds[i].fd == sockets[1])];
+            }
+        }
+    }
+}
+
+/// Read every pending packet on the socket, and hand each to the session owning its identifier
+- (void)drainSocket:(int)sock isIPv6:(BOOL)isIPv6
+{
+    char buffer[1024];
+    while (YES) {
+        struct sockaddr_storage ret_addr;
+        socklen_t addrLen = sizeof(ret_addr);
+        ssize_t bytesRead = recvfrom(sock, buffer, sizeof(buffer), 0, (struct sockaddr *)&ret_addr, &addrLen);
+        uint64_t receiveTime = RSNetMonotonicMicros();
+
+        if (bytesRead <= 0) {
+            if (bytesRead < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                log4cplus_warn("RSICMPReactor", "receive icmp packet error: %s\n", strerror(errno));
+            }
+            return;
+        }
+
+        // Echo reply carries the identifier itself, errors quote the original request
+        uint8_t type = 0;
+        uint16_t identifier = 0;
+        uint16_t seq = 0;
+        if (![RSNetDiagnosisHelper parseICMPResponseWithBuffer:buffer length:(int)bytesRead isIPv6:isIPv6 type:&type identifier:&identifier seq:&seq]) {
+            continue;
+        }
+
+        id<RSICMPReactorSession> session = nil;
+        @synchronized (self) {
+            session = self.sessions[RSReactorSessionKey(isIPv6 ? AF_INET6 : AF_INET, identifier)];
+        }
+        [session icmpReactorDidReceivePacket:buffer length:(int)bytesRead fromAddress:(struct sockaddr *)&ret_addr receiveTime:receiveTime];
+    }
+}
+
+@end
@@ -0,0 +1,64 @@
+//
+//  RSLatencyStatistics.h
+//  RSNetDiagnosis
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Streaming latency statistics.
+
+ @discussion Samples are folded in as they come, memory is fixed whatever the probe count.
+ Mean and stddev use Welford's method, jitter is the mean difference of consecutive samples,
+ percentiles come from a log-linear histogram (16 buckets per power of two, error within 1/16).
+ Not thread safe, feed it from the thread driving the probes.
+ */
+@interface RSLatencyStatistics : NSObject
+
+/// Samples plus losses
+@property (nonatomic, readonly) NSUInteger totalCount;
+@property (nonatomic, readonly) NSUInteger receivedCount;
+@property (nonatomic, readonly) NSUInteger lossCount;
+/// Loss percent in [0, 100]
+@property (nonatomic, readonly) double lossPercent;
+
+/// Values below are in millisecond, 0 when there is no sample
+@property (nonatomic, readonly) double min;
+@property (nonatomic, readonly) double max;
+@property (nonatomic, readonly) double mean;
+@property (nonatomic, readonly) double stddev;
+@property (nonatomic, readonly) double jitter;
+@property (nonatomic, readonly) double p50;
+@property (nonatomic, readonly) double p90;
+@property (nonatomic, readonly) double p99;
+
+/**
+ @brief Add a round trip time.
+
+ @param rttMicros microsecond, the difference of two `RSNetMonotonicMicros()` stamps
+ */
+- (void)addSampleMicros:(uint64_t)rttMicros;
+
+/**
+ @brief Add a probe which got no answer.
+ */
+- (void)addLoss;
+
+/**
+ @brief Percentile of samples.
+
+ @param percent in (0, 100]
+ @return millisecond, 0 when there is no sample
+ */
+- (double)percentile:(double)percent;
+
+- (void)reset;
+
+@end
+
+NS_ASSUME_NONNULL_END
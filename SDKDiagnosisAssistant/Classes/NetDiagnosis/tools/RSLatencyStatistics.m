@@ -0,0 +1,179 @@
+//
+//  RSLatencyStatistics.m
+//  RSNetDiagnosis
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+
+#import "RSLatencyStatistics.h"
+
+#define KStatsSubBucketBits     4
+#define KStatsSubBucketCount    (1 << KStatsSubBucketBits)
+#define KStatsMaxExponent       26      // 2^26 microsecond, about 67s, larger samples fall in the last bucket
+#define KStatsBucketCount       (KStatsSubBucketCount * (KStatsMaxExponent - KStatsSubBucketBits + 1))
+
+/// Bucket of a value: values below 16 map one to one, above that every power of two is split into 16
+static inline int RSStatsBucketIndex(uint64_t value)
+{
+    if (value < KStatsSubBucketCount) {
+        return (int)value;
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    if (exponent >= KStatsMaxExponent) {
+        return KStatsBucketCount - 1;
+    }
+    int shift = exponent - KStatsSubBucketBits;
+    int sub = (int)((value >> shift) & (KStatsSubBucketCount - 1));
+    return KStatsSubBucketCount + shift * KStatsSubBucketCount + sub;
+}
+
+/// Middle value of a bucket, in microsecond
+static inline double RSStatsBucketValue(int index)
+{
+    if (index < KStatsSubBucketCount) {
+        return index;
+    }
+    int shift = index / KStatsSubBucketCount - 1;
+    int sub = index % KStatsSubBucketCount;
+    uint64_t lower = (uint64_t)(KStatsSubBucketCount + sub) << shift;
+    return lower + ((1ULL << shift) - 1) / 2.0;
+}
+
+@interface RSLatencyStatistics()
+{
+    uint32_t _buckets[KStatsBucketCount];
+    uint64_t _minMicros;
+    uint64_t _maxMicros;
+    uint64_t _lastMicros;
+    double _mean;       // microsecond
+    double _m2;         // sum of squared differences from the mean
+    double _jitterSum;  // microsecond
+}
+@end
+
+@implementation RSLatencyStatistics
+
+- (instancetype)init
+{
+    if (self = [super init]) {
+        [self reset];
+    }
+    return self;
+}
+
+- (void)reset
+{
+    memset(_buckets, 0, sizeof(_buckets));
+    _minMicros = UINT64_MAX;
+    _maxMicros = 0;
+    _lastMicros = 0;
+    _mean = 0;
+    _m2 = 0;
+    _jitterSum = 0;
+    _receivedCount = 0;
+    _lossCount = 0;
+}
+
+- (void)addSampleMicros:(uint64_t)rttMicros
+{
+    _receivedCount++;
+    _minMicros = MIN(_minMicros, rttMicros);
+    _maxMicros = MAX(_maxMicros, rttMicros);
+    _buckets[RSStatsBucketIndex(rttMicros)]++;
+
+    double delta = (double)rttMicros - _mean;
+    _mean += delta / _receivedCount;
+    _m2 += delta * ((double)rttMicros - _mean);
+
+    if (_receivedCount > 1) {
+        _jitterSum += rttMicros > _lastMicros ? rttMicros - _lastMicros : _lastMicros - rttMicros;
+    }
+    _lastMicros = rttMicros;
+}
+
+- (void)addLoss
+{
+    _lossCount++;
+}
+
+- (double)percentile:(double)percent
+{
+    if (_receivedCount == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)ceil(_receivedCount * MIN(MAX(percent, 0.0), 100.0) / 100.0);
+    rank = MAX(rank, (uint64_t)1);
+
+    uint64_t seen = 0;
+    for (int i = 0; i < KStatsBucketCount; i++) {
+        seen += _buckets[i];
+        if (seen >= rank) {
+            // Never report outside of what was really seen
+            double value = MIN(MAX(RSStatsBucketValue(i), (double)_minMicros), (double)_maxMicros);
+            return value / 1000.0;
+        }
+    }
+    return _maxMicros / 1000.0;
+}
+
+#pragma mark - Getter
+
+- (NSUInteger)totalCount
+{
+    return _receivedCount + _lossCount;
+}
+
+- (double)lossPercent
+{
+    NSUInteger total = self.totalCount;
+    return total == 0 ? 0 : _lossCount * 100.0 / total;
+}
+
+- (double)min
+{
+    return _receivedCount == 0 ? 0 : _minMicros / 1000.0;
+}
+
+- (double)max
+{
+    return _maxMicros / 1000.0;
+}
+
+- (double)mean
+{
+    return _mean / 1000.0;
+}
+
+- (double)stddev
+{
+    return _receivedCount == 0 ? 0 : sqrt(_m2 / _receivedCount) / 1000.0;
+}
+
+- (double)jitter
+{
+    return _receivedCount < 2 ? 0 : _jitterSum / (_receivedCount - 1) / 1000.0;
+}
+
+- (double)p50
+{
+    return [self percentile:50];
+}
+
+- (double)p90
+{
+    return [self percentile:90];
+}
+
+- (double)p99
+{
+    return [self percentile:99];
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"count:%lu , loss:%.0f%% , min/avg/max/stddev = %.3f/%.3f/%.3f/%.3fms , jitter:%.3fms , p50/p90/p99 = %.3f/%.3f/%.3fms",
+            (unsigned long)self.totalCount, self.lossPercent, self.min, self.mean, self.max, self.stddev, self.jitter, self.p50, self.p90, self.p99];
+}
+
+@end
@@ -12,7 +12,6 @@ NS_ASSUME_NONNULL_BEGIN
 
 @interface RSNetQueue : NSObject
 
-+ (void)rs_net_ping_async:(dispatch_block_t)block;
 + (void)rs_net_trace_async:(dispatch_block_t)block;
 
 @end
@@ -9,7 +9,6 @@
 #import "RSNetQueue.h"
 
 @interface RSNetQueue()
-@property (nonatomic) dispatch_queue_t pingQueue;
 @property (nonatomic) dispatch_queue_t traceQueue;
 
 @end
@@ -30,19 +29,11 @@
 - (instancetype)init
 {
     if (self = [super init]) {
-        _pingQueue = dispatch_queue_create("rs_net_ping_queue", DISPATCH_QUEUE_SERIAL);
         _traceQueue = dispatch_queue_create("rs_net_trace_queue", DISPATCH_QUEUE_SERIAL);
     }
     return self;
 }
 
-+ (void)rs_net_ping_async:(dispatch_block_t)block
-{
-    dispatch_async([RSNetQueue shareInstance].pingQueue, ^{
-        block();
-    });
-}
-
 + (void)rs_net_trace_async:(dispatch_block_t)block
 {
     dispatch_async([RSNetQueue shareInstance].traceQueue , ^{
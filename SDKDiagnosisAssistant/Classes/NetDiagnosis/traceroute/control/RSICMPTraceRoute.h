@@ -15,6 +15,8 @@
 #define kTraceRouteMaxNoResCount        10      // Max count of no result nodes
 #define kTraceRouteMaxHop               30      // Max hops of traceroute
 #define kTraceRoutePacketCountPerNode   3       // Send 3 packet on every router node
+#define kTraceRouteProbeTimeout         1000    // milisecond, wait time for the reply of a probe
+#define kTraceRouteRoundInterval        100     // milisecond, gap between probe rounds in parallel TTL mode
 
 @class RSICMPTraceRoute;
 @protocol RSICMPTraceRouteDelegate<NSObject>
@@ -28,6 +30,12 @@
 @interface RSICMPTraceRoute : NSObject
 @property (nonatomic,strong) id<RSICMPTraceRouteDelegate> delegate;
 
+/// Default is YES.
+/// YES: send a probe for every TTL at once (one round per packet of a node), match replies by the quoted
+/// identifier/seq, so a full trace takes about one max RTT plus timeout.
+/// NO: walk TTL one by one, waiting for each probe.
+@property (nonatomic, assign) BOOL parallelTTL;
+
 - (void)startTracerouteHost:(NSString *)host;
 
 - (void)stopTraceroute;
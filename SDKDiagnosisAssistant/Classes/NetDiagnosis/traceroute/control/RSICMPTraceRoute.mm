@@ -12,6 +12,9 @@
 #import "RSNetInfoUtils.h"
 #import "RSNetQueue.h"
 #import "RSNetDiagnosisHelper.h"
+#import "RSICMPReactor.h"
+#import "RSAddressSelector.h"
+#import "RSICMPPacketPool.h"
 
 typedef NS_ENUM(NSUInteger, RSTraceRouteRecICMPType)
 {
@@ -21,19 +24,34 @@ typedef NS_ENUM(NSUInteger, RSTraceRouteRecICMPType)
     RSTraceRouteRecICMPType_Destination
 };
 
-@interface RSICMPTraceRoute()
+@interface RSICMPTraceRoute() <RSICMPReactorSession>
 {
     int socket_client;
     struct sockaddr_in  remote_addr;
     struct sockaddr_in6 remote_addr6;
     struct sockaddr * destination;
+    
+    // Parallel TTL mode, only touched on reactor thread once the session is registered.
+    // Probe of hop `ttl` in round `r` is sent with seq (ttl - 1) * kTraceRoutePacketCountPerNode + r
+    struct sockaddr_storage probeDestination;
+    uint16_t identifier;
+    uint64_t startTime;
+    uint64_t sendTimes[kTraceRouteMaxHop][kTraceRoutePacketCountPerNode];  // 0 means not sent
+    BOOL answered[kTraceRouteMaxHop][kTraceRoutePacketCountPerNode];
+    int sentRounds;
+    int destinationHop;         // 0 until the path length is pinned by the destination
+    int nextReportHop;
+    int continuousNoReplyHops;
+    
+    RSICMPPacketPool *packetPool;
 }
 
 @property (nonatomic, strong) NSString *host;
 @property (nonatomic, assign) BOOL stopTraceFlag;
 @property (nonatomic, assign) BOOL isTracerouting;
 @property (nonatomic, assign) RSTraceRouteRecICMPType lastTraceRouteRecICMPType;
-@property (nonatomic, strong) NSDate *sendDate;
+@property (nonatomic, assign) uint64_t sendTime;    // microsecond, monotonic
+@property (nonatomic, strong) NSArray<RSTraceRouteResult *> *hopRecords;
 @end
 
 @implementation RSICMPTraceRoute
@@ -44,6 +62,7 @@ typedef NS_ENUM(NSUInteger, RSTraceRouteRecICMPType)
         _stopTraceFlag = NO;
         _isTracerouting = NO;
         _lastTraceRouteRecICMPType = RSTraceRouteRecICMPType_None;
+        _parallelTTL = YES;
     }
     return self;
 }
@@ -52,6 +71,7 @@ typedef NS_ENUM(NSUInteger, RSTraceRouteRecICMPType)
 {
     _stopTraceFlag = YES;
     _isTracerouting = NO;
+    [[RSICMPReactor shareInstance] wakeup];
     if (self.delegate && [self.delegate respondsToSelector:@selector(traceRouteDidFinished:)]) {
         [self.delegate traceRouteDidFinished: self];
     }
@@ -65,24 +85,22 @@ typedef NS_ENUM(NSUInteger, RSTraceRouteRecICMPType)
 - (void)settingICMPSocket
 {
     NSString *ipAddress = _host;
-    NSData *addrData = nil;
     BOOL isIPv6 = [ipAddress rangeOfString:@":"].location != NSNotFound;
     if (isIPv6) {
         memset(&remote_addr6,0,sizeof(remote_addr6));
         remote_addr6.sin6_len = sizeof(remote_addr6);
         remote_addr6.sin6_family = AF_INET6;
         inet_pton(AF_INET6, ipAddress.UTF8String, &remote_addr6.sin6_addr);
-        addrData = [NSData dataWithBytes:&remote_addr6 length:sizeof(remote_addr6)];
+        destination = (struct sockaddr *)&remote_addr6;
         
     } else {
         memset(&remote_addr,0,sizeof(remote_addr));
         remote_addr.sin_len =sizeof(remote_addr);
         remote_addr.sin_family = AF_INET;
         inet_pton(AF_INET, ipAddress.UTF8String, &remote_addr.sin_addr.s_addr);
-        addrData = [NSData dataWithBytes:&remote_addr length:sizeof(remote_addr)];
+        destination = (struct sockaddr *)&remote_addr;
     }
-    
-    destination = (struct sockaddr *)[addrData bytes];
+    packetPool = [[RSICMPPacketPool alloc] initWithKind:RSICMPPacketKindTraceRoute isIPv6:isIPv6 slotCount:1];
     
     struct timeval timeout;
     timeout.tv_sec = 1;
@@ -105,42 +123,41 @@ typedef NS_ENUM(NSUInteger, RSTraceRouteRecICMPType)
     
 }
 
-- (BOOL)verificationHost:(NSString *)host
+- (void)verificationHost:(NSString *)host completeHandler:(void (^)(BOOL isValid))handler
 {
-    // Doing host resolve here
-    NSArray *address = [RSNetDiagnosisHelper resolveHost:host];
-    if (address.count > 0) {
-        NSString *ipAddress = [address firstObject];
-        if ([[RSNetInfoUtils shareInstance] isIPv6Environment]) {
-            // Traceroute to IPv4 address always failed under IPv6 network circumstance, try to find a IPv6 address.
-            for (NSString *add in address) {
-                if ([add rangeOfString:@":"].location != NSNotFound) {
-                    ipAddress = add;
-                }
+    // Doing host resolve here. Traceroute to IPv4 address always failed under IPv6 network circumstance,
+    // so the family answering echo first is traced. Raced on the selector queue, the caller may be the main queue
+    [[RSAddressSelector shareInstance] selectAddressForHost:host method:RSAddressRaceMethodICMP port:0 completeHandler:^(RSAddressSelection *selection) {
+        if (selection.address) {
+            self.host = selection.address;
+            if (selection.familyResults.count > 0) {
+                log4cplus_info("RSTracert", "select address: %s\n", [selection.description UTF8String]);
             }
+        } else {
+            log4cplus_warn("RSTracert", "access %s DNS error , remove this ip..\n",[host UTF8String]);
         }
-        _host = ipAddress;
-    } else {
-        log4cplus_warn("RSTracert", "access %s DNS error , remove this ip..\n",[host UTF8String]);
-    }
-    
-    if (_host == NULL) {
-        return NO;
-    }
-    return YES;
+        handler(self.host != NULL);
+    }];
 }
 
 - (void)startTracerouteHost:(NSString *)host
 {
-    if (![self verificationHost:host]) {
-        [self stopTraceroute];
-        log4cplus_warn("RSTracert", "there is no valid domain in the domain list , traceroute complete..\n");
-        return;
-    }
-    
-    [RSNetQueue rs_net_trace_async:^{
-        [self settingICMPSocket];
-        [self startTraceroute];
+    [self verificationHost:host completeHandler:^(BOOL isValid) {
+        if (!isValid) {
+            [self stopTraceroute];
+            log4cplus_warn("RSTracert", "there is no valid domain in the domain list , traceroute complete..\n");
+            return;
+        }
+        
+        if (self.parallelTTL) {
+            [self startParallelTraceroute];
+            return;
+        }
+        
+        [RSNetQueue rs_net_trace_async:^{
+            [self settingICMPSocket];
+            [self startTraceroute];
+        }];
     }];
 }
 
@@ -170,14 +187,14 @@ typedef NS_ENUM(NSUInteger, RSTraceRouteRecICMPType)
         }
         
         uint16_t identifier = (uint16_t)(5000 +  ttl);
-        RSICMPTraceRoutePacket *packet = [RSNetDiagnosisHelper constructICMPTraceRoutePacketWithSeq:ttl andIdentifier:identifier isIPv6:isIPv6];
+        const void *packet = [packetPool packetWithIdentifier:identifier seq:ttl];
         
         RSTraceRouteResult *record = [[RSTraceRouteResult alloc] initWithHop:ttl countPerNode:kTraceRoutePacketCountPerNode];
         
         for (int trytime = 0; trytime < kTraceRoutePacketCountPerNode; trytime++) {
-            _sendDate = [NSDate date];
             socklen_t addrLen = isIPv6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
-            size_t sent = sendto(socket_client, packet, sizeof(RSICMPTraceRoutePacket), 0, (struct sockaddr *)destination, addrLen);
+            _sendTime = RSNetMonotonicMicros();
+            size_t sent = sendto(socket_client, packet, packetPool.packetLength, 0, (struct sockaddr *)destination, addrLen);
             
             if ((int)sent < 0) {
                 log4cplus_debug("RSTracert", "send icmp packet failed, error info :%s\n", strerror(errno));
@@ -239,11 +256,13 @@ typedef NS_ENUM(NSUInteger, RSTraceRouteRecICMPType)
     char buff[200];
     socklen_t addrLen = 0;
     ssize_t bytesRead = 0;
+    uint64_t receiveTime = 0;
     NSString *remoteAddress = nil;
     if (isIPv6) {
         struct sockaddr_in6 ret_addr6;
         addrLen = sizeof(sockaddr_in6);
         bytesRead = recvfrom(socket_client, buff, sizeof(buff), 0, (struct sockaddr *)&ret_addr6, &addrLen);
+        receiveTime = RSNetMonotonicMicros();
         
         char ip[INET6_ADDRSTRLEN] = { 0 };
         struct sockaddr_in6 *addr_in6 = (struct sockaddr_in6 *)&ret_addr6;
@@ -254,6 +273,7 @@ typedef NS_ENUM(NSUInteger, RSTraceRouteRecICMPType)
         struct sockaddr_in ret_addr;
         addrLen = sizeof(sockaddr_in);
         bytesRead = recvfrom(socket_client, buff, sizeof(buff), 0, (struct sockaddr *)&ret_addr, &addrLen);
+        receiveTime = RSNetMonotonicMicros();
         
         char ip[INET_ADDRSTRLEN] = { 0 };
         struct sockaddr_in *addr_in = (struct sockaddr_in *)&ret_addr;
@@ -266,13 +286,13 @@ typedef NS_ENUM(NSUInteger, RSTraceRouteRecICMPType)
     } else {
         if ([RSNetDiagnosisHelper isTimeoutPacket:buff length:(int)bytesRead isIPv6:isIPv6] && ![remoteAddress isEqualToString: self.host]) {
             // Arriving at the intermediate routing node
-            record.durations[seq] = [[NSDate date] timeIntervalSinceDate:_sendDate];
+            record.durations[seq] = (receiveTime - _sendTime) / 1000000.0;
             record.ip = remoteAddress;
             
         } else if ([RSNetDiagnosisHelper isEchoReplyPacket:buff length:(int)bytesRead isIPv6:isIPv6] && [remoteAddress isEqualToString: self.host]) {
             // Reach to destination server
             res = RSTraceRouteRecICMPType_Destination;
-            record.durations[seq] = [[NSDate date] timeIntervalSinceDate:_sendDate];
+            record.durations[seq] = (receiveTime - _sendTime) / 1000000.0;
             record.ip = remoteAddress;
             record.status = RSTracerouteStatusFinish;
         }
@@ -280,4 +300,208 @@ typedef NS_ENUM(NSUInteger, RSTraceRouteRecICMPType)
     return res;
 }
 
+#pragma mark - Parallel TTL
+
+- (void)startParallelTraceroute
+{
+    if (_isTracerouting) {
+        return;
+    }
+    _isTracerouting = YES;
+    _stopTraceFlag = NO;
+    
+    BOOL isIPv6 = [_host rangeOfString:@":"].location != NSNotFound;
+    memset(&probeDestination, 0, sizeof(probeDestination));
+    if (isIPv6) {
+        struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *)&probeDestination;
+        addr6->sin6_len = sizeof(struct sockaddr_in6);
+        addr6->sin6_family = AF_INET6;
+        inet_pton(AF_INET6, _host.UTF8String, &addr6->sin6_addr);
+    } else {
+        struct sockaddr_in *addr4 = (struct sockaddr_in *)&probeDestination;
+        addr4->sin_len = sizeof(struct sockaddr_in);
+        addr4->sin_family = AF_INET;
+        inet_pton(AF_INET, _host.UTF8String, &addr4->sin_addr.s_addr);
+    }
+    
+    NSMutableArray<RSTraceRouteResult *> *records = [NSMutableArray arrayWithCapacity:kTraceRouteMaxHop];
+    for (int ttl = 1; ttl <= kTraceRouteMaxHop; ttl++) {
+        RSTraceRouteResult *record = [[RSTraceRouteResult alloc] initWithHop:ttl countPerNode:kTraceRoutePacketCountPerNode];
+        record.dstIp = _host;
+        [records addObject:record];
+    }
+    _hopRecords = [records copy];
+    
+    memset(sendTimes, 0, sizeof(sendTimes));
+    memset(answered, 0, sizeof(answered));
+    startTime = 0;
+    sentRounds = 0;
+    destinationHop = 0;
+    nextReportHop = 1;
+    continuousNoReplyHops = 0;
+    
+    packetPool = [[RSICMPPacketPool alloc] initWithKind:RSICMPPacketKindTraceRoute isIPv6:isIPv6 slotCount:kICMPPacketPoolDefaultSlots];
+    
+    log4cplus_debug("RSTracert", "begin parallel tracert ip: %s \n", [self.host UTF8String]);
+    if (![[RSICMPReactor shareInstance] registerSession:self family:probeDestination.ss_family identifier:&identifier]) {
+        log4cplus_warn("RSTracert", "tracert %s , create icmp session error..\n", [self.host UTF8String]);
+        [self stopTraceroute];
+    }
+}
+
+- (uint64_t)icmpReactorTick:(uint64_t)now
+{
+    if (self.stopTraceFlag) {
+        return 0;
+    }
+    
+    uint64_t roundMicros = kTraceRouteRoundInterval * 1000;
+    uint64_t timeoutMicros = kTraceRouteProbeTimeout * 1000;
+    if (startTime == 0) {
+        startTime = now;
+    }
+    
+    // Send every round that is due, hops beyond the destination are not worth probing
+    while (sentRounds < kTraceRoutePacketCountPerNode && now >= startTime + sentRounds * roundMicros) {
+        int maxTTL = destinationHop > 0 ? destinationHop : kTraceRouteMaxHop;
+        for (int ttl = 1; ttl <= maxTTL; ttl++) {
+            [self sendProbeWithTTL:ttl round:sentRounds];
+        }
+        sentRounds++;
+    }
+    
+    if ([self reportCompletedHops:RSNetMonotonicMicros()]) {
+        log4cplus_debug("RSTracert", "done parallel tracert , ip :%s \n", [self.host UTF8String]);
+        [self stopTraceroute];
+        return 0;
+    }
+    
+    // Next round, or the nearest deadline of the hop waiting to be reported
+    uint64_t wakeTime = UINT64_MAX;
+    if (sentRounds < kTraceRoutePacketCountPerNode) {
+        wakeTime = startTime + sentRounds * roundMicros;
+    }
+    int lastHop = destinationHop > 0 ? destinationHop : kTraceRouteMaxHop;
+    for (int hop = nextReportHop; hop <= lastHop; hop++) {
+        for (int round = 0; round < kTraceRoutePacketCountPerNode; round++) {
+            uint64_t sendTime = sendTimes[hop - 1][round];
+            if (sendTime > 0 && !answered[hop - 1][round]) {
+                wakeTime = MIN(wakeTime, sendTime + timeoutMicros);
+            }
+        }
+    }
+    return wakeTime;
+}
+
+- (void)sendProbeWithTTL:(int)ttl round:(int)round
+{
+    uint16_t seq = (uint16_t)((ttl - 1) * kTraceRoutePacketCountPerNode + round);
+    const void *packet = [packetPool packetWithIdentifier:identifier seq:seq];
+    sendTimes[ttl - 1][round] = RSNetMonotonicMicros();
+    ssize_t sent = [[RSICMPReactor shareInstance] sendPacket:packet length:packetPool.packetLength toAddress:(struct sockaddr *)&probeDestination ttl:ttl];
+    if (sent < 0) {
+        // Leave it to time out, the hop is reported as `*`
+        log4cplus_debug("RSTracert", "send icmp packet failed, error info :%s\n", strerror(errno));
+    }
+}
+
+- (BOOL)isHopComplete:(int)hop now:(uint64_t)now
+{
+    uint64_t timeoutMicros = kTraceRouteProbeTimeout * 1000;
+    for (int round = 0; round < kTraceRoutePacketCountPerNode; round++) {
+        uint64_t sendTime = sendTimes[hop - 1][round];
+        if (sendTime == 0) {
+            return NO;
+        }
+        if (!answered[hop - 1][round] && now < sendTime + timeoutMicros) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+/// Report hops in order as they complete, return YES when the trace is over
+- (BOOL)reportCompletedHops:(uint64_t)now
+{
+    int lastHop = destinationHop > 0 ? destinationHop : kTraceRouteMaxHop;
+    while (nextReportHop <= lastHop && [self isHopComplete:nextReportHop now:now]) {
+        RSTraceRouteResult *record = self.hopRecords[nextReportHop - 1];
+        
+        BOOL hasReply = NO;
+        for (int round = 0; round < kTraceRoutePacketCountPerNode; round++) {
+            hasReply = hasReply || answered[nextReportHop - 1][round];
+        }
+        continuousNoReplyHops = hasReply ? 0 : continuousNoReplyHops + 1;
+        
+        BOOL isLast = NO;
+        if (nextReportHop == destinationHop) {
+            record.status = RSTracerouteStatusFinish;
+            isLast = YES;
+        } else if (continuousNoReplyHops == kTraceRouteMaxNoResCount) {
+            log4cplus_debug("RSTracert", "%d consecutive routes are not responding ,and end the tracert ip: %s\n", kTraceRouteMaxNoResCount, [self.host UTF8String]);
+            record.status = RSTracerouteStatusFinish;
+            isLast = YES;
+        }
+        
+        if (self.delegate && [self.delegate respondsToSelector:@selector(traceRoute:reportTracerResult:)]) {
+            [self.delegate traceRoute:self reportTracerResult:record];
+        }
+        nextReportHop++;
+        
+        if (isLast) {
+            return YES;
+        }
+    }
+    return nextReportHop > lastHop;
+}
+
+- (void)icmpReactorDidReceivePacket:(char *)buffer
+                             length:(int)length
+                        fromAddress:(const struct sockaddr *)address
+                        receiveTime:(uint64_t)receiveTime
+{
+    BOOL isIPv6 = probeDestination.ss_family == AF_INET6;
+    uint8_t type = 0;
+    uint16_t replyIdentifier = 0;
+    uint16_t seq = 0;
+    if (![RSNetDiagnosisHelper parseICMPResponseWithBuffer:buffer length:length isIPv6:isIPv6 type:&type identifier:&replyIdentifier seq:&seq] || replyIdentifier != identifier) {
+        return;
+    }
+    
+    int hop = seq / kTraceRoutePacketCountPerNode + 1;
+    int round = seq % kTraceRoutePacketCountPerNode;
+    if (hop > kTraceRouteMaxHop || hop < nextReportHop) {
+        // Unknown probe, or hop already reported
+        return;
+    }
+    uint64_t sendTime = sendTimes[hop - 1][round];
+    if (sendTime == 0 || answered[hop - 1][round]) {
+        return;
+    }
+    
+    char ip[INET6_ADDRSTRLEN] = { 0 };
+    if (isIPv6) {
+        inet_ntop(AF_INET6, &((const struct sockaddr_in6 *)address)->sin6_addr, ip, sizeof(ip));
+    } else {
+        inet_ntop(AF_INET, &((const struct sockaddr_in *)address)->sin_addr.s_addr, ip, sizeof(ip));
+    }
+    NSString *remoteAddress = [NSString stringWithUTF8String:ip];
+    
+    BOOL isEchoReply = type == (isIPv6 ? RSICMPv6Type_EchoReply : RSICMPType_EchoReply);
+    BOOL isUnreachable = type == (isIPv6 ? RSICMPv6Type_UNREACH : RSICMPType_UNREACH);
+    if (isEchoReply && ![remoteAddress isEqualToString:self.host]) {
+        return;
+    }
+    
+    answered[hop - 1][round] = YES;
+    RSTraceRouteResult *record = self.hopRecords[hop - 1];
+    record.durations[round] = (receiveTime - sendTime) / 1000000.0;
+    record.ip = remoteAddress;
+    
+    // Reply of destination, or a router saying it can not go further, pins the path length
+    if ((isEchoReply || isUnreachable) && (destinationHop == 0 || hop < destinationHop)) {
+        destinationHop = hop;
+    }
+}
+
 @end
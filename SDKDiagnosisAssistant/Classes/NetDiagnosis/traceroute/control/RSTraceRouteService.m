@@ -86,6 +86,8 @@
 {
     BOOL isDone = YES;
     _traceRouteResultHandler(nil,nil, isDone);
+    // Traceroute is over, break the delegate cycle so a service created per detection can be freed
+    traceRoute.delegate = nil;
 }
 
 @end
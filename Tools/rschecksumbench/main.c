@@ -0,0 +1,155 @@
+//
+//  main.c
+//  rschecksumbench
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+//  Measures each Internet checksum kernel the cpu supports on buffers from an ICMP header to 64 KiB,
+//  in nanoseconds per call and GB/s, next to the scalar kernel and RSNetChecksum itself.
+//  Every kernel is checked first against a plain 16-bit RFC 1071 loop, on every length up to 600 and odd offsets.
+//
+//  cc -O2 -I ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/common main.c ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/common/RSNetChecksum.c -o rschecksumbench
+//
+//  rschecksumbench [megabytes per size]
+//
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "RSNetChecksum.h"
+
+static uint64_t nowNanos(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// RFC 1071 as written, one 16-bit word at a time in memory order
+static uint16_t reference(const uint8_t *buffer, size_t length) {
+    uint32_t sum = 0;
+    while (length > 1) {
+        uint16_t word;
+        memcpy(&word, buffer, 2);
+        sum += word;
+        sum = (sum & 0xffff) + (sum >> 16);
+        buffer += 2;
+        length -= 2;
+    }
+    if (length == 1) {
+        uint8_t last[2] = { *buffer, 0 };
+        uint16_t word;
+        memcpy(&word, last, 2);
+        sum += word;
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return (uint16_t)~sum;
+}
+
+static int check(uint8_t *buffer, size_t length) {
+    static const size_t longLengths[] = { 1023, 1500, 4096, 65535, 65536 };
+    for (int kernel = 0; kernel < RSNetChecksumKernelCount; kernel++) {
+        if (!RSNetChecksumKernelIsSupported(kernel)) {
+            continue;
+        }
+        for (size_t offset = 0; offset < 8; offset++) {
+            for (size_t n = 0; n < 600 + sizeof(longLengths) / sizeof(longLengths[0]); n++) {
+                size_t size = n < 600 ? n : longLengths[n - 600];
+                if (offset + size > length) {
+                    continue;
+                }
+                uint16_t expected = reference(buffer + offset, size);
+                uint16_t actual = RSNetChecksumWithKernel(kernel, buffer + offset, size);
+                if (actual != expected || (kernel == 0 && RSNetChecksum(buffer + offset, size) != expected)) {
+                    fprintf(stderr, "%s: %zu bytes at +%zu gave %04x, reference %04x\n",
+                            RSNetChecksumKernelNameOf(kernel), size, offset, actual, expected);
+                    return 0;
+                }
+            }
+        }
+    }
+
+    // All ones, the worst case for carries
+    uint8_t *ones = malloc(65536);
+    memset(ones, 0xff, 65536);
+    for (int kernel = 0; kernel < RSNetChecksumKernelCount; kernel++) {
+        if (RSNetChecksumKernelIsSupported(kernel) && RSNetChecksumWithKernel(kernel, ones, 65536) != reference(ones, 65536)) {
+            fprintf(stderr, "%s: all ones gave %04x\n", RSNetChecksumKernelNameOf(kernel), RSNetChecksumWithKernel(kernel, ones, 65536));
+            free(ones);
+            return 0;
+        }
+    }
+    free(ones);
+
+    // A packet carrying its checksum verifies, and keeps verifying after an incremental update
+    uint8_t packet[64];
+    memcpy(packet, buffer, sizeof(packet));
+    packet[2] = packet[3] = 0;
+    uint16_t checksum = RSNetChecksum(packet, sizeof(packet));
+    memcpy(packet + 2, &checksum, 2);
+    uint16_t oldWord, newWord = 0xbeef;
+    memcpy(&oldWord, packet + 6, 2);
+    memcpy(packet + 6, &newWord, 2);
+    checksum = RSNetChecksumUpdate16(checksum, oldWord, newWord);
+    memcpy(packet + 2, &checksum, 2);
+    if (!RSNetChecksumVerify(packet, sizeof(packet))) {
+        fprintf(stderr, "packet with updated checksum does not verify\n");
+        return 0;
+    }
+    return 1;
+}
+
+// kernel -1 is RSNetChecksum, as callers see it
+static void report(int kernel, const uint8_t *buffer, size_t size, size_t megabytes) {
+    size_t calls = megabytes * 1024 * 1024 / size;
+    uint32_t sink = 0;
+    uint64_t start = nowNanos();
+    for (size_t i = 0; i < calls; i++) {
+        // Moving offset, so a call can not be hoisted out of the loop
+        const uint8_t *data = buffer + (i & 7);
+        sink += kernel < 0 ? RSNetChecksum(data, size) : RSNetChecksumWithKernel(kernel, data, size);
+    }
+    uint64_t elapsed = nowNanos() - start;
+    printf("  %-8s %8.1f ns/call  %7.2f GB/s  (%08x)\n", kernel < 0 ? "dispatch" : RSNetChecksumKernelNameOf(kernel),
+           (double)elapsed / (double)calls, (double)(calls * size) / (double)elapsed, sink);
+}
+
+int main(int argc, const char *argv[]) {
+    size_t megabytes = argc > 1 ? (size_t)strtoull(argv[1], NULL, 10) : 256;
+    if (megabytes == 0) {
+        fprintf(stderr, "usage: rschecksumbench [megabytes per size]\n");
+        return 1;
+    }
+    size_t length = 65536 + 8;
+    uint8_t *buffer = malloc(length);
+    if (!buffer) {
+        return 1;
+    }
+    uint32_t seed = 1;
+    for (size_t i = 0; i < length; i++) {
+        seed = seed * 1103515245 + 12345;
+        buffer[i] = (uint8_t)(seed >> 24);
+    }
+
+    if (!check(buffer, length)) {
+        free(buffer);
+        return 1;
+    }
+    printf("%zu MB per size, selected kernel %s\n", megabytes, RSNetChecksumKernelName());
+
+    static const size_t sizes[] = { 8, 20, 64, 256, 1500, 4096, 16384, 65536 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        printf("%zu B\n", sizes[i]);
+        report(-1, buffer, sizes[i], megabytes);
+        for (int kernel = 0; kernel < RSNetChecksumKernelCount; kernel++) {
+            if (RSNetChecksumKernelIsSupported(kernel)) {
+                report(kernel, buffer, sizes[i], megabytes);
+            }
+        }
+    }
+
+    free(buffer);
+    return 0;
+}
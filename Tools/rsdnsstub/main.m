@@ -0,0 +1,531 @@
+//
+//  main.m
+//  rsdnsstub
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+//  Checks RSDNSClient against a stub DNS server on a loopback port, over UDP and TCP:
+//  addresses and TTLs, CNAME chains, truncation asked again over TCP, NXDOMAIN, a stray datagram and a timeout.
+//  Then RSHostResolver, its getaddrinfo swapped for questions to the stub, so the stub counts what reaches it:
+//  concurrent lookups coalesced into one query, positive and negative cache, and expiry.
+//  Prints one line per check and exits with 1 if any fails.
+//
+//  clang -O2 -fobjc-arc -framework Foundation -I ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/lookup -I ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/common -I ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/tools main.m ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/lookup/RSDNSClient.m ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/lookup/RSHostResolver.m ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/common/RSNetDiagnosisHelper.m ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/common/RSNetChecksum.c ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/tools/RSNetDiagnosisLog.mm -lc++ -o rsdnsstub
+//
+//  rsdnsstub
+//
+
+#import <Foundation/Foundation.h>
+#import <arpa/inet.h>
+#import <ctype.h>
+#import <poll.h>
+#import <pthread.h>
+#import <time.h>
+#import <netdb.h>
+#import "RSDNSClient.h"
+#import "RSHostResolver.h"
+
+//MARK: - Stub server
+
+#define kStubMaxPending     64
+#define kStubSlowMicros     200000
+#define kStubResolveTimeout 300000
+
+typedef struct {
+    uint64_t due;
+    struct sockaddr_storage address;
+    socklen_t addressLength;
+    uint8_t message[512];
+    size_t length;
+} RSStubReply;
+
+static int stubUDP = -1;
+static int stubTCP = -1;
+static uint16_t stubPort = 0;
+static pthread_mutex_t stubLock = PTHREAD_MUTEX_INITIALIZER;
+static char stubNames[32][64];
+static int stubCounts[32];
+static RSStubReply stubPending[kStubMaxPending];
+static int stubPendingCount = 0;
+
+static uint64_t stubNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static void stubCount(const char *name) {
+    pthread_mutex_lock(&stubLock);
+    int i = 0;
+    while (i < 32 && stubNames[i][0] && strcmp(stubNames[i], name) != 0) {
+        i++;
+    }
+    if (i < 32) {
+        snprintf(stubNames[i], sizeof(stubNames[i]), "%s", name);
+        stubCounts[i]++;
+    }
+    pthread_mutex_unlock(&stubLock);
+}
+
+/// Questions the stub received for `name`, over UDP and TCP
+static int stubQueryCount(const char *name) {
+    pthread_mutex_lock(&stubLock);
+    int count = 0;
+    for (int i = 0; i < 32 && stubNames[i][0]; i++) {
+        if (strcmp(stubNames[i], name) == 0) {
+            count = stubCounts[i];
+        }
+    }
+    pthread_mutex_unlock(&stubLock);
+    return count;
+}
+
+static void stubResetCounts(void) {
+    pthread_mutex_lock(&stubLock);
+    memset(stubNames, 0, sizeof(stubNames));
+    memset(stubCounts, 0, sizeof(stubCounts));
+    pthread_mutex_unlock(&stubLock);
+}
+
+static void put16(uint8_t *p, uint16_t value) {
+    p[0] = (uint8_t)(value >> 8);
+    p[1] = (uint8_t)value;
+}
+
+static size_t putName(uint8_t *p, const char *name) {
+    size_t n = 0;
+    while (*name) {
+        const char *dot = strchr(name, '.');
+        size_t label = dot ? (size_t)(dot - name) : strlen(name);
+        p[n++] = (uint8_t)label;
+        memcpy(p + n, name, label);
+        n += label;
+        name += label + (dot ? 1 : 0);
+    }
+    p[n++] = 0;
+    return n;
+}
+
+/// `name` written as a compression pointer to the question when it is the queried name
+static size_t putRecord(uint8_t *p, const char *qname, const char *name, uint16_t type, uint32_t ttl, const void *data, size_t dataLength) {
+    size_t n = 0;
+    if (strcmp(name, qname) == 0) {
+        put16(p, 0xC000 | 12);
+        n = 2;
+    } else {
+        n = putName(p, name);
+    }
+    put16(p + n, type);
+    put16(p + n + 2, 1);
+    put16(p + n + 4, (uint16_t)(ttl >> 16));
+    put16(p + n + 6, (uint16_t)ttl);
+    if (type == 5) {
+        size_t rdLength = putName(p + n + 10, (const char *)data);
+        put16(p + n + 8, (uint16_t)rdLength);
+        return n + 10 + rdLength;
+    }
+    put16(p + n + 8, (uint16_t)dataLength);
+    memcpy(p + n + 10, data, dataLength);
+    return n + 10 + dataLength;
+}
+
+static size_t putAddress(uint8_t *p, const char *qname, const char *name, uint16_t type, uint32_t ttl, const char *ip) {
+    uint8_t data[16];
+    inet_pton(type == 28 ? AF_INET6 : AF_INET, ip, data);
+    return putRecord(p, qname, name, type, ttl, data, type == 28 ? 16 : 4);
+}
+
+/**
+ Answer of the stub zone. Returns the response length, 0 to stay silent.
+
+ plain.test    A 192.0.2.1 ttl 60, AAAA 2001:db8::1 ttl 120
+ alias.test    CNAME mid.test, CNAME plain.test, then the records of plain.test
+ big.test      truncated over UDP, 20 A records over TCP
+ missing.test  NXDOMAIN
+ silent.test   never answered
+ stray.test    A 192.0.2.9, after a datagram with the wrong id
+ slow.test     A 192.0.2.2 ttl 60, answered after kStubSlowMicros
+ */
+static size_t stubAnswer(const uint8_t *query, size_t length, BOOL overTCP, uint8_t *response, uint64_t *delay, BOOL *stray) {
+    char qname[64] = { 0 };
+    size_t offset = 12, nameLength = 0;
+    if (length < 12) {
+        return 0;
+    }
+    while (offset < length && query[offset] != 0) {
+        size_t label = query[offset];
+        if (label > 63 || offset + 1 + label >= length || nameLength + label + 1 >= sizeof(qname)) {
+            return 0;
+        }
+        if (nameLength > 0) {
+            qname[nameLength++] = '.';
+        }
+        for (size_t i = 0; i < label; i++) {
+            qname[nameLength++] = (char)tolower(query[offset + 1 + i]);
+        }
+        offset += 1 + label;
+    }
+    if (offset + 5 > length) {
+        return 0;
+    }
+    uint16_t qtype = (uint16_t)((query[offset + 1] << 8) | query[offset + 2]);
+    size_t questionEnd = offset + 5;
+    stubCount(qname);
+
+    // Header and question echoed, answers appended
+    memcpy(response, query, questionEnd);
+    uint16_t flags = 0x8000 | 0x0100 | 0x0080;
+    uint16_t answers = 0;
+    size_t n = questionEnd;
+    *delay = 0;
+    *stray = NO;
+
+    if (strcmp(qname, "silent.test") == 0) {
+        return 0;
+    } else if (strcmp(qname, "missing.test") == 0) {
+        flags |= 3;
+    } else if (strcmp(qname, "big.test") == 0) {
+        if (!overTCP) {
+            flags |= 0x0200;
+        } else if (qtype == 1) {
+            for (int i = 0; i < 20; i++) {
+                char ip[INET_ADDRSTRLEN];
+                snprintf(ip, sizeof(ip), "192.0.2.%d", 10 + i);
+                n += putAddress(response + n, qname, qname, 1, 5, ip);
+                answers++;
+            }
+        }
+    } else if (strcmp(qname, "alias.test") == 0 || strcmp(qname, "plain.test") == 0) {
+        if (strcmp(qname, "alias.test") == 0) {
+            n += putRecord(response + n, qname, "alias.test", 5, 30, "mid.test", 0);
+            n += putRecord(response + n, qname, "mid.test", 5, 30, "plain.test", 0);
+            answers += 2;
+        }
+        if (qtype == 1) {
+            n += putAddress(response + n, qname, "plain.test", 1, 60, "192.0.2.1");
+            answers++;
+        } else if (qtype == 28) {
+            n += putAddress(response + n, qname, "plain.test", 28, 120, "2001:db8::1");
+            answers++;
+        }
+    } else if (strcmp(qname, "stray.test") == 0 || strcmp(qname, "slow.test") == 0) {
+        if (qtype == 1) {
+            n += putAddress(response + n, qname, qname, 1, 60, qname[1] == 't' ? "192.0.2.9" : "192.0.2.2");
+            answers++;
+        }
+        *delay = qname[1] == 'l' ? kStubSlowMicros : 0;
+        *stray = qname[1] == 't';
+    } else {
+        flags |= 3;
+    }
+
+    put16(response + 2, flags);
+    put16(response + 6, answers);
+    put16(response + 8, 0);
+    put16(response + 10, 0);
+    return n;
+}
+
+static void stubReadUDP(void) {
+    uint8_t query[512], response[512];
+    struct sockaddr_storage address;
+    socklen_t addressLength = sizeof(address);
+    ssize_t length = recvfrom(stubUDP, query, sizeof(query), 0, (struct sockaddr *)&address, &addressLength);
+    if (length <= 0) {
+        return;
+    }
+    uint64_t delay = 0;
+    BOOL stray = NO;
+    size_t n = stubAnswer(query, (size_t)length, NO, response, &delay, &stray);
+    if (n == 0) {
+        return;
+    }
+    if (stray) {
+        // Same question, another id, must be ignored by the client
+        uint8_t stray[512];
+        memcpy(stray, response, n);
+        put16(stray, (uint16_t)(((query[0] << 8) | query[1]) ^ 1));
+        stray[n - 1] ^= 0x40;
+        sendto(stubUDP, stray, n, 0, (struct sockaddr *)&address, addressLength);
+    }
+    if (delay == 0 || stubPendingCount == kStubMaxPending) {
+        sendto(stubUDP, response, n, 0, (struct sockaddr *)&address, addressLength);
+        return;
+    }
+    RSStubReply *reply = &stubPending[stubPendingCount++];
+    reply->due = stubNow() + delay;
+    reply->address = address;
+    reply->addressLength = addressLength;
+    memcpy(reply->message, response, n);
+    reply->length = n;
+}
+
+static void stubAcceptTCP(void) {
+    int fd = accept(stubTCP, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+    struct timeval timeout = { 1, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    uint8_t query[514], response[514];
+    size_t length = 0;
+    while (length < 2 || length < 2 + (size_t)((query[0] << 8) | query[1])) {
+        ssize_t n = recv(fd, query + length, sizeof(query) - length, 0);
+        if (n <= 0) {
+            close(fd);
+            return;
+        }
+        length += (size_t)n;
+    }
+    uint64_t delay = 0;
+    BOOL stray = NO;
+    size_t n = stubAnswer(query + 2, length - 2, YES, response + 2, &delay, &stray);
+    if (n > 0) {
+        put16(response, (uint16_t)n);
+        send(fd, response, n + 2, 0);
+    }
+    close(fd);
+}
+
+static void *stubRun(__unused void *context) {
+    while (YES) {
+        int timeout = -1;
+        uint64_t now = stubNow();
+        for (int i = 0; i < stubPendingCount; i++) {
+            if (stubPending[i].due <= now) {
+                sendto(stubUDP, stubPending[i].message, stubPending[i].length, 0,
+                       (struct sockaddr *)&stubPending[i].address, stubPending[i].addressLength);
+                stubPending[i--] = stubPending[--stubPendingCount];
+            } else if (timeout < 0 || (int)((stubPending[i].due - now + 999) / 1000) < timeout) {
+                timeout = (int)((stubPending[i].due - now + 999) / 1000);
+            }
+        }
+        struct pollfd fds[2] = { { stubUDP, POLLIN, 0 }, { stubTCP, POLLIN, 0 } };
+        if (poll(fds, 2, timeout) <= 0) {
+            continue;
+        }
+        if (fds[0].revents & POLLIN) {
+            stubReadUDP();
+        }
+        if (fds[1].revents & POLLIN) {
+            stubAcceptTCP();
+        }
+    }
+    return NULL;
+}
+
+/// UDP and TCP sockets on one loopback port, served on a thread of their own
+static BOOL stubStart(void) {
+    for (int attempt = 0; attempt < 16; attempt++) {
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t addressLength = sizeof(address);
+
+        stubUDP = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (stubUDP < 0 || bind(stubUDP, (struct sockaddr *)&address, sizeof(address)) < 0 ||
+            getsockname(stubUDP, (struct sockaddr *)&address, &addressLength) < 0) {
+            return NO;
+        }
+        stubTCP = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        int on = 1;
+        setsockopt(stubTCP, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind(stubTCP, (struct sockaddr *)&address, sizeof(address)) == 0 && listen(stubTCP, 16) == 0) {
+            stubPort = ntohs(address.sin_port);
+            pthread_t thread;
+            return pthread_create(&thread, NULL, stubRun, NULL) == 0;
+        }
+        // The UDP port is taken over TCP, try another one
+        close(stubUDP);
+        close(stubTCP);
+    }
+    return NO;
+}
+
+
+//MARK: - Resolver asking the stub
+
+@interface RSHostResolution (Stub)
+- (void)setHost:(NSString *)host;
+- (void)setAddresses:(NSArray<NSString *> *)addresses;
+- (void)setCanonicalName:(NSString *)canonicalName;
+- (void)setError:(int)error;
+- (void)setResolveMicros:(uint64_t)resolveMicros;
+@end
+
+@interface RSHostResolver (Stub)
+- (RSHostResolution *)queryHost:(NSString *)host;
+@end
+
+@interface RSStubHostResolver : RSHostResolver
+@property (nonatomic, strong) RSDNSClient *client;
+@end
+
+@implementation RSStubHostResolver
+
+/// Blocking like getaddrinfo, with its error codes
+- (RSHostResolution *)queryHost:(NSString *)host
+{
+    __block NSArray<RSDNSQueryResult *> *results = nil;
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    uint64_t start = stubNow();
+    [self.client queryDomain:host servers:@[@"127.0.0.1"] timeout:kStubResolveTimeout completeHandler:^(NSArray<RSDNSQueryResult *> *answers) {
+        results = answers;
+        dispatch_semaphore_signal(semaphore);
+    }];
+    dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+
+    RSHostResolution *resolution = [[RSHostResolution alloc] init];
+    resolution.host = host;
+    resolution.canonicalName = host;
+    resolution.resolveMicros = stubNow() - start;
+    NSMutableArray<NSString *> *addresses = [NSMutableArray array];
+    for (RSDNSQueryResult *result in results) {
+        [addresses addObjectsFromArray:[result.addresses valueForKey:@"value"]];
+    }
+    resolution.addresses = addresses;
+    if (addresses.count == 0) {
+        resolution.error = results.firstObject.rcode == 3 ? EAI_NONAME : EAI_AGAIN;
+    }
+    return resolution;
+}
+
+@end
+
+
+//MARK: - Checks
+
+static int failures = 0;
+
+static void expect(BOOL condition, NSString *name, NSString *detail) {
+    if (condition) {
+        printf("  ok    %s\n", name.UTF8String);
+    } else {
+        printf("  FAIL  %s: %s\n", name.UTF8String, detail.UTF8String);
+        failures++;
+    }
+}
+
+static NSArray<RSDNSQueryResult *> *query(RSDNSClient *client, NSString *domain, uint64_t timeoutMicros) {
+    __block NSArray<RSDNSQueryResult *> *results = nil;
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    [client queryDomain:domain servers:@[@"127.0.0.1"] timeout:timeoutMicros completeHandler:^(NSArray<RSDNSQueryResult *> *answers) {
+        results = answers;
+        dispatch_semaphore_signal(semaphore);
+    }];
+    dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+    return results;
+}
+
+static void checkClient(RSDNSClient *client) {
+    NSArray<RSDNSQueryResult *> *results = query(client, @"plain.test", kDNSClientDefaultTimeout);
+    RSDNSQueryResult *a = results.firstObject, *aaaa = results.lastObject;
+    expect(results.count == 2 && a.queryType == RSDNSRecordTypeA && aaaa.queryType == RSDNSRecordTypeAAAA,
+           @"one result per question", results.description);
+    expect(a.error == 0 && a.rcode == 0 && !a.usedTCP && a.addresses.count == 1 &&
+           [a.addresses[0].value isEqualToString:@"192.0.2.1"] && a.addresses[0].ttl == 60,
+           @"A record and ttl", a.description);
+    expect(aaaa.error == 0 && aaaa.addresses.count == 1 &&
+           [aaaa.addresses[0].value isEqualToString:@"2001:db8::1"] && aaaa.addresses[0].ttl == 120,
+           @"AAAA record and ttl", aaaa.description);
+
+    results = query(client, @"alias.test", kDNSClientDefaultTimeout);
+    a = results.firstObject;
+    expect([a.cnameChain isEqualToArray:@[@"mid.test", @"plain.test"]] && a.addresses.count == 1 &&
+           [a.addresses[0].name isEqualToString:@"plain.test"],
+           @"cname chain followed", a.description);
+
+    results = query(client, @"big.test", kDNSClientDefaultTimeout);
+    a = results.firstObject;
+    expect(a.error == 0 && a.usedTCP && a.addresses.count == 20 && [a.addresses.lastObject.value isEqualToString:@"192.0.2.29"],
+           @"truncated answer asked again over tcp", a.description);
+
+    results = query(client, @"missing.test", kDNSClientDefaultTimeout);
+    a = results.firstObject;
+    expect(a.error == 0 && a.rcode == 3 && a.addresses.count == 0, @"nxdomain", a.description);
+
+    results = query(client, @"stray.test", kDNSClientDefaultTimeout);
+    a = results.firstObject;
+    expect(a.addresses.count == 1 && [a.addresses[0].value isEqualToString:@"192.0.2.9"],
+           @"datagram with another id ignored", a.description);
+
+    uint64_t start = stubNow();
+    results = query(client, @"silent.test", 300000);
+    uint64_t elapsed = stubNow() - start;
+    a = results.firstObject;
+    expect(a.error == ETIMEDOUT && results.lastObject.error == ETIMEDOUT && elapsed >= 300000 && elapsed < 1000000,
+           @"silent server times out at the deadline", [NSString stringWithFormat:@"%@ after %llu us", a, elapsed]);
+}
+
+static void checkResolver(RSStubHostResolver *resolver) {
+    // Questions of one lookup, A and AAAA
+    const int perLookup = 2;
+
+    NSMutableArray<RSHostResolution *> *resolutions = [NSMutableArray array];
+    dispatch_group_t group = dispatch_group_create();
+    for (int i = 0; i < 32; i++) {
+        dispatch_group_enter(group);
+        [resolver resolveHost:@"slow.test" completeHandler:^(RSHostResolution *resolution) {
+            @synchronized (resolutions) {
+                [resolutions addObject:resolution];
+            }
+            dispatch_group_leave(group);
+        }];
+    }
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    RSHostResolution *first = resolutions.firstObject;
+    expect(stubQueryCount("slow.test") == perLookup, @"concurrent lookups share one query",
+           [NSString stringWithFormat:@"%d questions for 32 lookups", stubQueryCount("slow.test")]);
+    expect(resolutions.count == 32 && [[resolutions valueForKeyPath:@"@distinctUnionOfObjects.addresses"] count] == 1 &&
+           [first.addresses isEqualToArray:@[@"192.0.2.2"]],
+           @"every waiter gets the answer", first.description);
+    expect(first.resolveMicros >= kStubSlowMicros && !first.fromCache, @"resolution timed", first.description);
+
+    RSHostResolution *cached = [resolver resolveHostSync:@"SLOW.test"];
+    expect(cached.fromCache && [cached.addresses isEqualToArray:first.addresses] && stubQueryCount("slow.test") == perLookup,
+           @"positive answer cached, name case ignored", cached.description);
+
+    RSHostResolution *missing = [resolver resolveHostSync:@"missing.test"];
+    RSHostResolution *missingAgain = [resolver resolveHostSync:@"missing.test"];
+    expect(missing.error == EAI_NONAME && !missing.fromCache && missingAgain.fromCache &&
+           stubQueryCount("missing.test") == perLookup,
+           @"nxdomain cached", missingAgain.description);
+
+    RSHostResolution *silent = [resolver resolveHostSync:@"silent.test"];
+    RSHostResolution *silentAgain = [resolver resolveHostSync:@"silent.test"];
+    expect(silent.error == EAI_AGAIN && !silentAgain.fromCache && stubQueryCount("silent.test") == 2 * perLookup,
+           @"failure other than nxdomain not cached", silentAgain.description);
+
+    resolver.positiveTTL = 0.1;
+    [resolver clearCache];
+    [resolver resolveHostSync:@"plain.test"];
+    [NSThread sleepForTimeInterval:0.2];
+    RSHostResolution *expired = [resolver resolveHostSync:@"plain.test"];
+    expect(!expired.fromCache && stubQueryCount("plain.test") == 2 * perLookup &&
+           [expired.addresses isEqualToArray:@[@"192.0.2.1", @"2001:db8::1"]],
+           @"expired answer asked again", expired.description);
+}
+
+int main(int argc, const char *argv[]) {
+    @autoreleasepool {
+        if (!stubStart()) {
+            fprintf(stderr, "cannot bind a loopback port: %s\n", strerror(errno));
+            return 1;
+        }
+        printf("stub server on 127.0.0.1:%u\n", stubPort);
+
+        RSDNSClient *client = [[RSDNSClient alloc] init];
+        client.port = stubPort;
+        printf("RSDNSClient\n");
+        checkClient(client);
+
+        stubResetCounts();
+        RSStubHostResolver *resolver = [[RSStubHostResolver alloc] init];
+        resolver.client = client;
+        printf("RSHostResolver\n");
+        checkResolver(resolver);
+    }
+    return failures > 0 ? 1 : 0;
+}
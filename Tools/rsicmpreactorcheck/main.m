@@ -0,0 +1,228 @@
+//
+//  main.m
+//  rsicmpreactorcheck
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+//  Pings 127.0.0.1 from several sessions at once through the shared RSICMPReactor, and checks:
+//
+//  - the reactor opens one ICMP socket for all of them
+//  - every session hears a reply to each of its echoes, once
+//  - no session is handed a packet carrying another session's identifier
+//  - the sessions were all in flight at the same time
+//
+//  Prints one line per check and exits with 1 if any fails.
+//
+//  clang -O2 -fobjc-arc -framework Foundation -I ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/common -I ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/lookup -I ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/tools main.m ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/tools/RSICMPReactor.mm ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/common/RSICMPPacketPool.m ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/common/RSNetDiagnosisHelper.m ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/common/RSNetChecksum.c ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/lookup/RSHostResolver.m ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/tools/RSNetDiagnosisLog.mm -lc++ -o rsicmpreactorcheck
+//
+//  rsicmpreactorcheck [sessions] [echoes]
+//
+
+#import <Foundation/Foundation.h>
+#import <sys/stat.h>
+#import "RSICMPReactor.h"
+#import "RSICMPPacketPool.h"
+#import "RSNetDiagnosisHelper.h"
+
+#define kCheckMaxEchoes         1024
+#define kCheckIntervalMicros    10000       // Between two echoes of a session
+#define kCheckTimeoutMicros     2000000     // After the last echo, for its reply
+
+//MARK: - Session
+
+/// Sends `echoes` requests to loopback, then waits for the replies. Only touched on the reactor thread
+@interface RSLoopbackSession : NSObject <RSICMPReactorSession>
+{
+@public
+    uint16_t identifier;
+    int echoes;
+    int sent;
+    int received;
+    int duplicates;
+    int foreign;
+    uint64_t nextSendTime;
+    uint64_t deadline;
+    uint64_t firstSendTime;
+    uint64_t lastReceiveTime;
+    BOOL answered[kCheckMaxEchoes];
+}
+@property (nonatomic, strong) RSICMPPacketPool *packetPool;
+@property (nonatomic, strong) dispatch_semaphore_t done;
+@end
+
+@implementation RSLoopbackSession
+
+- (instancetype)initWithEchoes:(int)count
+{
+    if (self = [super init]) {
+        echoes = count;
+        _packetPool = [[RSICMPPacketPool alloc] initWithKind:RSICMPPacketKindEcho isIPv6:NO slotCount:kICMPPacketPoolDefaultSlots];
+        _done = dispatch_semaphore_create(0);
+    }
+    return self;
+}
+
+- (uint64_t)icmpReactorTick:(uint64_t)now
+{
+    if (received == echoes || (deadline != 0 && now >= deadline)) {
+        dispatch_semaphore_signal(self.done);
+        return 0;
+    }
+    if (sent < echoes && now >= nextSendTime) {
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_len = sizeof(address);
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        const void *packet = [self.packetPool packetWithIdentifier:identifier seq:(uint16_t)sent];
+        if ([[RSICMPReactor shareInstance] sendPacket:packet length:self.packetPool.packetLength toAddress:(struct sockaddr *)&address] < 0) {
+            fprintf(stderr, "session %u: send echo %d: %s\n", identifier, sent, strerror(errno));
+        }
+        if (sent == 0) {
+            firstSendTime = now;
+        }
+        sent++;
+        nextSendTime = now + kCheckIntervalMicros;
+        if (sent == echoes) {
+            deadline = now + kCheckTimeoutMicros;
+        }
+    }
+    return sent < echoes ? nextSendTime : deadline;
+}
+
+- (void)icmpReactorDidReceivePacket:(char *)buffer
+                             length:(int)length
+                        fromAddress:(const struct sockaddr *)address
+                        receiveTime:(uint64_t)receiveTime
+{
+    uint8_t type = 0;
+    uint16_t replyIdentifier = 0;
+    uint16_t seq = 0;
+    if (![RSNetDiagnosisHelper parseICMPResponseWithBuffer:buffer length:length isIPv6:NO type:&type identifier:&replyIdentifier seq:&seq]
+        || replyIdentifier != identifier) {
+        foreign++;
+        return;
+    }
+    if (seq >= sent || answered[seq]) {
+        duplicates++;
+        return;
+    }
+    answered[seq] = YES;
+    received++;
+    lastReceiveTime = receiveTime;
+}
+
+@end
+
+
+//MARK: - Checks
+
+static int failures = 0;
+
+static void expect(BOOL condition, NSString *name, NSString *detail) {
+    if (condition) {
+        printf("  ok    %s\n", name.UTF8String);
+    } else {
+        printf("  FAIL  %s: %s\n", name.UTF8String, detail.UTF8String);
+        failures++;
+    }
+}
+
+/// IPv4 datagram sockets open in this process, the reactor's ICMP socket is one of them
+static int countDatagramSockets(void) {
+    int count = 0;
+    for (int fd = 0; fd < getdtablesize(); fd++) {
+        struct stat st;
+        if (fstat(fd, &st) != 0 || !S_ISSOCK(st.st_mode)) {
+            continue;
+        }
+        int type = 0;
+        socklen_t typeLength = sizeof(type);
+        struct sockaddr_storage address;
+        socklen_t addressLength = sizeof(address);
+        if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &typeLength) == 0 && type == SOCK_DGRAM
+            && getsockname(fd, (struct sockaddr *)&address, &addressLength) == 0 && address.ss_family == AF_INET) {
+            count++;
+        }
+    }
+    return count;
+}
+
+int main(int argc, const char *argv[]) {
+    @autoreleasepool {
+        int sessionCount = argc > 1 ? atoi(argv[1]) : 8;
+        int echoes = argc > 2 ? atoi(argv[2]) : 50;
+        if (sessionCount <= 0 || echoes <= 0 || echoes > kCheckMaxEchoes) {
+            fprintf(stderr, "usage: rsicmpreactorcheck [sessions] [echoes <= %d]\n", kCheckMaxEchoes);
+            return 1;
+        }
+        printf("%d sessions x %d echoes to 127.0.0.1\n", sessionCount, echoes);
+
+        RSICMPReactor *reactor = [RSICMPReactor shareInstance];
+        int socketsBefore = countDatagramSockets();
+
+        // Registered together on the reactor thread, so no session is ticked before the others exist
+        NSMutableArray<RSLoopbackSession *> *sessions = [NSMutableArray array];
+        for (int i = 0; i < sessionCount; i++) {
+            [sessions addObject:[[RSLoopbackSession alloc] initWithEchoes:echoes]];
+        }
+        __block int registered = 0;
+        __block int socketsDuring = 0;
+        dispatch_semaphore_t ready = dispatch_semaphore_create(0);
+        [reactor performBlock:^{
+            for (RSLoopbackSession *session in sessions) {
+                uint16_t identifier = 0;
+                if ([reactor registerSession:session family:AF_INET identifier:&identifier]) {
+                    session->identifier = identifier;
+                    registered++;
+                }
+            }
+            socketsDuring = countDatagramSockets();
+            dispatch_semaphore_signal(ready);
+        }];
+        dispatch_semaphore_wait(ready, DISPATCH_TIME_FOREVER);
+        if (registered != sessionCount) {
+            fprintf(stderr, "icmp socket: %s, registered %d of %d sessions\n", strerror(errno), registered, sessionCount);
+            return 1;
+        }
+
+        for (RSLoopbackSession *session in sessions) {
+            dispatch_semaphore_wait(session.done, DISPATCH_TIME_FOREVER);
+        }
+
+        // Collected on the reactor thread, the sessions are removed by now
+        NSMutableString *missing = [NSMutableString string];
+        NSMutableString *stray = [NSMutableString string];
+        NSMutableSet<NSNumber *> *identifiers = [NSMutableSet set];
+        __block uint64_t latestFirstSend = 0;
+        __block uint64_t earliestLastReceive = UINT64_MAX;
+        dispatch_semaphore_t collected = dispatch_semaphore_create(0);
+        [reactor performBlock:^{
+            for (RSLoopbackSession *session in sessions) {
+                [identifiers addObject:@(session->identifier)];
+                if (session->received != echoes) {
+                    [missing appendFormat:@" id %u got %d;", session->identifier, session->received];
+                }
+                if (session->foreign > 0 || session->duplicates > 0) {
+                    [stray appendFormat:@" id %u foreign %d duplicate %d;", session->identifier, session->foreign, session->duplicates];
+                }
+                latestFirstSend = MAX(latestFirstSend, session->firstSendTime);
+                earliestLastReceive = MIN(earliestLastReceive, session->lastReceiveTime);
+            }
+            dispatch_semaphore_signal(collected);
+        }];
+        dispatch_semaphore_wait(collected, DISPATCH_TIME_FOREVER);
+
+        expect(socketsDuring - socketsBefore == 1, @"one shared icmp socket",
+               [NSString stringWithFormat:@"%d sockets opened", socketsDuring - socketsBefore]);
+        expect(identifiers.count == (NSUInteger)sessionCount, @"an identifier per session",
+               [NSString stringWithFormat:@"%lu distinct of %d", (unsigned long)identifiers.count, sessionCount]);
+        expect(missing.length == 0, @"every echo answered", missing);
+        expect(stray.length == 0, @"only own replies delivered", stray);
+        expect(latestFirstSend < earliestLastReceive, @"sessions overlap",
+               @"a session finished before another one started");
+    }
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,120 @@
+//
+//  main.m
+//  rspacketpoolcheck
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+//  Counts heap allocations made per echo request, on the thread sending them:
+//
+//  - constructed:  +[RSNetDiagnosisHelper constructICMPEchoPacketWithSeq:andIdentifier:isIPv6:], a malloc per packet
+//  - pool:         -[RSICMPPacketPool packetWithIdentifier:seq:] once the pool is created, which must allocate nothing
+//
+//  Each echo is also sent to 127.0.0.1 over an unprivileged ICMP socket, and every IPv4 packet must carry a valid
+//  checksum. Allocations are seen through libmalloc's malloc_logger hook. Exits with 1 if the pool allocates.
+//
+//  clang -O2 -fobjc-arc -framework Foundation -I ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/common -I ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/lookup -I ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/tools main.m ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/common/RSICMPPacketPool.m ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/common/RSNetDiagnosisHelper.m ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/common/RSNetChecksum.c ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/lookup/RSHostResolver.m ../../SDKDiagnosisAssistant/Classes/NetDiagnosis/tools/RSNetDiagnosisLog.mm -lc++ -o rspacketpoolcheck
+//
+//  rspacketpoolcheck [echoes]
+//
+
+#import <Foundation/Foundation.h>
+#import <pthread.h>
+#import "RSICMPPacketPool.h"
+#import "RSNetDiagnosisHelper.h"
+#import "RSNetChecksum.h"
+
+// libmalloc calls this on every allocation and free when set, see <malloc/malloc.h> of libmalloc
+#define kMallocLogTypeAllocate  2
+extern void (*malloc_logger)(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t result, uint32_t numHotFramesToSkip);
+
+static pthread_t countedThread;
+static volatile uint64_t allocations = 0;
+
+static void countAllocation(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t result, uint32_t numHotFramesToSkip) {
+    if ((type & kMallocLogTypeAllocate) && pthread_equal(pthread_self(), countedThread)) {
+        allocations++;
+    }
+}
+
+static int openSocket(void) {
+    int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_ICMP);
+    if (fd < 0) {
+        fprintf(stderr, "icmp socket: %s, echoes are not sent\n", strerror(errno));
+    }
+    return fd;
+}
+
+static void sendEcho(int fd, const void *packet, size_t length) {
+    if (fd < 0) {
+        return;
+    }
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_len = sizeof(address);
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sendto(fd, packet, length, 0, (struct sockaddr *)&address, sizeof(address));
+}
+
+/// Allocations per echo over `echoes` requests, -1 if a packet has a bad checksum
+static double measure(int fd, NSUInteger echoes, const void *(^take)(uint16_t seq), void (^give)(const void *packet), size_t length) {
+    uint64_t start = allocations;
+    for (NSUInteger i = 0; i < echoes; i++) {
+        const void *packet = take((uint16_t)i);
+        if (!RSNetChecksumVerify(packet, length)) {
+            fprintf(stderr, "echo %lu has a bad checksum\n", (unsigned long)i);
+            return -1;
+        }
+        sendEcho(fd, packet, length);
+        give(packet);
+    }
+    return (double)(allocations - start) / (double)echoes;
+}
+
+int main(int argc, const char *argv[]) {
+    @autoreleasepool {
+        NSUInteger echoes = argc > 1 ? (NSUInteger)strtoull(argv[1], NULL, 10) : 10000;
+        if (echoes == 0) {
+            fprintf(stderr, "usage: rspacketpoolcheck [echoes]\n");
+            return 1;
+        }
+        int fd = openSocket();
+        uint16_t identifier = (uint16_t)getpid();
+
+        // Blocks and the pool are made before counting starts, as a session makes them before its first probe
+        const void *(^construct)(uint16_t) = ^const void *(uint16_t seq) {
+            return [RSNetDiagnosisHelper constructICMPEchoPacketWithSeq:seq andIdentifier:identifier isIPv6:NO];
+        };
+        void (^release)(const void *) = ^(const void *packet) {
+            free((void *)packet);
+        };
+        RSICMPPacketPool *pool = [[RSICMPPacketPool alloc] initWithKind:RSICMPPacketKindEcho isIPv6:NO slotCount:kICMPPacketPoolDefaultSlots];
+        const void *(^take)(uint16_t) = ^const void *(uint16_t seq) {
+            return [pool packetWithIdentifier:identifier seq:seq];
+        };
+        void (^keep)(const void *) = ^(const void *packet) {
+        };
+        // Warm both paths, the helper builds its templates on first use
+        release(construct(0));
+        take(0);
+
+        countedThread = pthread_self();
+        malloc_logger = countAllocation;
+        double constructed = measure(fd, echoes, construct, release, sizeof(RSICMPPacket));
+        double pooled = measure(fd, echoes, take, keep, pool.packetLength);
+        malloc_logger = NULL;
+
+        printf("%lu echoes\n", (unsigned long)echoes);
+        printf("  constructed  %6.2f allocations/echo\n", constructed);
+        printf("  pool         %6.2f allocations/echo\n", pooled);
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (constructed < 0 || pooled != 0) {
+            printf("FAIL: a warm pool must allocate nothing\n");
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,125 @@
+//
+//  main.c
+//  vvcrc32bench
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+//  Measures each CRC-32 kernel of minizip the cpu supports, in GB/s, next to zlib's crc32().
+//  Every kernel is checked against zlib first, on odd lengths and offsets, and so is vv_mz_crc32_combine.
+//
+//  cc -O2 -lz -I ../../SDKDiagnosisAssistant/Classes/Log/Upload/VVZipArchive/minizip main.c ../../SDKDiagnosisAssistant/Classes/Log/Upload/VVZipArchive/minizip/vv_mz_crc32.c -o vvcrc32bench
+//
+//  vvcrc32bench [megabytes]
+//
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <zlib.h>
+#include "vv_mz_crc32.h"
+
+static uint64_t nowNanos(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int check(const uint8_t *buffer, size_t length) {
+    static const size_t lengths[] = { 0, 1, 7, 15, 16, 63, 64, 65, 127, 128, 1000, 4096, 65537 };
+    for (int32_t kernel = 0; kernel < VV_MZ_CRC32_KERNEL_COUNT; kernel++) {
+        if (!vv_mz_crc32_kernel_is_supported(kernel)) {
+            continue;
+        }
+        for (size_t offset = 0; offset < 8; offset++) {
+            for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+                size_t n = lengths[i] < length - offset ? lengths[i] : length - offset;
+                uint32_t expected = (uint32_t)crc32(0x12345678, buffer + offset, (uInt)n);
+                uint32_t actual = vv_mz_crc32_update_kernel(kernel, 0x12345678, buffer + offset, n);
+                if (actual != expected) {
+                    fprintf(stderr, "%s: %zu bytes at +%zu gave %08x, zlib %08x\n",
+                            vv_mz_crc32_kernel_name(kernel), n, offset, actual, expected);
+                    return 0;
+                }
+            }
+        }
+    }
+
+    // Pieces of a buffer merged back into its CRC
+    uint32_t whole = vv_mz_crc32_update(0, buffer, (int64_t)length);
+    uint32_t merged = 0;
+    size_t offset = 0;
+    for (size_t piece = 1; offset < length; piece = piece * 3 + 1) {
+        size_t n = piece < length - offset ? piece : length - offset;
+        merged = vv_mz_crc32_combine(merged, vv_mz_crc32_update(0, buffer + offset, (int64_t)n), (int64_t)n);
+        offset += n;
+    }
+    if (merged != whole) {
+        fprintf(stderr, "combine gave %08x, whole buffer %08x\n", merged, whole);
+        return 0;
+    }
+    return 1;
+}
+
+// kernel -1 is zlib
+static uint32_t update(int32_t kernel, uint32_t crc, const uint8_t *buf, size_t size) {
+    if (kernel < 0) {
+        return (uint32_t)crc32(crc, buf, (uInt)size);
+    }
+    return vv_mz_crc32_update_kernel(kernel, crc, buf, (int64_t)size);
+}
+
+static void report(int32_t kernel, const uint8_t *buffer, size_t length, size_t blockLength) {
+    uint32_t crc = 0;
+    // Warm the caches and the tables
+    crc = update(kernel, crc, buffer, blockLength < length ? blockLength : length);
+
+    uint64_t start = nowNanos();
+    for (size_t offset = 0; offset + blockLength <= length; offset += blockLength) {
+        crc = update(kernel, crc, buffer + offset, blockLength);
+    }
+    uint64_t elapsed = nowNanos() - start;
+    printf("  %-12s %8zu B blocks  %7.2f GB/s  (%08x)\n", kernel < 0 ? "zlib" : vv_mz_crc32_kernel_name(kernel), blockLength,
+           (double)(length - length % blockLength) / (double)elapsed, crc);
+}
+
+int main(int argc, const char *argv[]) {
+    size_t megabytes = argc > 1 ? (size_t)strtoull(argv[1], NULL, 10) : 256;
+    if (megabytes == 0) {
+        fprintf(stderr, "usage: vvcrc32bench [megabytes]\n");
+        return 1;
+    }
+    size_t length = megabytes * 1024 * 1024;
+    uint8_t *buffer = malloc(length);
+    if (!buffer) {
+        fprintf(stderr, "no memory for %zu MB\n", megabytes);
+        return 1;
+    }
+    uint32_t seed = 1;
+    for (size_t i = 0; i < length; i++) {
+        seed = seed * 1103515245 + 12345;
+        buffer[i] = (uint8_t)(seed >> 24);
+    }
+
+    if (!check(buffer, length)) {
+        free(buffer);
+        return 1;
+    }
+    printf("%zu MB, selected kernel %s\n", megabytes, vv_mz_crc32_kernel_name(vv_mz_crc32_kernel_selected()));
+
+    static const size_t blockLengths[] = { 256, 16 * 1024, 1024 * 1024 };
+    for (size_t i = 0; i < sizeof(blockLengths) / sizeof(blockLengths[0]); i++) {
+        report(-1, buffer, length, blockLengths[i]);
+        for (int32_t kernel = 0; kernel < VV_MZ_CRC32_KERNEL_COUNT; kernel++) {
+            if (!vv_mz_crc32_kernel_is_supported(kernel)) {
+                continue;
+            }
+            report(kernel, buffer, length, blockLengths[i]);
+        }
+    }
+
+    free(buffer);
+    return 0;
+}
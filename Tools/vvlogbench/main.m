@@ -0,0 +1,92 @@
+//
+//  main.m
+//  vvlogbench
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+//  Measures what a disabled log statement costs the calling thread, in nanoseconds per statement.
+//  One logger takes Info and above, as in a release configuration, and Debug statements are issued:
+//
+//  - level check only:  what the macros did before, `if (flg & vvLogLevel)` then format and queue the statement
+//  - enabled levels:    the macros now, `VVLogIsEnabledForFlag` before any argument is evaluated
+//  - build floor:       the statement compiled out by VV_LOG_LEVEL_FLOOR
+//
+//  clang -O2 -fobjc-arc -framework Foundation -lz -DVV_CLI -I ../../SDKDiagnosisAssistant/Classes/Log/RVOnlyLog/CocoaVVLog main.m ../../SDKDiagnosisAssistant/Classes/Log/RVOnlyLog/CocoaVVLog/*.m -o vvlogbench
+//
+//  vvlogbench [iterations]
+//
+
+#import <Foundation/Foundation.h>
+#import <time.h>
+#import "CocoaVVLog.h"
+
+static const VVLogLevel vvLogLevel = VVLogLevelVerbose;
+
+// What LOG_MAYBE expanded to before the enabled levels check.
+#define LOG_MAYBE_LEVEL_ONLY(async, lvl, flg, ctx, tag, fnct, frmt, ...) \
+        do { if((lvl & flg) != 0) LOG_MACRO_CALL_SITE(async, lvl, flg, ctx, tag, fnct, frmt, ##__VA_ARGS__); } while(0)
+
+// A build whose floor is Info.
+#define LOG_MAYBE_FLOOR_INFO(async, lvl, flg, ctx, tag, fnct, frmt, ...) \
+        do { if(((flg) & VVLogLevelInfo) != 0 && VV_LOG_FLAG_ENABLED(lvl, flg)) LOG_MACRO_CALL_SITE(async, lvl, flg, ctx, tag, fnct, frmt, ##__VA_ARGS__); } while(0)
+
+@interface VVBenchLogger : VVAbstractLogger
+@end
+
+@implementation VVBenchLogger
+
+- (void)logMessage:(VVLogMessage *)logMessage {
+}
+
+@end
+
+// Not inlined, so evaluating the arguments has a cost the compiler can't drop.
+__attribute__((noinline)) static NSString *argument(void) {
+    return @"argument";
+}
+
+static double nanosPerStatement(NSUInteger iterations, void (^block)(void)) {
+    uint64_t start = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+    for (NSUInteger i = 0; i < iterations; i++) {
+        @autoreleasepool {
+            block();
+        }
+    }
+    uint64_t elapsed = clock_gettime_nsec_np(CLOCK_UPTIME_RAW) - start;
+    return (double)elapsed / iterations;
+}
+
+int main(int argc, const char *argv[]) {
+    @autoreleasepool {
+        NSUInteger iterations = argc > 1 ? (NSUInteger)strtoull(argv[1], NULL, 10) : 1000000;
+        if (iterations == 0) {
+            fprintf(stderr, "usage: vvlogbench [iterations]\n");
+            return 1;
+        }
+
+        [VVLog sharedInstance].queueOverflowPolicy = VVLogQueueOverflowPolicyDropNewest;
+        [VVLog addLogger:[VVBenchLogger new] withLevel:VVLogLevelInfo];
+        [VVLog flushLog];
+
+        double levelOnly = nanosPerStatement(iterations, ^{
+            LOG_MAYBE_LEVEL_ONLY(YES, vvLogLevel, VVLogFlagDebug, 0, nil, __PRETTY_FUNCTION__, @"value %@ %d", argument(), 42);
+        });
+        [VVLog flushLog];
+
+        double enabledLevels = nanosPerStatement(iterations, ^{
+            LOG_MAYBE(YES, vvLogLevel, VVLogFlagDebug, 0, nil, __PRETTY_FUNCTION__, @"value %@ %d", argument(), 42);
+        });
+
+        // Nothing left but the loop, the block call and the autorelease pool.
+        double buildFloor = nanosPerStatement(iterations, ^{
+            LOG_MAYBE_FLOOR_INFO(YES, vvLogLevel, VVLogFlagDebug, 0, nil, __PRETTY_FUNCTION__, @"value %@ %d", argument(), 42);
+        });
+
+        printf("disabled Debug statement, %lu iterations\n", (unsigned long)iterations);
+        printf("  level check only  %8.1f ns\n", levelOnly);
+        printf("  enabled levels    %8.1f ns\n", enabledLevels);
+        printf("  build floor       %8.1f ns\n", buildFloor);
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+//
+//  main.m
+//  vvlogdecode
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+//  Turns uploaded binary log files (.vvlog) back into text,
+//  and compressed ones (.logz, .vvlogz) taken from the device as they are.
+//
+//  clang -fobjc-arc -framework Foundation -lz -I ../../SDKDiagnosisAssistant/Classes/Log/RVOnlyLog/CocoaVVLog main.m ../../SDKDiagnosisAssistant/Classes/Log/RVOnlyLog/CocoaVVLog/VVLogRecordFormat.m ../../SDKDiagnosisAssistant/Classes/Log/RVOnlyLog/CocoaVVLog/VVLogBlockFile.m -o vvlogdecode
+//
+//  vvlogdecode file.vvlog [more.vvlog ...]   decoded text to stdout
+//  vvlogdecode -o dir file.vvlog ...         writes dir/file.log for each file
+//
+
+#import <Foundation/Foundation.h>
+#import "VVLogRecordFormat.h"
+#import "VVLogBlockFile.h"
+
+static NSString *textWithContentsOfFile(NSString *path, NSError **error) {
+    NSData *data = nil;
+    if ([VVLogBlockFile isBlockFileAtPath:path]) {
+        data = [[[VVLogBlockFile alloc] initWithPath:path error:error] dataWithError:error];
+    } else {
+        data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:error];
+    }
+    if (!data) {
+        return nil;
+    }
+
+    if (![VVLogRecordDecoder isRecordData:data]) {
+        // Compressed text
+        return [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+    }
+    return [VVLogRecordDecoder textWithData:data error:error];
+}
+
+int main(int argc, const char *argv[]) {
+    @autoreleasepool {
+        NSMutableArray<NSString *> *paths = [NSMutableArray array];
+        NSString *outputDirectory = nil;
+
+        for (int i = 1; i < argc; i++) {
+            NSString *argument = [NSString stringWithUTF8String:argv[i]];
+            if ([argument isEqualToString:@"-o"] && i + 1 < argc) {
+                outputDirectory = [NSString stringWithUTF8String:argv[++i]];
+            } else {
+                [paths addObject:argument];
+            }
+        }
+
+        if (paths.count == 0) {
+            fprintf(stderr, "usage: vvlogdecode [-o directory] file.vvlog|file.vvlogz|file.logz ...\n");
+            return 64;
+        }
+
+        int status = 0;
+        for (NSString *path in paths) {
+            NSError *error = nil;
+            NSString *text = textWithContentsOfFile(path, &error);
+            if (!text) {
+                fprintf(stderr, "%s: %s\n", path.fileSystemRepresentation, error.localizedDescription.UTF8String);
+                status = 1;
+                continue;
+            }
+
+            if (outputDirectory) {
+                NSString *fileName = [path.lastPathComponent.stringByDeletingPathExtension stringByAppendingPathExtension:@"log"];
+                NSString *outputPath = [outputDirectory stringByAppendingPathComponent:fileName];
+                if (![text writeToFile:outputPath atomically:YES encoding:NSUTF8StringEncoding error:&error]) {
+                    fprintf(stderr, "%s: %s\n", outputPath.fileSystemRepresentation, error.localizedDescription.UTF8String);
+                    status = 1;
+                }
+            } else {
+                NSData *data = [text dataUsingEncoding:NSUTF8StringEncoding];
+                fwrite(data.bytes, 1, data.length, stdout);
+            }
+        }
+
+        return status;
+    }
+}
@@ -0,0 +1,160 @@
+//
+//  main.m
+//  vvmappedbench
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+//  Compares the two write paths of VVFileLogger, plain text without compression:
+//
+//  - direct:  `bufferSize` 0, a seek and a write per message
+//  - mapped:  messages appended to a VVMappedLogBuffer, written to the log file in chunks
+//
+//  messages/sec:  statements logged asynchronously, timed until flushLog returns.
+//  tail loss:     a child process logs numbered statements asynchronously and is killed with SIGKILL; a new
+//                 logger is opened on its directory, which writes back what the mapped buffer held, and the
+//                 statements issued but found in no log file are counted.
+//
+//  clang -O2 -fobjc-arc -framework Foundation -lz -DVV_CLI -I ../../SDKDiagnosisAssistant/Classes/Log/RVOnlyLog/CocoaVVLog main.m ../../SDKDiagnosisAssistant/Classes/Log/RVOnlyLog/CocoaVVLog/*.m -o vvmappedbench
+//
+//  vvmappedbench [messages] [buffer KB]
+//
+
+#import <Foundation/Foundation.h>
+#import <signal.h>
+#import <sys/mman.h>
+#import <time.h>
+#import "CocoaVVLog.h"
+
+static const VVLogLevel vvLogLevel = VVLogLevelVerbose;
+
+static VVFileLogger *addFileLogger(NSString *directory, NSUInteger bufferSize) {
+    VVLogFileManagerDefault *manager = [[VVLogFileManagerDefault alloc] initWithLogsDirectory:directory];
+    // Keep every file, the tail loss check reads them all
+    manager.maximumNumberOfLogFiles = 0;
+    manager.logFilesDiskQuota = 0;
+    VVFileLogger *logger = [[VVFileLogger alloc] initWithLogFileManager:manager];
+    logger.maximumFileSize = 0;
+    logger.rollingFrequency = 0;
+    logger.bufferSize = bufferSize;
+    [VVLog addLogger:logger withLevel:VVLogLevelInfo];
+    return logger;
+}
+
+static NSString *freshDirectory(NSString *name) {
+    NSString *directory = [NSTemporaryDirectory() stringByAppendingPathComponent:name];
+    [[NSFileManager defaultManager] removeItemAtPath:directory error:nil];
+    // The mapped buffer lives next to the logs directory
+    NSString *buffer = [NSString stringWithFormat:@".%@.vvbuffer", name];
+    [[NSFileManager defaultManager] removeItemAtPath:[NSTemporaryDirectory() stringByAppendingPathComponent:buffer] error:nil];
+    return directory;
+}
+
+static double messagesPerSecond(NSString *name, NSUInteger bufferSize, NSUInteger messages) {
+    VVFileLogger *logger = addFileLogger(freshDirectory(name), bufferSize);
+    uint64_t start = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+    for (NSUInteger i = 0; i < messages; i++) {
+        @autoreleasepool {
+            VVLogInfo(@"seq %lu [RVLogUploadManager] part uploaded in %u ms", (unsigned long)i, (unsigned)(i % 5000));
+        }
+    }
+    [VVLog flushLog];
+    uint64_t elapsed = clock_gettime_nsec_np(CLOCK_UPTIME_RAW) - start;
+    [VVLog removeLogger:logger];
+    return messages / (elapsed / 1e9);
+}
+
+/// Issued statements counted in a file both processes map, the child stores, the parent reads after the kill
+static volatile uint64_t *mapCounter(NSString *path) {
+    int fd = open(path.fileSystemRepresentation, O_RDWR | O_CREAT, 0644);
+    if (fd < 0 || ftruncate(fd, sizeof(uint64_t)) < 0) {
+        return NULL;
+    }
+    void *counter = mmap(NULL, sizeof(uint64_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return counter == MAP_FAILED ? NULL : (volatile uint64_t *)counter;
+}
+
+static void runChild(NSString *name, NSUInteger bufferSize) {
+    NSString *directory = [NSTemporaryDirectory() stringByAppendingPathComponent:name];
+    volatile uint64_t *issued = mapCounter([directory stringByAppendingPathExtension:@"count"]);
+    addFileLogger(directory, bufferSize);
+    for (uint64_t i = 0; issued; i++) {
+        @autoreleasepool {
+            VVLogInfo(@"seq %llu [RVLogUploadManager] part uploaded in %u ms", i, (unsigned)(i % 5000));
+        }
+        *issued = i + 1;
+    }
+}
+
+static NSIndexSet *persistedSeqs(NSString *directory) {
+    NSMutableIndexSet *seqs = [NSMutableIndexSet indexSet];
+    for (NSString *file in [[NSFileManager defaultManager] contentsOfDirectoryAtPath:directory error:nil]) {
+        NSString *text = [NSString stringWithContentsOfFile:[directory stringByAppendingPathComponent:file] encoding:NSUTF8StringEncoding error:nil];
+        for (NSString *line in [text componentsSeparatedByString:@"\n"]) {
+            NSRange range = [line rangeOfString:@"seq "];
+            if (range.location == NSNotFound) {
+                continue;
+            }
+            NSScanner *scanner = [NSScanner scannerWithString:[line substringFromIndex:NSMaxRange(range)]];
+            unsigned long long seq = 0;
+            if ([scanner scanUnsignedLongLong:&seq]) {
+                [seqs addIndex:(NSUInteger)seq];
+            }
+        }
+    }
+    return seqs;
+}
+
+static void tailLoss(NSString *label, NSString *name, NSUInteger bufferSize, NSTimeInterval runTime) {
+    NSString *directory = freshDirectory(name);
+    [[NSFileManager defaultManager] createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:nil];
+    NSString *counterPath = [directory stringByAppendingPathExtension:@"count"];
+    [[NSFileManager defaultManager] removeItemAtPath:counterPath error:nil];
+    volatile uint64_t *issued = mapCounter(counterPath);
+
+    NSTask *child = [[NSTask alloc] init];
+    child.launchPath = [NSProcessInfo processInfo].arguments[0];
+    child.arguments = @[@"--child", name, [NSString stringWithFormat:@"%lu", (unsigned long)bufferSize]];
+    [child launch];
+    [NSThread sleepForTimeInterval:runTime];
+    kill(child.processIdentifier, SIGKILL);
+    [child waitUntilExit];
+    uint64_t issuedCount = issued ? *issued : 0;
+
+    // Opening the logger again writes back the buffer of the killed process, on the first statement
+    VVFileLogger *logger = addFileLogger(directory, bufferSize);
+    VVLogInfo(@"reopened");
+    [VVLog flushLog];
+    [VVLog removeLogger:logger];
+
+    NSIndexSet *seqs = persistedSeqs(directory);
+    uint64_t lost = issuedCount > seqs.count ? issuedCount - seqs.count : 0;
+    printf("  %-8s %10llu issued  %10lu persisted  %8llu lost\n", label.UTF8String,
+           issuedCount, (unsigned long)seqs.count, lost);
+}
+
+int main(int argc, const char *argv[]) {
+    @autoreleasepool {
+        if (argc > 3 && strcmp(argv[1], "--child") == 0) {
+            runChild(@(argv[2]), (NSUInteger)strtoull(argv[3], NULL, 10));
+            return 0;
+        }
+
+        NSUInteger messages = argc > 1 ? (NSUInteger)strtoull(argv[1], NULL, 10) : 200000;
+        NSUInteger bufferSize = (argc > 2 ? (NSUInteger)strtoull(argv[2], NULL, 10) : 256) * 1024;
+        if (messages == 0 || bufferSize == 0) {
+            fprintf(stderr, "usage: vvmappedbench [messages] [buffer KB]\n");
+            return 1;
+        }
+
+        printf("messages/sec, %lu messages, %lu KB buffer\n", (unsigned long)messages, (unsigned long)bufferSize / 1024);
+        printf("  direct   %10.0f\n", messagesPerSecond(@"vvmappedbench-direct", 0, messages));
+        printf("  mapped   %10.0f\n", messagesPerSecond(@"vvmappedbench-mapped", bufferSize, messages));
+
+        printf("tail loss, child killed after 0.5 s\n");
+        tailLoss(@"direct", @"vvmappedbench-direct", 0, 0.5);
+        tailLoss(@"mapped", @"vvmappedbench-mapped", bufferSize, 0.5);
+    }
+    return 0;
+}
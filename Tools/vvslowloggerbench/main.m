@@ -0,0 +1,137 @@
+//
+//  main.m
+//  vvslowloggerbench
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+//  Issues asynchronous statements to a fast logger and a slow one (a fixed cost per message), under each queue
+//  overflow policy, and shows what the slow logger costs:
+//
+//  - issue:     mean and max time of a statement on the issuing thread
+//  - fast lag:  how long after the last statement was issued the fast logger logged it
+//  - received:  messages each logger logged, dropped ones excluded, and what VVLog counted as dropped
+//
+//  Under every policy the slow logger must degrade only itself: the fast logger receives every statement the queue
+//  kept (all of them under Block, the default) within a bounded lag, and the slow one the rest of them less what
+//  VVLog counted as dropped for it.
+//
+//  clang -O2 -fobjc-arc -framework Foundation -lz -DVV_CLI -I ../../SDKDiagnosisAssistant/Classes/Log/RVOnlyLog/CocoaVVLog main.m ../../SDKDiagnosisAssistant/Classes/Log/RVOnlyLog/CocoaVVLog/*.m -o vvslowloggerbench
+//
+//  vvslowloggerbench [statements] [slow logger us per message]
+//
+
+#import <Foundation/Foundation.h>
+#import <stdatomic.h>
+#import <time.h>
+#import "CocoaVVLog.h"
+
+static const VVLogLevel vvLogLevel = VVLogLevelVerbose;
+
+// Most the fast logger may trail the last statement, far below what the slow logger takes for all of them
+static const double kMaxFastLagMillis = 250;
+
+@interface VVCountingLogger : VVAbstractLogger
+@property (nonatomic, assign) uint64_t costNanos;
+@property (nonatomic, assign) uint64_t received;
+@property (nonatomic, assign) uint64_t lastLogged;
+@end
+
+@implementation VVCountingLogger
+
+- (void)logMessage:(VVLogMessage *)logMessage {
+    // Busy, so the cost holds at microseconds where a sleep would not
+    uint64_t start = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+    while (clock_gettime_nsec_np(CLOCK_UPTIME_RAW) - start < self.costNanos) {
+    }
+    if (![logMessage.message hasPrefix:@"VVLog:"]) {
+        self.received++;
+        self.lastLogged = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+    }
+}
+
+@end
+
+static uint64_t droppedFor(VVLog *vvlog, id<VVLogger> logger) {
+    for (VVLoggerInformation *information in vvlog.allLoggersWithLevel) {
+        if (information.logger == logger) {
+            return information.droppedCount;
+        }
+    }
+    return 0;
+}
+
+static BOOL run(NSString *label, VVLogQueueOverflowPolicy policy, NSUInteger statements, uint64_t slowNanos) {
+    VVLog *vvlog = [[VVLog alloc] init];
+    vvlog.queueOverflowPolicy = policy;
+    VVCountingLogger *fast = [VVCountingLogger new];
+    VVCountingLogger *slow = [VVCountingLogger new];
+    slow.costNanos = slowNanos;
+    [vvlog addLogger:fast withLevel:VVLogLevelInfo];
+    [vvlog addLogger:slow withLevel:VVLogLevelInfo];
+
+    uint64_t start = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+    for (NSUInteger i = 0; i < statements; i++) {
+        @autoreleasepool {
+            VVLogInfoToVVLog(vvlog, @"statement %lu", (unsigned long)i);
+        }
+    }
+    uint64_t issued = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+    VVLogQueueStatistics statistics = vvlog.queueStatistics;
+
+    // The fast logger is done long before the flush returns unless the slow one holds it back
+    while (fast.received + droppedFor(vvlog, fast) + statistics.droppedCount < statements &&
+           clock_gettime_nsec_np(CLOCK_UPTIME_RAW) - issued < 60 * NSEC_PER_SEC) {
+        usleep(100);
+        statistics = vvlog.queueStatistics;
+    }
+    double fastLag = fast.lastLogged > issued ? (fast.lastLogged - issued) / 1e6 : 0;
+    [vvlog flushLog];
+    statistics = vvlog.queueStatistics;
+
+    printf("  %-11s issue %7.1f ns mean %9.3f ms max  fast lag %8.3f ms  received fast %7llu slow %7llu  dropped queue %llu slow %llu\n",
+           label.UTF8String, (double)(issued - start) / statements, statistics.maxEnqueueNanos / 1e6, fastLag,
+           fast.received, slow.received, statistics.droppedCount, droppedFor(vvlog, slow));
+
+    uint64_t slowDropped = droppedFor(vvlog, slow);
+    [vvlog removeAllLoggers];
+
+    BOOL ok = YES;
+    if (policy == VVLogQueueOverflowPolicyBlock && fast.received != statements) {
+        printf("FAIL: %s lost statements for the fast logger\n", label.UTF8String);
+        ok = NO;
+    }
+    if (fast.received + statistics.droppedCount != statements) {
+        printf("FAIL: %s dropped statements for the fast logger\n", label.UTF8String);
+        ok = NO;
+    }
+    if (slow.received + slowDropped + statistics.droppedCount != statements) {
+        printf("FAIL: %s lost statements for the slow logger it did not count\n", label.UTF8String);
+        ok = NO;
+    }
+    if (fastLag > kMaxFastLagMillis) {
+        printf("FAIL: %s fast logger lag %.3f ms over %.0f ms, the slow logger held it back\n", label.UTF8String, fastLag, kMaxFastLagMillis);
+        ok = NO;
+    }
+    return ok;
+}
+
+int main(int argc, const char *argv[]) {
+    @autoreleasepool {
+        NSUInteger statements = argc > 1 ? (NSUInteger)strtoull(argv[1], NULL, 10) : 100000;
+        uint64_t slowNanos = (argc > 2 ? strtoull(argv[2], NULL, 10) : 20) * NSEC_PER_USEC;
+        if (statements == 0) {
+            fprintf(stderr, "usage: vvslowloggerbench [statements] [slow logger us per message]\n");
+            return 1;
+        }
+
+        printf("%lu statements, slow logger %llu us per message\n", (unsigned long)statements, slowNanos / NSEC_PER_USEC);
+        BOOL ok = run(@"Block", VVLogQueueOverflowPolicyBlock, statements, slowNanos);
+        ok = run(@"DropNewest", VVLogQueueOverflowPolicyDropNewest, statements, slowNanos) && ok;
+        ok = run(@"DropOldest", VVLogQueueOverflowPolicyDropOldest, statements, slowNanos) && ok;
+        if (!ok) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+//
+//  main.m
+//  vvzipbench
+//
+//  Created by Ron-Samkulami on 12/26/2023.
+//  Copyright (c) 2023 Ron-Samkulami. All rights reserved.
+//
+//  Measures how fast a directory of logs is zipped, in MB of input per second:
+//
+//  - serial:     one zlib stream per entry on the calling thread, as createZipFileAtPath has always done
+//  - N threads:  entries cut into chunks deflated on N threads and written in order
+//
+//  Without a directory it zips 24 files of 4 MB of generated log lines. Each archive is checked with `unzip -tq`
+//  when unzip is installed.
+//
+//  clang -O2 -fobjc-arc -framework Foundation -framework Security -lz -I ../../SDKDiagnosisAssistant/Classes/Log/Upload/VVZipArchive -I ../../SDKDiagnosisAssistant/Classes/Log/RVOnlyLog/CocoaVVLog main.m ../../SDKDiagnosisAssistant/Classes/Log/Upload/VVZipArchive/VVZipArchive.m ../../SDKDiagnosisAssistant/Classes/Log/Upload/VVZipArchive/minizip/*.c ../../SDKDiagnosisAssistant/Classes/Log/RVOnlyLog/CocoaVVLog/VVLogBlockFile.m -o vvzipbench
+//
+//  vvzipbench [directory]
+//
+
+#import <Foundation/Foundation.h>
+#import <time.h>
+#import "VVZipArchive.h"
+
+static NSString *generateLogs(void) {
+    NSString *directory = [NSTemporaryDirectory() stringByAppendingPathComponent:@"vvzipbench-logs"];
+    [[NSFileManager defaultManager] removeItemAtPath:directory error:nil];
+    [[NSFileManager defaultManager] createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:nil];
+
+    static const char *const levels[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+    uint32_t seed = 1;
+    for (int file = 0; file < 24; file++) {
+        NSMutableData *data = [NSMutableData dataWithCapacity:4 * 1024 * 1024];
+        for (int line = 0; data.length < 4 * 1024 * 1024; line++) {
+            seed = seed * 1103515245 + 12345;
+            char buffer[160];
+            int length = snprintf(buffer, sizeof(buffer), "2023-12-26 10:%02d:%02d.%03d [%s] [RVLogUploadManager] part %d uploaded in %u ms\n",
+                                  line / 3600 % 60, line / 60 % 60, line % 1000, levels[seed >> 30], line, (seed >> 16) % 5000);
+            [data appendBytes:buffer length:(NSUInteger)length];
+        }
+        [data writeToFile:[directory stringByAppendingPathComponent:[NSString stringWithFormat:@"log-%02d.log", file]] atomically:NO];
+    }
+    return directory;
+}
+
+static unsigned long long sizeOfDirectory(NSString *directory) {
+    unsigned long long size = 0;
+    NSDirectoryEnumerator *enumerator = [[NSFileManager defaultManager] enumeratorAtPath:directory];
+    for (NSString *subpath in enumerator) {
+        if ([enumerator.fileAttributes.fileType isEqualToString:NSFileTypeRegular]) {
+            size += enumerator.fileAttributes.fileSize;
+        }
+    }
+    return size;
+}
+
+static BOOL unzipTest(NSString *path) {
+    if (![[NSFileManager defaultManager] isExecutableFileAtPath:@"/usr/bin/unzip"]) {
+        return YES;
+    }
+    NSTask *task = [NSTask launchedTaskWithLaunchPath:@"/usr/bin/unzip" arguments:@[@"-tq", path]];
+    [task waitUntilExit];
+    return task.terminationStatus == 0;
+}
+
+static void report(NSString *label, NSString *zipPath, unsigned long long inputSize, BOOL (^zip)(void)) {
+    [[NSFileManager defaultManager] removeItemAtPath:zipPath error:nil];
+    uint64_t start = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+    BOOL success = zip();
+    uint64_t elapsed = clock_gettime_nsec_np(CLOCK_UPTIME_RAW) - start;
+
+    unsigned long long zipSize = [[NSFileManager defaultManager] attributesOfItemAtPath:zipPath error:nil].fileSize;
+    const char *status = !success ? "failed" : (unzipTest(zipPath) ? "ok" : "unzip -t failed");
+    printf("  %-10s %8.1f MB/s  %10llu bytes  %s\n", label.UTF8String,
+           inputSize / 1e6 / (elapsed / 1e9), zipSize, status);
+}
+
+int main(int argc, const char *argv[]) {
+    @autoreleasepool {
+        NSString *directory = argc > 1 ? @(argv[1]) : generateLogs();
+        unsigned long long inputSize = sizeOfDirectory(directory);
+        if (inputSize == 0) {
+            fprintf(stderr, "usage: vvzipbench [directory]\n");
+            return 1;
+        }
+        NSString *zipPath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"vvzipbench.zip"];
+        NSUInteger cores = [NSProcessInfo processInfo].activeProcessorCount;
+
+        printf("%s, %llu bytes, %lu cores\n", directory.UTF8String, inputSize, (unsigned long)cores);
+
+        report(@"serial", zipPath, inputSize, ^BOOL{
+            return [VVZipArchive createZipFileAtPath:zipPath withContentsOfDirectory:directory keepParentDirectory:NO compressionLevel:Z_DEFAULT_COMPRESSION password:nil AES:NO progressHandler:nil];
+        });
+
+        for (NSUInteger threads = 1; threads <= cores; threads = (threads * 2 > cores && threads < cores) ? cores : threads * 2) {
+            report([NSString stringWithFormat:@"%lu threads", (unsigned long)threads], zipPath, inputSize, ^BOOL{
+                return [VVZipArchive createZipFileAtPath:zipPath withContentsOfDirectory:directory keepParentDirectory:NO compressionLevel:Z_DEFAULT_COMPRESSION threadCount:threads progressHandler:nil];
+            });
+        }
+
+        [[NSFileManager defaultManager] removeItemAtPath:zipPath error:nil];
+    }
+    return 0;
+}